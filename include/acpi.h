@@ -0,0 +1,110 @@
+/* acpi.h - Minimal ACPI table discovery */
+
+#ifndef ACPI_H
+#define ACPI_H
+
+#include "types.h"
+
+/* Root System Description Pointer (ACPI 1.0 part) */
+typedef struct {
+    char signature[8];       /* "RSD PTR " */
+    uint8_t checksum;        /* Checksum of the first 20 bytes */
+    char oem_id[6];          /* OEM identifier */
+    uint8_t revision;        /* 0 = ACPI 1.0, 2 = ACPI 2.0+ */
+    uint32_t rsdt_address;   /* Physical address of the RSDT */
+} __attribute__((packed)) acpi_rsdp_t;
+
+/* Common System Description Table header */
+typedef struct {
+    char signature[4];       /* Table signature ("APIC", "HPET", ...) */
+    uint32_t length;         /* Length of the whole table in bytes */
+    uint8_t revision;
+    uint8_t checksum;        /* Whole table sums to zero */
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+/* Generic Address Structure */
+typedef struct {
+    uint8_t address_space;   /* 0 = system memory, 1 = system I/O */
+    uint8_t bit_width;
+    uint8_t bit_offset;
+    uint8_t access_size;
+    uint64_t address;
+} __attribute__((packed)) acpi_gas_t;
+
+/* HPET description table */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t event_timer_block_id;
+    acpi_gas_t base_address; /* MMIO base of the HPET registers */
+    uint8_t hpet_number;
+    uint16_t min_tick;
+    uint8_t page_protection;
+} __attribute__((packed)) acpi_hpet_t;
+
+/* Multiple APIC Description Table ("APIC"), followed by variable-length
+ * entries up to header.length */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t lapic_address;  /* Physical address of the local APICs */
+    uint32_t flags;          /* Bit 0: dual 8259 PICs installed */
+} __attribute__((packed)) acpi_madt_t;
+
+/* MADT entry types */
+#define ACPI_MADT_LAPIC 0        /* Processor local APIC */
+#define ACPI_MADT_IOAPIC 1       /* I/O APIC */
+#define ACPI_MADT_ISO 2          /* Interrupt source override */
+
+/* Common MADT entry header */
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) acpi_madt_entry_t;
+
+/* Processor local APIC entry */
+typedef struct {
+    acpi_madt_entry_t header;
+    uint8_t acpi_id;         /* ACPI processor UID */
+    uint8_t apic_id;         /* Local APIC ID */
+    uint32_t flags;          /* Bit 0: enabled, bit 1: can be enabled */
+} __attribute__((packed)) acpi_madt_lapic_t;
+
+#define ACPI_MADT_LAPIC_ENABLED 0x1
+#define ACPI_MADT_LAPIC_ONLINE_CAPABLE 0x2
+
+/* I/O APIC entry */
+typedef struct {
+    acpi_madt_entry_t header;
+    uint8_t ioapic_id;
+    uint8_t reserved;
+    uint32_t address;        /* Physical address of its registers */
+    uint32_t gsi_base;       /* First global system interrupt it handles */
+} __attribute__((packed)) acpi_madt_ioapic_t;
+
+/* Interrupt source override: ISA IRQ source arrives on global system
+ * interrupt gsi, with the polarity and trigger mode in flags */
+typedef struct {
+    acpi_madt_entry_t header;
+    uint8_t bus;             /* 0 = ISA */
+    uint8_t source;          /* ISA IRQ */
+    uint32_t gsi;
+    uint16_t flags;
+} __attribute__((packed)) acpi_madt_iso_t;
+
+/* MPS INTI flags of an override (00 in either field: bus default) */
+#define ACPI_MADT_POLARITY_MASK    0x3
+#define ACPI_MADT_POLARITY_LOW     0x3
+#define ACPI_MADT_TRIGGER_MASK     0xC
+#define ACPI_MADT_TRIGGER_LEVEL    0xC
+
+/* Locate the RSDP and map the RSDT (returns 0 on success) */
+int acpi_init(void);
+
+/* Find a table by its 4-character signature (NULL if absent) */
+const acpi_sdt_header_t *acpi_find_table(const char *signature);
+
+#endif /* ACPI_H */
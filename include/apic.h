@@ -0,0 +1,76 @@
+/* apic.h - Local APIC: CPU enumeration, inter-processor interrupts, timer */
+
+#ifndef APIC_H
+#define APIC_H
+
+#include "types.h"
+
+/* Local APIC register offsets */
+#define APIC_REG_ID        0x020     /* Bits 24-31: APIC ID */
+#define APIC_REG_VERSION   0x030
+#define APIC_REG_TPR       0x080     /* Task priority */
+#define APIC_REG_EOI       0x0B0
+#define APIC_REG_SVR       0x0F0     /* Spurious vector, software enable */
+#define APIC_REG_ESR       0x280     /* Error status */
+#define APIC_REG_ICR_LOW   0x300     /* Interrupt command (writing sends) */
+#define APIC_REG_ICR_HIGH  0x310     /* Bits 24-31: destination APIC ID */
+#define APIC_REG_LVT_TIMER 0x320
+#define APIC_REG_LVT_LINT0 0x350
+#define APIC_REG_LVT_LINT1 0x360
+#define APIC_REG_LVT_ERROR 0x370
+#define APIC_REG_TIMER_INITIAL 0x380 /* Writing starts the countdown */
+#define APIC_REG_TIMER_CURRENT 0x390
+#define APIC_REG_TIMER_DIVIDE  0x3E0
+
+#define APIC_SVR_ENABLE    0x100
+#define APIC_LVT_MASKED    0x10000
+#define APIC_TIMER_PERIODIC 0x20000
+#define APIC_TIMER_DIVIDE_16 0x3     /* Count at bus clock / 16 */
+
+/* Interrupt command fields */
+#define APIC_ICR_FIXED     0x000
+#define APIC_ICR_INIT      0x500
+#define APIC_ICR_STARTUP   0x600
+#define APIC_ICR_PENDING   0x1000    /* Delivery status: not yet accepted */
+#define APIC_ICR_ASSERT    0x4000
+#define APIC_ICR_LEVEL     0x8000
+
+/* Vector of spurious local APIC interrupts (never acknowledged) */
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+/* Map and enable the boot CPU's local APIC and list the CPUs in the
+ * MADT (returns 0 on success, -1 without a local APIC) */
+int apic_init(void);
+
+/* Enable the local APIC of an application processor */
+void apic_init_ap(void);
+
+/* Whether apic_init found and enabled the local APIC */
+bool apic_enabled(void);
+
+/* This CPU's APIC ID */
+uint32_t apic_id(void);
+
+/* Acknowledge the interrupt being handled */
+void apic_eoi(void);
+
+/* Calibrate the local APIC timer against the PIT and start it on this
+ * CPU at frequency Hz (returns 0 on success) */
+int apic_timer_init(uint32_t frequency);
+
+/* Whether the local APIC timers give every CPU its own tick */
+bool apic_timer_enabled(void);
+
+/* Timer counts per second (bus clock / 16) */
+uint32_t apic_timer_frequency(void);
+
+/* Inter-processor interrupts to one CPU (by APIC ID) */
+void apic_send_ipi(uint32_t apic_id, uint32_t vector);
+void apic_send_init(uint32_t apic_id);
+void apic_send_startup(uint32_t apic_id, uint32_t page);
+
+/* CPUs listed (and enabled) in the MADT, boot CPU first */
+uint32_t apic_cpu_count(void);
+uint32_t apic_cpu_apic_id(uint32_t index);
+
+#endif /* APIC_H */
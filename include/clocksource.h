@@ -0,0 +1,70 @@
+/* clocksource.h - High-resolution clocksource framework */
+
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+#include "types.h"
+
+/* Time unit conversions */
+#define NSEC_PER_USEC 1000U
+#define NSEC_PER_MSEC 1000000U
+#define NSEC_PER_SEC  1000000000U
+#define USEC_PER_SEC  1000000U
+
+/* Ratings used to pick the best available source */
+#define CLOCKSOURCE_RATING_TSC_INVARIANT 300
+#define CLOCKSOURCE_RATING_HPET          250
+#define CLOCKSOURCE_RATING_TSC           200
+#define CLOCKSOURCE_RATING_PIT           110
+#define CLOCKSOURCE_RATING_JIFFIES       1
+
+/* A free-running hardware counter */
+typedef struct clocksource {
+    const char *name;              /* Short name ("tsc", "hpet", ...) */
+    int rating;                    /* Higher is better */
+    uint64_t (*read)(void);        /* Read the raw counter */
+    uint64_t mask;                 /* Valid bits of the counter */
+    uint32_t freq_khz;             /* Counter frequency in kHz */
+    uint32_t mult;                 /* ns = (cycles * mult) >> shift (0 = from freq_khz) */
+    uint32_t shift;
+    void (*enable)(void);          /* Timekeeping moved to it (optional) */
+    void (*disable)(void);         /* ... or away from it (optional) */
+    struct clocksource *next;      /* Registered sources list */
+} clocksource_t;
+
+/* Probe and calibrate the available clocksources (TSC, HPET) */
+void clocksource_init(void);
+
+/* Register a clocksource and switch to it if it rates higher */
+int clocksource_register(clocksource_t *cs);
+
+/* Force a clocksource by name (returns -1 if unknown) */
+int clocksource_select(const char *name);
+
+/* Look up a registered clocksource by name (NULL if unknown) */
+clocksource_t *clocksource_find(const char *name);
+
+/* Get the clocksource currently used for timekeeping */
+clocksource_t *clocksource_get_current(void);
+
+/* Print registered clocksources */
+void clocksource_print_info(void);
+
+/* Fold elapsed cycles into the time base (called on each timer tick) */
+void clocksource_tick(void);
+
+/* Compute mult/shift so that (cycles_at_from * mult) >> shift is in units of to */
+void clocksource_calc_mult_shift(uint32_t *mult, uint32_t *shift, uint32_t from, uint32_t to);
+
+/* Convert a cycle delta of a clocksource to nanoseconds */
+uint64_t clocksource_cyc2ns(const clocksource_t *cs, uint64_t cycles);
+
+/* Advance of read() across a one-shot PIT window of latch PIT cycles
+ * (0 if the PIT never fires); used to calibrate other counters */
+uint64_t clocksource_measure_pit_window(uint32_t latch, uint64_t (*read)(void));
+
+/* Monotonic time since boot */
+uint64_t ktime_get_ns(void);
+uint64_t ktime_get_us(void);
+
+#endif /* CLOCKSOURCE_H */
@@ -0,0 +1,101 @@
+/* cpu.h - CPU feature detection and privileged register access */
+
+#ifndef CPU_H
+#define CPU_H
+
+#include "types.h"
+
+/* CPUID leaf 1 EDX feature bits */
+#define CPUID_FEAT_EDX_FPU   (1 << 0)   /* On-chip x87 FPU */
+#define CPUID_FEAT_EDX_TSC   (1 << 4)   /* Time Stamp Counter */
+#define CPUID_FEAT_EDX_MSR   (1 << 5)   /* RDMSR/WRMSR */
+#define CPUID_FEAT_EDX_APIC  (1 << 9)   /* On-chip local APIC */
+#define CPUID_FEAT_EDX_SEP   (1 << 11)  /* SYSENTER/SYSEXIT */
+#define CPUID_FEAT_EDX_FXSR  (1 << 24)  /* FXSAVE/FXRSTOR */
+#define CPUID_FEAT_EDX_SSE   (1 << 25)  /* SSE */
+#define CPUID_FEAT_EDX_SSE2  (1 << 26)  /* SSE2 */
+
+/* Control register bits */
+#define CR0_MP         (1 << 1)     /* Monitor coprocessor: WAIT honours TS */
+#define CR0_EM         (1 << 2)     /* Emulate FPU (trap every FPU instruction) */
+#define CR0_TS         (1 << 3)     /* Task switched: next FPU use raises #NM */
+#define CR0_NE         (1 << 5)     /* Native x87 error reporting (#MF) */
+#define CR0_WP         (1 << 16)    /* Write protect: ring 0 honours read-only pages */
+#define CR4_OSFXSR     (1 << 9)     /* OS supports FXSAVE/FXRSTOR and SSE */
+#define CR4_OSXMMEXCPT (1 << 10)    /* OS handles SIMD exceptions (#XM) */
+
+/* Local APIC base address and global enable */
+#define MSR_IA32_APIC_BASE    0x1B
+#define APIC_BASE_BSP         (1 << 8)   /* This is the bootstrap processor */
+#define APIC_BASE_ENABLE      (1 << 11)  /* Local APIC enabled */
+#define APIC_BASE_ADDR_MASK   0xFFFFF000
+
+/* SYSENTER target: CS (SS = CS + 8), ESP and EIP loaded on entry */
+#define MSR_IA32_SYSENTER_CS  0x174
+#define MSR_IA32_SYSENTER_ESP 0x175
+#define MSR_IA32_SYSENTER_EIP 0x176
+
+/* CPUID leaf 0x80000007 EDX feature bits */
+#define CPUID_APM_EDX_INVARIANT_TSC (1 << 8)  /* TSC ticks at a constant rate */
+
+/* Execute CPUID for a given leaf */
+static inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx,
+                         uint32_t *ecx, uint32_t *edx) {
+    __asm__ volatile("cpuid"
+                     : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                     : "a"(leaf), "c"(0));
+}
+
+/* Read the Time Stamp Counter */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Read a Model Specific Register */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Write a Model Specific Register */
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value),
+                     "d"((uint32_t)(value >> 32)));
+}
+
+/* Control register access */
+static inline uint32_t read_cr0(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+/* Spin-wait hint for busy loops */
+static inline void cpu_relax(void) {
+    __asm__ volatile("pause" ::: "memory");
+}
+
+/* Check whether CPUID reports a leaf 1 EDX feature */
+bool cpu_has_feature(uint32_t edx_bit);
+
+/* Check whether the TSC is invariant across P/C-states */
+bool cpu_has_invariant_tsc(void);
+
+#endif /* CPU_H */
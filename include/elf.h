@@ -0,0 +1,64 @@
+/* elf.h - ELF32 executable format (i386) */
+
+#ifndef ELF_H
+#define ELF_H
+
+#include "types.h"
+
+/* e_ident */
+#define EI_NIDENT     16
+#define ELFMAG0       0x7F
+#define ELFMAG1       'E'
+#define ELFMAG2       'L'
+#define ELFMAG3       'F'
+#define EI_CLASS      4
+#define EI_DATA       5
+#define EI_VERSION    6
+#define ELFCLASS32    1
+#define ELFDATA2LSB   1
+#define EV_CURRENT    1
+
+/* e_type, e_machine */
+#define ET_EXEC       2
+#define EM_386        3
+
+/* p_type */
+#define PT_NULL       0
+#define PT_LOAD       1
+
+/* p_flags */
+#define PF_X          0x1
+#define PF_W          0x2
+#define PF_R          0x4
+
+/* File header */
+typedef struct {
+    uint8_t  e_ident[EI_NIDENT];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;                /* Entry point address */
+    uint32_t e_phoff;                /* Program header table offset */
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} __attribute__((packed)) elf32_ehdr_t;
+
+/* Program header (segment) */
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_offset;               /* File offset of the segment */
+    uint32_t p_vaddr;                /* Virtual address */
+    uint32_t p_paddr;
+    uint32_t p_filesz;               /* Bytes in the file */
+    uint32_t p_memsz;                /* Bytes in memory (rest zero-filled) */
+    uint32_t p_flags;                /* PF_R / PF_W / PF_X */
+    uint32_t p_align;
+} __attribute__((packed)) elf32_phdr_t;
+
+#endif /* ELF_H */
@@ -0,0 +1,74 @@
+/* exec.h - ELF program loading with demand-paged segments */
+
+#ifndef EXEC_H
+#define EXEC_H
+
+#include "types.h"
+#include "vfs.h"
+#include "process.h"
+
+/* Most PT_LOAD segments accepted in one image */
+#define EXEC_MAX_SEGMENTS 8
+
+/* Reference-counted copy of the executable's node, shared by its mappings */
+typedef struct vm_file {
+    uint32_t refs;
+    vfs_node_t node;
+} vm_file_t;
+
+/* A mapped region, filled in page by page on first access. Bytes from
+ * start up to file_end come from the file, the rest reads as zero (BSS). */
+typedef struct vm_area {
+    uint32_t start;                  /* Page-aligned start address */
+    uint32_t end;                    /* Page-aligned end address (exclusive) */
+    uint32_t flags;                  /* SECTION_READ / WRITE / EXEC */
+    vm_file_t *file;                 /* Backing file (NULL: demand-zero) */
+    uint32_t file_offset;            /* File offset of start */
+    uint32_t file_end;               /* Address where file data stops */
+    struct vm_area *next;
+} vm_area_t;
+
+/* Create /bin with the built-in images (hello, true) */
+void exec_init(void);
+
+/* Replace the current process image with the ELF at path; only returns
+ * on error. Only the headers are read here, segments fault in later. */
+int process_execve(const char *path);
+
+/* Start the ELF at path as a new child of the current process, without
+ * copying or borrowing anything from the caller */
+process_t *process_spawn_path(const char *path);
+
+/* Fill in the page at addr from its mapping (0 on success, -1 if the
+ * address is not mapped or the access is not allowed) */
+int vma_fault(mm_t *mm, uint32_t addr, uint32_t err_code, bool can_block);
+
+/* Give a copied address space its own copy of the mapping list */
+int vma_dup(mm_t *dst, const mm_t *src);
+
+/* Drop every mapping of an address space */
+void vma_free_all(mm_t *mm);
+
+/* sys_execve(path, argv, envp) */
+int sys_execve(uint32_t path, uint32_t argv, uint32_t envp, uint32_t unused1, uint32_t unused2);
+
+/* sys_spawn(path, argv): start the binary as a new child, returns its PID */
+int sys_spawn(uint32_t path, uint32_t argv, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+
+/* Print load/fault statistics */
+void exec_print_stats(void);
+
+/* Snapshot of the counters (for before/after comparisons) */
+typedef struct {
+    uint32_t execs;                  /* Successful execve calls */
+    uint32_t spawns;                 /* Processes started by spawn */
+    uint64_t load_ns;                /* Time spent loading (execve and spawn) */
+    uint32_t file_faults;            /* File-backed pages mapped */
+    uint32_t cache_faults;           /* ... found in the page cache (no read) */
+    uint32_t zero_faults;            /* Demand-zero pages */
+    uint64_t bytes_read;             /* File bytes read by faults */
+} exec_stats_t;
+
+void exec_get_stats(exec_stats_t *stats);
+
+#endif /* EXEC_H */
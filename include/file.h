@@ -0,0 +1,101 @@
+/* file.h - Per-process file descriptor tables and open files */
+
+#ifndef FILE_H
+#define FILE_H
+
+#include "types.h"
+#include "vfs.h"
+
+/* Descriptors per table */
+#define FILES_MAX 32
+
+/* Console descriptors every table starts with */
+#define STDIN_FILENO  0
+#define STDOUT_FILENO 1
+#define STDERR_FILENO 2
+
+/* open() flags */
+#define O_RDONLY  0x0
+#define O_WRONLY  0x1
+#define O_RDWR    0x2
+#define O_ACCMODE 0x3
+#define O_APPEND  0x400
+
+/* lseek() whence */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+/* Entries accepted by readv/writev */
+#define IOV_MAX 16
+
+/* Bounce buffer size: file data moves in chunks of up to this much */
+#define FILE_IO_CHUNK (32 * 1024)
+
+/* What an open file refers to */
+typedef enum {
+    FILE_TYPE_VFS = 1,               /* File or directory node */
+    FILE_TYPE_SOCKET,                /* Socket (socket.c id) */
+    FILE_TYPE_CONSOLE                /* Keyboard in, screen out */
+} file_type_t;
+
+/* Open file, shared by descriptors that dup2 or fork copied */
+typedef struct file {
+    uint32_t count;                  /* Descriptors and in-flight calls using it */
+    file_type_t type;
+    uint32_t flags;                  /* O_* given to open */
+    uint32_t pos;                    /* Offset for read/write/lseek */
+    vfs_node_t *node;                /* FILE_TYPE_VFS */
+    int sock;                        /* FILE_TYPE_SOCKET */
+} file_t;
+
+/* Descriptor table, shared by CLONE_FILES threads */
+typedef struct files_struct {
+    uint32_t users;
+    file_t *fd[FILES_MAX];
+} files_struct_t;
+
+/* readv/writev buffer */
+typedef struct iovec {
+    uint32_t iov_base;
+    uint32_t iov_len;
+} iovec_t;
+
+/* Tables: a fresh one (console on 0-2), a fork copy, and references */
+files_struct_t *files_alloc(void);
+files_struct_t *files_copy(files_struct_t *src);
+void files_get(files_struct_t *files);
+void files_put(files_struct_t *files);
+
+/* Take a reference to the file behind fd in files (NULL if none) */
+file_t *files_fget(files_struct_t *files, int fd);
+
+/* Same for the current process's table */
+file_t *fget(int fd);
+void fput(file_t *file);
+
+/* Kernel-side positional I/O on an open file (no offset update) */
+int file_pread(file_t *file, void *buf, uint32_t len, uint32_t offset);
+int file_pwrite(file_t *file, const void *buf, uint32_t len, uint32_t offset);
+
+/* Sockets in the current process's table: install a socket id as a new
+ * descriptor, or get the id behind a descriptor (-1 if not a socket) */
+int fd_install_socket(int sock);
+int fd_to_socket(int fd);
+
+/* Print the current process's descriptors */
+void files_print(void);
+
+/* System calls */
+int sys_open(uint32_t path, uint32_t flags, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+int sys_close(uint32_t fd, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
+int sys_read(uint32_t fd, uint32_t buf, uint32_t count, uint32_t unused1, uint32_t unused2);
+int sys_write(uint32_t fd, uint32_t buf, uint32_t count, uint32_t unused1, uint32_t unused2);
+int sys_lseek(uint32_t fd, uint32_t offset, uint32_t whence, uint32_t unused1, uint32_t unused2);
+int sys_pread(uint32_t fd, uint32_t buf, uint32_t count, uint32_t offset, uint32_t unused);
+int sys_pwrite(uint32_t fd, uint32_t buf, uint32_t count, uint32_t offset, uint32_t unused);
+int sys_readv(uint32_t fd, uint32_t iov, uint32_t iovcnt, uint32_t unused1, uint32_t unused2);
+int sys_writev(uint32_t fd, uint32_t iov, uint32_t iovcnt, uint32_t unused1, uint32_t unused2);
+int sys_dup2(uint32_t oldfd, uint32_t newfd, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+
+#endif /* FILE_H */
@@ -0,0 +1,39 @@
+/* fpu.h - Lazy x87/SSE state management */
+
+#ifndef FPU_H
+#define FPU_H
+
+#include "types.h"
+
+struct process;
+
+/* FXSAVE image (FNSAVE uses the first 108 bytes on CPUs without FXSR) */
+#define FPU_STATE_SIZE 512
+
+typedef struct fpu_state {
+    uint8_t area[FPU_STATE_SIZE];    /* Must be 16-byte aligned for FXSAVE */
+    void *alloc;                     /* Unaligned kmalloc block to free */
+} __attribute__((aligned(16))) fpu_state_t;
+
+/* Enable the FPU and SSE, capture the initial state and hook #NM */
+void fpu_init(void);
+
+/* Enable the FPU on an application processor */
+void fpu_init_ap(void);
+
+/* Set or clear CR0.TS for the task about to run (called on context switch) */
+void fpu_switch(struct process *prev, struct process *next);
+
+/* Give a forked child a copy of the parent's FPU state */
+int fpu_fork(struct process *child, struct process *parent);
+
+/* Drop a process's FPU state (on exit) */
+void fpu_release(struct process *proc);
+
+/* Check whether SSE instructions may be used */
+bool fpu_has_sse(void);
+
+/* Print FPU features and lazy switching statistics */
+void fpu_print_info(void);
+
+#endif /* FPU_H */
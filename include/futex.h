@@ -0,0 +1,77 @@
+/* futex.h - Fast user-space locking: sleep/wake on a shared word */
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include "types.h"
+#include "syscall.h"
+
+/* sys_futex operations */
+#define FUTEX_WAIT    0   /* Sleep if *uaddr == val (arg4: timespec_t *, 0 = forever) */
+#define FUTEX_WAKE    1   /* Wake up to val waiters */
+#define FUTEX_REQUEUE 3   /* Wake val waiters, move up to arg4 others to uaddr2 */
+
+/* Waiters are hashed on the physical address of the word */
+#define FUTEX_HASH_BITS 6
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS)
+
+/* Set up the hash buckets */
+void futex_init(void);
+
+/* sys_futex(uaddr, op, val, timeout / nr_requeue, uaddr2) */
+int sys_futex(uint32_t uaddr, uint32_t op, uint32_t val, uint32_t arg4, uint32_t uaddr2);
+
+/* Print operation counts and bucket occupancy */
+void futex_print_stats(void);
+
+/* ===== User-side mutex (no syscall unless contended) ===== */
+
+static inline int futex_call(volatile uint32_t *uaddr, uint32_t op, uint32_t val,
+                             uint32_t arg4, volatile uint32_t *uaddr2) {
+    int result;
+    __asm__ volatile(
+        "int $0x80"
+        : "=a"(result)
+        : "a"(SYS_FUTEX), "b"(uaddr), "c"(op), "d"(val), "S"(arg4), "D"(uaddr2)
+        : "memory"
+    );
+    return result;
+}
+
+static inline uint32_t futex_cmpxchg(volatile uint32_t *ptr, uint32_t old, uint32_t new_val) {
+    uint32_t prev;
+    __asm__ volatile("lock cmpxchgl %2, %1"
+                     : "=a"(prev), "+m"(*ptr)
+                     : "r"(new_val), "0"(old)
+                     : "memory");
+    return prev;
+}
+
+static inline uint32_t futex_xchg(volatile uint32_t *ptr, uint32_t val) {
+    __asm__ volatile("xchgl %0, %1" : "+r"(val), "+m"(*ptr) : : "memory");
+    return val;
+}
+
+/* Mutex word: 0 unlocked, 1 locked, 2 locked with possible waiters */
+static inline void futex_mutex_lock(volatile uint32_t *mutex) {
+    uint32_t c = futex_cmpxchg(mutex, 0, 1);
+    if (c == 0) {
+        return;  /* Uncontended: no syscall */
+    }
+
+    if (c != 2) {
+        c = futex_xchg(mutex, 2);
+    }
+    while (c != 0) {
+        futex_call(mutex, FUTEX_WAIT, 2, 0, NULL);
+        c = futex_xchg(mutex, 2);
+    }
+}
+
+static inline void futex_mutex_unlock(volatile uint32_t *mutex) {
+    if (futex_xchg(mutex, 0) == 2) {
+        futex_call(mutex, FUTEX_WAKE, 1, 0, NULL);
+    }
+}
+
+#endif /* FUTEX_H */
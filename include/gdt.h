@@ -21,8 +21,12 @@ struct gdt_ptr {
     uint32_t base;           /* Address of the first GDT entry */
 } __attribute__((packed));
 
+/* Per-CPU data segments (loaded into GS), one per CPU (SMP_MAX_CPUS) */
+#define GDT_PERCPU_FIRST 6
+#define GDT_PERCPU_COUNT 8
+
 /* Number of GDT entries */
-#define GDT_ENTRIES 6
+#define GDT_ENTRIES (GDT_PERCPU_FIRST + GDT_PERCPU_COUNT)
 
 /* Segment selectors (offset into GDT) */
 #define KERNEL_CODE_SEGMENT  0x08  /* 1st descriptor */
@@ -32,6 +36,9 @@ struct gdt_ptr {
 #define USER_DATA_SEGMENT    0x28  /* 5th descriptor */
 #define USER_STACK_SEGMENT   0x30  /* 6th descriptor */
 
+/* Selector of a CPU's per-CPU data segment */
+#define GDT_PERCPU_SELECTOR(cpu) ((GDT_PERCPU_FIRST + (cpu)) << 3)
+
 /* Access byte flags */
 #define GDT_ACCESS_PRESENT   0x80  /* Segment is present */
 #define GDT_ACCESS_RING0     0x00  /* Ring 0 (kernel) */
@@ -49,6 +56,9 @@ struct gdt_ptr {
 /* Initialize the GDT */
 void gdt_init(void);
 
+/* Point CPU cpu's data segment at its per-CPU area */
+void gdt_set_percpu(uint32_t cpu, uint32_t base, uint32_t size);
+
 /* External assembly function to load GDT */
 extern void gdt_flush(uint32_t gdt_ptr);
 
@@ -0,0 +1,24 @@
+/* hpet.h - High Precision Event Timer */
+
+#ifndef HPET_H
+#define HPET_H
+
+#include "types.h"
+
+/* HPET register offsets */
+#define HPET_REG_CAPABILITIES 0x000  /* Low: capabilities, high: period (fs) */
+#define HPET_REG_PERIOD       0x004
+#define HPET_REG_CONFIG       0x010
+#define HPET_REG_COUNTER      0x0F0  /* Main counter (low 32 bits) */
+#define HPET_REG_COUNTER_HI   0x0F4
+
+#define HPET_CAP_COUNTER_64   (1 << 13)  /* Main counter is 64 bits wide */
+#define HPET_CFG_ENABLE       (1 << 0)   /* Main counter runs */
+
+/* Maximum legal counter period: 100 ns, in femtoseconds */
+#define HPET_MAX_PERIOD_FS    100000000
+
+/* Locate the HPET via ACPI, start it and register it as a clocksource */
+int hpet_init(void);
+
+#endif /* HPET_H */
@@ -0,0 +1,42 @@
+/* hrtimer.h - Nanosecond-resolution timers kept in a red-black tree */
+
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+#include "types.h"
+#include "rbtree.h"
+
+/* Deadlines closer than this are busy-waited instead of slept on (queued
+ * timers are only checked on the tick, so they fire up to a tick late) */
+#define HRTIMER_SPIN_THRESHOLD_NS 100000ULL
+
+/* Callback return value: re-queue (after updating expires) or not */
+typedef enum {
+    HRTIMER_NORESTART = 0,
+    HRTIMER_RESTART
+} hrtimer_restart_t;
+
+/* A one-shot timer expiring at an absolute ktime (ns since boot) */
+typedef struct hrtimer {
+    rb_node_t node;                                   /* Tree linkage */
+    uint64_t expires;                                 /* Absolute expiry (ns) */
+    hrtimer_restart_t (*function)(struct hrtimer *);  /* Runs in timer IRQ context */
+    bool queued;                                      /* Currently in the tree */
+} hrtimer_t;
+
+/* Prepare a timer before first use */
+void hrtimer_init(hrtimer_t *timer, hrtimer_restart_t (*function)(hrtimer_t *));
+
+/* Arm a timer at an absolute ktime (re-arms if already queued) */
+void hrtimer_start(hrtimer_t *timer, uint64_t expires_ns);
+
+/* Disarm a timer (returns 1 if it was queued) */
+int hrtimer_cancel(hrtimer_t *timer);
+
+/* Expire due timers (called from the timer interrupt) */
+void hrtimer_run_queues(void);
+
+/* Earliest pending deadline (0 if none) */
+uint64_t hrtimer_next_expiry(void);
+
+#endif /* HRTIMER_H */
@@ -102,4 +102,10 @@ uint8_t ide_read_status(uint16_t io_base);
 /* Print IDE device information */
 void ide_print_devices(void);
 
+/* Complete commands via IRQ14/15 and the block softirq */
+void ide_enable_interrupts(void);
+
+/* Print completion interrupt statistics */
+void ide_print_irq_stats(void);
+
 #endif /* IDE_H */
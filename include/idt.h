@@ -97,6 +97,9 @@ struct interrupt_frame {
 #define IRQ14 0x2E  /* Primary ATA */
 #define IRQ15 0x2F  /* Secondary ATA */
 
+/* EFLAGS interrupt enable flag */
+#define EFLAGS_IF 0x200
+
 /* Software interrupt for syscalls */
 #define INT_SYSCALL 0x80
 
@@ -118,6 +121,14 @@ void idt_register_handler(uint8_t num, interrupt_handler_t handler);
 /* Unregister a C interrupt handler */
 void idt_unregister_handler(uint8_t num);
 
+/* Load the IDT on this CPU */
+void idt_load(void);
+
+/* Take/drop the interrupt lock for this CPU (interrupts_disable/enable do
+ * this; entry paths that clear IF themselves call them directly) */
+void irq_lock_acquire(void);
+void irq_lock_release(void);
+
 /* Enable/disable interrupts */
 void interrupts_enable(void);
 void interrupts_disable(void);
@@ -125,6 +136,10 @@ void interrupts_disable(void);
 /* Check if interrupts are enabled */
 bool interrupts_enabled(void);
 
+/* Disable interrupts for a critical section and restore the previous state */
+bool interrupts_save(void);
+void interrupts_restore(bool was_enabled);
+
 /* External assembly interrupt stubs */
 extern void isr0(void);   /* Division by Zero */
 extern void isr1(void);   /* Debug */
@@ -168,6 +183,13 @@ extern void irq15(void);  /* Secondary ATA */
 /* Syscall handler */
 extern void isr128(void); /* Syscall (INT 0x80) */
 
+/* Inter-processor and local APIC interrupts (smp.h) */
+extern void isr240(void); /* Reschedule */
+extern void isr241(void); /* Local timer */
+extern void isr252(void); /* TLB shootdown */
+extern void isr253(void); /* Stop */
+extern void isr255(void); /* APIC spurious */
+
 /* Print IDT information for debugging */
 void idt_print_info(void);
 
@@ -0,0 +1,44 @@
+/* ioapic.h - I/O APIC: routing of ISA interrupts to the local APICs */
+
+#ifndef IOAPIC_H
+#define IOAPIC_H
+
+#include "types.h"
+
+/* I/O APICs handled (MADT entries beyond this are ignored) */
+#define IOAPIC_MAX 4
+
+/* Register window: write the register index to REGSEL, access it at WINDOW */
+#define IOAPIC_REGSEL      0x00
+#define IOAPIC_WINDOW      0x10
+
+/* Registers */
+#define IOAPIC_REG_ID      0x00
+#define IOAPIC_REG_VERSION 0x01      /* Bits 16-23: last redirection entry */
+#define IOAPIC_REG_REDTBL(pin) (0x10 + 2 * (pin))   /* Low dword; high at +1 */
+
+/* Redirection entry, low dword (fixed delivery, physical destination) */
+#define IOAPIC_REDIR_ACTIVE_LOW 0x2000
+#define IOAPIC_REDIR_LEVEL      0x8000
+#define IOAPIC_REDIR_MASKED     0x10000
+
+/* ISA IRQ lines */
+#define IOAPIC_ISA_IRQS 16
+
+/* Find the I/O APICs and the ISA overrides in the MADT, map them and
+ * mask every pin (returns 0 on success, -1 without an I/O APIC) */
+int ioapic_init(void);
+
+/* Deliver ISA IRQ irq as vector to the CPU with APIC ID dest */
+void ioapic_route_isa(uint8_t irq, uint8_t vector, uint32_t dest, bool masked);
+
+/* Mask or unmask the pin of ISA IRQ irq */
+void ioapic_set_masked(uint8_t irq, bool masked);
+
+/* Mask every pin of every I/O APIC */
+void ioapic_mask_all(void);
+
+/* Print the I/O APICs and the ISA routes */
+void ioapic_print_info(void);
+
+#endif /* IOAPIC_H */
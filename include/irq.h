@@ -0,0 +1,37 @@
+/* irq.h - ISA IRQ lines: 8259 PIC or I/O APIC */
+
+#ifndef IRQ_H
+#define IRQ_H
+
+#include "types.h"
+
+/* ISA IRQ lines (vectors IRQ0..IRQ15 with either controller) */
+#define IRQ_LINES 16
+
+typedef enum {
+    IRQ_CONTROLLER_PIC,
+    IRQ_CONTROLLER_IOAPIC,
+} irq_controller_t;
+
+/* Acknowledge IRQ irq (from its handler) */
+void irq_eoi(uint8_t irq);
+
+/* Mask or unmask IRQ irq on the controller in use */
+void irq_mask(uint8_t irq);
+void irq_unmask(uint8_t irq);
+
+/* Route every line through the I/O APIC to the boot CPU and mask the PIC
+ * (returns -1 without a local APIC or an I/O APIC) */
+int irq_use_ioapic(void);
+
+/* Controller in use */
+irq_controller_t irq_get_controller(void);
+const char *irq_controller_name(void);
+
+/* Count an interrupt on line irq and the cycles its handler took */
+void irq_account(uint8_t irq, uint64_t cycles);
+
+/* Print the controller, per-line counts and handler cost, and the routes */
+void irq_print_info(void);
+
+#endif /* IRQ_H */
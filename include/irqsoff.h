@@ -0,0 +1,49 @@
+/* irqsoff.h - Interrupts-off and preemption-off latency tracer */
+
+#ifndef IRQSOFF_H
+#define IRQSOFF_H
+
+#include "types.h"
+
+/* Longest windows kept per kind */
+#define IRQSOFF_WORST 8
+
+/* Return addresses kept from where a window opened */
+#define IRQSOFF_STACK_DEPTH 6
+
+typedef enum {
+    IRQSOFF_IRQS = 0,        /* Interrupts disabled */
+    IRQSOFF_PREEMPT,         /* Preempt count raised by preempt_disable() */
+    IRQSOFF_NR_KINDS
+} irqsoff_kind_t;
+
+/* One window, measured with the TSC */
+typedef struct irqsoff_record {
+    uint64_t cycles;
+    uint32_t cpu;
+    uint32_t end_ip;                          /* Where it closed */
+    uint32_t stack[IRQSOFF_STACK_DEPTH];      /* Where it opened, innermost first */
+} irqsoff_record_t;
+
+/* Whether windows are being traced (checked inline by the hooks) */
+extern volatile bool irqsoff_tracing;
+
+/* Hooks: the interrupt flag went 1->0 or is about to go 0->1 on this CPU
+ * (interrupts_disable/enable and interrupt entry/exit) */
+void trace_irqs_off(void);
+void trace_irqs_on(void);
+
+/* Hooks: the preempt_disable() depth went 0->1 or is about to go 1->0 */
+void trace_preempt_off(void);
+void trace_preempt_on(void);
+
+/* Start or stop tracing (starting forgets windows already open) */
+void irqsoff_enable(bool on);
+
+/* Forget the recorded windows */
+void irqsoff_reset(void);
+
+/* Print the longest windows of each kind with the stacks that opened them */
+void irqsoff_print(void);
+
+#endif /* IRQSOFF_H */
@@ -49,6 +49,9 @@ int keyboard_getchar(void);
 /* Check if key is available */
 bool keyboard_haskey(void);
 
+/* Block the current process until a key is available */
+void keyboard_wait(void);
+
 /* Set keyboard layout */
 void keyboard_set_layout(keyboard_layout_t layout);
 
@@ -20,6 +20,9 @@ void kfree(void *ptr);
 /* Get size of allocated block */
 size_t ksize(void *ptr);
 
+/* Number of kmalloc and kfree calls so far (for before/after checks) */
+void kmalloc_get_counts(size_t *allocations, size_t *frees);
+
 /* Get kernel heap statistics */
 void kmalloc_stats(void);
 
@@ -0,0 +1,15 @@
+/* kthread.h - Kernel threads */
+
+#ifndef KTHREAD_H
+#define KTHREAD_H
+
+#include "process.h"
+
+/* Create and start a kernel thread running fn(data) in the kernel
+ * address space; its return value becomes the exit status */
+process_t *kthread_create(int (*fn)(void *data), void *data, const char *name);
+
+/* Check whether the current process is a kernel thread */
+bool kthread_is_current(void);
+
+#endif /* KTHREAD_H */
@@ -0,0 +1,57 @@
+/* ktimer.h - Kernel timers on a hierarchical timing wheel */
+
+#ifndef KTIMER_H
+#define KTIMER_H
+
+#include "types.h"
+#include "list.h"
+
+/* Wheel geometry: one 256-slot root level and four 64-slot cascades */
+#define TVR_BITS 8
+#define TVN_BITS 6
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVN_MASK (TVN_SIZE - 1)
+
+/* Wrap-safe tick comparisons */
+#define time_after(a, b)     ((int32_t)((b) - (a)) < 0)
+#define time_after_eq(a, b)  ((int32_t)((a) - (b)) >= 0)
+#define time_before(a, b)    time_after(b, a)
+
+/* Longest timeout accepted by schedule_timeout() */
+#define MAX_SCHEDULE_TIMEOUT 0x7FFFFFFF
+
+/* A one-shot timer expiring at an absolute tick count */
+typedef struct timer_list {
+    list_head_t entry;                 /* Wheel slot linkage */
+    uint32_t expires;                  /* Absolute expiry in timer ticks */
+    void (*function)(uint32_t data);   /* Callback, runs in timer IRQ context */
+    uint32_t data;                     /* Argument passed to the callback */
+} timer_list_t;
+
+/* Initialize the timer wheel */
+void ktimer_init(void);
+
+/* Prepare a timer before first use */
+void init_timer(timer_list_t *timer, void (*function)(uint32_t), uint32_t data);
+
+/* Arm a timer (must not already be pending) */
+void add_timer(timer_list_t *timer);
+
+/* Disarm a timer (returns 1 if it was pending) */
+int del_timer(timer_list_t *timer);
+
+/* Re-arm a timer with a new expiry (returns 1 if it was pending) */
+int mod_timer(timer_list_t *timer, uint32_t expires);
+
+/* Check whether a timer is armed */
+bool timer_pending(const timer_list_t *timer);
+
+/* Expire due timers (called from the timer interrupt) */
+void run_timers(void);
+
+/* Convert between milliseconds and timer ticks (rounding up) */
+uint32_t msecs_to_ticks(uint32_t msecs);
+
+#endif /* KTIMER_H */
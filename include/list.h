@@ -0,0 +1,79 @@
+/* list.h - Intrusive circular doubly linked lists */
+
+#ifndef LIST_H
+#define LIST_H
+
+#include "types.h"
+
+/* List node, embedded in the structure being linked */
+typedef struct list_head {
+    struct list_head *next;
+    struct list_head *prev;
+} list_head_t;
+
+/* Get the containing structure from an embedded member */
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - __builtin_offsetof(type, member)))
+
+#define list_entry(ptr, type, member) container_of(ptr, type, member)
+
+#define LIST_HEAD_INIT(name) { &(name), &(name) }
+
+/* Iterate over a list (safe against removal of the current node) */
+#define list_for_each_safe(pos, tmp, head) \
+    for (pos = (head)->next, tmp = pos->next; pos != (head); pos = tmp, tmp = pos->next)
+
+#define list_for_each(pos, head) \
+    for (pos = (head)->next; pos != (head); pos = pos->next)
+
+static inline void list_init(list_head_t *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static inline bool list_empty(const list_head_t *head) {
+    return head->next == head;
+}
+
+static inline void list_insert(list_head_t *node, list_head_t *prev, list_head_t *next) {
+    next->prev = node;
+    node->next = next;
+    node->prev = prev;
+    prev->next = node;
+}
+
+/* Insert after head (stack order) */
+static inline void list_add(list_head_t *node, list_head_t *head) {
+    list_insert(node, head, head->next);
+}
+
+/* Insert before head (queue order) */
+static inline void list_add_tail(list_head_t *node, list_head_t *head) {
+    list_insert(node, head->prev, head);
+}
+
+/* Unlink a node and leave it pointing to itself */
+static inline void list_del(list_head_t *node) {
+    node->next->prev = node->prev;
+    node->prev->next = node->next;
+    node->next = node;
+    node->prev = node;
+}
+
+/* Move every node of list to the tail of head, leaving list empty */
+static inline void list_splice_tail_init(list_head_t *list, list_head_t *head) {
+    if (list_empty(list)) {
+        return;
+    }
+    list_head_t *first = list->next;
+    list_head_t *last = list->prev;
+    list_head_t *at = head->prev;
+
+    at->next = first;
+    first->prev = at;
+    last->next = head;
+    head->prev = last;
+    list_init(list);
+}
+
+#endif /* LIST_H */
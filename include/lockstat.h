@@ -0,0 +1,50 @@
+/* lockstat.h - Lock contention statistics per lock class */
+
+#ifndef LOCKSTAT_H
+#define LOCKSTAT_H
+
+#include "types.h"
+
+/* Counters shared by every lock of a class (all run queue locks are one
+ * class); a lock without a class is not counted */
+typedef struct lock_class {
+    const char *name;
+    uint32_t acquisitions;
+    uint32_t contentions;            /* Acquisitions that had to wait */
+    uint64_t wait_cycles;            /* Spent waiting, contended ones only */
+    uint32_t holds;                  /* Timed holds (rwlocks: writers only) */
+    uint64_t hold_cycles;
+    uint32_t max_wait_cycles;
+    uint32_t max_hold_cycles;
+    volatile uint32_t registered;    /* On the class list */
+    struct lock_class *next;
+} lock_class_t;
+
+#define LOCK_CLASS_INIT(class_name) { .name = (class_name) }
+
+/* Collection switch (off at boot) */
+extern volatile bool lockstat_enabled;
+
+/* Whether acquisitions of a lock of this class are being recorded */
+static inline bool lockstat_active(lock_class_t *cls) {
+    return cls != NULL && lockstat_enabled;
+}
+
+/* Record an acquisition; wait_start is the rdtsc() value when waiting
+ * began, 0 if the lock was free. Returns the start of the hold (0 if
+ * collection has just been turned off). */
+uint64_t lockstat_acquired(lock_class_t *cls, uint64_t wait_start);
+
+/* Record a release of a lock held since held_since (no-op for 0) */
+void lockstat_released(lock_class_t *cls, uint64_t held_since);
+
+/* Turn collection on or off */
+void lockstat_enable(bool on);
+
+/* Clear the counters of every class */
+void lockstat_reset(void);
+
+/* Print the classes seen so far, busiest first */
+void lockstat_print(void);
+
+#endif /* LOCKSTAT_H */
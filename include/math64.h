@@ -0,0 +1,67 @@
+/* math64.h - 64-bit arithmetic helpers (no libgcc available) */
+
+#ifndef MATH64_H
+#define MATH64_H
+
+#include "types.h"
+
+/* Divide a 64-bit value by a 32-bit divisor, returning the quotient.
+ * GCC would emit a call to __udivdi3 for a plain 64-bit division, which
+ * we do not link against, so do it in two steps with DIVL instead. */
+static inline uint64_t div_u64_rem(uint64_t dividend, uint32_t divisor, uint32_t *remainder) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t low = (uint32_t)dividend;
+    uint32_t quot_high = 0;
+    uint32_t rem;
+
+    if (high >= divisor) {
+        quot_high = high / divisor;
+        high %= divisor;
+    }
+
+    __asm__("divl %4" : "=a"(low), "=d"(rem) : "a"(low), "d"(high), "rm"(divisor));
+
+    if (remainder) {
+        *remainder = rem;
+    }
+    return ((uint64_t)quot_high << 32) | low;
+}
+
+/* Divide a 64-bit value by a 32-bit divisor */
+static inline uint64_t div_u64(uint64_t dividend, uint32_t divisor) {
+    return div_u64_rem(dividend, divisor, NULL);
+}
+
+/* Compute (value * mult) >> shift without losing the upper bits */
+static inline uint64_t mul_u64_u32_shr(uint64_t value, uint32_t mult, uint32_t shift) {
+    uint32_t high = (uint32_t)(value >> 32);
+    uint32_t low = (uint32_t)value;
+    uint64_t result = ((uint64_t)low * mult) >> shift;
+
+    if (high) {
+        result += ((uint64_t)high * mult) << (32 - shift);
+    }
+    return result;
+}
+
+/* Index of the highest set bit (value must be non-zero) */
+static inline uint32_t ilog2_u32(uint32_t value) {
+    uint32_t bit;
+    __asm__("bsrl %1, %0" : "=r"(bit) : "rm"(value) : "cc");
+    return bit;
+}
+
+/* Index of the lowest set bit (value must be non-zero) */
+static inline uint32_t ffs_u32(uint32_t value) {
+    uint32_t bit;
+    __asm__("bsfl %1, %0" : "=r"(bit) : "rm"(value) : "cc");
+    return bit;
+}
+
+/* Index of the highest set bit of a 64-bit value (value must be non-zero) */
+static inline uint32_t ilog2_u64(uint64_t value) {
+    uint32_t high = (uint32_t)(value >> 32);
+    return high ? 32 + ilog2_u32(high) : ilog2_u32((uint32_t)value);
+}
+
+#endif /* MATH64_H */
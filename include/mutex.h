@@ -0,0 +1,38 @@
+/* mutex.h - Sleeping locks for process context */
+
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include "types.h"
+#include "wait.h"
+#include "lockstat.h"
+
+struct process;
+
+/* Lock whose waiters sleep: the holder may block (page faults, disk I/O,
+ * kmalloc) while holding it. Not for interrupt handlers. */
+typedef struct mutex {
+    volatile uint32_t locked;
+    struct process *owner;
+    wait_queue_head_t wait;          /* Exclusive waiters, woken one at a time */
+    lock_class_t *class;
+    uint64_t held_since;
+} mutex_t;
+
+#define MUTEX_INIT(name, cls) { 0, NULL, WAIT_QUEUE_HEAD_INIT((name).wait), &(cls), 0 }
+
+void mutex_init(mutex_t *mutex, lock_class_t *class);
+
+/* Take the mutex, sleeping while another process holds it (spinning
+ * before the first process exists). Must be called with interrupts on,
+ * outside interrupt handlers: anything else is reported. */
+void mutex_lock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+
+/* Take the mutex only if it is free (true if taken) */
+bool mutex_trylock(mutex_t *mutex);
+
+/* Check whether someone holds the mutex */
+bool mutex_is_locked(mutex_t *mutex);
+
+#endif /* MUTEX_H */
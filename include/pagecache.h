@@ -0,0 +1,36 @@
+/* pagecache.h - Shared frames of read-only executable file pages */
+
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include "types.h"
+#include "vfs.h"
+
+/* Buckets of the (file, offset) and frame lookup hashes */
+#define PAGECACHE_HASH_BITS 6
+#define PAGECACHE_HASH_SIZE (1 << PAGECACHE_HASH_BITS)
+
+/* Pages kept after their last mapping goes away, for the next exec */
+#define PAGECACHE_MAX_UNMAPPED 32
+
+/* Get the frame holding len bytes of node at offset (zero-filled past
+ * len), reading it in on a miss; takes a mapping reference. Returns the
+ * frame address, or 0 on error. *bytes_read is 0 on a hit. can_block:
+ * the caller has interrupts off but may sleep for the read; they are
+ * off again on return. */
+uint32_t pagecache_get_page(vfs_node_t *node, uint32_t offset, uint32_t len,
+                            bool can_block, uint32_t *bytes_read);
+
+/* Take another mapping reference (fork copies a PAGE_CACHED entry) */
+void pagecache_get(uint32_t frame);
+
+/* Drop a mapping reference; unmapped pages stay cached until evicted */
+void pagecache_put(uint32_t frame);
+
+/* Forget unmapped pages of a file that is being written */
+void pagecache_invalidate(vfs_node_t *node);
+
+/* Print hit/miss counts and sharing */
+void pagecache_print_stats(void);
+
+#endif /* PAGECACHE_H */
@@ -15,8 +15,21 @@
 #define PAGE_PRESENT    0x1   /* Page is present in memory */
 #define PAGE_WRITE      0x2   /* Page is writable */
 #define PAGE_USER       0x4   /* Page is accessible from user mode */
+#define PAGE_WRITETHROUGH 0x8 /* Write-through caching */
+#define PAGE_NOCACHE    0x10  /* Caching disabled (MMIO) */
 #define PAGE_ACCESSED   0x20  /* Page was accessed */
 #define PAGE_DIRTY      0x40  /* Page was written to */
+#define PAGE_SHARED     0x200 /* Available bit: frame shared by MAP_SHARED mappings */
+#define PAGE_CACHED     0x400 /* Available bit: read-only frame owned by the page cache */
+
+/* Page fault error code bits */
+#define PAGE_FAULT_PRESENT 0x1  /* Protection violation (clear: page not present) */
+#define PAGE_FAULT_WRITE   0x2  /* Faulting access was a write */
+#define PAGE_FAULT_USER    0x4  /* Fault happened in user mode */
+
+/* Kernel MMIO window (shared by every page directory) */
+#define KERNEL_MMIO_BASE 0xFF000000
+#define KERNEL_MMIO_SIZE 0x01000000  /* 16MB, 4 page tables */
 
 /* Page directory entry */
 typedef uint32_t page_directory_entry_t;
@@ -43,6 +56,9 @@ void paging_enable(void);
 /* Get the current page directory */
 page_directory_t *paging_get_directory(void);
 
+/* Get the kernel page directory */
+page_directory_t *paging_get_kernel_directory(void);
+
 /* Map a virtual address to a physical address */
 void paging_map_page(uint32_t virt_addr, uint32_t phys_addr, uint32_t flags);
 
@@ -52,8 +68,15 @@ void paging_unmap_page(uint32_t virt_addr);
 /* Get physical address from virtual address */
 uint32_t paging_get_physical_address(uint32_t virt_addr);
 
-/* Page fault handler */
-void page_fault_handler(void);
+/* Map a physical MMIO range into the kernel MMIO window (uncached) */
+void *paging_map_mmio(uint32_t phys_addr, uint32_t size);
+
+/* Map a kernel page read-only for everyone at a vDSO address */
+void paging_map_vdso_page(uint32_t virt_addr, uint32_t phys_addr);
+
+/* Page fault handler (registered for EXC_PAGE_FAULT) */
+struct interrupt_frame;
+void page_fault_handler(struct interrupt_frame *frame);
 
 /* Process memory management functions (KFS_5) */
 page_directory_t *paging_create_directory(void);
@@ -62,5 +85,22 @@ page_directory_t *paging_clone_directory(page_directory_t *src);
 void paging_map_page_in_directory(page_directory_t *dir, uint32_t virt_addr,
                                    uint32_t phys_addr, uint32_t flags);
 void paging_switch_directory(page_directory_t *dir);
+uint32_t paging_unmap_page_in_directory(page_directory_t *dir, uint32_t virt_addr);
+
+/* Shared (MAP_SHARED) frames are kept across fork and freed with their
+ * last mapping, page cache frames are handed back to the cache;
+ * paging_release_frame() frees the frame of any entry */
+int paging_share_frame(uint32_t phys);
+void paging_shared_frame_get(uint32_t phys);
+void paging_release_frame(uint32_t entry);
+
+/* Allocate a page-aligned frame for a user mapping (freed by release) */
+void *paging_alloc_frame(void);
+
+/* Number of CR3 reloads and of switches that kept the directory */
+void paging_get_switch_stats(uint32_t *loads, uint32_t *skips);
+
+/* Count present pages outside the shared kernel mappings */
+uint32_t paging_count_user_pages(page_directory_t *dir);
 
 #endif /* PAGING_H */
@@ -0,0 +1,96 @@
+/* preempt.h - Kernel preemption control */
+
+#ifndef PREEMPT_H
+#define PREEMPT_H
+
+#include "types.h"
+#include "smp.h"
+#include "irqsoff.h"
+
+/* Per-CPU preempt count: preempt_disable() depth in the low bits, one
+ * HARDIRQ_OFFSET per interrupt handler being run above them. The CPU may
+ * switch processes only when it is zero. */
+#define PREEMPT_MASK    0x0000FFFF
+#define HARDIRQ_OFFSET  0x00010000
+#define HARDIRQ_MASK    0xFFFF0000
+
+/* When a wakeup takes the CPU from the process running there */
+typedef enum {
+    PREEMPT_THROUGHPUT = 0,   /* At the end of its time slice: fewer switches */
+    PREEMPT_LOWLATENCY        /* Right away, on the next preemption point */
+} preempt_mode_t;
+
+/* Mode at boot ('preempt' selects another) */
+#define PREEMPT_MODE_DEFAULT PREEMPT_LOWLATENCY
+
+/* Current preempt count of this CPU */
+static inline uint32_t preempt_count(void) {
+    uint32_t count;
+    __asm__ volatile("movl %%gs:%c1, %0"
+                     : "=r"(count) : "i"(__builtin_offsetof(cpu_t, preempt_count)));
+    return count;
+}
+
+/* One instruction each, so the process cannot move to another CPU
+ * between finding this CPU's count and changing it */
+static inline void preempt_count_add(uint32_t value) {
+    __asm__ volatile("addl %0, %%gs:%c1"
+                     : : "ri"(value), "i"(__builtin_offsetof(cpu_t, preempt_count)) : "memory");
+}
+
+static inline void preempt_count_sub(uint32_t value) {
+    __asm__ volatile("subl %0, %%gs:%c1"
+                     : : "ri"(value), "i"(__builtin_offsetof(cpu_t, preempt_count)) : "memory");
+}
+
+/* Inside an interrupt handler on this CPU */
+static inline bool in_irq(void) {
+    return (preempt_count() & HARDIRQ_MASK) != 0;
+}
+
+/* Keep this CPU's process until the matching preempt_enable() */
+static inline void preempt_disable(void) {
+    preempt_count_add(1);
+    if (irqsoff_tracing && (preempt_count() & PREEMPT_MASK) == 1) {
+        trace_preempt_off();
+    }
+}
+
+/* Drop a preempt_disable() without acting on a pending reschedule */
+static inline void preempt_enable_no_resched(void) {
+    if (irqsoff_tracing && (preempt_count() & PREEMPT_MASK) == 1) {
+        trace_preempt_on();
+    }
+    preempt_count_sub(1);
+}
+
+/* Drop a preempt_disable(), switching now if a reschedule came due */
+void preempt_enable(void);
+
+/* Whether this CPU may switch processes here: count zero, interrupts
+ * enabled and not running softirqs */
+bool preemptible(void);
+
+/* Preemption point for long kernel loops: give up the CPU if a reschedule
+ * is pending and nothing forbids it. Returns true if it switched. */
+bool cond_resched(void);
+
+/* On the way out of an interrupt: switch if a reschedule is pending and
+ * the interrupted code was preemptible, else leave it for preempt_enable() */
+void preempt_irq_return(void);
+
+/* Schedule with a lock or interrupt handler still counted: report it
+ * (the count stays with the process, see process_switch) */
+void preempt_check_schedule(void);
+
+/* Whether a wakeup should preempt the process running on cpu */
+bool preempt_wakeup_preempts(cpu_t *cpu);
+
+void preempt_set_mode(preempt_mode_t mode);
+preempt_mode_t preempt_get_mode(void);
+const char *preempt_mode_name(preempt_mode_t mode);
+
+/* Print the mode and each CPU's preemption counters */
+void preempt_print_info(void);
+
+#endif /* PREEMPT_H */
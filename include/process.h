@@ -5,9 +5,26 @@
 
 #include "types.h"
 #include "paging.h"
+#include "ktimer.h"
+#include "hrtimer.h"
+#include "wait.h"
+#include "list.h"
+#include "timer.h"
+#include "schedstat.h"
+#include "smp.h"
 
-/* Maximum number of processes */
-#define MAX_PROCESSES 256
+/* PIDs are allocated from 1 to PID_MAX - 1 (0 is the idle task) */
+#define PID_MAX 32768
+
+/* Buckets of the PID lookup hash */
+#define PID_HASH_BITS 8
+#define PID_HASH_SIZE (1 << PID_HASH_BITS)
+
+/* Released PCBs kept (with their kernel stacks) for reuse */
+#define PCB_CACHE_MAX 32
+
+/* Per-process kernel stack size */
+#define KERNEL_STACK_SIZE PAGE_SIZE
 
 /* Process states */
 typedef enum {
@@ -31,11 +48,17 @@ typedef struct {
 /* Signal handler type */
 typedef void (*process_signal_handler_t)(int signal);
 
-/* Process signal queue entry */
-typedef struct signal_queue_entry {
-    int signal;
-    struct signal_queue_entry *next;
-} signal_queue_entry_t;
+/* Handler of a real-time signal that also receives the queued value */
+typedef void (*process_siginfo_handler_t)(int signal, uint32_t value);
+
+/* Queued real-time signals per process (no allocation when sending) */
+#define PROCESS_SIGQUEUE_MAX 16
+
+/* A queued real-time signal and its payload */
+typedef struct sigqueue_entry {
+    uint8_t signal;
+    uint32_t value;
+} sigqueue_entry_t;
 
 /* Process memory sections (ELF-like) */
 typedef struct {
@@ -49,20 +72,55 @@ typedef struct {
 #define SECTION_WRITE   0x2
 #define SECTION_EXEC    0x4
 
-/* Process Control Block (PCB) */
-typedef struct process {
-    uint32_t pid;                    /* Process ID */
-    process_state_t state;           /* Process state */
+/* Process flags */
+#define PROCESS_FLAG_KTHREAD 0x01    /* Kernel thread: no user address space */
+#define PROCESS_FLAG_STRACE  0x02    /* Syscalls go to the sysstat trace (inherited) */
 
-    /* Parent and children */
-    struct process *parent;
-    struct process *children;        /* Linked list of children */
-    struct process *next_sibling;
+/* Length of a process name (including terminator) */
+#define PROCESS_NAME_LEN 16
 
-    /* Memory management */
-    page_directory_t *page_directory; /* Virtual address space */
-    uint32_t kernel_stack;            /* Kernel stack pointer */
-    uint32_t user_stack;              /* User stack pointer */
+/* Per-process resource usage (top command, /proc/<pid>/stat) */
+typedef struct {
+    uint32_t utime;                  /* Ticks charged outside syscalls */
+    uint32_t stime;                  /* Ticks charged to syscalls and kernel threads */
+    uint32_t nvcsw;                  /* Voluntary context switches (blocked, exited) */
+    uint32_t nivcsw;                 /* Involuntary context switches (preempted) */
+    uint32_t page_faults;            /* Page faults taken */
+    uint32_t syscalls;               /* System calls made */
+    uint64_t read_bytes;             /* Bytes returned by read/recv */
+    uint64_t write_bytes;            /* Bytes accepted by write/send */
+    uint32_t in_syscall;             /* Syscall nesting depth (0 = not in a syscall) */
+    uint32_t start_ticks;            /* timer_ticks at creation */
+    uint32_t sample_ticks;           /* utime + stime at the last top refresh */
+} process_acct_t;
+
+/* Load average fixed point (11 fractional bits), sampled every 5 s */
+#define LOAD_FSHIFT 11
+#define LOAD_FIXED_1 (1 << LOAD_FSHIFT)
+#define LOAD_FREQ (5 * TIMER_FREQUENCY + 1)
+#define LOAD_EXP_1  1884             /* 1 / exp(5s / 1min) */
+#define LOAD_EXP_5  2014             /* 1 / exp(5s / 5min) */
+#define LOAD_EXP_15 2037             /* 1 / exp(5s / 15min) */
+#define LOAD_INT(x)  ((x) >> LOAD_FSHIFT)
+#define LOAD_FRAC(x) LOAD_INT(((x) & (LOAD_FIXED_1 - 1)) * 100)   /* Hundredths */
+
+/* clone() flags: share the resource with the caller instead of copying it */
+#define CLONE_VM      0x00000100     /* Address space */
+#define CLONE_FS      0x00000200     /* Working directory */
+#define CLONE_FILES   0x00000400     /* File descriptor table */
+#define CLONE_SIGHAND 0x00000800     /* Signal handlers (requires CLONE_VM) */
+#define CLONE_VFORK   0x00004000     /* Caller sleeps until the child execs or exits */
+#define CLONE_THREAD  0x00010000     /* Same thread group (requires CLONE_SIGHAND) */
+
+/* Main user stack page, and the top of the per-thread stack area below
+ * it (one page per thread, each with an unmapped guard page) */
+#define USER_STACK_BASE  0x10000000
+#define THREAD_STACK_TOP USER_STACK_BASE
+
+/* Address space, shared by CLONE_VM threads */
+typedef struct mm {
+    uint32_t users;                  /* Threads using it */
+    page_directory_t *pgd;           /* Page directory */
 
     /* Process memory sections (KFS-5 Bonus) */
     process_section_t text_section;  /* .text - executable code */
@@ -72,12 +130,95 @@ typedef struct process {
     uint32_t heap_start;             /* Heap start address */
     uint32_t heap_end;               /* Current heap end (brk) */
 
+    uint32_t stack_next;             /* Next per-thread stack page (grows down) */
+
+    /* Demand-paged regions of an exec'd image (exec.c) */
+    struct vm_area *vmas;
+    uint32_t file_faults;            /* Pages read in from the executable */
+    uint32_t zero_faults;            /* Demand-zero pages */
+} mm_t;
+
+/* Signal handlers, shared by CLONE_SIGHAND threads */
+typedef struct sighand {
+    uint32_t count;
+    process_signal_handler_t handlers[32];
+    process_siginfo_handler_t info_handlers[32]; /* Used instead if set */
+} sighand_t;
+
+/* Working directory (KFS-6 MANDATORY), shared by CLONE_FS threads */
+typedef struct fs_struct {
+    uint32_t users;
+    char pwd[256];                   /* Current working directory path */
+} fs_struct_t;
+
+/* Threads created with CLONE_THREAD; the TGID is the leader's PID */
+typedef struct thread_group {
+    uint32_t count;                  /* References (live and zombie members) */
+    uint32_t tgid;
+    uint32_t nr_threads;             /* Members that have not exited */
+    list_head_t threads;             /* process_t.thread_node */
+} thread_group_t;
+
+/* What a vfork parent sleeps on (on its stack) until the child lets go
+ * of the borrowed address space */
+typedef struct vfork_done {
+    volatile bool done;
+    wait_queue_head_t wq;
+} vfork_done_t;
+
+/* Rarely used per-process data, allocated apart from the PCB so that
+ * scheduler walks only touch the hot fields */
+typedef struct process_cold {
+    /* Resources that clone() can share (NULL mm for kernel threads) */
+    mm_t *mm;
+    sighand_t *sighand;
+    fs_struct_t *fs;
+    struct files_struct *files;      /* Descriptor table (file.h) */
+    thread_group_t *group;
+
+    /* Set in a vfork child until it execs or exits */
+    vfork_done_t *vfork_done;
+
+    /* Scheduler latency histograms */
+    sched_info_t sched;
+
+    /* Real-time signals waiting for delivery, oldest first */
+    sigqueue_entry_t sigqueue[PROCESS_SIGQUEUE_MAX];
+    uint32_t sigqueue_len;
+} process_cold_t;
+
+/* Process Control Block (PCB) */
+typedef struct process {
+    /* Hot: read on every scheduling decision and context switch */
+    uint32_t pid;                    /* Process ID */
+    process_state_t state;           /* Process state */
+    uint32_t flags;                  /* PROCESS_FLAG_* */
+    list_head_t run_list;            /* Run queue link while runnable */
+    uint32_t cpu;                    /* CPU whose run queue holds it (last ran on) */
+    uint32_t kernel_esp;             /* Saved kernel stack pointer while switched out */
+    uint32_t preempt_count;          /* CPU's preempt count while switched out */
+    page_directory_t *page_directory; /* Virtual address space */
+    struct fpu_state *fpu;           /* x87/SSE save area (allocated on first use) */
+    uint32_t signal_pending;         /* Bitmask of pending signals */
+
     /* Context (saved state when not running) */
     process_context_t context;
 
-    /* Signals */
-    signal_queue_entry_t *signal_queue;
-    process_signal_handler_t signal_handlers[32];
+    /* Warm: lookup, lifetime and ownership */
+    struct process *pid_next;        /* PID hash chain */
+    list_head_t tasks;               /* All processes (or the PCB cache) */
+    uint32_t tgid;                   /* Thread group ID (getpid) */
+    list_head_t thread_node;         /* Thread group membership */
+    char name[PROCESS_NAME_LEN];     /* Short name for listings */
+
+    /* Parent and children */
+    struct process *parent;
+    struct process *children;        /* Linked list of children */
+    struct process *next_sibling;
+
+    uint32_t kernel_stack;            /* Kernel stack base (allocation) */
+    uint32_t user_stack;              /* User stack pointer */
+    uint32_t thread_stack;            /* Per-thread stack page in a shared mm (0 = none) */
 
     /* User owner */
     uint32_t uid;
@@ -86,36 +227,118 @@ typedef struct process {
     /* Exit status (for zombies) */
     int exit_status;
 
-    /* Current working directory (KFS-6 MANDATORY) */
-    char pwd[256];  /* Current working directory path */
+    /* Sleep/timeout timers (owned by the process so exit can cancel them) */
+    timer_list_t sleep_timer;
+    hrtimer_t sleep_hrtimer;
 
+    /* Woken when a child exits (process_wait sleeps here) */
+    wait_queue_head_t wait_chldexit;
+
+    /* Kernel thread body (PROCESS_FLAG_KTHREAD) */
+    int (*thread_fn)(void *data);
+    void *thread_data;
+
+    /* Resource usage */
+    process_acct_t acct;
+
+    /* Scheduler latency: when the task became READY / was woken (0 = not) */
+    uint64_t sched_queued_ns;
+    uint64_t sched_woken_ns;
+
+    /* Cold: shared resources, scheduler statistics */
+    process_cold_t *cold;
 } process_t;
 
 /* Process management functions */
 void process_init(void);
 process_t *process_create(void (*entry_point)(void), uint32_t uid);
+process_t *process_create_kernel(int (*fn)(void *data), void *data, const char *name);
 process_t *process_fork(process_t *parent);
+process_t *process_clone(process_t *parent, uint32_t flags,
+                         int (*fn)(void *arg), void *arg, uint32_t stack);
+process_t *process_spawn(process_t *parent, mm_t *mm, int (*fn)(void *arg), void *arg,
+                         const char *name);
 void process_exit(process_t *proc, int status);
 int process_wait(process_t *parent, int *status);
 void process_kill(process_t *proc, int signal);
 
+/* exec support: a fresh address space, and installing it in proc
+ * (dropping the old one and resetting signal handlers to default) */
+mm_t *process_mm_create(void);
+void process_exec_mm(process_t *proc, mm_t *mm);
+void mm_get(mm_t *mm);
+void mm_put(mm_t *mm);
+
+/* Kernel thread working in a user address space (and back) */
+void process_use_mm(mm_t *mm);
+void process_unuse_mm(void);
+
 /* Process scheduling */
 void process_schedule(void);
+void process_preempt(void);
 process_t *process_get_current(void);
 void process_set_current(process_t *proc);
 void process_switch(process_t *next);
 
+/* Set when a wakeup made a process runnable or a time slice ended;
+ * acted on at the preemption points of preempt.c (per CPU) */
+#define process_need_resched (this_cpu()->need_resched)
+
+/* SMP: idle task of an application processor (freed again if the CPU
+ * never starts), its idle loop, and whether a process is running on
+ * some CPU right now */
+process_t *process_create_idle(uint32_t cpu);
+void process_free_idle(process_t *idle);
+void process_idle(void) __attribute__((noreturn));
+bool process_on_cpu(process_t *proc);
+
+/* Blocking and wakeup (set current->state to BLOCKED before sleeping) */
+int process_wakeup(process_t *proc);
+int32_t schedule_timeout(int32_t timeout);
+
 /* Process signal handling */
 int process_signal_register(process_t *proc, int signal, process_signal_handler_t handler);
+int process_signal_register_info(process_t *proc, int signal, process_siginfo_handler_t handler);
 int process_signal_send(process_t *proc, int signal);
+int process_signal_queue(process_t *proc, int signal, uint32_t value);
 void process_signal_process(process_t *proc);
 
+/* Signal delivery counters */
+typedef struct {
+    uint32_t sent;                   /* Signals that became pending */
+    uint32_t coalesced;              /* Standard signals already pending */
+    uint32_t queued;                 /* Real-time signals queued */
+    uint32_t overflows;              /* Real-time signals refused (queue full) */
+    uint32_t delivered;              /* Handler (or default) invocations */
+} process_signal_stats_t;
+
+void process_signal_get_stats(process_signal_stats_t *stats);
+
 /* Exception to signal mapping (KFS-5 Bonus) */
 void process_handle_exception(uint32_t exception_num);
 
 /* Helper functions */
 process_t *process_get_by_pid(uint32_t pid);
+uint32_t process_count(void);
+
+/* Visit every process (idle tasks first) with the table read-locked and
+ * interrupts on: fn must not create or free processes, and changes to
+ * fields the scheduler also writes need their own locking (interrupts_save).
+ * Must not be called with interrupts disabled. */
+void process_for_each(void (*fn)(process_t *proc, void *data), void *data);
+
+/* Resource accounting */
+void process_account_tick(uint32_t cs);          /* Timer tick: charge current */
+void process_account_syscall_enter(void);
+void process_account_syscall_exit(uint32_t num, int result);
+uint32_t process_nr_running(void);               /* Run-queue length (READY + RUNNING) */
+void process_get_loadavg(uint32_t loadavg[3]);   /* LOAD_FSHIFT fixed point */
+uint32_t process_rss_pages(process_t *proc);     /* Resident user pages + kernel stack */
+char process_state_char(process_state_t state);   /* ps-style R/S/Z */
+int process_format_stat(process_t *proc, char *buf, size_t size);
 uint32_t process_get_current_uid(void);
+void process_set_uid(process_t *proc, uint32_t uid);
+void process_set_name(process_t *proc, const char *name);
 
 /* Working directory functions (KFS-6 MANDATORY) */
 const char *process_get_pwd(process_t *proc);
@@ -127,6 +350,7 @@ int process_set_pwd(process_t *proc, const char *path);
 #define PROT_WRITE  0x2  /* Write access */
 #define PROT_EXEC   0x4  /* Execute access */
 
+#define MAP_SHARED  0x01 /* Shared with children across fork */
 #define MAP_PRIVATE 0x02 /* Private mapping */
 #define MAP_ANONYMOUS 0x20 /* Anonymous mapping (no file) */
 
@@ -136,6 +360,10 @@ int process_brk(process_t *proc, void *addr);  /* Change heap size */
 
 /* System calls */
 int sys_fork(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5);
+int sys_clone(uint32_t flags, uint32_t fn, uint32_t arg, uint32_t stack, uint32_t unused);
+int sys_vfork(uint32_t fn, uint32_t arg, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+int sys_getpid(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5);
+int sys_gettid(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5);
 int sys_wait(uint32_t status_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
 int sys_getuid(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5);
 int sys_kill(uint32_t pid, uint32_t signal, uint32_t unused1, uint32_t unused2, uint32_t unused3);
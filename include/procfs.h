@@ -0,0 +1,13 @@
+/* procfs.h - Process information pseudo-filesystem mounted at /proc */
+
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include "vfs.h"
+
+/* Create /proc under the VFS root:
+ *   /proc/<pid>/stat  per-process accounting line
+ *   /proc/loadavg     load averages and run-queue length */
+void procfs_init(void);
+
+#endif /* PROCFS_H */
@@ -0,0 +1,55 @@
+/* rbtree.h - Intrusive red-black trees */
+
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include "types.h"
+
+#define RB_RED   0
+#define RB_BLACK 1
+
+/* Tree node, embedded in the structure being indexed */
+typedef struct rb_node {
+    struct rb_node *parent;
+    struct rb_node *left;
+    struct rb_node *right;
+    int color;
+} rb_node_t;
+
+/* Tree root, caching the leftmost (smallest) node */
+typedef struct rb_root {
+    rb_node_t *node;
+    rb_node_t *leftmost;
+} rb_root_t;
+
+#define RB_ROOT_INIT { NULL, NULL }
+
+#define rb_entry(ptr, type, member) \
+    ((type *)((char *)(ptr) - __builtin_offsetof(type, member)))
+
+/* Link a node at the position found by a descent from the root;
+ * parent and link come from the caller's search, leftmost is true if
+ * the descent only ever went left. */
+static inline void rb_link_node(rb_node_t *node, rb_node_t *parent, rb_node_t **link) {
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->color = RB_RED;
+    *link = node;
+}
+
+/* Rebalance after rb_link_node() */
+void rb_insert_color(rb_node_t *node, rb_root_t *root, bool leftmost);
+
+/* Remove a node from the tree */
+void rb_erase(rb_node_t *node, rb_root_t *root);
+
+/* Smallest node (NULL if empty) */
+static inline rb_node_t *rb_first(const rb_root_t *root) {
+    return root->leftmost;
+}
+
+/* In-order successor */
+rb_node_t *rb_next(const rb_node_t *node);
+
+#endif /* RBTREE_H */
@@ -0,0 +1,45 @@
+/* schedstat.h - Scheduler latency statistics (run delay, wakeup latency) */
+
+#ifndef SCHEDSTAT_H
+#define SCHEDSTAT_H
+
+#include "types.h"
+
+struct process;
+
+/* log2 buckets in microseconds: [0] < 1 us, [i] = [2^(i-1), 2^i) us,
+ * the last bucket collects everything above ~0.5 s */
+#define SCHEDSTAT_BUCKETS 21
+
+typedef struct {
+    uint32_t buckets[SCHEDSTAT_BUCKETS];
+    uint32_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+} sched_hist_t;
+
+/* Per-task histograms (kept in the process's cold data) */
+typedef struct {
+    sched_hist_t run_delay;          /* READY -> RUNNING, every time */
+    sched_hist_t wakeup_latency;     /* Wakeup -> RUNNING */
+} sched_info_t;
+
+/* Task became runnable (created, forked or preempted) */
+void sched_info_queued(struct process *proc);
+
+/* Task was woken from BLOCKED */
+void sched_info_woken(struct process *proc);
+
+/* Task became runnable again without being switched out */
+void sched_info_dequeued(struct process *proc);
+
+/* Task is about to get the CPU: record how long it waited */
+void sched_info_arrive(struct process *proc);
+
+/* Clear the global and per-task histograms */
+void schedstat_reset(void);
+
+/* Print the global histograms, or one task's if proc is given */
+void schedstat_print(struct process *proc);
+
+#endif /* SCHEDSTAT_H */
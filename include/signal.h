@@ -31,6 +31,10 @@
 #define SIGSTOP     19  /* Stop */
 #define SIGTSTP     20  /* Keyboard stop */
 
+/* Real-time signals: queued with a value instead of coalescing */
+#define SIGRTMIN    24
+#define SIGRTMAX    31
+
 #define MAX_SIGNALS 32
 
 /* Signal action structure */
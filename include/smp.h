@@ -0,0 +1,114 @@
+/* smp.h - Symmetric multiprocessing: per-CPU data, AP startup, IPIs */
+
+#ifndef SMP_H
+#define SMP_H
+
+#include "types.h"
+#include "list.h"
+#include "paging.h"
+#include "spinlock.h"
+#include "gdt.h"
+
+/* CPUs supported (one per-CPU data segment each) */
+#define SMP_MAX_CPUS GDT_PERCPU_COUNT
+
+/* Inter-processor interrupt vectors */
+#define IPI_RESCHEDULE_VECTOR 0xF0   /* Look at the run queue */
+#define LOCAL_TIMER_VECTOR    0xF1   /* Per-CPU tick: local APIC timer, or relayed */
+#define IPI_TLB_VECTOR        0xFC   /* Flush a TLB entry (smp_flush_tlb_page) */
+#define IPI_STOP_VECTOR       0xFD   /* Halt (panic) */
+
+/* Vectors from here on are handled without the interrupt lock (idt.c) */
+#define SMP_NOLOCK_VECTOR_FIRST 0xFC
+
+/* Where the AP startup code is copied (below 1 MB, page aligned) */
+#define SMP_TRAMPOLINE_BASE 0x8000
+
+/* Flush the whole TLB instead of one page */
+#define TLB_FLUSH_ALL 0xFFFFFFFF
+
+/* Per-CPU run queue: the processes this CPU runs, current included */
+typedef struct runqueue {
+    spinlock_t lock;
+    list_head_t tasks;               /* process_t.run_list */
+    uint32_t nr_running;             /* Entries on tasks */
+    struct process *wakeup_hint;     /* Most recently woken: picked first */
+} runqueue_t;
+
+/* Per-CPU data, reached through the GS segment (self is at %gs:0) */
+typedef struct cpu {
+    struct cpu *self;
+    uint32_t id;                     /* 0 = boot CPU */
+    uint32_t apic_id;
+    volatile bool online;
+
+    struct process *current;         /* Running process */
+    struct process *idle;            /* Runs when the run queue is empty */
+    volatile bool need_resched;      /* Reschedule on interrupt exit */
+    volatile uint32_t preempt_count; /* Switching forbidden while nonzero (preempt.h) */
+    struct process *fpu_live;        /* Process whose FPU state is live here */
+    page_directory_t *directory;     /* Loaded in CR3 */
+    runqueue_t rq;
+
+    /* Statistics */
+    uint32_t ticks;                  /* Timer ticks taken */
+    uint32_t idle_ticks;             /* ... while idle */
+    uint32_t switches;               /* Context switches */
+    uint32_t steals;                 /* Processes taken from other CPUs */
+    uint32_t ipis;                   /* IPIs received */
+    uint32_t tlb_flushes;            /* Shootdowns answered */
+    uint32_t irq_lock_waits;         /* Interrupt lock acquisitions that spun */
+    uint32_t preemptions;            /* Processes switched out involuntarily */
+    uint32_t preempt_deferred;       /* Reschedules held back by the preempt count */
+    uint32_t cond_rescheds;          /* Switches at cond_resched() points */
+    uint32_t atomic_schedules;       /* Schedules with the preempt count raised */
+} cpu_t;
+
+/* Per-CPU data of the running CPU */
+static inline cpu_t *this_cpu(void) {
+    cpu_t *cpu;
+    __asm__ volatile("movl %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+/* Number of the running CPU */
+static inline uint32_t smp_processor_id(void) {
+    uint32_t id;
+    __asm__ volatile("movl %%gs:%c1, %0" : "=r"(id) : "i"(__builtin_offsetof(cpu_t, id)));
+    return id;
+}
+
+/* Set up the boot CPU's per-CPU data and GS (right after gdt_init) */
+void smp_prepare_boot_cpu(void);
+
+/* Bring up the local APIC, move device interrupts to the I/O APIC,
+ * start the local APIC timers and the other CPUs (MADT) */
+void smp_init(void);
+
+/* Per-CPU data of CPU id (NULL if out of range) */
+cpu_t *smp_cpu(uint32_t id);
+
+/* CPUs running the kernel */
+uint32_t smp_online_cpus(void);
+
+/* Ask CPU id to reschedule */
+void smp_send_reschedule(uint32_t id);
+
+/* Relay a timer tick from the boot CPU to the others (no APIC timer) */
+void smp_send_tick(void);
+
+/* Halt the other CPUs (panic) */
+void smp_send_stop(void);
+
+/* Invalidate addr (or TLB_FLUSH_ALL) on this CPU and on every other CPU
+ * that may cache it: all of them for kernel addresses (dir NULL), else
+ * those with dir loaded. Returns after they have all done it. */
+void smp_flush_tlb_page(page_directory_t *dir, uint32_t addr);
+
+/* Answer a pending TLB shootdown (called while spinning with interrupts off) */
+void smp_poll_ipis(void);
+
+/* Print the CPU table */
+void smp_print_info(void);
+
+#endif /* SMP_H */
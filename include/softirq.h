@@ -0,0 +1,40 @@
+/* softirq.h - Deferred interrupt work (bottom halves) */
+
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include "types.h"
+
+/* Softirq vectors, run in this order when pending */
+typedef enum {
+    TIMER_SOFTIRQ = 0,     /* Timer wheel and hrtimer expiry */
+    KEYBOARD_SOFTIRQ,      /* Scancode translation and reader wakeup */
+    BLOCK_SOFTIRQ,         /* Disk command completion */
+    NR_SOFTIRQS
+} softirq_nr_t;
+
+/* Restart the pending loop at most this many times per interrupt exit */
+#define MAX_SOFTIRQ_RESTART 10
+
+/* Hand remaining work to ksoftirqd after this much time on interrupt exit */
+#define MAX_SOFTIRQ_TIME_NS 2000000ULL
+
+/* Install the handler of a softirq vector */
+void open_softirq(softirq_nr_t nr, void (*action)(void));
+
+/* Mark a softirq pending (safe from top halves and process context) */
+void raise_softirq(softirq_nr_t nr);
+
+/* Run pending softirqs with interrupts enabled (no-op when nested) */
+void do_softirq(void);
+
+/* Check whether softirq handlers are running on this CPU */
+bool in_softirq(void);
+
+/* Start the ksoftirqd fallback thread */
+void softirq_init(void);
+
+/* Print per-vector statistics */
+void softirq_print_stats(void);
+
+#endif /* SOFTIRQ_H */
@@ -0,0 +1,63 @@
+/* spinlock.h - Busy-waiting locks for data shared between CPUs */
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+#include "lockstat.h"
+
+/* Test-and-set lock (0 = free) */
+typedef struct spinlock {
+    volatile uint32_t locked;
+    lock_class_t *class;             /* lockstat class (NULL: not counted) */
+    uint64_t held_since;             /* lockstat: start of the current hold */
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0, NULL, 0 }
+#define SPINLOCK_INIT_CLASS(cls) { 0, &(cls), 0 }
+
+/* Reader/writer lock: count > 0 readers, -1 one writer, 0 free */
+typedef struct rwlock {
+    volatile int32_t count;
+    lock_class_t *class;
+    uint64_t held_since;             /* Writer's hold (readers are not timed) */
+} rwlock_t;
+
+#define RWLOCK_INIT_CLASS(cls) { 0, &(cls), 0 }
+
+void spin_lock_init(spinlock_t *lock);
+void spin_lock_init_class(spinlock_t *lock, lock_class_t *class);
+
+/* Spin until the lock is ours; spinning only reads the lock word, so
+ * waiters do not keep pulling its cache line away from the holder.
+ * The holder is not preempted (preempt.h) and must not sleep. */
+void spin_lock(spinlock_t *lock);
+void spin_unlock(spinlock_t *lock);
+
+/* Take the lock only if it is free (true if taken) */
+bool spin_trylock(spinlock_t *lock);
+
+/* Check whether some CPU holds the lock */
+bool spin_is_locked(spinlock_t *lock);
+
+/* Interrupts off (which takes the interrupt lock), then the lock: for
+ * data also touched by interrupt handlers. Returns the interrupt state
+ * for spin_unlock_irqrestore. The holder must not sleep or schedule. */
+bool spin_lock_irqsave(spinlock_t *lock);
+void spin_unlock_irqrestore(spinlock_t *lock, bool flags);
+
+/* Reader/writer lock: readers share it (and may nest), a writer waits
+ * for them all to leave */
+void rwlock_init(rwlock_t *lock, lock_class_t *class);
+void read_lock(rwlock_t *lock);
+void read_unlock(rwlock_t *lock);
+void write_lock(rwlock_t *lock);
+void write_unlock(rwlock_t *lock);
+
+/* As spin_lock_irqsave, for either side of a reader/writer lock */
+bool read_lock_irqsave(rwlock_t *lock);
+void read_unlock_irqrestore(rwlock_t *lock, bool flags);
+bool write_lock_irqsave(rwlock_t *lock);
+void write_unlock_irqrestore(rwlock_t *lock, bool flags);
+
+#endif /* SPINLOCK_H */
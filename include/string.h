@@ -29,6 +29,9 @@ void *memset(void *ptr, int value, size_t num);
 /* Copy memory */
 void *memcpy(void *dest, const void *src, size_t num);
 
+/* Convert a decimal string to an integer (stops at the first non-digit) */
+int atoi(const char *str);
+
 /* Format string (simplified version) */
 int snprintf(char *str, size_t size, const char *format, ...);
 
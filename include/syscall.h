@@ -28,6 +28,22 @@
 #define SYS_CONNECT 18  /* KFS-5 MANDATORY - Socket IPC */
 #define SYS_SEND    19  /* KFS-5 MANDATORY - Socket IPC */
 #define SYS_RECV    20  /* KFS-5 MANDATORY - Socket IPC */
+#define SYS_NANOSLEEP 21
+#define SYS_CLONE   22
+#define SYS_GETTID  23
+#define SYS_FUTEX   24
+#define SYS_EXECVE  25
+#define SYS_VFORK   26
+#define SYS_SPAWN   27
+#define SYS_URING_SETUP 28
+#define SYS_URING_ENTER 29
+#define SYS_URING_CLOSE 30
+#define SYS_LSEEK   31
+#define SYS_PREAD   32
+#define SYS_PWRITE  33
+#define SYS_READV   34
+#define SYS_WRITEV  35
+#define SYS_DUP2    36
 
 #define MAX_SYSCALLS 256
 
@@ -37,6 +53,9 @@ typedef int (*syscall_handler_t)(uint32_t arg1, uint32_t arg2, uint32_t arg3, ui
 /* Initialize syscall system */
 void syscall_init(void);
 
+/* Set up SYSENTER on an application processor */
+void syscall_init_ap(void);
+
 /* Register a syscall handler */
 int syscall_register(uint32_t syscall_num, syscall_handler_t handler);
 
@@ -46,9 +65,35 @@ int syscall_unregister(uint32_t syscall_num);
 /* Syscall dispatcher (called from INT 0x80) */
 void syscall_dispatcher(struct interrupt_frame *frame);
 
-/* Example syscall implementations */
-int sys_write(uint32_t fd, uint32_t buf, uint32_t count, uint32_t unused1, uint32_t unused2);
-int sys_read(uint32_t fd, uint32_t buf, uint32_t count, uint32_t unused1, uint32_t unused2);
+/* Syscall dispatcher (called from the SYSENTER entry) */
+int sysenter_dispatch(uint32_t syscall_num, uint32_t arg1, uint32_t arg2,
+                      uint32_t arg3, uint32_t arg4, uint32_t arg5);
+
+/* Kernel-side entry stubs (sysenter.s): eax = number, ebx..edi =
+ * arguments, result in eax. syscall_int80 always traps through
+ * INT 0x80, syscall_sysenter takes the SYSENTER fast path. */
+extern void syscall_int80(void);
+extern void syscall_sysenter(void);
+
+/* syscall_sysenter if the CPU supports it, syscall_int80 otherwise */
+extern void (*syscall_entry)(void);
+
+/* Whether the SYSENTER MSRs were set up at boot */
+bool syscall_sysenter_enabled(void);
+
+/* Issue a system call through one of the entry stubs */
+static inline int syscall_call(void (*entry)(void), uint32_t num, uint32_t arg1,
+                               uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5) {
+    int result;
+    __asm__ volatile("call *%7"
+                     : "=a"(result)
+                     : "a"(num), "b"(arg1), "c"(arg2), "d"(arg3), "S"(arg4), "D"(arg5),
+                       "m"(entry)
+                     : "memory", "cc");
+    return result;
+}
+
+/* Example syscall implementations (read/write are in file.h) */
 int sys_exit(uint32_t status, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
 
 #endif /* SYSCALL_H */
@@ -0,0 +1,47 @@
+/* sysstat.h - Per-syscall statistics and an opt-in syscall trace */
+
+#ifndef SYSSTAT_H
+#define SYSSTAT_H
+
+#include "types.h"
+#include "syscall.h"
+
+/* What is being collected (sysstat_mask) */
+#define SYSSTAT_COUNT 0x1            /* Counters, errors and latency histograms */
+#define SYSSTAT_TRACE 0x2            /* Trace ring for PROCESS_FLAG_STRACE processes */
+
+/* Syscall numbers with their own counters (higher ones are pooled) */
+#define SYSSTAT_NR 48
+
+/* log2 buckets in cycles: [0] < 2^6, [i] = [2^(i+5), 2^(i+6)),
+ * the last bucket collects everything from 2^25 (~11 ms at 3 GHz) */
+#define SYSSTAT_BUCKETS 21
+#define SYSSTAT_MIN_LOG2 6
+
+/* Trace ring size (oldest entries are overwritten) */
+#define SYSSTAT_TRACE_ENTRIES 64
+
+/* Zero when nothing is collected: the dispatchers test only this */
+extern volatile uint32_t sysstat_mask;
+
+/* Run a handler, timing and recording it (dispatchers call this only
+ * when sysstat_mask is set) */
+int sysstat_run(syscall_handler_t handler, uint32_t num, uint32_t arg1, uint32_t arg2,
+                uint32_t arg3, uint32_t arg4, uint32_t arg5);
+
+/* Count a call of an unregistered number */
+void sysstat_invalid(uint32_t num);
+
+/* Turn collection bits on or off (on needs a TSC) */
+int sysstat_enable(uint32_t bits);
+void sysstat_disable(uint32_t bits);
+
+/* Clear the counters, histograms and trace ring */
+void sysstat_reset(void);
+
+/* Print the per-syscall table, one syscall's histogram, or the trace */
+void sysstat_print(void);
+void sysstat_print_hist(uint32_t num);
+void sysstat_print_trace(void);
+
+#endif /* SYSSTAT_H */
@@ -17,10 +17,33 @@ extern volatile uint32_t timer_ticks;
 /* Initialize the PIT timer */
 void timer_init(uint32_t frequency);
 
+/* Global part of a tick: timer_ticks, time base, timer expiry (boot CPU) */
+void timer_global_tick(void);
+
+/* Drive the global tick from the boot CPU's local APIC timer and mask
+ * IRQ0 (the PIT remains the fallback) */
+void timer_apic_takeover(void);
+
+/* Per-CPU part of a tick: accounting and time slices (every CPU) */
+struct interrupt_frame;
+void timer_local_tick(struct interrupt_frame *frame);
+
 /* Get current timer ticks */
 uint32_t timer_get_ticks(void);
 
-/* Wait for specified number of ticks */
+/* Time interval for sys_nanosleep */
+typedef struct {
+    int32_t tv_sec;
+    int32_t tv_nsec;
+} timespec_t;
+
+/* Wait for specified number of ticks (blocks the current process) */
 void timer_wait(uint32_t ticks);
 
+/* Sleep for a number of nanoseconds (spins for very short waits) */
+void timer_nanosleep(uint64_t ns);
+
+/* System call: nanosleep(req, rem) */
+int sys_nanosleep(uint32_t req_ptr, uint32_t rem_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+
 #endif /* TIMER_H */
@@ -0,0 +1,21 @@
+/* uaccess.h - Copying to and from process buffers */
+
+#ifndef UACCESS_H
+#define UACCESS_H
+
+#include "types.h"
+
+/* Whether [addr, addr + size) may hold a process buffer: not NULL, no
+ * wrap-around and below the fixed kernel pages at the top (vDSO, MMIO) */
+bool access_ok(uint32_t addr, uint32_t size);
+
+/* Bulk copies (a dword at a time); return 0, or -1 if the process range
+ * fails access_ok. Untouched pages of the range fault in as usual. */
+int copy_from_user(void *dest, uint32_t src, uint32_t size);
+int copy_to_user(uint32_t dest, const void *src, uint32_t size);
+
+/* Copy a NUL-terminated string of at most size bytes (terminator
+ * included); returns its length, or -1 if it is bad or too long */
+int strncpy_from_user(char *dest, uint32_t src, uint32_t size);
+
+#endif /* UACCESS_H */
@@ -0,0 +1,96 @@
+/* uring.h - Submission/completion rings for batched system calls */
+
+#ifndef URING_H
+#define URING_H
+
+#include "types.h"
+#include "process.h"
+
+/* Rings open at once (system-wide) */
+#define URING_MAX_RINGS 8
+
+/* Queue sizes (powers of two); both fit the one shared page */
+#define URING_SQ_ENTRIES 64
+#define URING_CQ_ENTRIES 128
+
+/* uring_setup flags */
+#define URING_SETUP_SQPOLL 0x1       /* A kernel thread polls the SQ: no doorbell needed */
+
+/* uring_enter flags */
+#define URING_ENTER_GETEVENTS 0x1    /* Wait for min_complete completions */
+#define URING_ENTER_SQ_WAKEUP 0x2    /* Wake the SQ poller (it set URING_SQ_NEED_WAKEUP) */
+
+/* Shared flags word, set by the kernel */
+#define URING_SQ_NEED_WAKEUP 0x1     /* The SQ poller went to sleep */
+
+/* SQPOLL: ticks the poller keeps spinning after the last submission */
+#define URING_SQPOLL_IDLE 10
+
+/* Operations */
+#define URING_OP_NOP     0
+#define URING_OP_READ    1           /* pread(path or fd, addr, len, off) */
+#define URING_OP_WRITE   2           /* pwrite(path or fd, addr, len, off) */
+#define URING_OP_SEND    3           /* send(fd, addr, len) */
+#define URING_OP_RECV    4           /* recv(fd, addr, len), waits for data */
+#define URING_OP_POLL    5           /* Wait until fd is ready for len's URING_POLL_* */
+#define URING_OP_TIMEOUT 6           /* Complete after off milliseconds */
+#define URING_OP_MAX     7
+
+/* URING_OP_POLL events */
+#define URING_POLL_IN  0x1
+#define URING_POLL_OUT 0x4
+
+/* Submission queue entry */
+typedef struct uring_sqe {
+    uint8_t opcode;                  /* URING_OP_* */
+    uint8_t flags;
+    uint16_t reserved;
+    int32_t fd;                      /* Descriptor of the owner (socket, or file if no path) */
+    uint32_t addr;                   /* Buffer */
+    uint32_t len;                    /* Buffer length (poll: events) */
+    uint32_t off;                    /* File offset (timeout: ms) */
+    uint32_t path;                   /* Absolute file path (read/write), or 0 */
+    uint32_t user_data;              /* Copied to the completion */
+} uring_sqe_t;
+
+/* Completion queue entry */
+typedef struct uring_cqe {
+    uint32_t user_data;
+    int32_t res;                     /* Result of the operation (-1 on error) */
+} uring_cqe_t;
+
+/* The page shared between the process and the kernel. The process
+ * fills sqes[sq_tail & mask] and then advances sq_tail; the kernel
+ * consumes up to it and advances sq_head. Completions go the other way
+ * through cq_tail (kernel) and cq_head (process). */
+typedef struct uring_shared {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    volatile uint32_t flags;         /* URING_SQ_NEED_WAKEUP */
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    volatile uint32_t cq_overflow;   /* Completions dropped (CQ full) */
+    uring_sqe_t sqes[URING_SQ_ENTRIES];
+    uring_cqe_t cqes[URING_CQ_ENTRIES];
+} uring_shared_t;
+
+/* Close the rings a process set up (it is exiting) */
+void uring_exit_task(process_t *proc);
+
+/* sys_uring_setup(flags, &addr): map a ring into the caller, storing the
+ * address of its uring_shared_t in *addr; returns the ring id */
+int sys_uring_setup(uint32_t flags, uint32_t addr_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+
+/* sys_uring_enter(ring, to_submit, min_complete, flags): submit queued
+ * entries and optionally wait; returns the number submitted */
+int sys_uring_enter(uint32_t ring, uint32_t to_submit, uint32_t min_complete, uint32_t flags, uint32_t unused);
+
+/* sys_uring_close(ring) */
+int sys_uring_close(uint32_t ring, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
+
+/* Print per-ring counters */
+void uring_print_stats(void);
+
+#endif /* URING_H */
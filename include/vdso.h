@@ -0,0 +1,71 @@
+/* vdso.h - Kernel-maintained page for trap-free time and identity reads */
+
+#ifndef VDSO_H
+#define VDSO_H
+
+#include "types.h"
+#include "gdt.h"
+
+/* Fixed user-visible addresses, mapped read-only in every address space:
+ * the data page, then the code page reading it */
+#define VDSO_BASE      0xFEFFE000
+#define VDSO_DATA_ADDR VDSO_BASE
+#define VDSO_TEXT_ADDR (VDSO_BASE + 0x1000)
+
+/* How the code page computes time */
+#define VDSO_CLOCK_COARSE 0          /* base_ns as of the last tick */
+#define VDSO_CLOCK_TSC    1          /* base_ns plus the scaled TSC delta */
+
+/* One task slot per CPU (smp.h SMP_MAX_CPUS) */
+#define VDSO_MAX_CPUS GDT_PERCPU_COUNT
+
+/* Identity of the process running on one CPU; vdso_code.s finds its CPU's
+ * slot from the GS selector (GDT_PERCPU_SELECTOR) */
+typedef struct vdso_task {
+    volatile uint32_t seq;           /*  0 */
+    uint32_t pid;                    /*  4 Running process (getpid: TGID) */
+    uint32_t tid;                    /*  8 */
+    uint32_t uid;                    /* 12 */
+} vdso_task_t;
+
+/* Data page layout; the offsets are also used by vdso_code.s. Writers bump
+ * seq (the page's, or a task slot's own) to odd before and back to even
+ * after changing it, readers retry while seq is odd or changed under them. */
+typedef struct vdso_data {
+    volatile uint32_t seq;           /*  0 */
+    uint32_t clock_mode;             /*  4 VDSO_CLOCK_* */
+    uint32_t mult;                   /*  8 ns = (cycles * mult) >> shift */
+    uint32_t shift;                  /* 12 */
+    uint64_t cycle_last;             /* 16 TSC at base_ns */
+    uint64_t base_ns;                /* 24 Monotonic time at the last tick */
+    uint32_t ticks;                  /* 32 timer_ticks */
+    vdso_task_t tasks[VDSO_MAX_CPUS]; /* 36 Indexed by CPU */
+} vdso_data_t;
+
+/* Map the pages (once paging is set up) */
+void vdso_init(void);
+
+/* Timekeeping changed (timer tick or clocksource switch) */
+void vdso_update_time(uint32_t ticks, uint32_t clock_mode, uint32_t mult, uint32_t shift,
+                      uint64_t cycle_last, uint64_t base_ns);
+
+/* A different process runs on this CPU now, or its uid changed */
+void vdso_update_task(uint32_t pid, uint32_t tid, uint32_t uid);
+
+/* Code page entry points (vdso_code.s), at their link addresses; call them
+ * through vdso_sym() so that they run from the user-visible copy */
+extern uint8_t __vdso_text_start[];
+extern uint64_t vdso_clock_gettime_ns(void);
+extern uint32_t vdso_get_ticks(void);
+extern uint32_t vdso_getpid(void);
+extern uint32_t vdso_gettid(void);
+extern uint32_t vdso_getuid(void);
+
+/* Address of a code page function as user code sees it */
+#define vdso_sym(fn) ((__typeof__(&(fn)))(VDSO_TEXT_ADDR + \
+                      ((uint32_t)&(fn) - (uint32_t)__vdso_text_start)))
+
+/* Print the page contents and mapping */
+void vdso_print_info(void);
+
+#endif /* VDSO_H */
@@ -108,6 +108,12 @@ vfs_node_t *vfs_finddir(vfs_node_t *node, const char *name);
 /* Get root node */
 vfs_node_t *vfs_get_root(void);
 
+/* Link a node into an in-memory directory */
+int vfs_add_child(vfs_node_t *parent, vfs_node_t *child);
+
+/* Create an in-memory directory and link it under parent */
+vfs_node_t *vfs_create_dir(vfs_node_t *parent, const char *name);
+
 /* Create basic directory structure (/dev, /proc, /sys, /var) */
 void vfs_create_base_dirs(void);
 
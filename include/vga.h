@@ -41,6 +41,9 @@ void vga_putchar(char c);
 /* Print string */
 void vga_print(const char *str);
 
+/* Print len bytes of buf */
+void vga_write(const char *buf, size_t len);
+
 /* Set color */
 void vga_set_color(vga_color_t fg, vga_color_t bg);
 
@@ -0,0 +1,109 @@
+/* wait.h - Wait queues for blocking until a condition becomes true */
+
+#ifndef WAIT_H
+#define WAIT_H
+
+#include "types.h"
+#include "list.h"
+
+struct process;
+
+/* Waiter flags */
+#define WQ_FLAG_EXCLUSIVE 0x01  /* Only one exclusive waiter is woken per wake_up() */
+
+/* One sleeping task, usually on the sleeper's stack */
+typedef struct wait_queue_entry {
+    list_head_t entry;
+    struct process *task;
+    uint32_t flags;
+} wait_queue_entry_t;
+
+/* Queue of sleeping tasks; exclusive waiters are kept at the tail */
+typedef struct {
+    list_head_t head;
+} wait_queue_head_t;
+
+#define WAIT_QUEUE_HEAD_INIT(name) { LIST_HEAD_INIT((name).head) }
+
+/* Initialize a wait queue */
+void init_waitqueue_head(wait_queue_head_t *wq);
+
+/* Initialize a waiter for the current process */
+void init_wait_entry(wait_queue_entry_t *wait, uint32_t flags);
+
+/* Queue the waiter (if needed) and mark the current process BLOCKED */
+void prepare_to_wait(wait_queue_head_t *wq, wait_queue_entry_t *wait);
+
+/* Dequeue the waiter and mark the current process RUNNING again */
+void finish_wait(wait_queue_head_t *wq, wait_queue_entry_t *wait);
+
+/* Wake all non-exclusive waiters and up to nr_exclusive exclusive ones */
+void __wake_up(wait_queue_head_t *wq, int nr_exclusive);
+
+#define wake_up(wq)     __wake_up(wq, 1)
+#define wake_up_all(wq) __wake_up(wq, 0)
+
+/* Check whether anyone is waiting */
+bool waitqueue_active(wait_queue_head_t *wq);
+
+/* Scheduler entry points used by the wait_event macros */
+void wait_schedule(void);
+int32_t wait_schedule_timeout(int32_t timeout);
+
+#define __wait_event(wq, condition, flags)                  \
+    do {                                                    \
+        wait_queue_entry_t __wait;                          \
+        init_wait_entry(&__wait, flags);                    \
+        for (;;) {                                          \
+            prepare_to_wait(&(wq), &__wait);                \
+            if (condition) {                                \
+                break;                                      \
+            }                                               \
+            wait_schedule();                                \
+        }                                                   \
+        finish_wait(&(wq), &__wait);                        \
+    } while (0)
+
+/* Sleep until condition is true (re-checked after every wakeup) */
+#define wait_event(wq, condition)                           \
+    do {                                                    \
+        if (!(condition)) {                                 \
+            __wait_event(wq, condition, 0);                 \
+        }                                                   \
+    } while (0)
+
+/* As wait_event, but only one such waiter is woken by wake_up() */
+#define wait_event_exclusive(wq, condition)                 \
+    do {                                                    \
+        if (!(condition)) {                                 \
+            __wait_event(wq, condition, WQ_FLAG_EXCLUSIVE); \
+        }                                                   \
+    } while (0)
+
+/* Sleep until condition is true or timeout ticks elapse.
+ * Evaluates to 0 on timeout, otherwise the ticks left (at least 1). */
+#define wait_event_timeout(wq, condition, timeout)          \
+    ({                                                      \
+        int32_t __ret = (timeout);                          \
+        if (!(condition)) {                                 \
+            wait_queue_entry_t __wait;                      \
+            init_wait_entry(&__wait, 0);                    \
+            for (;;) {                                      \
+                prepare_to_wait(&(wq), &__wait);            \
+                if (condition) {                            \
+                    break;                                  \
+                }                                           \
+                __ret = wait_schedule_timeout(__ret);       \
+                if (!__ret) {                               \
+                    break;                                  \
+                }                                           \
+            }                                               \
+            finish_wait(&(wq), &__wait);                    \
+            if (!__ret && (condition)) {                    \
+                __ret = 1;                                  \
+            }                                               \
+        }                                                   \
+        __ret;                                              \
+    })
+
+#endif /* WAIT_H */
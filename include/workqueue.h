@@ -0,0 +1,88 @@
+/* workqueue.h - Deferred work executed by kernel worker threads */
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include "types.h"
+#include "list.h"
+#include "wait.h"
+#include "ktimer.h"
+#include "process.h"
+
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+/* A unit of deferred work (embed it and use container_of in func) */
+typedef struct work_struct {
+    list_head_t entry;
+    work_func_t func;
+    bool pending;                /* Queued and not yet started */
+} work_t;
+
+struct workqueue;
+
+/* Work queued after a delay in timer ticks */
+typedef struct delayed_work {
+    work_t work;
+    timer_list_t timer;
+    struct workqueue *wq;
+} delayed_work_t;
+
+/* A queue of work served by one worker thread */
+typedef struct workqueue {
+    const char *name;
+    list_head_t worklist;
+    wait_queue_head_t more_work;   /* Worker sleeps here when idle */
+    process_t *worker;
+
+    /* Statistics */
+    uint32_t queued;               /* Items queued */
+    uint32_t completed;            /* Items run */
+    uint64_t busy_ns;              /* Time spent running items */
+    uint64_t max_ns;               /* Longest single item */
+    uint64_t created_ns;           /* Worker start time */
+
+    struct workqueue *next;
+} workqueue_t;
+
+#define INIT_WORK(w, f)                 \
+    do {                                \
+        list_init(&(w)->entry);         \
+        (w)->func = (f);                \
+        (w)->pending = false;           \
+    } while (0)
+
+/* Timer callback queueing a delayed_work (data is the delayed_work_t *) */
+void delayed_work_timer_fn(uint32_t data);
+
+#define INIT_DELAYED_WORK(d, f)                                         \
+    do {                                                                \
+        INIT_WORK(&(d)->work, (f));                                     \
+        init_timer(&(d)->timer, delayed_work_timer_fn, (uint32_t)(d));  \
+        (d)->wq = NULL;                                                 \
+    } while (0)
+
+/* Create the shared "events" workqueue */
+void workqueue_init(void);
+
+/* Create a workqueue with its own worker thread */
+workqueue_t *create_workqueue(const char *name);
+
+/* Queue work (returns false if it was already pending) */
+bool queue_work(workqueue_t *wq, work_t *work);
+
+/* Queue work after delay ticks (returns false if already pending) */
+bool queue_delayed_work(workqueue_t *wq, delayed_work_t *dwork, uint32_t delay);
+
+/* Cancel work that has not started yet (returns true if it was pending) */
+bool cancel_work(work_t *work);
+bool cancel_delayed_work(delayed_work_t *dwork);
+
+/* Same, on the shared "events" workqueue */
+bool schedule_work(work_t *work);
+bool schedule_delayed_work(delayed_work_t *dwork, uint32_t delay);
+
+/* Print per-worker statistics */
+void workqueue_print_stats(void);
+
+#endif /* WORKQUEUE_H */
@@ -0,0 +1,110 @@
+/* acpi.c - Minimal ACPI table discovery (RSDP/RSDT walk) */
+
+#include "../include/acpi.h"
+#include "../include/paging.h"
+#include "../include/printf.h"
+#include "../include/string.h"
+
+/* BIOS areas searched for the RSDP */
+#define ACPI_EBDA_PTR       0x40E    /* Real-mode segment of the EBDA */
+#define ACPI_BIOS_ROM_START 0xE0000
+#define ACPI_BIOS_ROM_END   0x100000
+
+/* Maximum number of tables remembered from the RSDT */
+#define ACPI_MAX_TABLES 32
+
+/* Tables mapped once at init time */
+static const acpi_sdt_header_t *acpi_tables[ACPI_MAX_TABLES];
+static uint32_t acpi_table_count = 0;
+
+/* Sum bytes of a table (valid tables sum to zero) */
+static uint8_t acpi_checksum(const void *data, uint32_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint8_t sum = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum;
+}
+
+/* Scan a physical range (identity mapped) for the RSDP signature */
+static const acpi_rsdp_t *acpi_scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + sizeof(acpi_rsdp_t) <= end; addr += 16) {
+        const acpi_rsdp_t *rsdp = (const acpi_rsdp_t *)addr;
+        if (strncmp(rsdp->signature, "RSD PTR ", 8) == 0 &&
+            acpi_checksum(rsdp, sizeof(acpi_rsdp_t)) == 0) {
+            return rsdp;
+        }
+    }
+    return NULL;
+}
+
+/* Map a whole table: map the header first to learn its length */
+static const acpi_sdt_header_t *acpi_map_table(uint32_t phys_addr) {
+    const acpi_sdt_header_t *header =
+        (const acpi_sdt_header_t *)paging_map_mmio(phys_addr, sizeof(acpi_sdt_header_t));
+    if (!header) {
+        return NULL;
+    }
+
+    if (header->length <= sizeof(acpi_sdt_header_t)) {
+        return header;
+    }
+    return (const acpi_sdt_header_t *)paging_map_mmio(phys_addr, header->length);
+}
+
+/* Locate the RSDP and map the RSDT */
+int acpi_init(void) {
+    /* First KB of the EBDA, then the BIOS read-only area */
+    const acpi_rsdp_t *rsdp = NULL;
+    uint32_t ebda = (uint32_t)(*(volatile uint16_t *)ACPI_EBDA_PTR) << 4;
+    if (ebda) {
+        rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+    }
+    if (!rsdp) {
+        rsdp = acpi_scan_rsdp(ACPI_BIOS_ROM_START, ACPI_BIOS_ROM_END);
+    }
+    if (!rsdp) {
+        printk("[ACPI] RSDP not found\n");
+        return -1;
+    }
+
+    const acpi_sdt_header_t *rsdt = acpi_map_table(rsdp->rsdt_address);
+    if (!rsdt || strncmp(rsdt->signature, "RSDT", 4) != 0 ||
+        acpi_checksum(rsdt, rsdt->length) != 0) {
+        printk("[ACPI] Invalid RSDT at 0x%x\n", rsdp->rsdt_address);
+        return -1;
+    }
+
+    /* Map every valid table once so lookups do not consume MMIO window */
+    const uint32_t *entries = (const uint32_t *)(rsdt + 1);
+    uint32_t count = (rsdt->length - sizeof(acpi_sdt_header_t)) / 4;
+    acpi_table_count = 0;
+
+    for (uint32_t i = 0; i < count && acpi_table_count < ACPI_MAX_TABLES; i++) {
+        const acpi_sdt_header_t *table = acpi_map_table(entries[i]);
+        if (table && acpi_checksum(table, table->length) == 0) {
+            acpi_tables[acpi_table_count++] = table;
+        }
+    }
+
+    printk("[ACPI] RSDT at 0x%x (revision %d, %d tables)\n",
+           rsdp->rsdt_address, rsdp->revision, acpi_table_count);
+    return 0;
+}
+
+/* Find a table by its 4-character signature */
+const acpi_sdt_header_t *acpi_find_table(const char *signature) {
+    if (!signature) {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < acpi_table_count; i++) {
+        if (strncmp(acpi_tables[i]->signature, signature, 4) == 0) {
+            return acpi_tables[i];
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,253 @@
+/* apic.c - Local APIC: CPU enumeration, inter-processor interrupts, timer
+ *
+ * The local APIC is used to find and start the other CPUs, to send
+ * interrupts between CPUs, to acknowledge device interrupts once irq.c
+ * has moved them to the I/O APIC, and as a per-CPU periodic timer. The
+ * timer counts at the bus clock, which nothing reports, so it is measured
+ * against a PIT channel 2 window once on the boot CPU; every CPU then
+ * loads the same count.
+ */
+
+#include "../include/apic.h"
+#include "../include/acpi.h"
+#include "../include/cpu.h"
+#include "../include/paging.h"
+#include "../include/printf.h"
+#include "../include/smp.h"
+#include "../include/idt.h"
+#include "../include/clocksource.h"
+#include "../include/timer.h"
+#include "../include/math64.h"
+
+/* Spins waiting for the previous IPI to be accepted before giving up */
+#define APIC_ICR_TIMEOUT 1000000
+
+/* Timer calibration: best of a few 10 ms PIT windows */
+#define APIC_TIMER_CALIBRATE_MS   10
+#define APIC_TIMER_CALIBRATE_RUNS 3
+
+static volatile uint8_t *lapic_base = NULL;
+static uint32_t lapic_phys = 0;
+
+/* APIC IDs of the usable CPUs, boot CPU first */
+static uint32_t apic_cpu_ids[SMP_MAX_CPUS];
+static uint32_t apic_cpus = 0;
+
+/* Timer: counts per second and per tick (0 until calibrated) */
+static uint32_t apic_timer_hz = 0;
+static uint32_t apic_timer_count = 0;
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return *(volatile uint32_t *)(lapic_base + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t *)(lapic_base + reg) = value;
+}
+
+/* Enable this CPU's local APIC: global enable bit, software enable */
+static void apic_enable_cpu(void) {
+    wrmsr(MSR_IA32_APIC_BASE, rdmsr(MSR_IA32_APIC_BASE) | APIC_BASE_ENABLE);
+
+    lapic_write(APIC_REG_TPR, 0);
+    lapic_write(APIC_REG_LVT_ERROR, APIC_LVT_MASKED);
+    lapic_write(APIC_REG_SVR, APIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+
+    /* Clear errors latched before we got here (write, then read) */
+    lapic_write(APIC_REG_ESR, 0);
+    (void)lapic_read(APIC_REG_ESR);
+}
+
+/* Record a CPU once (the boot CPU is already first) */
+static void apic_add_cpu(uint32_t id) {
+    for (uint32_t i = 0; i < apic_cpus; i++) {
+        if (apic_cpu_ids[i] == id) {
+            return;
+        }
+    }
+    if (apic_cpus == SMP_MAX_CPUS) {
+        printk("[APIC] Ignoring CPU with APIC ID %d (max %d CPUs)\n", id, SMP_MAX_CPUS);
+        return;
+    }
+    apic_cpu_ids[apic_cpus++] = id;
+}
+
+/* Map and enable the boot CPU's local APIC and list the CPUs */
+int apic_init(void) {
+    if (!cpu_has_feature(CPUID_FEAT_EDX_APIC) || !cpu_has_feature(CPUID_FEAT_EDX_MSR)) {
+        printk("[APIC] No local APIC\n");
+        return -1;
+    }
+
+    const acpi_madt_t *madt = (const acpi_madt_t *)acpi_find_table("APIC");
+    lapic_phys = madt ? madt->lapic_address
+                      : (uint32_t)rdmsr(MSR_IA32_APIC_BASE) & APIC_BASE_ADDR_MASK;
+
+    lapic_base = (volatile uint8_t *)paging_map_mmio(lapic_phys, PAGE_SIZE);
+    if (!lapic_base) {
+        return -1;
+    }
+    apic_enable_cpu();
+
+    /* Boot CPU first, then every enabled processor entry */
+    apic_cpus = 0;
+    apic_add_cpu(apic_id());
+    if (madt) {
+        const uint8_t *entry = (const uint8_t *)(madt + 1);
+        const uint8_t *end = (const uint8_t *)madt + madt->header.length;
+
+        while (entry + sizeof(acpi_madt_entry_t) <= end) {
+            const acpi_madt_entry_t *header = (const acpi_madt_entry_t *)entry;
+            if (header->length < sizeof(acpi_madt_entry_t)) {
+                break;
+            }
+            if (header->type == ACPI_MADT_LAPIC) {
+                const acpi_madt_lapic_t *lapic = (const acpi_madt_lapic_t *)entry;
+                if (lapic->flags & ACPI_MADT_LAPIC_ENABLED) {
+                    apic_add_cpu(lapic->apic_id);
+                }
+            }
+            entry += header->length;
+        }
+    }
+
+    printk("[APIC] Local APIC at 0x%x, version 0x%x, %d CPU%s%s\n",
+           lapic_phys, lapic_read(APIC_REG_VERSION) & 0xFF, apic_cpus,
+           apic_cpus == 1 ? "" : "s", madt ? "" : " (no MADT)");
+    return 0;
+}
+
+/* Start this CPU's timer with the calibrated count */
+static void apic_timer_start(void) {
+    lapic_write(APIC_REG_TIMER_DIVIDE, APIC_TIMER_DIVIDE_16);
+    lapic_write(APIC_REG_LVT_TIMER, APIC_TIMER_PERIODIC | LOCAL_TIMER_VECTOR);
+    lapic_write(APIC_REG_TIMER_INITIAL, apic_timer_count);
+}
+
+/* Enable the local APIC of an application processor and start its timer;
+ * device interrupts are only routed to the boot CPU */
+void apic_init_ap(void) {
+    apic_enable_cpu();
+    lapic_write(APIC_REG_LVT_LINT0, APIC_LVT_MASKED);
+    lapic_write(APIC_REG_LVT_LINT1, APIC_LVT_MASKED);
+    if (apic_timer_count) {
+        apic_timer_start();
+    }
+}
+
+/* Whether apic_init found and enabled the local APIC */
+bool apic_enabled(void) {
+    return lapic_base != NULL;
+}
+
+/* This CPU's APIC ID */
+uint32_t apic_id(void) {
+    return lapic_read(APIC_REG_ID) >> 24;
+}
+
+/* Acknowledge the interrupt being handled */
+void apic_eoi(void) {
+    lapic_write(APIC_REG_EOI, 0);
+}
+
+/* Timer counts elapsed so far (counting down from all ones, masked) */
+static uint64_t apic_timer_elapsed(void) {
+    return 0xFFFFFFFF - lapic_read(APIC_REG_TIMER_CURRENT);
+}
+
+/* Calibrate the timer against the PIT and start it on this CPU */
+int apic_timer_init(uint32_t frequency) {
+    uint32_t latch = PIT_FREQUENCY / (1000 / APIC_TIMER_CALIBRATE_MS);
+    uint64_t best = 0;
+
+    if (!lapic_base || frequency == 0) {
+        return -1;
+    }
+
+    bool flags = interrupts_save();
+    lapic_write(APIC_REG_TIMER_DIVIDE, APIC_TIMER_DIVIDE_16);
+    lapic_write(APIC_REG_LVT_TIMER, APIC_LVT_MASKED | LOCAL_TIMER_VECTOR);
+    for (int i = 0; i < APIC_TIMER_CALIBRATE_RUNS; i++) {
+        lapic_write(APIC_REG_TIMER_INITIAL, 0xFFFFFFFF);
+        uint64_t delta = clocksource_measure_pit_window(latch, apic_timer_elapsed);
+        if (delta && (best == 0 || delta < best)) {
+            best = delta;
+        }
+    }
+    lapic_write(APIC_REG_TIMER_INITIAL, 0);
+
+    /* counts * PIT_FREQUENCY / latch = counts per second */
+    uint32_t hz = (uint32_t)div_u64(best * PIT_FREQUENCY, latch);
+    if (hz / frequency == 0) {
+        interrupts_restore(flags);
+        printk("[APIC] Timer calibration failed\n");
+        return -1;
+    }
+
+    apic_timer_hz = hz;
+    apic_timer_count = hz / frequency;
+    apic_timer_start();
+    interrupts_restore(flags);
+
+    printk("[APIC] Timer at %u kHz, %u counts per tick (%d Hz per CPU)\n",
+           apic_timer_hz / 1000, apic_timer_count, frequency);
+    return 0;
+}
+
+/* Whether the local APIC timers give every CPU its own tick */
+bool apic_timer_enabled(void) {
+    return apic_timer_count != 0;
+}
+
+/* Timer counts per second */
+uint32_t apic_timer_frequency(void) {
+    return apic_timer_hz;
+}
+
+/* Write the interrupt command register once the previous IPI is out.
+ * Only local interrupts are held off (an IPI sent from an interrupt
+ * handler must not land between the two writes): this also runs from
+ * panic and from handlers that do not take the interrupt lock. */
+static void apic_send(uint32_t apic_id, uint32_t command) {
+    uint32_t eflags;
+    __asm__ volatile("pushfl; pop %0; cli" : "=r"(eflags) : : "memory");
+
+    for (uint32_t i = 0; i < APIC_ICR_TIMEOUT; i++) {
+        if (!(lapic_read(APIC_REG_ICR_LOW) & APIC_ICR_PENDING)) {
+            break;
+        }
+        cpu_relax();
+    }
+
+    lapic_write(APIC_REG_ICR_HIGH, apic_id << 24);
+    lapic_write(APIC_REG_ICR_LOW, command);
+
+    if (eflags & EFLAGS_IF) {
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
+/* Fixed interrupt to one CPU */
+void apic_send_ipi(uint32_t apic_id, uint32_t vector) {
+    apic_send(apic_id, APIC_ICR_FIXED | APIC_ICR_ASSERT | (vector & 0xFF));
+}
+
+/* INIT: reset the CPU into its wait-for-startup state */
+void apic_send_init(uint32_t apic_id) {
+    apic_send(apic_id, APIC_ICR_INIT | APIC_ICR_LEVEL | APIC_ICR_ASSERT);
+    apic_send(apic_id, APIC_ICR_INIT | APIC_ICR_LEVEL);
+}
+
+/* STARTUP: start the CPU in real mode at page * 4 KB */
+void apic_send_startup(uint32_t apic_id, uint32_t page) {
+    apic_send(apic_id, APIC_ICR_STARTUP | (page & 0xFF));
+}
+
+/* CPUs listed (and enabled) in the MADT, boot CPU first */
+uint32_t apic_cpu_count(void) {
+    return apic_cpus;
+}
+
+uint32_t apic_cpu_apic_id(uint32_t index) {
+    return index < apic_cpus ? apic_cpu_ids[index] : 0;
+}
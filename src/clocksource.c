@@ -0,0 +1,304 @@
+/* clocksource.c - Clocksource registration, TSC calibration and ktime */
+
+#include "../include/clocksource.h"
+#include "../include/hpet.h"
+#include "../include/timer.h"
+#include "../include/cpu.h"
+#include "../include/math64.h"
+#include "../include/idt.h"
+#include "../include/io.h"
+#include "../include/printf.h"
+#include "../include/string.h"
+#include "../include/vga.h"
+#include "../include/vdso.h"
+
+/* PIT channel 2 is used as a one-shot reference to calibrate the TSC */
+#define PIT_CHANNEL2     0x42
+#define PIT_COMMAND      0x43
+#define PIT_GATE_PORT    0x61    /* Bit 0: ch2 gate, bit 1: speaker, bit 5: ch2 out */
+#define PIT_CH2_ONESHOT  0xB0    /* Channel 2, LSB/MSB, mode 0, binary */
+
+#define TSC_CALIBRATE_MS     10
+#define TSC_CALIBRATE_RUNS   3
+#define PIT_WINDOW_LOOPS     10000000  /* Give up if the PIT never fires */
+
+/* Registered clocksources (most recently registered first) */
+static clocksource_t *clocksource_list = NULL;
+static clocksource_t *clocksource_current = NULL;
+static bool clocksource_forced = false;
+
+/* Timekeeping base: ns at cycle_last, protected by a sequence count */
+static volatile uint32_t tk_seq = 0;
+static uint64_t tk_cycle_last = 0;
+static uint64_t tk_base_ns = 0;
+
+/* Always-present fallback: the PIT tick counter */
+static uint64_t jiffies_read(void) {
+    return timer_ticks;
+}
+
+static clocksource_t clocksource_jiffies = {
+    .name = "jiffies",
+    .rating = CLOCKSOURCE_RATING_JIFFIES,
+    .read = jiffies_read,
+    .mask = 0xFFFFFFFFULL,
+    .freq_khz = 0,
+    .mult = NSEC_PER_SEC / TIMER_FREQUENCY,
+    .shift = 0,
+    .next = NULL,
+};
+
+static uint64_t tsc_read(void) {
+    return rdtsc();
+}
+
+static clocksource_t clocksource_tsc = {
+    .name = "tsc",
+    .read = tsc_read,
+    .mask = 0xFFFFFFFFFFFFFFFFULL,
+};
+
+/* Compute mult/shift so that (cycles_at_from * mult) >> shift is in units of to */
+void clocksource_calc_mult_shift(uint32_t *mult, uint32_t *shift, uint32_t from, uint32_t to) {
+    uint32_t sft;
+    uint64_t tmp = 0;
+
+    /* Largest shift (best precision) whose multiplier still fits 32 bits */
+    for (sft = 32; sft > 0; sft--) {
+        tmp = div_u64((uint64_t)to << sft, from);
+        if ((tmp >> 32) == 0) {
+            break;
+        }
+    }
+    if (sft == 0) {
+        tmp = to / from;
+    }
+
+    *mult = (uint32_t)tmp;
+    *shift = sft;
+}
+
+/* Convert a cycle delta of a clocksource to nanoseconds */
+uint64_t clocksource_cyc2ns(const clocksource_t *cs, uint64_t cycles) {
+    return mul_u64_u32_shr(cycles, cs->mult, cs->shift);
+}
+
+/* Publish the time base to the vDSO page (the code page only knows
+ * how to read the TSC, other sources give tick resolution there) */
+static void timekeeping_update_vdso(void) {
+    clocksource_t *cs = clocksource_current;
+    vdso_update_time(timer_ticks,
+                     cs == &clocksource_tsc ? VDSO_CLOCK_TSC : VDSO_CLOCK_COARSE,
+                     cs->mult, cs->shift, tk_cycle_last, tk_base_ns);
+}
+
+/* Swap the timekeeping source without letting time jump backwards */
+static void timekeeping_switch(clocksource_t *cs) {
+    bool was_enabled = interrupts_save();
+
+    tk_seq++;
+    clocksource_t *old = clocksource_current;
+    if (old) {
+        uint64_t now = old->read();
+        tk_base_ns += clocksource_cyc2ns(old, (now - tk_cycle_last) & old->mask);
+    }
+    clocksource_current = cs;
+    if (old && old->disable) {
+        old->disable();
+    }
+    if (cs->enable) {
+        cs->enable();
+    }
+    tk_cycle_last = cs->read();
+    tk_seq++;
+    timekeeping_update_vdso();
+
+    interrupts_restore(was_enabled);
+}
+
+/* Register a clocksource and switch to it if it rates higher */
+int clocksource_register(clocksource_t *cs) {
+    if (!cs || !cs->read) {
+        return -1;
+    }
+
+    if (cs->mult == 0) {
+        if (cs->freq_khz == 0) {
+            return -1;
+        }
+        clocksource_calc_mult_shift(&cs->mult, &cs->shift, cs->freq_khz, NSEC_PER_MSEC);
+    }
+
+    cs->next = clocksource_list;
+    clocksource_list = cs;
+
+    if (!clocksource_forced &&
+        (!clocksource_current || cs->rating > clocksource_current->rating)) {
+        timekeeping_switch(cs);
+    }
+    return 0;
+}
+
+/* Force a clocksource by name (returns -1 if unknown) */
+int clocksource_select(const char *name) {
+    clocksource_t *cs = clocksource_find(name);
+    if (!cs) {
+        return -1;
+    }
+
+    clocksource_forced = true;
+    if (cs != clocksource_current) {
+        timekeeping_switch(cs);
+    }
+    return 0;
+}
+
+/* Look up a registered clocksource by name */
+clocksource_t *clocksource_find(const char *name) {
+    for (clocksource_t *cs = clocksource_list; cs; cs = cs->next) {
+        if (strcmp(cs->name, name) == 0) {
+            return cs;
+        }
+    }
+    return NULL;
+}
+
+/* Get the clocksource currently used for timekeeping */
+clocksource_t *clocksource_get_current(void) {
+    return clocksource_current;
+}
+
+/* Fold elapsed cycles into the time base (called on each timer tick)
+ * Keeping the delta small avoids counter wrap (32-bit HPET) and
+ * overflow in the cycles-to-ns multiplication. */
+void clocksource_tick(void) {
+    clocksource_t *cs = clocksource_current;
+    uint64_t now = cs->read();
+
+    tk_seq++;
+    __asm__ volatile("" ::: "memory");
+    tk_base_ns += clocksource_cyc2ns(cs, (now - tk_cycle_last) & cs->mask);
+    tk_cycle_last = now;
+    __asm__ volatile("" ::: "memory");
+    tk_seq++;
+
+    timekeeping_update_vdso();
+}
+
+/* Monotonic time since boot in nanoseconds */
+uint64_t ktime_get_ns(void) {
+    clocksource_t *cs;
+    uint64_t base, last, now;
+    uint32_t seq;
+
+    /* Retry if a timer tick updated the base while we were reading */
+    do {
+        seq = tk_seq;
+        __asm__ volatile("" ::: "memory");
+        cs = clocksource_current;
+        base = tk_base_ns;
+        last = tk_cycle_last;
+        now = cs->read();
+        __asm__ volatile("" ::: "memory");
+    } while ((seq & 1) || seq != tk_seq);
+
+    return base + clocksource_cyc2ns(cs, (now - last) & cs->mask);
+}
+
+/* Monotonic time since boot in microseconds */
+uint64_t ktime_get_us(void) {
+    return div_u64(ktime_get_ns(), NSEC_PER_USEC);
+}
+
+/* Measure how far a counter advances across one PIT channel 2 one-shot
+ * countdown of latch PIT cycles (0 if the PIT never fires) */
+uint64_t clocksource_measure_pit_window(uint32_t latch, uint64_t (*read)(void)) {
+    uint8_t gate = inb(PIT_GATE_PORT);
+
+    /* Gate high, speaker off */
+    outb(PIT_GATE_PORT, (gate & ~0x02) | 0x01);
+
+    outb(PIT_COMMAND, PIT_CH2_ONESHOT);
+    outb(PIT_CHANNEL2, latch & 0xFF);
+    outb(PIT_CHANNEL2, (latch >> 8) & 0xFF);
+
+    uint64_t start = read();
+    uint32_t loops = 0;
+    while (!(inb(PIT_GATE_PORT) & 0x20)) {
+        if (++loops > PIT_WINDOW_LOOPS) {
+            outb(PIT_GATE_PORT, gate);
+            return 0;
+        }
+    }
+    uint64_t end = read();
+
+    outb(PIT_GATE_PORT, gate);
+    return end - start;
+}
+
+/* Calibrate the TSC frequency in kHz (0 on failure) */
+static uint32_t tsc_calibrate_khz(void) {
+    uint32_t latch = PIT_FREQUENCY / (1000 / TSC_CALIBRATE_MS);
+    uint64_t best = 0;
+
+    /* The shortest window is the one least disturbed by SMIs/emulation */
+    for (int i = 0; i < TSC_CALIBRATE_RUNS; i++) {
+        uint64_t delta = clocksource_measure_pit_window(latch, tsc_read);
+        if (delta && (best == 0 || delta < best)) {
+            best = delta;
+        }
+    }
+
+    if (best == 0) {
+        return 0;
+    }
+
+    /* cycles * PIT_FREQUENCY / latch = Hz; divide by 1000 for kHz */
+    return (uint32_t)div_u64(div_u64(best * PIT_FREQUENCY, latch), 1000);
+}
+
+/* Probe and calibrate the available clocksources (TSC, HPET) */
+void clocksource_init(void) {
+    clocksource_register(&clocksource_jiffies);
+
+    if (cpu_has_feature(CPUID_FEAT_EDX_TSC)) {
+        uint32_t khz = tsc_calibrate_khz();
+        if (khz) {
+            bool invariant = cpu_has_invariant_tsc();
+            clocksource_tsc.freq_khz = khz;
+            clocksource_tsc.rating = invariant ? CLOCKSOURCE_RATING_TSC_INVARIANT
+                                               : CLOCKSOURCE_RATING_TSC;
+            clocksource_register(&clocksource_tsc);
+            printk("[CLOCK] TSC calibrated: %u kHz%s\n", khz,
+                   invariant ? " (invariant)" : "");
+        } else {
+            printk("[CLOCK] TSC calibration failed\n");
+        }
+    }
+
+    hpet_init();
+
+    printk("[CLOCK] Using clocksource '%s'\n", clocksource_current->name);
+}
+
+/* Print registered clocksources */
+void clocksource_print_info(void) {
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Clocksources ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    for (clocksource_t *cs = clocksource_list; cs; cs = cs->next) {
+        printk("  %c %s: rating %d, ", cs == clocksource_current ? '*' : ' ',
+               cs->name, cs->rating);
+        if (cs->freq_khz) {
+            printk("%u kHz", cs->freq_khz);
+        } else {
+            printk("%u Hz", TIMER_FREQUENCY);
+        }
+        printk(", mult %u, shift %u\n", cs->mult, cs->shift);
+    }
+
+    uint64_t ns = ktime_get_ns();
+    printk("Uptime: %u ms (%u us)\n", (uint32_t)div_u64(ns, NSEC_PER_MSEC),
+           (uint32_t)div_u64(ns, NSEC_PER_USEC));
+}
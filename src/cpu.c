@@ -0,0 +1,23 @@
+/* cpu.c - CPU feature detection */
+
+#include "../include/cpu.h"
+
+/* Check whether CPUID reports a leaf 1 EDX feature */
+bool cpu_has_feature(uint32_t edx_bit) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    return (edx & edx_bit) != 0;
+}
+
+/* Check whether the TSC is invariant across P/C-states */
+bool cpu_has_invariant_tsc(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax < 0x80000007) {
+        return false;
+    }
+
+    cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx & CPUID_APM_EDX_INVARIANT_TSC) != 0;
+}
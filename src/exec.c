@@ -0,0 +1,687 @@
+/* exec.c - ELF program loading with demand-paged segments
+ *
+ * execve only reads the ELF header and program headers. Each PT_LOAD
+ * segment becomes a vm_area of the new address space that remembers which
+ * file bytes back it; nothing is read or allocated for it yet. The first
+ * access to one of its pages faults, and the page fault handler fills in
+ * just that page: file bytes up to p_filesz, zeroes after (BSS, and pages
+ * past the end of the file data are never read at all). Starting a
+ * program therefore costs the pages it actually touches, not the size of
+ * the binary.
+ *
+ * Read-only file pages (text, rodata) are shared through the page cache,
+ * so every process running the same binary maps the same frames; only
+ * writable data, BSS and stacks are private.
+ *
+ * Like every other process on this kernel, the loaded image runs in
+ * kernel mode on its process's kernel stack: the entry point is called
+ * as a function and its return value is the exit status.
+ */
+
+#include "../include/exec.h"
+#include "../include/elf.h"
+#include "../include/pagecache.h"
+#include "../include/process.h"
+#include "../include/paging.h"
+#include "../include/kmalloc.h"
+#include "../include/string.h"
+#include "../include/syscall.h"
+#include "../include/clocksource.h"
+#include "../include/math64.h"
+#include "../include/idt.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+
+/* Segments must lie between the kernel identity mapping and the thread
+ * stack area below USER_STACK_BASE */
+#define EXEC_USER_BASE 0x00800000
+#define EXEC_USER_TOP  0x0F000000
+
+#define PAGE_ALIGN_UP(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+/* Statistics */
+static exec_stats_t exec_stats;
+
+/* ===== Mappings ===== */
+
+/* File references are shared by the mappings of every address space
+ * that inherited them, so the counts change under the interrupt lock */
+static void vm_file_get(vm_file_t *file) {
+    bool flags = interrupts_save();
+    file->refs++;
+    interrupts_restore(flags);
+}
+
+static void vm_file_put(vm_file_t *file) {
+    if (!file) {
+        return;
+    }
+
+    bool flags = interrupts_save();
+    bool last = --file->refs == 0;
+    interrupts_restore(flags);
+    if (last) {
+        kfree(file);
+    }
+}
+
+/* Find the mapping containing addr */
+static vm_area_t *vma_find(mm_t *mm, uint32_t addr) {
+    for (vm_area_t *vma = mm->vmas; vma; vma = vma->next) {
+        if (addr >= vma->start && addr < vma->end) {
+            return vma;
+        }
+    }
+    return NULL;
+}
+
+/* Fill in the page at addr from its mapping (0 on success, -1 if the
+ * address is not mapped or the access is not allowed) */
+int vma_fault(mm_t *mm, uint32_t addr, uint32_t err_code, bool can_block) {
+    vm_area_t *vma = vma_find(mm, addr);
+    if (!vma) {
+        return -1;
+    }
+    if ((err_code & PAGE_FAULT_WRITE) && !(vma->flags & SECTION_WRITE)) {
+        return -1;
+    }
+
+    uint32_t page = addr & ~(PAGE_SIZE - 1);
+    bool from_file = vma->file && page < vma->file_end;
+    uint32_t len = 0;
+    if (from_file) {
+        len = vma->file_end - page;
+        if (len > PAGE_SIZE) {
+            len = PAGE_SIZE;
+        }
+    }
+
+    /* Read-only file pages come from the page cache, shared with every
+     * other address space mapping them (the read may sleep) */
+    if (from_file && !(vma->flags & SECTION_WRITE)) {
+        uint32_t bytes_read;
+        vm_file_get(vma->file);
+        uint32_t frame = pagecache_get_page(&vma->file->node,
+                                            vma->file_offset + (page - vma->start), len,
+                                            can_block, &bytes_read);
+        vm_file_put(vma->file);
+        if (!frame) {
+            return -1;
+        }
+
+        /* Another thread of the address space faulted it in while we slept */
+        if (paging_get_physical_address(page)) {
+            pagecache_put(frame);
+            return 0;
+        }
+
+        paging_map_page_in_directory(mm->pgd, page, frame, PAGE_USER | PAGE_CACHED);
+        mm->file_faults++;
+        exec_stats.file_faults++;
+        exec_stats.bytes_read += bytes_read;
+        if (!bytes_read) {
+            exec_stats.cache_faults++;
+        }
+        return 0;
+    }
+
+    uint8_t *frame = (uint8_t *)paging_alloc_frame();
+    if (!frame) {
+        return -1;
+    }
+    memset(frame, 0, PAGE_SIZE);
+
+    /* Private copy of writable file data (the disk read may sleep) */
+    if (from_file) {
+        vm_file_get(vma->file);
+        if (can_block) {
+            interrupts_enable();
+        }
+        int n = vfs_read(&vma->file->node, vma->file_offset + (page - vma->start), len, frame);
+        interrupts_disable();
+        vm_file_put(vma->file);
+
+        if (n < 0) {
+            kfree(frame);
+            return -1;
+        }
+        exec_stats.bytes_read += (uint32_t)n;
+    }
+
+    /* Another thread of the address space faulted it in while we slept */
+    if (paging_get_physical_address(page)) {
+        kfree(frame);
+        return 0;
+    }
+
+    uint32_t page_flags = PAGE_USER;
+    if (vma->flags & SECTION_WRITE) {
+        page_flags |= PAGE_WRITE;
+    }
+    paging_map_page_in_directory(mm->pgd, page, (uint32_t)frame, page_flags);
+
+    if (from_file) {
+        mm->file_faults++;
+        exec_stats.file_faults++;
+    } else {
+        mm->zero_faults++;
+        exec_stats.zero_faults++;
+    }
+    return 0;
+}
+
+/* Give a copied address space its own copy of the mapping list */
+int vma_dup(mm_t *dst, const mm_t *src) {
+    vm_area_t **tail = &dst->vmas;
+
+    for (const vm_area_t *vma = src->vmas; vma; vma = vma->next) {
+        vm_area_t *copy = (vm_area_t *)kmalloc(sizeof(vm_area_t));
+        if (!copy) {
+            return -1;  /* The partial list is freed with dst */
+        }
+
+        *copy = *vma;
+        copy->next = NULL;
+        if (copy->file) {
+            vm_file_get(copy->file);
+        }
+        *tail = copy;
+        tail = &copy->next;
+    }
+    return 0;
+}
+
+/* Drop every mapping of an address space */
+void vma_free_all(mm_t *mm) {
+    vm_area_t *vma = mm->vmas;
+    while (vma) {
+        vm_area_t *next = vma->next;
+        vm_file_put(vma->file);
+        kfree(vma);
+        vma = next;
+    }
+    mm->vmas = NULL;
+}
+
+/* Record a PT_LOAD segment as a demand-paged mapping */
+static int vma_add_segment(mm_t *mm, vm_file_t *file, const elf32_phdr_t *phdr) {
+    vm_area_t *vma = (vm_area_t *)kmalloc(sizeof(vm_area_t));
+    if (!vma) {
+        return -1;
+    }
+
+    vma->start = phdr->p_vaddr & ~(PAGE_SIZE - 1);
+    vma->end = PAGE_ALIGN_UP(phdr->p_vaddr + phdr->p_memsz);
+    vma->flags = ((phdr->p_flags & PF_R) ? SECTION_READ : 0) |
+                 ((phdr->p_flags & PF_W) ? SECTION_WRITE : 0) |
+                 ((phdr->p_flags & PF_X) ? SECTION_EXEC : 0);
+    vma->file = NULL;
+    vma->file_offset = phdr->p_offset - (phdr->p_vaddr - vma->start);
+    vma->file_end = phdr->p_vaddr + phdr->p_filesz;
+    if (phdr->p_filesz) {
+        vma->file = file;
+        vm_file_get(file);
+    }
+
+    vma->next = mm->vmas;
+    mm->vmas = vma;
+    return 0;
+}
+
+/* ===== ELF loading ===== */
+
+/* Check the file header of an i386 executable */
+static int exec_check_header(const elf32_ehdr_t *ehdr) {
+    if (ehdr->e_ident[0] != ELFMAG0 || ehdr->e_ident[1] != ELFMAG1 ||
+        ehdr->e_ident[2] != ELFMAG2 || ehdr->e_ident[3] != ELFMAG3) {
+        return -1;
+    }
+    if (ehdr->e_ident[EI_CLASS] != ELFCLASS32 || ehdr->e_ident[EI_DATA] != ELFDATA2LSB) {
+        return -1;
+    }
+    if (ehdr->e_type != ET_EXEC || ehdr->e_machine != EM_386) {
+        return -1;
+    }
+    if (ehdr->e_phentsize != sizeof(elf32_phdr_t) || ehdr->e_phnum == 0 || ehdr->e_phnum > 16) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Check a PT_LOAD segment against the user range and the others */
+static int exec_check_segment(const elf32_phdr_t *phdr, const elf32_phdr_t *loads, int count) {
+    uint32_t start = phdr->p_vaddr & ~(PAGE_SIZE - 1);
+    uint32_t end = phdr->p_vaddr + phdr->p_memsz;
+
+    if (phdr->p_filesz > phdr->p_memsz || end < phdr->p_vaddr) {
+        return -1;
+    }
+    if ((phdr->p_vaddr & (PAGE_SIZE - 1)) != (phdr->p_offset & (PAGE_SIZE - 1))) {
+        return -1;
+    }
+    if (start < EXEC_USER_BASE || end > EXEC_USER_TOP) {
+        return -1;
+    }
+
+    /* Each page belongs to one mapping */
+    end = PAGE_ALIGN_UP(end);
+    for (int i = 0; i < count; i++) {
+        uint32_t other_start = loads[i].p_vaddr & ~(PAGE_SIZE - 1);
+        uint32_t other_end = PAGE_ALIGN_UP(loads[i].p_vaddr + loads[i].p_memsz);
+        if (start < other_end && other_start < end) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Describe the loaded segments in the mm sections (text, rodata, data, bss) */
+static void exec_set_sections(mm_t *mm, const elf32_phdr_t *loads, int count) {
+    uint32_t top = 0;
+
+    for (int i = 0; i < count; i++) {
+        const elf32_phdr_t *phdr = &loads[i];
+        uint32_t flags = ((phdr->p_flags & PF_R) ? SECTION_READ : 0) |
+                         ((phdr->p_flags & PF_W) ? SECTION_WRITE : 0) |
+                         ((phdr->p_flags & PF_X) ? SECTION_EXEC : 0);
+        process_section_t section = { phdr->p_vaddr, phdr->p_memsz, flags };
+
+        if (phdr->p_flags & PF_X) {
+            mm->text_section = section;
+        } else if (phdr->p_flags & PF_W) {
+            section.size = phdr->p_filesz;
+            mm->data_section = section;
+            mm->bss_section.start_addr = phdr->p_vaddr + phdr->p_filesz;
+            mm->bss_section.size = phdr->p_memsz - phdr->p_filesz;
+            mm->bss_section.flags = flags;
+        } else {
+            mm->rodata_section = section;
+        }
+
+        uint32_t end = PAGE_ALIGN_UP(phdr->p_vaddr + phdr->p_memsz);
+        if (end > top) {
+            top = end;
+        }
+    }
+
+    mm->heap_start = top;
+    mm->heap_end = top;
+}
+
+/* Resolve path, relative to the working directory unless absolute */
+static vfs_node_t *exec_resolve(const char *path) {
+    if (path[0] == '/') {
+        return vfs_resolve_path(path);
+    }
+
+    char full_path[256];
+    process_t *current = process_get_current();
+    const char *pwd = current ? process_get_pwd(current) : "/";
+    if (strcmp(pwd, "/") == 0) {
+        snprintf(full_path, sizeof(full_path), "/%s", path);
+    } else {
+        snprintf(full_path, sizeof(full_path), "%s/%s", pwd, path);
+    }
+    return vfs_resolve_path(full_path);
+}
+
+/* Entered when the image's entry point returns */
+static void __attribute__((regparm(1), noreturn)) exec_image_exit(int status) {
+    process_exit(process_get_current(), status);
+    __builtin_unreachable();
+}
+
+/* Run the new image on a fresh kernel stack, abandoning the execve call
+ * frames (the int 0x80 frame included): the entry point returns into
+ * exec_image_exit with its exit status in EAX */
+static void __attribute__((noreturn)) exec_start_image(process_t *proc, uint32_t entry) {
+    uint32_t stack_top = proc->kernel_stack + KERNEL_STACK_SIZE;
+
+    interrupts_disable();
+    process_account_syscall_exit(SYS_EXECVE, 0);
+
+    /* The sti below turns interrupts back on without interrupts_enable */
+    irq_lock_release();
+
+    __asm__ volatile(
+        "mov %0, %%esp\n"
+        "xor %%ebp, %%ebp\n"
+        "push $0\n"             /* Fake return address of exec_image_exit */
+        "push %1\n"             /* Entry point returns into exec_image_exit */
+        "sti\n"
+        "jmp *%2\n"
+        : : "r"(stack_top), "r"((uint32_t)exec_image_exit), "r"(entry) : "memory");
+    __builtin_unreachable();
+}
+
+/* Last component of a path (the process name) */
+static const char *exec_basename(const char *path) {
+    const char *base = path;
+    for (const char *p = path; *p; p++) {
+        if (*p == '/' && p[1]) {
+            base = p + 1;
+        }
+    }
+    return base;
+}
+
+/* Build an address space for the ELF at path. Only the headers are read:
+ * the segments are recorded as mappings and fault in on first access. */
+static mm_t *exec_load(const char *path, uint32_t *entry) {
+    vfs_node_t *node = exec_resolve(path);
+    if (!node || node->type != VFS_FILE_TYPE_REGULAR) {
+        return NULL;
+    }
+
+    elf32_ehdr_t ehdr;
+    if (vfs_read(node, 0, sizeof(ehdr), &ehdr) != (int)sizeof(ehdr) ||
+        exec_check_header(&ehdr) != 0) {
+        printk("[EXEC] %s: not an i386 ELF executable\n", path);
+        return NULL;
+    }
+
+    elf32_phdr_t loads[EXEC_MAX_SEGMENTS];
+    int nr_loads = 0;
+    bool entry_ok = false;
+    for (uint32_t i = 0; i < ehdr.e_phnum; i++) {
+        elf32_phdr_t phdr;
+        uint32_t offset = ehdr.e_phoff + i * sizeof(elf32_phdr_t);
+        if (vfs_read(node, offset, sizeof(phdr), &phdr) != (int)sizeof(phdr)) {
+            return NULL;
+        }
+        if (phdr.p_type != PT_LOAD || phdr.p_memsz == 0) {
+            continue;
+        }
+        if (nr_loads == EXEC_MAX_SEGMENTS || exec_check_segment(&phdr, loads, nr_loads) != 0) {
+            printk("[EXEC] %s: bad segment at 0x%x\n", path, phdr.p_vaddr);
+            return NULL;
+        }
+        if ((phdr.p_flags & PF_X) && ehdr.e_entry >= phdr.p_vaddr &&
+            ehdr.e_entry < phdr.p_vaddr + phdr.p_memsz) {
+            entry_ok = true;
+        }
+        loads[nr_loads++] = phdr;
+    }
+    if (!entry_ok) {
+        printk("[EXEC] %s: entry point 0x%x outside executable segments\n", path, ehdr.e_entry);
+        return NULL;
+    }
+
+    /* The mappings keep their own copy of the node (lookups may be transient) */
+    vm_file_t *file = (vm_file_t *)kmalloc(sizeof(vm_file_t));
+    mm_t *mm = process_mm_create();
+    if (!file || !mm) {
+        kfree(file);
+        mm_put(mm);
+        return NULL;
+    }
+    file->refs = 1;
+    memcpy(&file->node, node, sizeof(vfs_node_t));
+
+    for (int i = 0; i < nr_loads; i++) {
+        if (vma_add_segment(mm, file, &loads[i]) != 0) {
+            vm_file_put(file);
+            mm_put(mm);
+            return NULL;
+        }
+    }
+    vm_file_put(file);
+    exec_set_sections(mm, loads, nr_loads);
+
+    *entry = ehdr.e_entry;
+    return mm;
+}
+
+/* Replace the current process image with the ELF at path; only returns
+ * on error. Only the headers are read here, segments fault in later. */
+int process_execve(const char *path) {
+    process_t *proc = process_get_current();
+    if (!proc || !path || !path[0]) {
+        return -1;
+    }
+
+    /* Other threads would lose their code and stacks */
+    if (proc->cold->group && proc->cold->group->nr_threads > 1) {
+        printk("[EXEC] PID %d: exec from a multi-threaded process\n", proc->pid);
+        return -1;
+    }
+
+    uint64_t start_ns = ktime_get_ns();
+
+    /* The path may live in the address space about to be dropped */
+    char name[256];
+    strncpy(name, path, sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+
+    uint32_t entry;
+    mm_t *mm = exec_load(name, &entry);
+    if (!mm) {
+        return -1;
+    }
+
+    /* Point of no return: the old image is gone (a vfork parent resumes) */
+    process_exec_mm(proc, mm);
+    proc->flags &= ~PROCESS_FLAG_KTHREAD;
+    proc->thread_fn = NULL;
+    proc->thread_data = NULL;
+    proc->context.eip = entry;
+    process_set_name(proc, exec_basename(name));
+
+    exec_stats.execs++;
+    exec_stats.load_ns += ktime_get_ns() - start_ns;
+
+    exec_start_image(proc, entry);
+}
+
+/* First code of a spawned process: call the image's entry point */
+static int exec_spawn_entry(void *entry) {
+    return ((int (*)(void))entry)();
+}
+
+/* Start the ELF at path as a new child of the current process, without
+ * copying or borrowing anything from the caller */
+process_t *process_spawn_path(const char *path) {
+    process_t *parent = process_get_current();
+    if (!parent || !path || !path[0]) {
+        return NULL;
+    }
+
+    uint64_t start_ns = ktime_get_ns();
+
+    uint32_t entry;
+    mm_t *mm = exec_load(path, &entry);
+    if (!mm) {
+        return NULL;
+    }
+
+    process_t *child = process_spawn(parent, mm, exec_spawn_entry, (void *)entry,
+                                     exec_basename(path));
+    if (child) {
+        exec_stats.spawns++;
+        exec_stats.load_ns += ktime_get_ns() - start_ns;
+    }
+    return child;
+}
+
+/* sys_execve(path, argv, envp): arguments and environment are not passed on */
+int sys_execve(uint32_t path, uint32_t argv, uint32_t envp, uint32_t unused1, uint32_t unused2) {
+    (void)argv;
+    (void)envp;
+    (void)unused1;
+    (void)unused2;
+
+    return process_execve((const char *)path);
+}
+
+/* sys_spawn(path, argv): start the binary as a new child, returns its PID */
+int sys_spawn(uint32_t path, uint32_t argv, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
+    (void)argv;
+    (void)unused1;
+    (void)unused2;
+    (void)unused3;
+
+    process_t *child = process_spawn_path((const char *)path);
+    return child ? (int)child->pid : -1;
+}
+
+/* ===== Built-in images (/bin) ===== */
+
+/* A 4-page text segment whose first page holds the code, and a data
+ * segment of one message followed by 64KB of BSS. Running it touches one
+ * text page, one data page and one BSS page out of 21. */
+#define HELLO_TEXT_VADDR  0x08048000
+#define HELLO_TEXT_SIZE   (4 * PAGE_SIZE)
+#define HELLO_DATA_VADDR  0x08050000
+#define HELLO_DATA_SIZE   64
+#define HELLO_BSS_SIZE    0x10000
+#define HELLO_BSS_TOUCH   (HELLO_DATA_VADDR + 0x8000)
+#define HELLO_CODE_OFFSET (sizeof(elf32_ehdr_t) + 2 * sizeof(elf32_phdr_t))
+#define HELLO_MSG         "Hello from a demand-paged ELF image\n"
+
+#define LE32(x) ((x) & 0xFF), (((x) >> 8) & 0xFF), (((x) >> 16) & 0xFF), (((x) >> 24) & 0xFF)
+
+typedef struct {
+    elf32_ehdr_t ehdr;
+    elf32_phdr_t phdr[2];
+    uint8_t code[HELLO_TEXT_SIZE - HELLO_CODE_OFFSET];
+    char data[HELLO_DATA_SIZE];
+} __attribute__((packed)) hello_image_t;
+
+static const hello_image_t hello_image = {
+    .ehdr = {
+        .e_ident = { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS32, ELFDATA2LSB, EV_CURRENT },
+        .e_type = ET_EXEC,
+        .e_machine = EM_386,
+        .e_version = EV_CURRENT,
+        .e_entry = HELLO_TEXT_VADDR + HELLO_CODE_OFFSET,
+        .e_phoff = sizeof(elf32_ehdr_t),
+        .e_ehsize = sizeof(elf32_ehdr_t),
+        .e_phentsize = sizeof(elf32_phdr_t),
+        .e_phnum = 2,
+    },
+    .phdr = {
+        { PT_LOAD, 0, HELLO_TEXT_VADDR, HELLO_TEXT_VADDR,
+          HELLO_TEXT_SIZE, HELLO_TEXT_SIZE, PF_R | PF_X, PAGE_SIZE },
+        { PT_LOAD, HELLO_TEXT_SIZE, HELLO_DATA_VADDR, HELLO_DATA_VADDR,
+          HELLO_DATA_SIZE, HELLO_DATA_SIZE + HELLO_BSS_SIZE, PF_R | PF_W, PAGE_SIZE },
+    },
+    .code = {
+        0x53,                                   /* push %ebx */
+        0xB8, LE32(SYS_WRITE),                  /* mov $SYS_WRITE, %eax */
+        0xBB, LE32(1),                          /* mov $1, %ebx */
+        0xB9, LE32(HELLO_DATA_VADDR),           /* mov $msg, %ecx */
+        0xBA, LE32(sizeof(HELLO_MSG) - 1),      /* mov $len, %edx */
+        0xCD, 0x80,                             /* int $0x80 */
+        0xC7, 0x05, LE32(HELLO_BSS_TOUCH),
+                    LE32(0x600DF00D),           /* movl $0x600DF00D, bss */
+        0xA1, LE32(HELLO_BSS_TOUCH + 4),        /* mov bss+4, %eax (0 if zero-filled) */
+        0x5B,                                   /* pop %ebx */
+        0xC3,                                   /* ret: exit status in %eax */
+    },
+    .data = HELLO_MSG,
+};
+
+/* /bin/true: one page, returns 0 at once (process launch benchmarks) */
+#define TRUE_VADDR       0x08048000
+#define TRUE_CODE_OFFSET (sizeof(elf32_ehdr_t) + sizeof(elf32_phdr_t))
+
+typedef struct {
+    elf32_ehdr_t ehdr;
+    elf32_phdr_t phdr;
+    uint8_t code[4];
+} __attribute__((packed)) true_image_t;
+
+static const true_image_t true_image = {
+    .ehdr = {
+        .e_ident = { ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS32, ELFDATA2LSB, EV_CURRENT },
+        .e_type = ET_EXEC,
+        .e_machine = EM_386,
+        .e_version = EV_CURRENT,
+        .e_entry = TRUE_VADDR + TRUE_CODE_OFFSET,
+        .e_phoff = sizeof(elf32_ehdr_t),
+        .e_ehsize = sizeof(elf32_ehdr_t),
+        .e_phentsize = sizeof(elf32_phdr_t),
+        .e_phnum = 1,
+    },
+    .phdr = { PT_LOAD, 0, TRUE_VADDR, TRUE_VADDR,
+              sizeof(true_image_t), sizeof(true_image_t), PF_R | PF_X, PAGE_SIZE },
+    .code = {
+        0x31, 0xC0,                             /* xor %eax, %eax */
+        0xC3,                                   /* ret */
+    },
+};
+
+/* Images served from /bin (the node's inode is the table index) */
+static const struct {
+    const char *name;
+    const void *image;
+    uint32_t size;
+} exec_builtins[] = {
+    { "hello", &hello_image, sizeof(hello_image) },
+    { "true",  &true_image,  sizeof(true_image) },
+};
+
+#define EXEC_NR_BUILTINS (sizeof(exec_builtins) / sizeof(exec_builtins[0]))
+
+static int exec_builtin_read(vfs_node_t *node, uint32_t offset, uint32_t size, void *buffer) {
+    uint32_t image_size = exec_builtins[node->inode].size;
+
+    if (offset >= image_size) {
+        return 0;
+    }
+    if (size > image_size - offset) {
+        size = image_size - offset;
+    }
+    memcpy(buffer, (const uint8_t *)exec_builtins[node->inode].image + offset, size);
+    return (int)size;
+}
+
+/* Create /bin with the built-in images */
+void exec_init(void) {
+    vfs_node_t *bin = vfs_create_dir(vfs_get_root(), "bin");
+    if (!bin) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < EXEC_NR_BUILTINS; i++) {
+        vfs_node_t *node = (vfs_node_t *)kmalloc(sizeof(vfs_node_t));
+        if (!node) {
+            return;
+        }
+        memset(node, 0, sizeof(vfs_node_t));
+        strcpy(node->name, exec_builtins[i].name);
+        node->type = VFS_FILE_TYPE_REGULAR;
+        node->inode = i;
+        node->size = exec_builtins[i].size;
+        node->mode = 0755;
+        node->read = exec_builtin_read;
+        vfs_add_child(bin, node);
+    }
+
+    printk("[VFS] Created /bin (%u built-in ELF images)\n", (uint32_t)EXEC_NR_BUILTINS);
+}
+
+/* ===== Statistics ===== */
+
+void exec_get_stats(exec_stats_t *stats) {
+    bool flags = interrupts_save();
+    *stats = exec_stats;
+    interrupts_restore(flags);
+}
+
+/* Print load/fault statistics */
+void exec_print_stats(void) {
+    exec_stats_t stats;
+    exec_get_stats(&stats);
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== exec ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    uint32_t loads = stats.execs + stats.spawns;
+    printk("execve calls %u, spawns %u, avg load %u us\n", stats.execs, stats.spawns,
+           loads ? (uint32_t)div_u64(div_u64(stats.load_ns, loads), NSEC_PER_USEC) : 0);
+    printk("Page faults: %u from file (%u from the page cache, %u bytes read), %u demand-zero\n",
+           stats.file_faults, stats.cache_faults, (uint32_t)stats.bytes_read, stats.zero_faults);
+    pagecache_print_stats();
+}
@@ -6,6 +6,7 @@
 #include "../include/string.h"
 #include "../include/kmalloc.h"
 #include "../include/panic.h"
+#include "../include/preempt.h"
 
 /* Get block size from superblock */
 uint32_t ext2_get_block_size(ext2_filesystem_t *fs) {
@@ -186,60 +187,99 @@ int ext2_write_inode(ext2_filesystem_t *fs, uint32_t inode_num, const ext2_inode
     return result;
 }
 
-/* Read data from an inode (handles direct, indirect, double indirect blocks) */
-int ext2_read_inode_data(ext2_filesystem_t *fs, ext2_inode_t *inode,
-                         uint32_t offset, uint32_t size, void *buffer) {
-    uint32_t blocks_read = 0;
-    uint32_t bytes_read = 0;
-    uint32_t start_block = offset / fs->block_size;
-    uint32_t end_block = (offset + size + fs->block_size - 1) / fs->block_size;
+/* Largest single disk request (the IDE sector count is 8 bits) */
+#define EXT2_MAX_RUN_SECTORS 128
 
-    uint8_t *block_buffer = (uint8_t *)kmalloc(fs->block_size);
-    if (!block_buffer) {
-        return -1;
+/* Disk block holding file block index (0 = hole). The single indirect
+ * block is read on first use and kept in *indirect for the caller. */
+static uint32_t ext2_file_block(ext2_filesystem_t *fs, ext2_inode_t *inode,
+                                uint32_t index, uint32_t **indirect) {
+    /* Direct blocks (0-11) */
+    if (index < 12) {
+        return inode->i_block[index];
     }
 
-    for (uint32_t i = start_block; i < end_block && bytes_read < size; i++) {
-        uint32_t block_num = 0;
-
-        /* Direct blocks (0-11) */
-        if (i < 12) {
-            block_num = inode->i_block[i];
+    /* Indirect blocks (12+); double indirect ones are not supported */
+    index -= 12;
+    if (index >= fs->block_size / 4 || !inode->i_block[12]) {
+        return 0;
+    }
+    if (!*indirect) {
+        uint32_t *data = (uint32_t *)kmalloc(fs->block_size);
+        if (!data) {
+            return 0;
+        }
+        if (ext2_read_block(fs, inode->i_block[12], data) != 0) {
+            kfree(data);
+            return 0;
         }
-        /* Indirect blocks (12+) */
-        else if (i < 12 + (fs->block_size / 4)) {
-            uint32_t indirect_block = inode->i_block[12];
-            if (indirect_block) {
-                uint32_t *indirect_data = (uint32_t *)kmalloc(fs->block_size);
-                if (ext2_read_block(fs, indirect_block, indirect_data) == 0) {
-                    block_num = indirect_data[i - 12];
-                }
-                kfree(indirect_data);
+        *indirect = data;
+    }
+    return (*indirect)[index];
+}
+
+/* Read data from an inode (direct and indirect blocks). Whole blocks
+ * that are contiguous on disk go to the caller's buffer in one request
+ * of up to EXT2_MAX_RUN_SECTORS; only partial blocks are staged. */
+int ext2_read_inode_data(ext2_filesystem_t *fs, ext2_inode_t *inode,
+                         uint32_t offset, uint32_t size, void *buffer) {
+    uint32_t block_size = fs->block_size;
+    uint32_t sectors_per_block = block_size / 512;
+    uint32_t max_run = EXT2_MAX_RUN_SECTORS / sectors_per_block;
+    uint8_t *dest = (uint8_t *)buffer;
+    uint8_t *block_buffer = NULL;
+    uint32_t *indirect = NULL;
+    uint32_t bytes_read = 0;
+    bool error = false;
+
+    while (bytes_read < size) {
+        uint32_t pos = offset + bytes_read;
+        uint32_t index = pos / block_size;
+        uint32_t block_offset = pos % block_size;
+        uint32_t left = size - bytes_read;
+        uint32_t block_num = ext2_file_block(fs, inode, index, &indirect);
+
+        if (block_num && block_offset == 0 && left >= block_size) {
+            uint32_t run = 1;
+            while (run < max_run && (run + 1) * block_size <= left &&
+                   ext2_file_block(fs, inode, index + run, &indirect) == block_num + run) {
+                run++;
+            }
+            if (ide_read_sectors(fs->channel, fs->drive, block_num * sectors_per_block,
+                                 (uint8_t)(run * sectors_per_block), dest + bytes_read) != 0) {
+                error = true;
+                break;
             }
+            bytes_read += run * block_size;
+            continue;
+        }
+
+        uint32_t to_copy = block_size - block_offset;
+        if (to_copy > left) {
+            to_copy = left;
         }
-        /* Double indirect blocks would go here, but we'll keep it simple */
 
         if (block_num == 0) {
             /* Sparse block - fill with zeros */
-            uint32_t to_copy = (size - bytes_read > fs->block_size) ?
-                               fs->block_size : (size - bytes_read);
-            memset((uint8_t *)buffer + bytes_read, 0, to_copy);
-            bytes_read += to_copy;
+            memset(dest + bytes_read, 0, to_copy);
         } else {
-            /* Read block */
-            if (ext2_read_block(fs, block_num, block_buffer) == 0) {
-                uint32_t block_offset = (i == start_block) ? (offset % fs->block_size) : 0;
-                uint32_t to_copy = fs->block_size - block_offset;
-                if (to_copy > size - bytes_read) {
-                    to_copy = size - bytes_read;
-                }
-                memcpy((uint8_t *)buffer + bytes_read, block_buffer + block_offset, to_copy);
-                bytes_read += to_copy;
+            if (!block_buffer) {
+                block_buffer = (uint8_t *)kmalloc(block_size);
+            }
+            if (!block_buffer || ext2_read_block(fs, block_num, block_buffer) != 0) {
+                error = true;
+                break;
             }
+            memcpy(dest + bytes_read, block_buffer + block_offset, to_copy);
         }
+        bytes_read += to_copy;
     }
 
     kfree(block_buffer);
+    kfree(indirect);
+    if (error && bytes_read == 0) {
+        return -1;
+    }
     return bytes_read;
 }
 
@@ -288,6 +328,9 @@ int ext2_lookup(ext2_filesystem_t *fs, uint32_t dir_inode_num, const char *name,
         if (entry->rec_len == 0) {
             break;  /* Invalid entry */
         }
+
+        /* Large directories: a preemption point per entry */
+        cond_resched();
     }
 
     kfree(dir_data);
@@ -334,6 +377,7 @@ int ext2_read_dir(ext2_filesystem_t *fs, uint32_t dir_inode_num,
         if (entry->rec_len == 0) {
             break;
         }
+        cond_resched();
     }
 
     kfree(dir_data);
@@ -0,0 +1,663 @@
+/* file.c - Per-process file descriptor tables and open files
+ *
+ * A descriptor indexes the process's files_struct_t and names an open
+ * file; the open file holds the offset, so descriptors copied by dup2 or
+ * fork move through a file together, as in Unix. VFS files, sockets and
+ * the console are all open files, and read/write/close work on each.
+ * File data crosses into process buffers through a kernel bounce buffer
+ * of up to FILE_IO_CHUNK bytes per step: each step is one vfs_read, which
+ * ext2 turns into as few multi-block disk requests as the layout allows,
+ * and one bulk copy_to_user.
+ */
+
+#include "../include/file.h"
+#include "../include/process.h"
+#include "../include/socket.h"
+#include "../include/keyboard.h"
+#include "../include/uaccess.h"
+#include "../include/kmalloc.h"
+#include "../include/idt.h"
+#include "../include/vga.h"
+#include "../include/string.h"
+#include "../include/printf.h"
+
+/* Console reads return at most this much per call */
+#define CONSOLE_READ_MAX 256
+
+static file_t *file_alloc(file_type_t type, uint32_t flags) {
+    file_t *file = (file_t *)kmalloc(sizeof(file_t));
+    if (!file) {
+        return NULL;
+    }
+
+    memset(file, 0, sizeof(file_t));
+    file->count = 1;
+    file->type = type;
+    file->flags = flags;
+    file->sock = -1;
+    return file;
+}
+
+/* Last reference gone: close what the file refers to */
+static void file_release(file_t *file) {
+    if (file->type == FILE_TYPE_VFS) {
+        vfs_close(file->node);
+    } else if (file->type == FILE_TYPE_SOCKET) {
+        socket_close(file->sock);
+    }
+    kfree(file);
+}
+
+void fput(file_t *file) {
+    bool flags = interrupts_save();
+    bool last = --file->count == 0;
+    interrupts_restore(flags);
+
+    if (last) {
+        file_release(file);
+    }
+}
+
+/* Fresh table with the console on descriptors 0-2 */
+files_struct_t *files_alloc(void) {
+    files_struct_t *files = (files_struct_t *)kmalloc(sizeof(files_struct_t));
+    file_t *console = file_alloc(FILE_TYPE_CONSOLE, O_RDWR);
+    if (!files || !console) {
+        kfree(files);
+        kfree(console);
+        return NULL;
+    }
+
+    memset(files, 0, sizeof(files_struct_t));
+    files->users = 1;
+    files->fd[STDIN_FILENO] = console;
+    files->fd[STDOUT_FILENO] = console;
+    files->fd[STDERR_FILENO] = console;
+    console->count = 3;
+    return files;
+}
+
+/* Fork: same open files under the same numbers (a fresh table if the
+ * parent has none, like the idle task) */
+files_struct_t *files_copy(files_struct_t *src) {
+    if (!src) {
+        return files_alloc();
+    }
+
+    files_struct_t *files = (files_struct_t *)kmalloc(sizeof(files_struct_t));
+    if (!files) {
+        return NULL;
+    }
+
+    bool flags = interrupts_save();
+    memcpy(files->fd, src->fd, sizeof(files->fd));
+    for (int i = 0; i < FILES_MAX; i++) {
+        if (files->fd[i]) {
+            files->fd[i]->count++;
+        }
+    }
+    interrupts_restore(flags);
+
+    files->users = 1;
+    return files;
+}
+
+void files_get(files_struct_t *files) {
+    bool flags = interrupts_save();
+    files->users++;
+    interrupts_restore(flags);
+}
+
+/* Drop a table reference; the last one closes every descriptor */
+void files_put(files_struct_t *files) {
+    if (!files) {
+        return;
+    }
+
+    bool flags = interrupts_save();
+    bool last = --files->users == 0;
+    interrupts_restore(flags);
+    if (!last) {
+        return;
+    }
+
+    for (int i = 0; i < FILES_MAX; i++) {
+        if (files->fd[i]) {
+            fput(files->fd[i]);
+        }
+    }
+    kfree(files);
+}
+
+/* Take a reference to the file behind fd in files */
+file_t *files_fget(files_struct_t *files, int fd) {
+    if (!files || fd < 0 || fd >= FILES_MAX) {
+        return NULL;
+    }
+
+    bool flags = interrupts_save();
+    file_t *file = files->fd[fd];
+    if (file) {
+        file->count++;
+    }
+    interrupts_restore(flags);
+    return file;
+}
+
+static files_struct_t *current_files(void) {
+    process_t *proc = process_get_current();
+    return proc ? proc->cold->files : NULL;
+}
+
+file_t *fget(int fd) {
+    return files_fget(current_files(), fd);
+}
+
+/* Put file in the lowest free descriptor (the table takes the caller's
+ * reference); returns the descriptor or -1 */
+static int fd_install(file_t *file) {
+    files_struct_t *files = current_files();
+    if (!files) {
+        return -1;
+    }
+
+    bool flags = interrupts_save();
+    for (int fd = 0; fd < FILES_MAX; fd++) {
+        if (!files->fd[fd]) {
+            files->fd[fd] = file;
+            interrupts_restore(flags);
+            return fd;
+        }
+    }
+    interrupts_restore(flags);
+    return -1;
+}
+
+/* Install a socket id as a new descriptor */
+int fd_install_socket(int sock) {
+    file_t *file = file_alloc(FILE_TYPE_SOCKET, O_RDWR);
+    if (!file) {
+        return -1;
+    }
+    file->sock = sock;
+
+    int fd = fd_install(file);
+    if (fd < 0) {
+        kfree(file);              /* The caller still owns the socket */
+    }
+    return fd;
+}
+
+/* Socket id behind a descriptor (-1 if not a socket) */
+int fd_to_socket(int fd) {
+    file_t *file = fget(fd);
+    if (!file) {
+        return -1;
+    }
+    int sock = file->type == FILE_TYPE_SOCKET ? file->sock : -1;
+    fput(file);
+    return sock;
+}
+
+static bool file_readable(file_t *file) {
+    return (file->flags & O_ACCMODE) != O_WRONLY;
+}
+
+static bool file_writable(file_t *file) {
+    return (file->flags & O_ACCMODE) != O_RDONLY;
+}
+
+/* Clamp a read of an ext2 file to its size (procfs and other in-memory
+ * nodes report size 0 and bound the read themselves) */
+static uint32_t file_read_limit(vfs_node_t *node, uint32_t len, uint32_t offset) {
+    if (!node->fs) {
+        return len;
+    }
+    if (offset >= node->size) {
+        return 0;
+    }
+    return len < node->size - offset ? len : node->size - offset;
+}
+
+/* Kernel-side positional read of a VFS file */
+int file_pread(file_t *file, void *buf, uint32_t len, uint32_t offset) {
+    if (file->type != FILE_TYPE_VFS || !file_readable(file) ||
+        file->node->type == VFS_FILE_TYPE_DIRECTORY) {
+        return -1;
+    }
+    len = file_read_limit(file->node, len, offset);
+    return len ? vfs_read(file->node, offset, len, buf) : 0;
+}
+
+/* Kernel-side positional write of a VFS file */
+int file_pwrite(file_t *file, const void *buf, uint32_t len, uint32_t offset) {
+    if (file->type != FILE_TYPE_VFS || !file_writable(file)) {
+        return -1;
+    }
+    return len ? vfs_write(file->node, offset, len, buf) : 0;
+}
+
+/* VFS file into a process buffer, FILE_IO_CHUNK at a time */
+static int file_vfs_read(file_t *file, uint32_t buf, uint32_t len, uint32_t offset) {
+    if (file->node->type == VFS_FILE_TYPE_DIRECTORY) {
+        return -1;
+    }
+    len = file_read_limit(file->node, len, offset);
+    if (!len) {
+        return 0;
+    }
+
+    uint32_t chunk = len < FILE_IO_CHUNK ? len : FILE_IO_CHUNK;
+    uint8_t *bounce = (uint8_t *)kmalloc(chunk);
+    if (!bounce) {
+        return -1;
+    }
+
+    uint32_t done = 0;
+    int result = 0;
+    while (done < len) {
+        uint32_t want = len - done < chunk ? len - done : chunk;
+        int got = vfs_read(file->node, offset + done, want, bounce);
+        if (got < 0 || (got > 0 && copy_to_user(buf + done, bounce, (uint32_t)got) != 0)) {
+            result = -1;
+            break;
+        }
+        done += (uint32_t)got;
+        if ((uint32_t)got < want) {
+            break;
+        }
+    }
+
+    kfree(bounce);
+    return done ? (int)done : result;
+}
+
+/* Process buffer into a VFS file, FILE_IO_CHUNK at a time */
+static int file_vfs_write(file_t *file, uint32_t buf, uint32_t len, uint32_t offset) {
+    uint32_t chunk = len < FILE_IO_CHUNK ? len : FILE_IO_CHUNK;
+    uint8_t *bounce = (uint8_t *)kmalloc(chunk);
+    if (!bounce) {
+        return -1;
+    }
+
+    uint32_t done = 0;
+    int result = 0;
+    while (done < len) {
+        uint32_t want = len - done < chunk ? len - done : chunk;
+        int put = -1;
+        if (copy_from_user(bounce, buf + done, want) == 0) {
+            put = vfs_write(file->node, offset + done, want, bounce);
+        }
+        if (put < 0) {
+            result = -1;
+            break;
+        }
+        done += (uint32_t)put;
+        if ((uint32_t)put < want) {
+            break;
+        }
+    }
+
+    kfree(bounce);
+    return done ? (int)done : result;
+}
+
+/* Wait for a key, then hand over what has been typed */
+static int console_read(uint32_t buf, uint32_t len) {
+    char data[CONSOLE_READ_MAX];
+    uint32_t n = 0;
+
+    if (len > CONSOLE_READ_MAX) {
+        len = CONSOLE_READ_MAX;
+    }
+    while (!keyboard_haskey()) {
+        keyboard_wait();
+    }
+    while (n < len && keyboard_haskey()) {
+        int c = keyboard_getchar();
+        if (c > 0 && c < KEY_F1) {
+            data[n++] = (char)c;
+        }
+    }
+
+    return copy_to_user(buf, data, n) == 0 ? (int)n : -1;
+}
+
+static int console_write(uint32_t buf, uint32_t len) {
+    char data[256];
+    uint32_t done = 0;
+
+    while (done < len) {
+        uint32_t n = len - done < sizeof(data) ? len - done : sizeof(data);
+        if (copy_from_user(data, buf + done, n) != 0) {
+            return done ? (int)done : -1;
+        }
+        vga_write(data, n);
+        done += n;
+    }
+    return (int)done;
+}
+
+/* Read into a process buffer (offset only matters to VFS files) */
+static int file_read_user(file_t *file, uint32_t buf, uint32_t len, uint32_t offset) {
+    if (!file_readable(file) || !access_ok(buf, len)) {
+        return -1;
+    }
+    if (!len) {
+        return 0;
+    }
+
+    switch (file->type) {
+        case FILE_TYPE_VFS:
+            return file_vfs_read(file, buf, len, offset);
+        case FILE_TYPE_SOCKET:
+            return socket_recv(file->sock, (void *)buf, len, 0);
+        case FILE_TYPE_CONSOLE:
+            return console_read(buf, len);
+    }
+    return -1;
+}
+
+/* Write from a process buffer */
+static int file_write_user(file_t *file, uint32_t buf, uint32_t len, uint32_t offset) {
+    if (!file_writable(file) || !access_ok(buf, len)) {
+        return -1;
+    }
+    if (!len) {
+        return 0;
+    }
+
+    switch (file->type) {
+        case FILE_TYPE_VFS:
+            return file_vfs_write(file, buf, len, offset);
+        case FILE_TYPE_SOCKET:
+            return socket_send(file->sock, (const void *)buf, len, 0);
+        case FILE_TYPE_CONSOLE:
+            return console_write(buf, len);
+    }
+    return -1;
+}
+
+/* read/write at the file's offset, moving it past the data */
+static int file_read_pos(file_t *file, uint32_t buf, uint32_t len) {
+    int n = file_read_user(file, buf, len, file->pos);
+    if (n > 0 && file->type == FILE_TYPE_VFS) {
+        file->pos += (uint32_t)n;
+    }
+    return n;
+}
+
+static int file_write_pos(file_t *file, uint32_t buf, uint32_t len) {
+    if (file->type == FILE_TYPE_VFS && (file->flags & O_APPEND)) {
+        file->pos = file->node->size;
+    }
+    int n = file_write_user(file, buf, len, file->pos);
+    if (n > 0 && file->type == FILE_TYPE_VFS) {
+        file->pos += (uint32_t)n;
+    }
+    return n;
+}
+
+/* Resolve path, relative to the working directory unless absolute */
+static vfs_node_t *file_resolve(const char *path) {
+    if (path[0] == '/') {
+        return vfs_resolve_path(path);
+    }
+
+    char full_path[256];
+    process_t *current = process_get_current();
+    const char *pwd = current ? process_get_pwd(current) : "/";
+    if (strcmp(pwd, "/") == 0) {
+        snprintf(full_path, sizeof(full_path), "/%s", path);
+    } else {
+        snprintf(full_path, sizeof(full_path), "%s/%s", pwd, path);
+    }
+    return vfs_resolve_path(full_path);
+}
+
+/* sys_open - Open a file or directory, returning a descriptor */
+int sys_open(uint32_t path_ptr, uint32_t flags, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
+    (void)unused1; (void)unused2; (void)unused3;
+
+    char path[256];
+    if ((flags & O_ACCMODE) == O_ACCMODE ||
+        strncpy_from_user(path, path_ptr, sizeof(path)) <= 0) {
+        return -1;
+    }
+
+    vfs_node_t *node = file_resolve(path);
+    if (!node) {
+        return -1;
+    }
+    if (node->type == VFS_FILE_TYPE_DIRECTORY && (flags & O_ACCMODE) != O_RDONLY) {
+        return -1;
+    }
+    if (vfs_open(node, flags) != 0) {
+        return -1;
+    }
+
+    file_t *file = file_alloc(FILE_TYPE_VFS, flags);
+    if (!file) {
+        vfs_close(node);
+        return -1;
+    }
+    file->node = node;
+
+    int fd = fd_install(file);
+    if (fd < 0) {
+        fput(file);
+    }
+    return fd;
+}
+
+/* sys_close - Release a descriptor */
+int sys_close(uint32_t fd, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
+    (void)unused1; (void)unused2; (void)unused3; (void)unused4;
+
+    files_struct_t *files = current_files();
+    if (!files || fd >= FILES_MAX) {
+        return -1;
+    }
+
+    bool flags = interrupts_save();
+    file_t *file = files->fd[fd];
+    files->fd[fd] = NULL;
+    interrupts_restore(flags);
+
+    if (!file) {
+        return -1;
+    }
+    fput(file);
+    return 0;
+}
+
+/* sys_read - Read at the file offset */
+int sys_read(uint32_t fd, uint32_t buf, uint32_t count, uint32_t unused1, uint32_t unused2) {
+    (void)unused1; (void)unused2;
+
+    file_t *file = fget((int)fd);
+    if (!file) {
+        return -1;
+    }
+    int n = file_read_pos(file, buf, count);
+    fput(file);
+    return n;
+}
+
+/* sys_write - Write at the file offset (the end with O_APPEND) */
+int sys_write(uint32_t fd, uint32_t buf, uint32_t count, uint32_t unused1, uint32_t unused2) {
+    (void)unused1; (void)unused2;
+
+    file_t *file = fget((int)fd);
+    if (!file) {
+        return -1;
+    }
+    int n = file_write_pos(file, buf, count);
+    fput(file);
+    return n;
+}
+
+/* sys_lseek - Move the offset of a VFS file; returns the new offset */
+int sys_lseek(uint32_t fd, uint32_t offset, uint32_t whence, uint32_t unused1, uint32_t unused2) {
+    (void)unused1; (void)unused2;
+
+    file_t *file = fget((int)fd);
+    if (!file) {
+        return -1;
+    }
+    if (file->type != FILE_TYPE_VFS) {
+        fput(file);
+        return -1;
+    }
+
+    int32_t base;
+    switch (whence) {
+        case SEEK_SET: base = 0; break;
+        case SEEK_CUR: base = (int32_t)file->pos; break;
+        case SEEK_END: base = (int32_t)file->node->size; break;
+        default: base = -1; break;
+    }
+
+    int32_t pos = base + (int32_t)offset;
+    if (base < 0 || pos < 0) {
+        fput(file);
+        return -1;
+    }
+    file->pos = (uint32_t)pos;
+    fput(file);
+    return pos;
+}
+
+/* sys_pread - Read at an explicit offset, leaving the file offset alone */
+int sys_pread(uint32_t fd, uint32_t buf, uint32_t count, uint32_t offset, uint32_t unused) {
+    (void)unused;
+
+    file_t *file = fget((int)fd);
+    if (!file) {
+        return -1;
+    }
+    int n = file->type == FILE_TYPE_VFS ? file_read_user(file, buf, count, offset) : -1;
+    fput(file);
+    return n;
+}
+
+/* sys_pwrite - Write at an explicit offset, leaving the file offset alone */
+int sys_pwrite(uint32_t fd, uint32_t buf, uint32_t count, uint32_t offset, uint32_t unused) {
+    (void)unused;
+
+    file_t *file = fget((int)fd);
+    if (!file) {
+        return -1;
+    }
+    int n = file->type == FILE_TYPE_VFS ? file_write_user(file, buf, count, offset) : -1;
+    fput(file);
+    return n;
+}
+
+/* readv/writev: one transfer per buffer, stopping at the first short one */
+static int file_rw_vec(uint32_t fd, uint32_t iov_ptr, uint32_t iovcnt, bool write) {
+    iovec_t iov[IOV_MAX];
+    if (iovcnt > IOV_MAX || copy_from_user(iov, iov_ptr, iovcnt * sizeof(iovec_t)) != 0) {
+        return -1;
+    }
+
+    file_t *file = fget((int)fd);
+    if (!file) {
+        return -1;
+    }
+
+    int total = 0;
+    for (uint32_t i = 0; i < iovcnt; i++) {
+        int n = write ? file_write_pos(file, iov[i].iov_base, iov[i].iov_len)
+                      : file_read_pos(file, iov[i].iov_base, iov[i].iov_len);
+        if (n < 0) {
+            if (!total) {
+                total = -1;
+            }
+            break;
+        }
+        total += n;
+        if ((uint32_t)n < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    fput(file);
+    return total;
+}
+
+/* sys_readv - Scatter a read over several buffers */
+int sys_readv(uint32_t fd, uint32_t iov, uint32_t iovcnt, uint32_t unused1, uint32_t unused2) {
+    (void)unused1; (void)unused2;
+    return file_rw_vec(fd, iov, iovcnt, false);
+}
+
+/* sys_writev - Gather a write from several buffers */
+int sys_writev(uint32_t fd, uint32_t iov, uint32_t iovcnt, uint32_t unused1, uint32_t unused2) {
+    (void)unused1; (void)unused2;
+    return file_rw_vec(fd, iov, iovcnt, true);
+}
+
+/* sys_dup2 - Make newfd refer to oldfd's file (closing what it had) */
+int sys_dup2(uint32_t oldfd, uint32_t newfd, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
+    (void)unused1; (void)unused2; (void)unused3;
+
+    files_struct_t *files = current_files();
+    if (!files || newfd >= FILES_MAX) {
+        return -1;
+    }
+
+    file_t *file = files_fget(files, (int)oldfd);
+    if (!file) {
+        return -1;
+    }
+    if (oldfd == newfd) {
+        fput(file);
+        return (int)newfd;
+    }
+
+    bool flags = interrupts_save();
+    file_t *old = files->fd[newfd];
+    files->fd[newfd] = file;         /* Takes our reference */
+    interrupts_restore(flags);
+
+    if (old) {
+        fput(old);
+    }
+    return (int)newfd;
+}
+
+/* Print the current process's descriptors */
+void files_print(void) {
+    files_struct_t *files = current_files();
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Open files ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    if (!files) {
+        printk("No descriptor table\n");
+        return;
+    }
+
+    for (int fd = 0; fd < FILES_MAX; fd++) {
+        file_t *file = files->fd[fd];
+        if (!file) {
+            continue;
+        }
+        const char *mode = (file->flags & O_ACCMODE) == O_RDONLY ? "r" :
+                           (file->flags & O_ACCMODE) == O_WRONLY ? "w" : "rw";
+        switch (file->type) {
+            case FILE_TYPE_VFS:
+                printk("  %d: %s (%s), offset %u, %u refs\n", fd, file->node->name,
+                       mode, file->pos, file->count);
+                break;
+            case FILE_TYPE_SOCKET:
+                printk("  %d: socket %d, %u refs\n", fd, file->sock, file->count);
+                break;
+            case FILE_TYPE_CONSOLE:
+                printk("  %d: console, %u refs\n", fd, file->count);
+                break;
+        }
+    }
+}
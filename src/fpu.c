@@ -0,0 +1,271 @@
+/* fpu.c - Lazy x87/SSE state management
+ *
+ * The FPU registers belong to at most one process at a time (fpu_owner).
+ * Every context switch to any other process sets CR0.TS, so the first
+ * FPU/SSE instruction it executes raises #NM. The trap handler saves the
+ * owner's registers, loads the current process's (allocating its save
+ * area from a clean initial image on first use) and clears TS. Processes
+ * that never touch the FPU never pay for a save or restore.
+ *
+ * Each CPU has its own registers and owner. With more than one CPU online
+ * a process may next run elsewhere, so the owner's registers are saved
+ * when it is switched out instead of being left for a later trap.
+ */
+
+#include "../include/fpu.h"
+#include "../include/process.h"
+#include "../include/cpu.h"
+#include "../include/idt.h"
+#include "../include/kmalloc.h"
+#include "../include/string.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+#include "../include/smp.h"
+
+/* Default MXCSR: all SIMD exceptions masked, round to nearest */
+#define MXCSR_DEFAULT 0x1F80
+
+static bool fpu_present = false;
+static bool fpu_fxsr = false;
+static bool fpu_sse = false;
+static bool fpu_sse2 = false;
+
+/* Process whose state is live in this CPU's FPU registers */
+#define fpu_owner (this_cpu()->fpu_live)
+
+/* State after FNINIT, copied into each new save area */
+static fpu_state_t fpu_initial_state;
+
+/* Statistics */
+static uint32_t fpu_traps = 0;
+static uint32_t fpu_saves = 0;
+static uint32_t fpu_restores = 0;
+static uint32_t fpu_allocs = 0;
+
+static inline void fpu_clts(void) {
+    __asm__ volatile("clts" ::: "memory");
+}
+
+static inline void fpu_stts(void) {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+/* Store the live registers (FNSAVE also reinitialises the FPU) */
+static inline void fpu_save(fpu_state_t *state) {
+    if (fpu_fxsr) {
+        __asm__ volatile("fxsave (%0)" : : "r"(state->area) : "memory");
+    } else {
+        __asm__ volatile("fnsave (%0)" : : "r"(state->area) : "memory");
+    }
+}
+
+static inline void fpu_restore(fpu_state_t *state) {
+    if (fpu_fxsr) {
+        __asm__ volatile("fxrstor (%0)" : : "r"(state->area) : "memory");
+    } else {
+        __asm__ volatile("frstor (%0)" : : "r"(state->area) : "memory");
+    }
+}
+
+/* Allocate a 16-byte aligned save area holding the initial state */
+static fpu_state_t *fpu_alloc_state(void) {
+    void *block = kmalloc(sizeof(fpu_state_t) + 15);
+    if (!block) {
+        return NULL;
+    }
+
+    fpu_state_t *state = (fpu_state_t *)(((uint32_t)block + 15) & ~15U);
+    memcpy(state->area, fpu_initial_state.area, FPU_STATE_SIZE);
+    state->alloc = block;
+    fpu_allocs++;
+    return state;
+}
+
+/* #NM: hand the FPU registers to the current process */
+static void fpu_nm_handler(struct interrupt_frame *frame) {
+    process_t *proc = process_get_current();
+
+    fpu_clts();
+    fpu_traps++;
+
+    /* Early boot: nobody owns the registers yet */
+    if (!proc || fpu_owner == proc) {
+        return;
+    }
+
+    if (!proc->fpu) {
+        proc->fpu = fpu_alloc_state();
+        if (!proc->fpu) {
+            printk("[FPU] No memory for PID %d state\n", proc->pid);
+            fpu_stts();
+            process_handle_exception(frame->int_no);
+            return;
+        }
+    }
+
+    if (fpu_owner && fpu_owner->fpu) {
+        fpu_save(fpu_owner->fpu);
+        fpu_saves++;
+    }
+
+    fpu_restore(proc->fpu);
+    fpu_restores++;
+    fpu_owner = proc;
+}
+
+/* Set up this CPU's control registers for the FPU and SSE */
+static void fpu_setup_cpu(void) {
+    /* Real FPU, errors through #MF, WAIT/FWAIT trap while TS is set */
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+
+    if (fpu_fxsr) {
+        uint32_t cr4 = read_cr4() | CR4_OSFXSR;
+        if (fpu_sse) {
+            cr4 |= CR4_OSXMMEXCPT;
+        }
+        write_cr4(cr4);
+    }
+}
+
+/* Enable the FPU and SSE, capture the initial state and hook #NM */
+void fpu_init(void) {
+    fpu_present = cpu_has_feature(CPUID_FEAT_EDX_FPU);
+    if (!fpu_present) {
+        printk("[FPU] No FPU present\n");
+        return;
+    }
+    fpu_fxsr = cpu_has_feature(CPUID_FEAT_EDX_FXSR);
+    fpu_sse = fpu_fxsr && cpu_has_feature(CPUID_FEAT_EDX_SSE);
+    fpu_sse2 = fpu_sse && cpu_has_feature(CPUID_FEAT_EDX_SSE2);
+
+    fpu_setup_cpu();
+
+    /* Capture a clean register image for new save areas */
+    fpu_clts();
+    __asm__ volatile("fninit");
+    if (fpu_sse) {
+        uint32_t mxcsr = MXCSR_DEFAULT;
+        __asm__ volatile("ldmxcsr %0" : : "m"(mxcsr));
+    }
+    fpu_save(&fpu_initial_state);
+
+    idt_register_handler(EXC_DEVICE_NOT_AVAILABLE, fpu_nm_handler);
+
+    /* Nobody owns the registers: the first user traps */
+    fpu_stts();
+
+    printk("[FPU] x87%s%s enabled, lazy switching via CR0.TS\n",
+           fpu_sse ? " + SSE" : "", fpu_sse2 ? "/SSE2" : "");
+}
+
+/* Enable the FPU on an application processor (same features as the boot CPU) */
+void fpu_init_ap(void) {
+    if (!fpu_present) {
+        return;
+    }
+
+    fpu_setup_cpu();
+    fpu_clts();
+    __asm__ volatile("fninit");
+    fpu_stts();
+}
+
+/* Set or clear CR0.TS for the task about to run (called on context switch) */
+void fpu_switch(process_t *prev, process_t *next) {
+    if (!fpu_present) {
+        return;
+    }
+
+    /* prev may run on another CPU next: put its registers in memory */
+    if (prev && prev == fpu_owner && smp_online_cpus() > 1) {
+        if (prev->fpu) {
+            fpu_clts();
+            fpu_save(prev->fpu);
+            fpu_saves++;
+        }
+        fpu_owner = NULL;
+    }
+
+    /* The owner's registers are still live: let it run without a trap */
+    if (next == fpu_owner) {
+        fpu_clts();
+    } else {
+        fpu_stts();
+    }
+}
+
+/* Give a forked child a copy of the parent's FPU state */
+int fpu_fork(process_t *child, process_t *parent) {
+    child->fpu = NULL;
+    if (!parent->fpu) {
+        return 0;
+    }
+
+    fpu_state_t *state = fpu_alloc_state();
+    if (!state) {
+        return -1;
+    }
+
+    bool flags = interrupts_save();
+    if (fpu_owner == parent) {
+        /* Flush the live registers first (FNSAVE clobbers them: reload) */
+        uint32_t cr0 = read_cr0();
+        fpu_clts();
+        fpu_save(parent->fpu);
+        if (!fpu_fxsr) {
+            fpu_restore(parent->fpu);
+        }
+        write_cr0(cr0);
+        fpu_saves++;
+    }
+    memcpy(state->area, parent->fpu->area, FPU_STATE_SIZE);
+    interrupts_restore(flags);
+
+    child->fpu = state;
+    return 0;
+}
+
+/* Drop a process's FPU state (on exit) */
+void fpu_release(process_t *proc) {
+    bool flags = interrupts_save();
+
+    for (uint32_t i = 0; i < smp_online_cpus(); i++) {
+        if (smp_cpu(i)->fpu_live == proc) {
+            smp_cpu(i)->fpu_live = NULL;
+        }
+    }
+    if (proc->fpu) {
+        kfree(proc->fpu->alloc);
+        proc->fpu = NULL;
+    }
+
+    interrupts_restore(flags);
+}
+
+/* Check whether SSE instructions may be used */
+bool fpu_has_sse(void) {
+    return fpu_sse;
+}
+
+/* Print FPU features and lazy switching statistics */
+void fpu_print_info(void) {
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== FPU ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    if (!fpu_present) {
+        printk("No FPU present\n");
+        return;
+    }
+
+    printk("Features: x87%s%s%s\n", fpu_fxsr ? " FXSR" : "",
+           fpu_sse ? " SSE" : "", fpu_sse2 ? " SSE2" : "");
+    printk("CR0=0x%x CR4=0x%x\n", read_cr0(), read_cr4());
+    if (fpu_owner) {
+        printk("Owner: PID %d (%s)\n", fpu_owner->pid, fpu_owner->name);
+    } else {
+        printk("Owner: none\n");
+    }
+    printk("#NM traps %u, saves %u, restores %u, save areas allocated %u\n",
+           fpu_traps, fpu_saves, fpu_restores, fpu_allocs);
+}
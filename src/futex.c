@@ -0,0 +1,270 @@
+/* futex.c - Fast user-space locking: sleep/wake on a shared word
+ *
+ * A futex is just a 32-bit word in memory. User code changes it with
+ * atomic instructions and only enters the kernel to sleep while the word
+ * still holds an expected value, or to wake sleepers after changing it.
+ * Waiters are identified by the physical address of the word, so two
+ * processes mapping the same page at different addresses (or a parent and
+ * child sharing a MAP_SHARED page) meet on the same key. Each waiter's
+ * queue entry lives on its own kernel stack and is chained into one of
+ * FUTEX_HASH_SIZE buckets. Bucket state only changes with interrupts
+ * disabled, that is under the global interrupt lock (idt.c), which every
+ * CPU takes along with cli: the value check and the enqueue are one
+ * section, so a wake on another CPU sees either the old value or the
+ * queued waiter. User code changing the word needs no lock; a waker
+ * changes it before entering the kernel.
+ */
+
+#include "../include/futex.h"
+#include "../include/process.h"
+#include "../include/paging.h"
+#include "../include/hrtimer.h"
+#include "../include/clocksource.h"
+#include "../include/timer.h"
+#include "../include/list.h"
+#include "../include/idt.h"
+#include "../include/uaccess.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+
+/* One sleeping task, on its kernel stack */
+typedef struct futex_q {
+    list_head_t list;
+    uint32_t key;                  /* Physical address of the futex word */
+    process_t *task;
+    bool woken;                    /* Set by the waker before it unlinks us */
+} futex_q_t;
+
+typedef struct {
+    list_head_t waiters;
+    uint32_t nr_waiters;
+} futex_bucket_t;
+
+static futex_bucket_t futex_buckets[FUTEX_HASH_SIZE];
+
+/* Statistics */
+static uint32_t futex_waits = 0;
+static uint32_t futex_wait_mismatch = 0;
+static uint32_t futex_timeouts = 0;
+static uint32_t futex_wakes = 0;
+static uint32_t futex_woken = 0;
+static uint32_t futex_requeued = 0;
+
+/* Set up the hash buckets */
+void futex_init(void) {
+    for (int i = 0; i < FUTEX_HASH_SIZE; i++) {
+        list_init(&futex_buckets[i].waiters);
+        futex_buckets[i].nr_waiters = 0;
+    }
+}
+
+/* Translate a futex address into its key (physical address); -1 if the
+ * address is misaligned, outside the process range or not mapped in the
+ * caller's address space */
+static int futex_get_key(uint32_t uaddr, uint32_t *key) {
+    if (!access_ok(uaddr, sizeof(uint32_t)) || (uaddr & 3)) {
+        return -1;
+    }
+
+    uint32_t phys = paging_get_physical_address(uaddr);
+    if (!phys) {
+        return -1;
+    }
+    *key = phys;
+    return 0;
+}
+
+static futex_bucket_t *futex_hash(uint32_t key) {
+    return &futex_buckets[((key >> 2) * 0x9E3779B1U) >> (32 - FUTEX_HASH_BITS)];
+}
+
+static void futex_unqueue(futex_q_t *q) {
+    list_del(&q->list);
+    futex_hash(q->key)->nr_waiters--;
+}
+
+/* Sleep until woken, as long as *uaddr still holds val. Returns 0 when
+ * woken, -1 on a value mismatch or when the timeout (ns, 0 = none) ran out. */
+static int futex_wait(uint32_t uaddr, uint32_t val, uint64_t timeout_ns) {
+    process_t *proc = process_get_current();
+    uint32_t key;
+
+    if (!proc || futex_get_key(uaddr, &key) != 0) {
+        return -1;
+    }
+
+    uint64_t deadline = timeout_ns ? ktime_get_ns() + timeout_ns : 0;
+    futex_bucket_t *bucket = futex_hash(key);
+    bool flags = interrupts_save();
+
+    /* The word may have changed since user space looked at it */
+    if (*(volatile uint32_t *)uaddr != val) {
+        futex_wait_mismatch++;
+        interrupts_restore(flags);
+        return -1;
+    }
+
+    futex_q_t q;
+    q.key = key;
+    q.task = proc;
+    q.woken = false;
+    list_add_tail(&q.list, &bucket->waiters);
+    bucket->nr_waiters++;
+    futex_waits++;
+
+    while (!q.woken) {
+        if (deadline && ktime_get_ns() >= deadline) {
+            break;
+        }
+        proc->state = PROCESS_STATE_BLOCKED;
+        if (deadline) {
+            hrtimer_start(&proc->sleep_hrtimer, deadline);
+        }
+        process_schedule();
+    }
+
+    if (deadline) {
+        hrtimer_cancel(&proc->sleep_hrtimer);
+    }
+
+    /* Timed out: still queued (possibly requeued to another bucket) */
+    if (!q.woken) {
+        futex_unqueue(&q);
+        futex_timeouts++;
+    }
+
+    interrupts_restore(flags);
+    return q.woken ? 0 : -1;
+}
+
+/* Wake up to nr waiters on key (interrupts disabled); returns the count */
+static int futex_wake_key(uint32_t key, uint32_t nr) {
+    futex_bucket_t *bucket = futex_hash(key);
+    list_head_t *pos, *tmp;
+    int woken = 0;
+
+    list_for_each_safe(pos, tmp, &bucket->waiters) {
+        if ((uint32_t)woken >= nr) {
+            break;
+        }
+        futex_q_t *q = list_entry(pos, futex_q_t, list);
+        if (q->key != key) {
+            continue;
+        }
+        futex_unqueue(q);
+        q->woken = true;
+        process_wakeup(q->task);
+        woken++;
+    }
+
+    futex_woken += woken;
+    return woken;
+}
+
+/* Wake up to nr waiters on uaddr */
+static int futex_wake(uint32_t uaddr, uint32_t nr) {
+    uint32_t key;
+    if (futex_get_key(uaddr, &key) != 0) {
+        return -1;
+    }
+
+    bool flags = interrupts_save();
+    futex_wakes++;
+    int woken = futex_wake_key(key, nr);
+    interrupts_restore(flags);
+    return woken;
+}
+
+/* Wake nr_wake waiters on uaddr and move up to nr_requeue of the rest to
+ * uaddr2 without waking them (avoids a thundering herd on broadcasts) */
+static int futex_requeue(uint32_t uaddr, uint32_t nr_wake, uint32_t nr_requeue, uint32_t uaddr2) {
+    uint32_t key, key2;
+    if (futex_get_key(uaddr, &key) != 0 || futex_get_key(uaddr2, &key2) != 0) {
+        return -1;
+    }
+
+    bool flags = interrupts_save();
+    futex_wakes++;
+    int done = futex_wake_key(key, nr_wake);
+
+    futex_bucket_t *bucket = futex_hash(key);
+    futex_bucket_t *bucket2 = futex_hash(key2);
+    list_head_t *pos, *tmp;
+    uint32_t moved = 0;
+
+    list_for_each_safe(pos, tmp, &bucket->waiters) {
+        if (moved >= nr_requeue) {
+            break;
+        }
+        futex_q_t *q = list_entry(pos, futex_q_t, list);
+        if (q->key != key) {
+            continue;
+        }
+        futex_unqueue(q);
+        q->key = key2;
+        list_add_tail(&q->list, &bucket2->waiters);
+        bucket2->nr_waiters++;
+        moved++;
+    }
+
+    futex_requeued += moved;
+    interrupts_restore(flags);
+    return done + (int)moved;
+}
+
+/* sys_futex(uaddr, op, val, timeout / nr_requeue, uaddr2) */
+int sys_futex(uint32_t uaddr, uint32_t op, uint32_t val, uint32_t arg4, uint32_t uaddr2) {
+    switch (op) {
+        case FUTEX_WAIT: {
+            uint64_t timeout_ns = 0;
+            if (arg4) {
+                timespec_t timeout;
+                if (copy_from_user(&timeout, arg4, sizeof(timeout)) != 0 ||
+                    timeout.tv_sec < 0 || timeout.tv_nsec < 0 ||
+                    timeout.tv_nsec >= (int32_t)NSEC_PER_SEC) {
+                    return -1;
+                }
+                timeout_ns = (uint64_t)timeout.tv_sec * NSEC_PER_SEC + (uint32_t)timeout.tv_nsec;
+                if (!timeout_ns) {
+                    timeout_ns = 1;  /* Zero timeout: check and return */
+                }
+            }
+            return futex_wait(uaddr, val, timeout_ns);
+        }
+        case FUTEX_WAKE:
+            return futex_wake(uaddr, val);
+        case FUTEX_REQUEUE:
+            return futex_requeue(uaddr, val, arg4, uaddr2);
+        default:
+            return -1;
+    }
+}
+
+/* Print operation counts and bucket occupancy */
+void futex_print_stats(void) {
+    uint32_t used = 0;
+    uint32_t waiting = 0;
+    uint32_t longest = 0;
+
+    bool flags = interrupts_save();
+    for (int i = 0; i < FUTEX_HASH_SIZE; i++) {
+        uint32_t n = futex_buckets[i].nr_waiters;
+        if (n) {
+            used++;
+            waiting += n;
+        }
+        if (n > longest) {
+            longest = n;
+        }
+    }
+    interrupts_restore(flags);
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Futexes ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    printk("Waits %u (value changed %u, timed out %u), wake calls %u, woken %u, requeued %u\n",
+           futex_waits, futex_wait_mismatch, futex_timeouts, futex_wakes, futex_woken,
+           futex_requeued);
+    printk("Buckets: %u/%u in use, %u waiters, longest chain %u\n",
+           used, FUTEX_HASH_SIZE, waiting, longest);
+}
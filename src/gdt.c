@@ -68,10 +68,27 @@ void gdt_init(void) {
                  GDT_ACCESS_PRESENT | GDT_ACCESS_RING3 | GDT_ACCESS_DATA | GDT_ACCESS_RW,
                  GDT_GRAN_4K | GDT_GRAN_32BIT | GDT_GRAN_LIMIT_HIGH);
 
+    /* Per-CPU data segments stay empty until each CPU is set up */
+    for (int i = 0; i < GDT_PERCPU_COUNT; i++) {
+        gdt_set_gate(GDT_PERCPU_FIRST + i, 0, 0, 0, 0);
+    }
+
     /* Load the GDT */
     gdt_flush((uint32_t)&gdt_pointer);
 }
 
+/* Point CPU cpu's data segment at its per-CPU area (byte granular, so
+ * an access past the end faults) */
+void gdt_set_percpu(uint32_t cpu, uint32_t base, uint32_t size) {
+    if (cpu >= GDT_PERCPU_COUNT || size == 0) {
+        return;
+    }
+
+    gdt_set_gate(GDT_PERCPU_FIRST + cpu, base, size - 1,
+                 GDT_ACCESS_PRESENT | GDT_ACCESS_RING0 | GDT_ACCESS_DATA | GDT_ACCESS_RW,
+                 GDT_GRAN_32BIT);
+}
+
 /* Print GDT information for debugging */
 void gdt_print_info(void) {
     printk("\n=== Global Descriptor Table ===\n");
@@ -96,7 +113,14 @@ void gdt_print_info(void) {
         uint32_t limit = gdt_entries[i].limit_low |
                          ((gdt_entries[i].granularity & 0x0F) << 16);
 
-        printk("Entry %d: %s\n", i, segment_names[i]);
+        if (i >= GDT_PERCPU_FIRST) {
+            if (!(gdt_entries[i].access & GDT_ACCESS_PRESENT)) {
+                continue;
+            }
+            printk("Entry %d: Per-CPU Data (CPU %d)\n", i, i - GDT_PERCPU_FIRST);
+        } else {
+            printk("Entry %d: %s\n", i, segment_names[i]);
+        }
         printk("  Base:  0x%x\n", base);
         printk("  Limit: 0x%x\n", limit);
         printk("  Access: 0x%x\n", gdt_entries[i].access);
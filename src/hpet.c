@@ -0,0 +1,86 @@
+/* hpet.c - High Precision Event Timer clocksource */
+
+#include "../include/hpet.h"
+#include "../include/acpi.h"
+#include "../include/clocksource.h"
+#include "../include/math64.h"
+#include "../include/paging.h"
+#include "../include/printf.h"
+
+/* Femtoseconds per millisecond (period is expressed in fs) */
+#define FSEC_PER_MSEC 1000000000000ULL
+
+static volatile uint8_t *hpet_base = NULL;
+
+static inline uint32_t hpet_readl(uint32_t reg) {
+    return *(volatile uint32_t *)(hpet_base + reg);
+}
+
+static inline void hpet_writel(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t *)(hpet_base + reg) = value;
+}
+
+/* 64-bit counter read: retry if the high half changed mid-read */
+static uint64_t hpet_read64(void) {
+    uint32_t hi, lo;
+    do {
+        hi = hpet_readl(HPET_REG_COUNTER_HI);
+        lo = hpet_readl(HPET_REG_COUNTER);
+    } while (hi != hpet_readl(HPET_REG_COUNTER_HI));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static uint64_t hpet_read32(void) {
+    return hpet_readl(HPET_REG_COUNTER);
+}
+
+static clocksource_t clocksource_hpet = {
+    .name = "hpet",
+    .rating = CLOCKSOURCE_RATING_HPET,
+};
+
+/* Locate the HPET via ACPI, start it and register it as a clocksource */
+int hpet_init(void) {
+    const acpi_hpet_t *table = (const acpi_hpet_t *)acpi_find_table("HPET");
+    if (!table) {
+        printk("[HPET] Not present\n");
+        return -1;
+    }
+
+    if (table->base_address.address_space != 0 ||
+        (table->base_address.address >> 32) != 0) {
+        printk("[HPET] Unsupported register block address\n");
+        return -1;
+    }
+
+    hpet_base = (volatile uint8_t *)paging_map_mmio((uint32_t)table->base_address.address,
+                                                     PAGE_SIZE);
+    if (!hpet_base) {
+        return -1;
+    }
+
+    uint32_t caps = hpet_readl(HPET_REG_CAPABILITIES);
+    uint32_t period_fs = hpet_readl(HPET_REG_PERIOD);
+    if (period_fs == 0 || period_fs > HPET_MAX_PERIOD_FS) {
+        printk("[HPET] Invalid counter period %u fs\n", period_fs);
+        return -1;
+    }
+
+    /* Start the main counter */
+    hpet_writel(HPET_REG_CONFIG, hpet_readl(HPET_REG_CONFIG) | HPET_CFG_ENABLE);
+
+    if (caps & HPET_CAP_COUNTER_64) {
+        clocksource_hpet.read = hpet_read64;
+        clocksource_hpet.mask = 0xFFFFFFFFFFFFFFFFULL;
+    } else {
+        clocksource_hpet.read = hpet_read32;
+        clocksource_hpet.mask = 0xFFFFFFFFULL;
+    }
+    clocksource_hpet.freq_khz = (uint32_t)div_u64(FSEC_PER_MSEC, period_fs);
+
+    printk("[HPET] At 0x%x, %u kHz, %d-bit counter\n",
+           (uint32_t)table->base_address.address, clocksource_hpet.freq_khz,
+           (caps & HPET_CAP_COUNTER_64) ? 64 : 32);
+
+    return clocksource_register(&clocksource_hpet);
+}
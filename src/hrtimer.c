@@ -0,0 +1,104 @@
+/* hrtimer.c - High-resolution timers
+ *
+ * Timers are ordered by absolute expiry in a red-black tree whose
+ * leftmost node is cached, so the next deadline is found in O(1) and
+ * insertion/removal are O(log n). Expiry is checked on every timer
+ * tick against ktime_get_ns(): nothing programs a one-shot interrupt for
+ * the next deadline, so a timer fires on the first tick after it expires
+ * (up to one tick late). Only the waits timer_nanosleep spins on, those
+ * under HRTIMER_SPIN_THRESHOLD_NS, end with clocksource precision.
+ */
+
+#include "../include/hrtimer.h"
+#include "../include/clocksource.h"
+#include "../include/idt.h"
+
+static rb_root_t hrtimer_root = RB_ROOT_INIT;
+
+/* Prepare a timer before first use */
+void hrtimer_init(hrtimer_t *timer, hrtimer_restart_t (*function)(hrtimer_t *)) {
+    timer->expires = 0;
+    timer->function = function;
+    timer->queued = false;
+}
+
+/* Insert into the tree; equal deadlines keep insertion order */
+static void hrtimer_enqueue(hrtimer_t *timer) {
+    rb_node_t **link = &hrtimer_root.node;
+    rb_node_t *parent = NULL;
+    bool leftmost = true;
+
+    while (*link) {
+        hrtimer_t *entry = rb_entry(*link, hrtimer_t, node);
+        parent = *link;
+        if (timer->expires < entry->expires) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+
+    rb_link_node(&timer->node, parent, link);
+    rb_insert_color(&timer->node, &hrtimer_root, leftmost);
+    timer->queued = true;
+}
+
+static void hrtimer_dequeue(hrtimer_t *timer) {
+    rb_erase(&timer->node, &hrtimer_root);
+    timer->queued = false;
+}
+
+/* Arm a timer at an absolute ktime (re-arms if already queued) */
+void hrtimer_start(hrtimer_t *timer, uint64_t expires_ns) {
+    bool flags = interrupts_save();
+
+    if (timer->queued) {
+        hrtimer_dequeue(timer);
+    }
+    timer->expires = expires_ns;
+    hrtimer_enqueue(timer);
+
+    interrupts_restore(flags);
+}
+
+/* Disarm a timer (returns 1 if it was queued) */
+int hrtimer_cancel(hrtimer_t *timer) {
+    int ret = 0;
+    bool flags = interrupts_save();
+
+    if (timer->queued) {
+        hrtimer_dequeue(timer);
+        ret = 1;
+    }
+
+    interrupts_restore(flags);
+    return ret;
+}
+
+/* Expire due timers (called from the timer interrupt) */
+void hrtimer_run_queues(void) {
+    rb_node_t *first = rb_first(&hrtimer_root);
+    if (!first) {
+        return;
+    }
+
+    uint64_t now = ktime_get_ns();
+    while ((first = rb_first(&hrtimer_root)) != NULL) {
+        hrtimer_t *timer = rb_entry(first, hrtimer_t, node);
+        if (timer->expires > now) {
+            break;
+        }
+
+        hrtimer_dequeue(timer);
+        if (timer->function(timer) == HRTIMER_RESTART && !timer->queued) {
+            hrtimer_enqueue(timer);
+        }
+    }
+}
+
+/* Earliest pending deadline (0 if none) */
+uint64_t hrtimer_next_expiry(void) {
+    rb_node_t *first = rb_first(&hrtimer_root);
+    return first ? rb_entry(first, hrtimer_t, node)->expires : 0;
+}
@@ -5,10 +5,86 @@
 #include "../include/printf.h"
 #include "../include/string.h"
 #include "../include/panic.h"
+#include "../include/idt.h"
+#include "../include/irq.h"
+#include "../include/process.h"
+#include "../include/softirq.h"
+#include "../include/wait.h"
+#include "../include/ktimer.h"
+
+/* Give up on a completion interrupt after this long and poll instead */
+#define IDE_IRQ_TIMEOUT_MS 100
 
 /* Global IDE controller */
 static ide_controller_t ide_controller;
 
+/* Per-channel completion state (IRQ14 primary, IRQ15 secondary) */
+typedef struct {
+    volatile bool completed;     /* Set by the BLOCK softirq */
+    volatile uint8_t status;     /* Status read by the top half */
+    wait_queue_head_t wq;        /* Tasks waiting for completion */
+    uint32_t irqs;               /* Completion interrupts taken */
+    uint32_t irq_waits;          /* Waits satisfied by an interrupt */
+    uint32_t poll_waits;         /* Waits that fell back to polling */
+} ide_channel_state_t;
+
+static ide_channel_state_t ide_channels[2];
+static volatile uint32_t ide_irq_pending = 0;
+static bool ide_irq_enabled = false;
+
+/* IRQ14/15 top half: reading status acknowledges the drive */
+static void ide_irq_handler(struct interrupt_frame *frame) {
+    int channel = (frame->int_no == IRQ14) ? IDE_CHANNEL_PRIMARY : IDE_CHANNEL_SECONDARY;
+    uint16_t io_base = (channel == IDE_CHANNEL_PRIMARY) ?
+                       IDE_PRIMARY_IO_BASE : IDE_SECONDARY_IO_BASE;
+
+    ide_channels[channel].status = inb(io_base + IDE_REG_STATUS);
+    ide_channels[channel].irqs++;
+    ide_irq_pending |= 1U << channel;
+
+    irq_eoi(frame->int_no - IRQ0);
+    raise_softirq(BLOCK_SOFTIRQ);
+}
+
+/* Block softirq: complete channels that interrupted and wake their waiters */
+static void ide_block_softirq(void) {
+    bool flags = interrupts_save();
+    uint32_t pending = ide_irq_pending;
+    ide_irq_pending = 0;
+    interrupts_restore(flags);
+
+    for (int channel = 0; channel < 2; channel++) {
+        if (pending & (1U << channel)) {
+            ide_channels[channel].completed = true;
+            wake_up_all(&ide_channels[channel].wq);
+        }
+    }
+}
+
+/* Forget completions before starting a transfer step */
+static void ide_arm_completion(int channel) {
+    ide_channels[channel].completed = false;
+}
+
+/* Sleep until the channel interrupts (the polled waits that follow then
+ * succeed at once). Without a process to block, or on timeout, this
+ * returns immediately and the caller's polling does the waiting. */
+static void ide_wait_completion(int channel) {
+    ide_channel_state_t *state = &ide_channels[channel];
+
+    if (!ide_irq_enabled || !process_get_current() ||
+        !interrupts_enabled() || in_softirq()) {
+        return;
+    }
+
+    if (wait_event_timeout(state->wq, state->completed,
+                           msecs_to_ticks(IDE_IRQ_TIMEOUT_MS))) {
+        state->irq_waits++;
+    } else {
+        state->poll_waits++;
+    }
+}
+
 /* Wait for IDE device to be ready (not busy) */
 int ide_wait_ready(uint16_t io_base) {
     uint8_t status;
@@ -165,11 +241,15 @@ int ide_read_sectors(ide_channel_t channel, ide_drive_t drive,
     outb(io_base + IDE_REG_LBAHI, (lba >> 16) & 0xFF);
 
     /* Send READ SECTORS command */
+    ide_arm_completion(channel);
     outb(io_base + IDE_REG_COMMAND, IDE_CMD_READ_SECTORS);
 
-    /* Read sectors */
+    /* Read sectors (the drive interrupts as each one becomes ready) */
     uint16_t *buf = (uint16_t *)buffer;
     for (int sector = 0; sector < count; sector++) {
+        ide_wait_completion(channel);
+        ide_arm_completion(channel);
+
         /* Wait for DRQ */
         if (ide_wait_drq(io_base) != 0) {
             return -1;
@@ -229,18 +309,22 @@ int ide_write_sectors(ide_channel_t channel, ide_drive_t drive,
         }
 
         /* Write 256 words (512 bytes) */
+        ide_arm_completion(channel);
         for (int i = 0; i < 256; i++) {
             outw(io_base + IDE_REG_DATA, buf[sector * 256 + i]);
         }
 
         /* Wait for write to complete */
+        ide_wait_completion(channel);
         if (ide_wait_ready(io_base) != 0) {
             return -1;
         }
     }
 
     /* Flush cache */
+    ide_arm_completion(channel);
     outb(io_base + IDE_REG_COMMAND, IDE_CMD_FLUSH);
+    ide_wait_completion(channel);
     ide_wait_ready(io_base);
 
     return 0;
@@ -276,6 +360,39 @@ void ide_print_devices(void) {
     }
 }
 
+/* Route IRQ14/15 completions through the block softirq */
+void ide_enable_interrupts(void) {
+    for (int channel = 0; channel < 2; channel++) {
+        init_waitqueue_head(&ide_channels[channel].wq);
+        ide_channels[channel].completed = false;
+    }
+
+    open_softirq(BLOCK_SOFTIRQ, ide_block_softirq);
+    idt_register_handler(IRQ14, ide_irq_handler);
+    idt_register_handler(IRQ15, ide_irq_handler);
+
+    /* Clear nIEN so the drives raise INTRQ */
+    outb(IDE_PRIMARY_CTRL_BASE + IDE_REG_CONTROL, 0);
+    outb(IDE_SECONDARY_CTRL_BASE + IDE_REG_CONTROL, 0);
+
+    irq_unmask(2);   /* Cascade to the slave PIC */
+    irq_unmask(14);
+    irq_unmask(15);
+    ide_irq_enabled = true;
+}
+
+/* Print completion statistics */
+void ide_print_irq_stats(void) {
+    const char *channel_names[] = {"Primary", "Secondary"};
+
+    for (int channel = 0; channel < 2; channel++) {
+        ide_channel_state_t *state = &ide_channels[channel];
+        printk("  %s: %u IRQs, %u waits by IRQ, %u timed out to polling\n",
+               channel_names[channel], state->irqs, state->irq_waits,
+               state->poll_waits);
+    }
+}
+
 /* Initialize IDE controller */
 void ide_init(void) {
     printk("[IDE] Initializing IDE controller...\n");
@@ -293,5 +410,8 @@ void ide_init(void) {
     /* Print detected devices */
     ide_print_devices();
 
+    /* Let commands complete by interrupt instead of polling */
+    ide_enable_interrupts();
+
     printk("[IDE] IDE controller initialized\n");
 }
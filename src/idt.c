@@ -2,10 +2,18 @@
 
 #include "../include/idt.h"
 #include "../include/pic.h"
+#include "../include/irq.h"
 #include "../include/printf.h"
 #include "../include/vga.h"
 #include "../include/string.h"
 #include "../include/panic.h"
+#include "../include/process.h"
+#include "../include/softirq.h"
+#include "../include/smp.h"
+#include "../include/cpu.h"
+#include "../include/lockstat.h"
+#include "../include/preempt.h"
+#include "../include/irqsoff.h"
 
 /* IDT entries array */
 static struct idt_entry idt_entries[IDT_ENTRIES];
@@ -14,6 +22,17 @@ static struct idt_ptr idt_pointer;
 /* C-level interrupt handlers */
 static interrupt_handler_t interrupt_handlers[IDT_ENTRIES];
 
+/* The interrupt lock: held by the CPU that has interrupts disabled in
+ * kernel code, so "interrupts off" keeps excluding the other CPUs too.
+ * It belongs to the CPU, not the process: it stays held across context
+ * switches and is released where interrupts are turned back on. */
+#define IRQ_LOCK_FREE 0xFFFFFFFF
+static volatile uint32_t irq_lock_owner = IRQ_LOCK_FREE;
+
+/* lockstat class of the interrupt lock and the start of the current hold */
+static lock_class_t irq_lock_class = LOCK_CLASS_INIT("irq_lock");
+static uint64_t irq_lock_held_since = 0;
+
 /* Exception messages */
 static const char *exception_messages[] = {
     "Division By Zero",
@@ -111,14 +130,42 @@ static void default_exception_handler(struct interrupt_frame *frame) {
 
 /* Default IRQ handler */
 static void default_irq_handler(struct interrupt_frame *frame) {
-    /* Send EOI to PIC */
+    /* Acknowledge the line */
     if (frame->int_no >= 32 && frame->int_no <= 47) {
-        pic_send_eoi(frame->int_no - 32);
+        irq_eoi(frame->int_no - 32);
     }
 }
 
 /* Common interrupt handler called from assembly */
 void interrupt_handler_common(struct interrupt_frame *frame) {
+    /* TLB shootdowns and stops must get through while the sender holds
+     * the lock; their handlers touch nothing it protects */
+    if (frame->int_no >= SMP_NOLOCK_VECTOR_FIRST) {
+        if (interrupt_handlers[frame->int_no] != NULL) {
+            interrupt_handlers[frame->int_no](frame);
+        }
+        return;
+    }
+
+    /* The gate turned interrupts off: stamp the window here, the first C
+     * code after the stub */
+    if (irqsoff_tracing && (frame->eflags & EFLAGS_IF)) {
+        trace_irqs_off();
+    }
+
+    irq_lock_acquire();
+
+    /* Device interrupts are counted and timed per line (irq.c) */
+    bool is_irq = frame->int_no >= IRQ0 && frame->int_no <= IRQ15;
+    uint64_t start = is_irq ? rdtsc() : 0;
+
+    /* Device and local APIC interrupts count in the preempt count while
+     * their handler runs; exceptions and system calls may sleep */
+    bool hardirq = is_irq || frame->int_no >= IPI_RESCHEDULE_VECTOR;
+    if (hardirq) {
+        preempt_count_add(HARDIRQ_OFFSET);
+    }
+
     /* Check if we have a registered handler */
     if (interrupt_handlers[frame->int_no] != NULL) {
         /* Call the registered handler */
@@ -133,6 +180,31 @@ void interrupt_handler_common(struct interrupt_frame *frame) {
             default_irq_handler(frame);
         }
     }
+
+    if (is_irq) {
+        irq_account(frame->int_no - IRQ0, rdtsc() - start);
+    }
+    if (hardirq) {
+        preempt_count_sub(HARDIRQ_OFFSET);
+    }
+
+    /* Bottom halves raised by the handler run with interrupts enabled;
+     * an interrupt nested inside them leaves its work to the outer loop */
+    do_softirq();
+
+    /* A handler woke a process or ended the time slice: hand the CPU
+     * over before returning, unless the interrupted code holds a lock or
+     * was processing softirqs (preempt.c) */
+    preempt_irq_return();
+
+    /* Returning to code that ran with interrupts on: it did not hold the
+     * lock (an exception from code with them off leaves it held) */
+    if (frame->eflags & EFLAGS_IF) {
+        if (irqsoff_tracing) {
+            trace_irqs_on();
+        }
+        irq_lock_release();
+    }
 }
 
 /* Initialize the IDT */
@@ -198,27 +270,92 @@ void idt_init(void) {
     idt_set_gate(128, (uint32_t)isr128, 0x08, IDT_INTERRUPT | IDT_RING3);
 
     /* Load IDT */
-    __asm__ volatile("lidt %0" : : "m"(idt_pointer));
+    idt_load();
 
     /* Mask all IRQs initially */
     pic_disable_all();
 }
 
+/* Load the IDT on this CPU (application processors share the boot CPU's) */
+void idt_load(void) {
+    __asm__ volatile("lidt %0" : : "m"(idt_pointer));
+}
+
+/* Take the interrupt lock for this CPU (interrupts must be off). While
+ * waiting, answer TLB shootdowns: the holder may be waiting for us. */
+void irq_lock_acquire(void) {
+    uint32_t self = smp_processor_id();
+    uint64_t wait_start = 0;
+
+    if (irq_lock_owner == self) {
+        return;
+    }
+    if (!__sync_bool_compare_and_swap(&irq_lock_owner, IRQ_LOCK_FREE, self)) {
+        this_cpu()->irq_lock_waits++;
+        if (lockstat_active(&irq_lock_class)) {
+            wait_start = rdtsc();
+        }
+        while (!__sync_bool_compare_and_swap(&irq_lock_owner, IRQ_LOCK_FREE, self)) {
+            smp_poll_ipis();
+            cpu_relax();
+        }
+    }
+
+    if (lockstat_active(&irq_lock_class)) {
+        irq_lock_held_since = lockstat_acquired(&irq_lock_class, wait_start);
+    }
+}
+
+/* Drop the interrupt lock if this CPU holds it */
+void irq_lock_release(void) {
+    if (irq_lock_owner == smp_processor_id()) {
+        if (irq_lock_held_since) {
+            lockstat_released(&irq_lock_class, irq_lock_held_since);
+            irq_lock_held_since = 0;
+        }
+        __asm__ volatile("" ::: "memory");
+        irq_lock_owner = IRQ_LOCK_FREE;
+    }
+}
+
 /* Enable interrupts */
 void interrupts_enable(void) {
-    __asm__ volatile("sti");
+    if (irqsoff_tracing && !interrupts_enabled()) {
+        trace_irqs_on();
+    }
+    irq_lock_release();
+    __asm__ volatile("sti" ::: "memory");
 }
 
-/* Disable interrupts */
+/* Disable interrupts (the tracer's window includes waiting for the lock) */
 void interrupts_disable(void) {
-    __asm__ volatile("cli");
+    bool was_enabled = irqsoff_tracing && interrupts_enabled();
+    __asm__ volatile("cli" ::: "memory");
+    if (was_enabled) {
+        trace_irqs_off();
+    }
+    irq_lock_acquire();
 }
 
 /* Check if interrupts are enabled */
 bool interrupts_enabled(void) {
     uint32_t flags;
     __asm__ volatile("pushfl; pop %0" : "=r"(flags));
-    return (flags & 0x200) != 0;  /* Check IF flag */
+    return (flags & EFLAGS_IF) != 0;
+}
+
+/* Disable interrupts, returning whether they were enabled */
+bool interrupts_save(void) {
+    bool was_enabled = interrupts_enabled();
+    interrupts_disable();
+    return was_enabled;
+}
+
+/* Restore the interrupt state returned by interrupts_save() */
+void interrupts_restore(bool was_enabled) {
+    if (was_enabled) {
+        interrupts_enable();
+    }
 }
 
 /* Print IDT information for debugging */
@@ -20,20 +20,21 @@ isr_common_stub:
     push %fs
     push %gs
 
-    # Load kernel data segment
+    # Load kernel data segment (GS always holds this CPU's per-CPU
+    # segment and is left alone)
     mov $0x10, %ax
     mov %ax, %ds
     mov %ax, %es
     mov %ax, %fs
-    mov %ax, %gs
 
     # Call C interrupt handler (interrupt_frame* is on stack)
     push %esp
     call interrupt_handler_common
     add $4, %esp
 
-    # Restore segment registers
-    pop %gs
+    # Restore segment registers; the saved GS is dropped, as the
+    # process may have moved to another CPU since
+    add $4, %esp
     pop %fs
     pop %es
     pop %ds
@@ -118,3 +119,10 @@ IRQ 15, 47   # IRQ15 - Secondary ATA
 
 # Syscall handler (INT 0x80)
 ISR_NOERRCODE 128
+
+# Inter-processor interrupts and APIC spurious vector (smp.h)
+ISR_NOERRCODE 240 # Reschedule
+ISR_NOERRCODE 241 # Timer tick
+ISR_NOERRCODE 252 # TLB shootdown
+ISR_NOERRCODE 253 # Stop
+ISR_NOERRCODE 255 # APIC spurious
@@ -0,0 +1,239 @@
+/* ioapic.c - I/O APIC: routing of ISA interrupts to the local APICs
+ *
+ * The MADT lists the I/O APICs, each handling the global system
+ * interrupts (GSIs) from its gsi_base on, and the interrupt source
+ * overrides for ISA IRQs that are not wired to the pin of the same number
+ * (the PIT usually arrives on GSI 2) or not edge-triggered active-high.
+ * irq.c routes ISA IRQ n to vector IRQ0 + n, so the handlers registered
+ * for the PIC vectors keep working unchanged.
+ *
+ * Register accesses go through a select/window pair, so every access
+ * runs with interrupts off (and the interrupt lock held).
+ */
+
+#include "../include/ioapic.h"
+#include "../include/acpi.h"
+#include "../include/idt.h"
+#include "../include/paging.h"
+#include "../include/printf.h"
+
+/* No pin for an ISA IRQ */
+#define IOAPIC_NO_GSI 0xFFFFFFFF
+
+typedef struct {
+    volatile uint8_t *base;
+    uint32_t phys;
+    uint8_t id;
+    uint32_t gsi_base;
+    uint32_t pins;               /* Redirection entries */
+} ioapic_t;
+
+/* Where an ISA IRQ arrives and how it is signalled */
+typedef struct {
+    uint32_t gsi;
+    uint32_t redir;              /* IOAPIC_REDIR_ACTIVE_LOW / _LEVEL */
+    bool overridden;             /* From an interrupt source override */
+} ioapic_isa_t;
+
+static ioapic_t ioapics[IOAPIC_MAX];
+static uint32_t ioapic_count = 0;
+static ioapic_isa_t isa_irqs[IOAPIC_ISA_IRQS];
+
+static uint32_t ioapic_read(ioapic_t *io, uint32_t reg) {
+    *(volatile uint32_t *)(io->base + IOAPIC_REGSEL) = reg;
+    return *(volatile uint32_t *)(io->base + IOAPIC_WINDOW);
+}
+
+static void ioapic_write(ioapic_t *io, uint32_t reg, uint32_t value) {
+    *(volatile uint32_t *)(io->base + IOAPIC_REGSEL) = reg;
+    *(volatile uint32_t *)(io->base + IOAPIC_WINDOW) = value;
+}
+
+/* I/O APIC handling gsi, with the pin number in *pin */
+static ioapic_t *ioapic_for_gsi(uint32_t gsi, uint32_t *pin) {
+    for (uint32_t i = 0; i < ioapic_count; i++) {
+        ioapic_t *io = &ioapics[i];
+        if (gsi >= io->gsi_base && gsi < io->gsi_base + io->pins) {
+            *pin = gsi - io->gsi_base;
+            return io;
+        }
+    }
+    return NULL;
+}
+
+/* I/O APIC and pin of ISA IRQ irq (NULL if it has none) */
+static ioapic_t *ioapic_for_isa(uint8_t irq, uint32_t *pin) {
+    if (irq >= IOAPIC_ISA_IRQS || isa_irqs[irq].gsi == IOAPIC_NO_GSI) {
+        return NULL;
+    }
+    return ioapic_for_gsi(isa_irqs[irq].gsi, pin);
+}
+
+/* Map one I/O APIC entry */
+static void ioapic_add(const acpi_madt_ioapic_t *entry) {
+    if (ioapic_count == IOAPIC_MAX) {
+        printk("[IOAPIC] Ignoring I/O APIC %d (max %d)\n", entry->ioapic_id, IOAPIC_MAX);
+        return;
+    }
+
+    ioapic_t *io = &ioapics[ioapic_count];
+    io->base = (volatile uint8_t *)paging_map_mmio(entry->address, PAGE_SIZE);
+    if (!io->base) {
+        return;
+    }
+    io->phys = entry->address;
+    io->id = entry->ioapic_id;
+    io->gsi_base = entry->gsi_base;
+    io->pins = ((ioapic_read(io, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+    ioapic_count++;
+}
+
+/* Record an interrupt source override for an ISA IRQ */
+static void ioapic_add_override(const acpi_madt_iso_t *entry) {
+    if (entry->bus != 0 || entry->source >= IOAPIC_ISA_IRQS) {
+        return;
+    }
+
+    ioapic_isa_t *isa = &isa_irqs[entry->source];
+    isa->gsi = entry->gsi;
+    isa->redir = 0;
+    if ((entry->flags & ACPI_MADT_POLARITY_MASK) == ACPI_MADT_POLARITY_LOW) {
+        isa->redir |= IOAPIC_REDIR_ACTIVE_LOW;
+    }
+    if ((entry->flags & ACPI_MADT_TRIGGER_MASK) == ACPI_MADT_TRIGGER_LEVEL) {
+        isa->redir |= IOAPIC_REDIR_LEVEL;
+    }
+    isa->overridden = true;
+}
+
+/* Find the I/O APICs and the ISA overrides, mask every pin */
+int ioapic_init(void) {
+    const acpi_madt_t *madt = (const acpi_madt_t *)acpi_find_table("APIC");
+    if (!madt) {
+        return -1;
+    }
+
+    /* ISA default: pin n, edge-triggered, active high */
+    for (uint32_t i = 0; i < IOAPIC_ISA_IRQS; i++) {
+        isa_irqs[i].gsi = i;
+        isa_irqs[i].redir = 0;
+        isa_irqs[i].overridden = false;
+    }
+
+    const uint8_t *entry = (const uint8_t *)(madt + 1);
+    const uint8_t *end = (const uint8_t *)madt + madt->header.length;
+
+    while (entry + sizeof(acpi_madt_entry_t) <= end) {
+        const acpi_madt_entry_t *header = (const acpi_madt_entry_t *)entry;
+        if (header->length < sizeof(acpi_madt_entry_t)) {
+            break;
+        }
+        if (header->type == ACPI_MADT_IOAPIC && header->length >= sizeof(acpi_madt_ioapic_t)) {
+            ioapic_add((const acpi_madt_ioapic_t *)entry);
+        } else if (header->type == ACPI_MADT_ISO && header->length >= sizeof(acpi_madt_iso_t)) {
+            ioapic_add_override((const acpi_madt_iso_t *)entry);
+        }
+        entry += header->length;
+    }
+
+    if (ioapic_count == 0) {
+        return -1;
+    }
+
+    /* IRQ 2 is the PIC cascade; an IRQ whose pin another IRQ was moved to
+     * (IRQ 0 on GSI 2) has no pin left */
+    isa_irqs[2].gsi = IOAPIC_NO_GSI;
+    for (uint32_t i = 0; i < IOAPIC_ISA_IRQS; i++) {
+        if (!isa_irqs[i].overridden) {
+            continue;
+        }
+        for (uint32_t j = 0; j < IOAPIC_ISA_IRQS; j++) {
+            if (j != i && !isa_irqs[j].overridden && isa_irqs[j].gsi == isa_irqs[i].gsi) {
+                isa_irqs[j].gsi = IOAPIC_NO_GSI;
+            }
+        }
+    }
+
+    ioapic_mask_all();
+
+    for (uint32_t i = 0; i < ioapic_count; i++) {
+        printk("[IOAPIC] I/O APIC %d at 0x%x, GSI %d-%d\n", ioapics[i].id, ioapics[i].phys,
+               ioapics[i].gsi_base, ioapics[i].gsi_base + ioapics[i].pins - 1);
+    }
+    return 0;
+}
+
+/* Deliver ISA IRQ irq as vector to the CPU with APIC ID dest */
+void ioapic_route_isa(uint8_t irq, uint8_t vector, uint32_t dest, bool masked) {
+    uint32_t pin;
+    ioapic_t *io = ioapic_for_isa(irq, &pin);
+    if (!io) {
+        return;
+    }
+
+    uint32_t low = vector | isa_irqs[irq].redir | (masked ? IOAPIC_REDIR_MASKED : 0);
+
+    bool flags = interrupts_save();
+    /* Masked while the destination changes */
+    ioapic_write(io, IOAPIC_REG_REDTBL(pin), IOAPIC_REDIR_MASKED);
+    ioapic_write(io, IOAPIC_REG_REDTBL(pin) + 1, dest << 24);
+    ioapic_write(io, IOAPIC_REG_REDTBL(pin), low);
+    interrupts_restore(flags);
+}
+
+/* Mask or unmask the pin of ISA IRQ irq */
+void ioapic_set_masked(uint8_t irq, bool masked) {
+    uint32_t pin;
+    ioapic_t *io = ioapic_for_isa(irq, &pin);
+    if (!io) {
+        return;
+    }
+
+    bool flags = interrupts_save();
+    uint32_t low = ioapic_read(io, IOAPIC_REG_REDTBL(pin));
+    if (masked) {
+        low |= IOAPIC_REDIR_MASKED;
+    } else {
+        low &= ~IOAPIC_REDIR_MASKED;
+    }
+    ioapic_write(io, IOAPIC_REG_REDTBL(pin), low);
+    interrupts_restore(flags);
+}
+
+/* Mask every pin of every I/O APIC */
+void ioapic_mask_all(void) {
+    bool flags = interrupts_save();
+    for (uint32_t i = 0; i < ioapic_count; i++) {
+        for (uint32_t pin = 0; pin < ioapics[i].pins; pin++) {
+            ioapic_write(&ioapics[i], IOAPIC_REG_REDTBL(pin), IOAPIC_REDIR_MASKED);
+        }
+    }
+    interrupts_restore(flags);
+}
+
+/* Print the I/O APICs and the ISA routes */
+void ioapic_print_info(void) {
+    for (uint32_t i = 0; i < ioapic_count; i++) {
+        printk("I/O APIC %d at 0x%x: GSI %d-%d\n", ioapics[i].id, ioapics[i].phys,
+               ioapics[i].gsi_base, ioapics[i].gsi_base + ioapics[i].pins - 1);
+    }
+
+    printk("ISA IRQ  GSI  Vector  Trigger  Polarity  State\n");
+    for (uint8_t irq = 0; irq < IOAPIC_ISA_IRQS; irq++) {
+        uint32_t pin;
+        ioapic_t *io = ioapic_for_isa(irq, &pin);
+        if (!io) {
+            continue;
+        }
+
+        bool flags = interrupts_save();
+        uint32_t low = ioapic_read(io, IOAPIC_REG_REDTBL(pin));
+        interrupts_restore(flags);
+
+        printk("%d        %d    0x%x    %s    %s      %s%s\n", irq, isa_irqs[irq].gsi,
+               low & 0xFF, (low & IOAPIC_REDIR_LEVEL) ? "level" : "edge ",
+               (low & IOAPIC_REDIR_ACTIVE_LOW) ? "low " : "high",
+               (low & IOAPIC_REDIR_MASKED) ? "masked" : "enabled",
+               isa_irqs[irq].overridden ? " (override)" : "");
+    }
+}
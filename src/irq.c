@@ -0,0 +1,144 @@
+/* irq.c - ISA IRQ lines: 8259 PIC or I/O APIC
+ *
+ * Drivers acknowledge, mask and unmask their lines here rather than on
+ * the 8259 directly. Interrupts start on the PIC; once the local APIC is
+ * up and the MADT lists an I/O APIC, smp_init moves every line over,
+ * keeping its mask, and masks the PIC. An EOI is then one write to the
+ * local APIC instead of one or two outb to the PIC, each of which is a
+ * VM exit under virtualization.
+ *
+ * The switch is one-way: an interrupt accepted from one controller and
+ * acknowledged on the other would stay in service there for good.
+ */
+
+#include "../include/irq.h"
+#include "../include/pic.h"
+#include "../include/apic.h"
+#include "../include/ioapic.h"
+#include "../include/idt.h"
+#include "../include/math64.h"
+#include "../include/printf.h"
+#include "../include/string.h"
+#include "../include/vga.h"
+
+static irq_controller_t irq_controller = IRQ_CONTROLLER_PIC;
+
+/* Masked lines, bit per IRQ (idt_init starts with all of them masked) */
+static uint16_t irq_masked = 0xFFFF;
+
+/* Per-line interrupts and cycles spent in their handlers */
+static uint32_t irq_counts[IRQ_LINES];
+static uint64_t irq_cycles[IRQ_LINES];
+
+/* Clear the per-line counters */
+static void irq_reset_stats(void) {
+    bool flags = interrupts_save();
+    memset(irq_counts, 0, sizeof(irq_counts));
+    memset(irq_cycles, 0, sizeof(irq_cycles));
+    interrupts_restore(flags);
+}
+
+/* Acknowledge IRQ irq */
+void irq_eoi(uint8_t irq) {
+    if (irq_controller == IRQ_CONTROLLER_IOAPIC) {
+        apic_eoi();
+    } else {
+        pic_send_eoi(irq);
+    }
+}
+
+/* Mask IRQ irq */
+void irq_mask(uint8_t irq) {
+    if (irq >= IRQ_LINES) {
+        return;
+    }
+
+    bool flags = interrupts_save();
+    irq_masked |= 1 << irq;
+    if (irq_controller == IRQ_CONTROLLER_IOAPIC) {
+        ioapic_set_masked(irq, true);
+    } else {
+        pic_mask_irq(irq);
+    }
+    interrupts_restore(flags);
+}
+
+/* Unmask IRQ irq */
+void irq_unmask(uint8_t irq) {
+    if (irq >= IRQ_LINES) {
+        return;
+    }
+
+    bool flags = interrupts_save();
+    irq_masked &= ~(1 << irq);
+    if (irq_controller == IRQ_CONTROLLER_IOAPIC) {
+        ioapic_set_masked(irq, false);
+    } else {
+        pic_unmask_irq(irq);
+    }
+    interrupts_restore(flags);
+}
+
+/* Route every line through the I/O APIC to the boot CPU, mask the PIC */
+int irq_use_ioapic(void) {
+    if (irq_controller == IRQ_CONTROLLER_IOAPIC) {
+        return 0;
+    }
+    if (!apic_enabled() || ioapic_init() != 0) {
+        printk("[IRQ] No I/O APIC, device interrupts stay on the 8259 PIC\n");
+        return -1;
+    }
+
+    bool flags = interrupts_save();
+    for (uint8_t irq = 0; irq < IRQ_LINES; irq++) {
+        ioapic_route_isa(irq, IRQ0 + irq, apic_cpu_apic_id(0), (irq_masked >> irq) & 1);
+    }
+    pic_disable_all();
+    irq_controller = IRQ_CONTROLLER_IOAPIC;
+    irq_reset_stats();
+    interrupts_restore(flags);
+
+    printk("[IRQ] Device interrupts routed through the I/O APIC\n");
+    return 0;
+}
+
+/* Controller in use */
+irq_controller_t irq_get_controller(void) {
+    return irq_controller;
+}
+
+const char *irq_controller_name(void) {
+    return irq_controller == IRQ_CONTROLLER_IOAPIC ? "I/O APIC + local APIC" : "8259 PIC";
+}
+
+/* Count an interrupt on line irq (interrupt lock held) */
+void irq_account(uint8_t irq, uint64_t cycles) {
+    if (irq < IRQ_LINES) {
+        irq_counts[irq]++;
+        irq_cycles[irq] += cycles;
+    }
+}
+
+/* Print the controller, per-line counts and handler cost, and the routes */
+void irq_print_info(void) {
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== IRQs ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    printk("Controller: %s\n", irq_controller_name());
+    printk("IRQ  Count      Cycles/IRQ  State\n");
+    for (uint8_t irq = 0; irq < IRQ_LINES; irq++) {
+        bool masked = (irq_masked >> irq) & 1;
+        if (masked && irq_counts[irq] == 0) {
+            continue;
+        }
+        uint32_t avg = irq_counts[irq] ? (uint32_t)div_u64(irq_cycles[irq], irq_counts[irq]) : 0;
+        printk("%d    %u      %u        %s\n", irq, irq_counts[irq], avg,
+               masked ? "masked" : "enabled");
+    }
+
+    if (irq_controller == IRQ_CONTROLLER_IOAPIC) {
+        printk("\n");
+        ioapic_print_info();
+    }
+}
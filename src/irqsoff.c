@@ -0,0 +1,196 @@
+/* irqsoff.c - Interrupts-off and preemption-off latency tracer
+ *
+ * With tracing on, a CPU stamps the TSC and saves its caller's stack when
+ * interrupts go off (interrupts_disable, or an interrupt taken while they
+ * were on: the stub's gate and cli are stamped on entry to
+ * interrupt_handler_common; likewise a SYSENTER, at sysenter_entry) and
+ * when its preempt_disable() depth leaves
+ * zero. When the window closes, its length is compared with the longest
+ * seen so far; the IRQSOFF_WORST longest of each kind are kept with the
+ * stack that opened them and the address that closed them.
+ *
+ * The hooks run inside interrupts_disable and spin_lock, so they must not
+ * take a traced lock themselves: the tables are guarded by a try-lock,
+ * and a window that finds it busy is counted as dropped, not waited for.
+ */
+
+#include "../include/irqsoff.h"
+#include "../include/cpu.h"
+#include "../include/smp.h"
+#include "../include/process.h"
+#include "../include/clocksource.h"
+#include "../include/math64.h"
+#include "../include/string.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+
+/* A window open on one CPU */
+typedef struct {
+    uint64_t start;                           /* 0: none open */
+    uint32_t stack[IRQSOFF_STACK_DEPTH];
+} irqsoff_window_t;
+
+/* Longest windows of one kind, longest first */
+typedef struct {
+    irqsoff_record_t worst[IRQSOFF_WORST];
+    uint32_t windows;                         /* Windows closed */
+    uint32_t dropped;                         /* ... not compared: tables busy */
+} irqsoff_table_t;
+
+volatile bool irqsoff_tracing = false;
+
+static irqsoff_window_t irqsoff_open[SMP_MAX_CPUS][IRQSOFF_NR_KINDS];
+static irqsoff_table_t irqsoff_tables[IRQSOFF_NR_KINDS];
+static volatile uint32_t irqsoff_tables_lock = 0;
+
+static const char *irqsoff_kind_names[IRQSOFF_NR_KINDS] = {
+    "Interrupts off",
+    "Preemption off",
+};
+
+/* Return addresses of this function's callers, skipping the first skip;
+ * stops where the frame chain leaves the kernel stack */
+static void irqsoff_save_stack(uint32_t *stack, uint32_t depth, uint32_t skip) {
+    uint32_t *ebp = (uint32_t *)__builtin_frame_address(0);
+    uint32_t n = 0;
+
+    while (n < depth) {
+        uint32_t *next = (uint32_t *)ebp[0];
+        if (skip) {
+            skip--;
+        } else {
+            stack[n++] = ebp[1];
+        }
+
+        /* Frames sit higher up the same stack; anything else ends the
+         * chain (the top frame, or a user stack under an interrupt) */
+        if (next <= ebp || (uint32_t)next - (uint32_t)ebp > KERNEL_STACK_SIZE) {
+            break;
+        }
+        ebp = next;
+    }
+    while (n < depth) {
+        stack[n++] = 0;
+    }
+}
+
+/* Start a window; its stack begins at whoever called the wrapper
+ * (interrupts_disable, preempt_disable) that called the hook */
+static void irqsoff_open_window(irqsoff_kind_t kind) {
+    irqsoff_window_t *window = &irqsoff_open[smp_processor_id()][kind];
+    window->start = rdtsc();
+    irqsoff_save_stack(window->stack, IRQSOFF_STACK_DEPTH, 3);
+}
+
+static void irqsoff_close_window(irqsoff_kind_t kind) {
+    uint32_t cpu = smp_processor_id();
+    irqsoff_window_t *window = &irqsoff_open[cpu][kind];
+    irqsoff_table_t *table = &irqsoff_tables[kind];
+
+    if (!window->start) {
+        return;
+    }
+    uint64_t cycles = rdtsc() - window->start;
+    window->start = 0;
+
+    if (!__sync_bool_compare_and_swap(&irqsoff_tables_lock, 0, 1)) {
+        __sync_fetch_and_add(&table->dropped, 1);
+        return;
+    }
+
+    table->windows++;
+    if (cycles > table->worst[IRQSOFF_WORST - 1].cycles) {
+        uint32_t i = IRQSOFF_WORST - 1;
+        while (i > 0 && table->worst[i - 1].cycles < cycles) {
+            table->worst[i] = table->worst[i - 1];
+            i--;
+        }
+
+        irqsoff_record_t *rec = &table->worst[i];
+        rec->cycles = cycles;
+        rec->cpu = cpu;
+        irqsoff_save_stack(&rec->end_ip, 1, 3);
+        memcpy(rec->stack, window->stack, sizeof(rec->stack));
+    }
+
+    __sync_lock_release(&irqsoff_tables_lock);
+}
+
+void trace_irqs_off(void) {
+    irqsoff_open_window(IRQSOFF_IRQS);
+}
+
+void trace_irqs_on(void) {
+    irqsoff_close_window(IRQSOFF_IRQS);
+}
+
+void trace_preempt_off(void) {
+    irqsoff_open_window(IRQSOFF_PREEMPT);
+}
+
+void trace_preempt_on(void) {
+    irqsoff_close_window(IRQSOFF_PREEMPT);
+}
+
+/* Windows opened before tracing started would look as long as the time
+ * since the last session ended */
+void irqsoff_enable(bool on) {
+    if (on) {
+        memset(irqsoff_open, 0, sizeof(irqsoff_open));
+    }
+    irqsoff_tracing = on;
+}
+
+void irqsoff_reset(void) {
+    while (!__sync_bool_compare_and_swap(&irqsoff_tables_lock, 0, 1)) {
+        cpu_relax();
+    }
+    memset(irqsoff_tables, 0, sizeof(irqsoff_tables));
+    __sync_lock_release(&irqsoff_tables_lock);
+}
+
+void irqsoff_print(void) {
+    irqsoff_table_t snapshot[IRQSOFF_NR_KINDS];
+    clocksource_t *tsc = clocksource_find("tsc");
+    uint32_t tsc_khz = tsc ? tsc->freq_khz : 0;
+
+    /* Printing opens windows of its own: copy the tables first */
+    while (!__sync_bool_compare_and_swap(&irqsoff_tables_lock, 0, 1)) {
+        cpu_relax();
+    }
+    memcpy(snapshot, irqsoff_tables, sizeof(snapshot));
+    __sync_lock_release(&irqsoff_tables_lock);
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Latency tracer (%s) ===\n", irqsoff_tracing ? "tracing" : "off");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    for (uint32_t kind = 0; kind < IRQSOFF_NR_KINDS; kind++) {
+        irqsoff_table_t *table = &snapshot[kind];
+
+        printk("%s: %u windows", irqsoff_kind_names[kind], table->windows);
+        if (table->dropped) {
+            printk(" (%u not compared)", table->dropped);
+        }
+        printk("\n");
+
+        for (uint32_t i = 0; i < IRQSOFF_WORST && table->worst[i].cycles; i++) {
+            irqsoff_record_t *rec = &table->worst[i];
+            uint32_t cycles = rec->cycles > 0xFFFFFFFFULL ? 0xFFFFFFFF : (uint32_t)rec->cycles;
+
+            printk("  %u. CPU %u: %u cycles", i + 1, rec->cpu, cycles);
+            if (tsc_khz) {
+                printk(" (%u us)", (uint32_t)div_u64(rec->cycles * 1000, tsc_khz));
+            }
+            printk(", closed at 0x%x\n     opened at", rec->end_ip);
+            for (uint32_t f = 0; f < IRQSOFF_STACK_DEPTH && rec->stack[f]; f++) {
+                printk("%s0x%x", f ? " <- " : " ", rec->stack[f]);
+            }
+            printk("\n");
+        }
+    }
+
+    if (!irqsoff_tracing) {
+        printk("Start tracing with 'irqsoff on'\n");
+    }
+}
@@ -21,7 +21,17 @@
 #include "../include/socket.h"
 #include "../include/ide.h"
 #include "../include/ext2.h"
+#include "../include/procfs.h"
+#include "../include/futex.h"
+#include "../include/exec.h"
 #include "../include/vfs.h"
+#include "../include/acpi.h"
+#include "../include/clocksource.h"
+#include "../include/smp.h"
+#include "../include/workqueue.h"
+#include "../include/softirq.h"
+#include "../include/fpu.h"
+#include "../include/vdso.h"
 /* #include "../include/mouse.h" */       /* Disabled - causes keyboard issues */
 /* #include "../include/scrollback.h" */  /* Disabled - causes keyboard issues */
 
@@ -174,9 +184,15 @@ void kmain(void) {
     /* Initialize GDT - MANDATORY for KFS_2 */
     gdt_init();
 
+    /* Per-CPU data of the boot CPU, reached through GS from here on */
+    smp_prepare_boot_cpu();
+
     /* Initialize IDT - MANDATORY for KFS_4 */
     idt_init();
 
+    /* Enable x87/SSE with lazy per-process state (#NM handler) */
+    fpu_init();
+
     /* Initialize signal system - MANDATORY for KFS_4 */
     signal_init();
 
@@ -187,6 +203,9 @@ void kmain(void) {
     paging_init();
     paging_enable();
 
+    /* Map the vDSO pages into the shared kernel tables */
+    vdso_init();
+
     /* Initialize physical memory allocator - MANDATORY for KFS_3 */
     kmalloc_init();
 
@@ -196,6 +215,9 @@ void kmain(void) {
     /* Initialize process system - MANDATORY for KFS_5 */
     process_init();
 
+    /* Futex wait buckets (user-space lock sleep/wake) */
+    futex_init();
+
     /* Initialize socket system - MANDATORY for KFS_5 */
     socket_init();
 
@@ -215,6 +237,8 @@ void kmain(void) {
     printk("[INIT] Initializing Virtual File System (VFS)...\n");
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     vfs_init();
+    procfs_init();
+    exec_init();
 
     /* Mount EXT2 filesystem on primary master drive */
     ext2_filesystem_t *ext2_fs = kmalloc(sizeof(ext2_filesystem_t));
@@ -238,9 +262,24 @@ void kmain(void) {
         }
     }
 
+    /* Discover ACPI tables (HPET, MADT) */
+    acpi_init();
+
+    /* Calibrate clocksources (TSC against PIT channel 2, HPET) */
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("[INIT] Calibrating clocksources...\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    clocksource_init();
+
     /* Initialize timer for preemptive multitasking - MANDATORY for KFS_5 */
     timer_init(TIMER_FREQUENCY);
 
+    /* Start ksoftirqd for softirqs deferred under load */
+    softirq_init();
+
+    /* Start the shared worker thread for deferred work */
+    workqueue_init();
+
     /* DISABLED: Scrollback causes keyboard issues
      * scrollback_init();
      */
@@ -260,6 +299,10 @@ void kmain(void) {
     /* Enable interrupts globally */
     interrupts_enable();
 
+    /* Local APIC, I/O APIC routing, APIC timers and the other CPUs (MADT);
+     * needs the timer running */
+    smp_init();
+
     /* Initialize multiple screens */
     init_screens();
 
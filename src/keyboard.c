@@ -2,10 +2,14 @@
 
 #include "../include/keyboard.h"
 #include "../include/idt.h"
-#include "../include/pic.h"
+#include "../include/irq.h"
 #include "../include/io.h"
 #include "../include/printf.h"
 #include "../include/vga.h"
+#include "../include/process.h"
+#include "../include/wait.h"
+#include "../include/softirq.h"
+#include "../include/spinlock.h"
 
 /* Keyboard ports */
 #define KEYBOARD_DATA_PORT 0x60
@@ -79,6 +83,19 @@ static int keyboard_buffer[KEYBOARD_BUFFER_SIZE];
 static int buffer_read_pos = 0;
 static int buffer_write_pos = 0;
 
+/* Readers sleeping until a key arrives */
+static wait_queue_head_t keyboard_wq;
+
+/* Raw scancodes queued by the IRQ1 top half for the keyboard softirq */
+#define SCANCODE_RING_SIZE 64
+static uint8_t scancode_ring[SCANCODE_RING_SIZE];
+static volatile int scancode_read_pos = 0;
+static volatile int scancode_write_pos = 0;
+
+/* Both rings: filled from IRQ1 and its softirq, drained by readers */
+static lock_class_t keyboard_lock_class = LOCK_CLASS_INIT("keyboard");
+static spinlock_t keyboard_lock = SPINLOCK_INIT_CLASS(keyboard_lock_class);
+
 /* Buffer helper functions */
 static inline bool buffer_is_empty(void) {
     return buffer_read_pos == buffer_write_pos;
@@ -89,18 +106,22 @@ static inline bool buffer_is_full(void) {
 }
 
 static inline void buffer_put(int c) {
+    bool flags = spin_lock_irqsave(&keyboard_lock);
     if (!buffer_is_full()) {
         keyboard_buffer[buffer_write_pos] = c;
         buffer_write_pos = (buffer_write_pos + 1) % KEYBOARD_BUFFER_SIZE;
     }
+    spin_unlock_irqrestore(&keyboard_lock, flags);
 }
 
 static inline int buffer_get(void) {
-    if (buffer_is_empty()) {
-        return 0;
+    int c = 0;
+    bool flags = spin_lock_irqsave(&keyboard_lock);
+    if (!buffer_is_empty()) {
+        c = keyboard_buffer[buffer_read_pos];
+        buffer_read_pos = (buffer_read_pos + 1) % KEYBOARD_BUFFER_SIZE;
     }
-    int c = keyboard_buffer[buffer_read_pos];
-    buffer_read_pos = (buffer_read_pos + 1) % KEYBOARD_BUFFER_SIZE;
+    spin_unlock_irqrestore(&keyboard_lock, flags);
     return c;
 }
 
@@ -117,10 +138,8 @@ static const char* get_scancode_map(bool shifted) {
     }
 }
 
-/* Keyboard interrupt handler (called from IRQ1) */
-void keyboard_interrupt_handler(void) {
-    uint8_t scancode = inb(KEYBOARD_DATA_PORT);
-
+/* Translate one scancode into the character buffer */
+static void keyboard_process_scancode(uint8_t scancode) {
     /* Handle key release (bit 7 set) */
     if (scancode & 0x80) {
         scancode &= 0x7F;
@@ -165,11 +184,49 @@ void keyboard_interrupt_handler(void) {
     }
 }
 
-/* IRQ1 interrupt wrapper */
+/* Keyboard interrupt handler (polled use: read and translate one scancode) */
+void keyboard_interrupt_handler(void) {
+    keyboard_process_scancode(inb(KEYBOARD_DATA_PORT));
+}
+
+/* Keyboard softirq: translate queued scancodes and wake readers */
+static void keyboard_softirq(void) {
+    while (1) {
+        bool flags = spin_lock_irqsave(&keyboard_lock);
+        if (scancode_read_pos == scancode_write_pos) {
+            spin_unlock_irqrestore(&keyboard_lock, flags);
+            break;
+        }
+        uint8_t scancode = scancode_ring[scancode_read_pos];
+        scancode_read_pos = (scancode_read_pos + 1) % SCANCODE_RING_SIZE;
+        spin_unlock_irqrestore(&keyboard_lock, flags);
+
+        keyboard_process_scancode(scancode);
+    }
+
+    /* Wake readers blocked in keyboard_wait() */
+    if (!buffer_is_empty()) {
+        wake_up(&keyboard_wq);
+    }
+}
+
+/* IRQ1 top half: grab the scancode, acknowledge, defer the rest */
 static void keyboard_irq_handler(struct interrupt_frame *frame) {
     (void)frame;  /* Unused */
-    keyboard_interrupt_handler();
-    pic_send_eoi(1);  /* Send EOI to PIC for IRQ1 */
+    uint8_t scancode = inb(KEYBOARD_DATA_PORT);
+
+    spin_lock(&keyboard_lock);
+    int next = (scancode_write_pos + 1) % SCANCODE_RING_SIZE;
+
+    /* Drop the scancode if the bottom half has fallen this far behind */
+    if (next != scancode_read_pos) {
+        scancode_ring[scancode_write_pos] = scancode;
+        scancode_write_pos = next;
+    }
+    spin_unlock(&keyboard_lock);
+
+    irq_eoi(1);  /* Acknowledge IRQ1 */
+    raise_softirq(KEYBOARD_SOFTIRQ);
 }
 
 /* Initialize keyboard */
@@ -182,21 +239,25 @@ void keyboard_init(void) {
     /* Clear buffer */
     buffer_read_pos = 0;
     buffer_write_pos = 0;
+    scancode_read_pos = 0;
+    scancode_write_pos = 0;
+    init_waitqueue_head(&keyboard_wq);
 }
 
 /* Enable keyboard interrupts */
 void keyboard_enable_interrupts(void) {
-    /* Register IRQ1 handler */
+    /* Register IRQ1 handler and its bottom half */
+    open_softirq(KEYBOARD_SOFTIRQ, keyboard_softirq);
     idt_register_handler(IRQ1, keyboard_irq_handler);
 
-    /* Unmask IRQ1 on PIC */
-    pic_unmask_irq(1);
+    /* Unmask IRQ1 */
+    irq_unmask(1);
 }
 
 /* Disable keyboard interrupts */
 void keyboard_disable_interrupts(void) {
-    /* Mask IRQ1 on PIC */
-    pic_mask_irq(1);
+    /* Mask IRQ1 */
+    irq_mask(1);
 
     /* Unregister handler */
     idt_unregister_handler(IRQ1);
@@ -207,6 +268,19 @@ bool keyboard_haskey(void) {
     return !buffer_is_empty();
 }
 
+/* Sleep until a key is available */
+void keyboard_wait(void) {
+    /* Without a process to block (early boot, IRQ context) just halt */
+    if (!process_get_current() || !interrupts_enabled()) {
+        if (!keyboard_haskey()) {
+            __asm__ volatile("hlt");
+        }
+        return;
+    }
+
+    wait_event(keyboard_wq, keyboard_haskey());
+}
+
 /* Get keyboard input (non-blocking) */
 int keyboard_getchar(void) {
     return buffer_get();
@@ -233,7 +307,7 @@ int keyboard_getline(char *buffer, int max_len) {
     while (1) {
         /* Wait for a key */
         while (!keyboard_haskey()) {
-            __asm__ volatile("hlt");  /* Wait for interrupt */
+            keyboard_wait();
         }
 
         int c = keyboard_getchar();
@@ -4,6 +4,7 @@
 #include "../include/panic.h"
 #include "../include/printf.h"
 #include "../include/string.h"
+#include "../include/spinlock.h"
 
 /* Kernel heap configuration */
 #define HEAP_START 0x00500000  /* Start at 5MB */
@@ -19,16 +20,22 @@ typedef struct mem_block {
 } mem_block_t;
 
 #define BLOCK_MAGIC 0xDEADBEEF
+#define BLOCK_ALIGNED_MAGIC 0xA11C0FFE  /* Stub header of an aligned block */
 #define BLOCK_HEADER_SIZE sizeof(mem_block_t)
 
 /* Head of the free list */
 static mem_block_t *heap_start = NULL;
 static bool heap_initialized = false;
 
+/* The heap is shared by every CPU and by interrupt handlers */
+static lock_class_t kmalloc_lock_class = LOCK_CLASS_INIT("kmalloc");
+static spinlock_t kmalloc_lock = SPINLOCK_INIT_CLASS(kmalloc_lock_class);
+
 /* Statistics */
 static size_t total_allocated = 0;
 static size_t total_freed = 0;
 static size_t num_allocations = 0;
+static size_t num_frees = 0;
 
 /* Initialize kernel memory allocator */
 void kmalloc_init(void) {
@@ -108,10 +115,13 @@ void *kmalloc(size_t size) {
     size = (size + 3) & ~3;
     size_t total_size = size + BLOCK_HEADER_SIZE;
 
+    bool flags = spin_lock_irqsave(&kmalloc_lock);
+
     /* Find a free block */
     mem_block_t *block = find_free_block(total_size);
 
     if (block == NULL) {
+        spin_unlock_irqrestore(&kmalloc_lock, flags);
         kernel_warning("kmalloc: Out of memory");
         return NULL;
     }
@@ -125,6 +135,7 @@ void *kmalloc(size_t size) {
     /* Update statistics */
     total_allocated += size;
     num_allocations++;
+    spin_unlock_irqrestore(&kmalloc_lock, flags);
 
     /* Return pointer to data (after header) */
     return (void *)((uint32_t)block + BLOCK_HEADER_SIZE);
@@ -132,15 +143,22 @@ void *kmalloc(size_t size) {
 
 /* Allocate aligned physical memory */
 void *kmalloc_aligned(size_t size, uint32_t align) {
-    /* Simple implementation: just allocate extra space */
-    void *ptr = kmalloc(size + align);
+    /* Allocate extra space for the alignment and a stub header */
+    void *ptr = kmalloc(size + align + BLOCK_HEADER_SIZE);
     if (!ptr) {
         return NULL;
     }
 
-    uint32_t addr = (uint32_t)ptr;
+    uint32_t addr = (uint32_t)ptr + BLOCK_HEADER_SIZE;
     uint32_t aligned_addr = (addr + align - 1) & ~(align - 1);
 
+    /* The stub below the aligned address leads kfree() to the real block */
+    mem_block_t *stub = (mem_block_t *)(aligned_addr - BLOCK_HEADER_SIZE);
+    stub->size = 0;
+    stub->is_free = false;
+    stub->next = (mem_block_t *)ptr;
+    stub->magic = BLOCK_ALIGNED_MAGIC;
+
     return (void *)aligned_addr;
 }
 
@@ -153,12 +171,22 @@ void kfree(void *ptr) {
     /* Get block header */
     mem_block_t *block = (mem_block_t *)((uint32_t)ptr - BLOCK_HEADER_SIZE);
 
+    bool flags = spin_lock_irqsave(&kmalloc_lock);
+
+    /* Aligned allocation: free the block it was carved from */
+    if (block->magic == BLOCK_ALIGNED_MAGIC) {
+        block->magic = 0;
+        ptr = block->next;
+        block = (mem_block_t *)((uint32_t)ptr - BLOCK_HEADER_SIZE);
+    }
+
     /* Validate magic number */
     if (block->magic != BLOCK_MAGIC) {
         kernel_panic("kfree: Invalid pointer or corrupted heap");
     }
 
     if (block->is_free) {
+        spin_unlock_irqrestore(&kmalloc_lock, flags);
         kernel_warning("kfree: Double free detected");
         return;
     }
@@ -168,9 +196,11 @@ void kfree(void *ptr) {
 
     /* Update statistics */
     total_freed += (block->size - BLOCK_HEADER_SIZE);
+    num_frees++;
 
     /* Merge adjacent free blocks */
     merge_free_blocks();
+    spin_unlock_irqrestore(&kmalloc_lock, flags);
 }
 
 /* Get size of allocated block */
@@ -190,6 +220,12 @@ size_t ksize(void *ptr) {
     return block->size - BLOCK_HEADER_SIZE;
 }
 
+/* Number of kmalloc and kfree calls so far */
+void kmalloc_get_counts(size_t *allocations, size_t *frees) {
+    *allocations = num_allocations;
+    *frees = num_frees;
+}
+
 /* Get kernel heap statistics */
 void kmalloc_stats(void) {
     printk("\n=== Kernel Heap Statistics ===\n");
@@ -203,6 +239,7 @@ void kmalloc_stats(void) {
     /* Count free blocks */
     int free_blocks = 0;
     size_t free_memory = 0;
+    bool flags = spin_lock_irqsave(&kmalloc_lock);
     mem_block_t *current = heap_start;
 
     while (current != NULL) {
@@ -212,6 +249,7 @@ void kmalloc_stats(void) {
         }
         current = current->next;
     }
+    spin_unlock_irqrestore(&kmalloc_lock, flags);
 
     printk("Free blocks:      %d\n", free_blocks);
     printk("Free memory:      %d bytes\n", free_memory);
@@ -0,0 +1,22 @@
+/* kthread.c - Kernel threads */
+
+#include "../include/kthread.h"
+#include "../include/printf.h"
+
+/* Create and start a kernel thread */
+process_t *kthread_create(int (*fn)(void *data), void *data, const char *name) {
+    process_t *thread = process_create_kernel(fn, data, name);
+    if (!thread) {
+        printk("[KTHREAD] Failed to create '%s'\n", name);
+        return NULL;
+    }
+
+    printk("[KTHREAD] Started '%s' (PID %d)\n", thread->name, thread->pid);
+    return thread;
+}
+
+/* Check whether the current process is a kernel thread */
+bool kthread_is_current(void) {
+    process_t *proc = process_get_current();
+    return proc && (proc->flags & PROCESS_FLAG_KTHREAD);
+}
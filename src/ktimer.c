@@ -0,0 +1,170 @@
+/* ktimer.c - Hierarchical timing wheel for tick-based kernel timers
+ *
+ * Timers due within 256 ticks sit in the root level (tv1), one slot per
+ * tick. Later timers go to one of four 64-slot levels, each covering 64
+ * times the range of the level below. Whenever the root index wraps, the
+ * next slot of the level above is cascaded down. Adding, removing and
+ * expiring a timer are O(1); the cascade touches one slot per level.
+ */
+
+#include "../include/ktimer.h"
+#include "../include/timer.h"
+#include "../include/idt.h"
+
+typedef struct {
+    list_head_t vec[TVN_SIZE];
+} tvec_t;
+
+typedef struct {
+    list_head_t vec[TVR_SIZE];
+} tvec_root_t;
+
+/* Wheel levels */
+static tvec_root_t tv1;
+static tvec_t tv2, tv3, tv4, tv5;
+
+/* Next tick the wheel has not processed yet */
+static uint32_t wheel_ticks = 0;
+
+/* Initialize the timer wheel */
+void ktimer_init(void) {
+    for (int i = 0; i < TVR_SIZE; i++) {
+        list_init(&tv1.vec[i]);
+    }
+    for (int i = 0; i < TVN_SIZE; i++) {
+        list_init(&tv2.vec[i]);
+        list_init(&tv3.vec[i]);
+        list_init(&tv4.vec[i]);
+        list_init(&tv5.vec[i]);
+    }
+    wheel_ticks = timer_ticks;
+}
+
+/* Prepare a timer before first use */
+void init_timer(timer_list_t *timer, void (*function)(uint32_t), uint32_t data) {
+    list_init(&timer->entry);
+    timer->expires = 0;
+    timer->function = function;
+    timer->data = data;
+}
+
+/* Check whether a timer is armed */
+bool timer_pending(const timer_list_t *timer) {
+    return !list_empty(&timer->entry);
+}
+
+/* Place a timer in the slot matching its distance from wheel_ticks */
+static void internal_add_timer(timer_list_t *timer) {
+    uint32_t expires = timer->expires;
+    uint32_t idx = expires - wheel_ticks;
+    list_head_t *vec;
+
+    if ((int32_t)idx < 0) {
+        /* Already due: expire on the next tick processed */
+        vec = &tv1.vec[wheel_ticks & TVR_MASK];
+    } else if (idx < TVR_SIZE) {
+        vec = &tv1.vec[expires & TVR_MASK];
+    } else if (idx < 1U << (TVR_BITS + TVN_BITS)) {
+        vec = &tv2.vec[(expires >> TVR_BITS) & TVN_MASK];
+    } else if (idx < 1U << (TVR_BITS + 2 * TVN_BITS)) {
+        vec = &tv3.vec[(expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK];
+    } else if (idx < 1U << (TVR_BITS + 3 * TVN_BITS)) {
+        vec = &tv4.vec[(expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK];
+    } else {
+        /* Clamp timeouts beyond the wheel range to its last slot */
+        if (idx > 0xFFFFFFFFU >> 1) {
+            expires = wheel_ticks + (0xFFFFFFFFU >> 1);
+            timer->expires = expires;
+        }
+        vec = &tv5.vec[(expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK];
+    }
+
+    list_add_tail(&timer->entry, vec);
+}
+
+/* Arm a timer (must not already be pending) */
+void add_timer(timer_list_t *timer) {
+    bool flags = interrupts_save();
+    internal_add_timer(timer);
+    interrupts_restore(flags);
+}
+
+/* Disarm a timer (returns 1 if it was pending) */
+int del_timer(timer_list_t *timer) {
+    int ret = 0;
+    bool flags = interrupts_save();
+
+    if (timer_pending(timer)) {
+        list_del(&timer->entry);
+        ret = 1;
+    }
+
+    interrupts_restore(flags);
+    return ret;
+}
+
+/* Re-arm a timer with a new expiry (returns 1 if it was pending) */
+int mod_timer(timer_list_t *timer, uint32_t expires) {
+    int ret = 0;
+    bool flags = interrupts_save();
+
+    if (timer_pending(timer)) {
+        list_del(&timer->entry);
+        ret = 1;
+    }
+    timer->expires = expires;
+    internal_add_timer(timer);
+
+    interrupts_restore(flags);
+    return ret;
+}
+
+/* Re-distribute one slot of an upper level into the levels below */
+static uint32_t cascade(tvec_t *tv, uint32_t index) {
+    list_head_t pending;
+    list_head_t *pos, *tmp;
+
+    list_init(&pending);
+    list_splice_tail_init(&tv->vec[index], &pending);
+
+    list_for_each_safe(pos, tmp, &pending) {
+        list_del(pos);
+        internal_add_timer(list_entry(pos, timer_list_t, entry));
+    }
+
+    return index;
+}
+
+#define INDEX(level) ((wheel_ticks >> (TVR_BITS + (level) * TVN_BITS)) & TVN_MASK)
+
+/* Expire due timers (called from the timer interrupt) */
+void run_timers(void) {
+    while (time_after_eq(timer_ticks, wheel_ticks)) {
+        uint32_t index = wheel_ticks & TVR_MASK;
+        list_head_t expired;
+
+        /* Root level wrapped: pull down the next slot of each level above */
+        if (!index &&
+            !cascade(&tv2, INDEX(0)) &&
+            !cascade(&tv3, INDEX(1)) &&
+            !cascade(&tv4, INDEX(2))) {
+            cascade(&tv5, INDEX(3));
+        }
+        wheel_ticks++;
+
+        list_init(&expired);
+        list_splice_tail_init(&tv1.vec[index], &expired);
+
+        while (!list_empty(&expired)) {
+            timer_list_t *timer = list_entry(expired.next, timer_list_t, entry);
+            list_del(&timer->entry);
+            timer->function(timer->data);
+        }
+    }
+}
+
+/* Convert milliseconds to timer ticks (rounding up) */
+uint32_t msecs_to_ticks(uint32_t msecs) {
+    return (msecs / 1000) * TIMER_FREQUENCY +
+           ((msecs % 1000) * TIMER_FREQUENCY + 999) / 1000;
+}
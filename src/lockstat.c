@@ -0,0 +1,134 @@
+/* lockstat.c - Lock contention statistics per lock class
+ *
+ * With collection on, every lock that names a class counts its
+ * acquisitions; one that had to wait also counts a contention and the
+ * cycles it waited, and a release adds the cycles the lock was held.
+ * Classes put themselves on the list the first time they are counted.
+ *
+ * A class's counters are written by whoever holds one of its locks, so
+ * two CPUs holding different locks of one class can race on them: the
+ * figures are statistics, not exact counts.
+ */
+
+#include "../include/lockstat.h"
+#include "../include/cpu.h"
+#include "../include/idt.h"
+#include "../include/math64.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+
+/* Most classes printed */
+#define LOCKSTAT_PRINT_MAX 32
+
+volatile bool lockstat_enabled = false;
+
+/* Classes seen so far (pushed without a lock: locks use this file) */
+static lock_class_t *lockstat_classes = NULL;
+
+/* Put a class on the list once */
+static void lockstat_register(lock_class_t *cls) {
+    if (__sync_lock_test_and_set(&cls->registered, 1)) {
+        return;
+    }
+    do {
+        cls->next = lockstat_classes;
+    } while (!__sync_bool_compare_and_swap(&lockstat_classes, cls->next, cls));
+}
+
+/* Record an acquisition, returning the start of the hold */
+uint64_t lockstat_acquired(lock_class_t *cls, uint64_t wait_start) {
+    uint64_t now = rdtsc();
+
+    if (!cls->registered) {
+        lockstat_register(cls);
+    }
+    if (!lockstat_enabled) {
+        return 0;
+    }
+
+    cls->acquisitions++;
+    if (wait_start) {
+        uint64_t wait = now - wait_start;
+        cls->contentions++;
+        cls->wait_cycles += wait;
+        if (wait > cls->max_wait_cycles) {
+            cls->max_wait_cycles = wait > 0xFFFFFFFFULL ? 0xFFFFFFFF : (uint32_t)wait;
+        }
+    }
+    return now;
+}
+
+/* Record a release */
+void lockstat_released(lock_class_t *cls, uint64_t held_since) {
+    if (!held_since || !lockstat_enabled) {
+        return;
+    }
+
+    uint64_t hold = rdtsc() - held_since;
+    cls->holds++;
+    cls->hold_cycles += hold;
+    if (hold > cls->max_hold_cycles) {
+        cls->max_hold_cycles = hold > 0xFFFFFFFFULL ? 0xFFFFFFFF : (uint32_t)hold;
+    }
+}
+
+/* Turn collection on or off */
+void lockstat_enable(bool on) {
+    lockstat_enabled = on;
+}
+
+/* Clear the counters of every class */
+void lockstat_reset(void) {
+    bool flags = interrupts_save();
+    for (lock_class_t *cls = lockstat_classes; cls; cls = cls->next) {
+        cls->acquisitions = 0;
+        cls->contentions = 0;
+        cls->wait_cycles = 0;
+        cls->holds = 0;
+        cls->hold_cycles = 0;
+        cls->max_wait_cycles = 0;
+        cls->max_hold_cycles = 0;
+    }
+    interrupts_restore(flags);
+}
+
+/* Print the classes seen so far, most waited-on first */
+void lockstat_print(void) {
+    lock_class_t *sorted[LOCKSTAT_PRINT_MAX];
+    uint32_t count = 0;
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Lock statistics (%s) ===\n", lockstat_enabled ? "collecting" : "off");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    /* Insertion sort by total wait, then by acquisitions */
+    for (lock_class_t *cls = lockstat_classes; cls && count < LOCKSTAT_PRINT_MAX; cls = cls->next) {
+        uint32_t i = count++;
+        while (i > 0 && (sorted[i - 1]->wait_cycles < cls->wait_cycles ||
+                         (sorted[i - 1]->wait_cycles == cls->wait_cycles &&
+                          sorted[i - 1]->acquisitions < cls->acquisitions))) {
+            sorted[i] = sorted[i - 1];
+            i--;
+        }
+        sorted[i] = cls;
+    }
+
+    if (count == 0) {
+        printk("No locks taken since collection started ('lockstat on')\n");
+        return;
+    }
+
+    printk("Wait and hold times in cycles (average/maximum)\n");
+    for (uint32_t i = 0; i < count; i++) {
+        lock_class_t *cls = sorted[i];
+        uint32_t wait_avg = cls->contentions ?
+            (uint32_t)div_u64(cls->wait_cycles, cls->contentions) : 0;
+        uint32_t hold_avg = cls->holds ? (uint32_t)div_u64(cls->hold_cycles, cls->holds) : 0;
+        uint32_t pct = cls->acquisitions ?
+            (uint32_t)div_u64((uint64_t)cls->contentions * 100, cls->acquisitions) : 0;
+
+        printk("%s: %u acquired, %u contended (%u%%), wait %u/%u, hold %u/%u\n",
+               cls->name, cls->acquisitions, cls->contentions, pct,
+               wait_avg, cls->max_wait_cycles, hold_avg, cls->max_hold_cycles);
+    }
+}
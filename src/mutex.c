@@ -0,0 +1,99 @@
+/* mutex.c - Sleeping locks for process context
+ *
+ * The lock word is taken with an atomic exchange; a process that finds
+ * it taken sleeps as an exclusive waiter and retries when woken, so each
+ * unlock wakes at most one sleeper. The sleeper queues itself before it
+ * retries, and unlock clears the word before it looks for sleepers, so a
+ * wakeup cannot fall between the two.
+ *
+ * Taking a mutex with interrupts off or from an interrupt handler is a
+ * bug: the holder may be asleep waiting for the disk. It is reported;
+ * process context still sleeps (the interrupt lock follows the CPU, as
+ * for every other sleep with interrupts off), interrupt context spins.
+ */
+
+#include "../include/mutex.h"
+#include "../include/process.h"
+#include "../include/idt.h"
+#include "../include/cpu.h"
+#include "../include/preempt.h"
+#include "../include/softirq.h"
+#include "../include/printf.h"
+
+void mutex_init(mutex_t *mutex, lock_class_t *class) {
+    mutex->locked = 0;
+    mutex->owner = NULL;
+    init_waitqueue_head(&mutex->wait);
+    mutex->class = class;
+    mutex->held_since = 0;
+}
+
+/* One attempt at the lock word */
+static bool mutex_try_acquire(mutex_t *mutex) {
+    return __sync_lock_test_and_set(&mutex->locked, 1) == 0;
+}
+
+/* Take the mutex, sleeping while another process holds it */
+void mutex_lock(mutex_t *mutex) {
+    uint64_t wait_start = 0;
+
+    if (!mutex_try_acquire(mutex)) {
+        if (lockstat_active(mutex->class)) {
+            wait_start = rdtsc();
+        }
+        bool atomic = in_irq() || in_softirq();
+        if (atomic || !interrupts_enabled()) {
+            printk("[MUTEX] %s: mutex_lock %s (caller 0x%x)\n",
+                   mutex->class ? mutex->class->name : "mutex",
+                   atomic ? "in interrupt context" : "with interrupts off",
+                   (uint32_t)__builtin_return_address(0));
+        }
+
+        /* Before the first process there is nobody to sleep, and nobody
+         * else to hold the mutex for long */
+        if (!process_get_current() || atomic) {
+            while (!mutex_try_acquire(mutex)) {
+                cpu_relax();
+            }
+        } else {
+            wait_event_exclusive(mutex->wait, mutex_try_acquire(mutex));
+        }
+    }
+
+    mutex->owner = process_get_current();
+    if (lockstat_active(mutex->class)) {
+        mutex->held_since = lockstat_acquired(mutex->class, wait_start);
+    }
+}
+
+/* Release the mutex and wake one sleeper */
+void mutex_unlock(mutex_t *mutex) {
+    if (mutex->held_since) {
+        lockstat_released(mutex->class, mutex->held_since);
+        mutex->held_since = 0;
+    }
+    mutex->owner = NULL;
+
+    /* XCHG: the store is ordered before the waiter check below */
+    __sync_lock_test_and_set(&mutex->locked, 0);
+    if (waitqueue_active(&mutex->wait)) {
+        wake_up(&mutex->wait);
+    }
+}
+
+/* Take the mutex only if it is free */
+bool mutex_trylock(mutex_t *mutex) {
+    if (!mutex_try_acquire(mutex)) {
+        return false;
+    }
+    mutex->owner = process_get_current();
+    if (lockstat_active(mutex->class)) {
+        mutex->held_since = lockstat_acquired(mutex->class, 0);
+    }
+    return true;
+}
+
+/* Check whether someone holds the mutex */
+bool mutex_is_locked(mutex_t *mutex) {
+    return mutex->locked != 0;
+}
@@ -0,0 +1,272 @@
+/* pagecache.c - Shared frames of read-only executable file pages
+ *
+ * Read-only file-backed pages of exec'd images are looked up here by
+ * (file, offset) before anything is read. Every address space faulting
+ * the same page maps the same frame, marked PAGE_CACHED in its page
+ * table entry; the frame counts its mappings, fork takes another one and
+ * paging_release_frame() drops it. So each extra process running a
+ * binary only pays for its private data, BSS and stack pages.
+ *
+ * A page whose last mapping goes away stays cached on an LRU list so the
+ * next exec of the binary finds it, up to PAGECACHE_MAX_UNMAPPED pages.
+ * Frames are only found and changed with interrupts disabled; a miss
+ * reads into a fresh frame with interrupts enabled and then checks again
+ * whether another process inserted the page meanwhile.
+ */
+
+#include "../include/pagecache.h"
+#include "../include/paging.h"
+#include "../include/kmalloc.h"
+#include "../include/string.h"
+#include "../include/list.h"
+#include "../include/idt.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+
+typedef struct pagecache_page {
+    uint32_t dev;                    /* Filesystem (or read op) of the file */
+    uint32_t ino;                    /* Inode within it */
+    uint32_t offset;                 /* File offset of the page */
+    uint32_t len;                    /* File bytes in the page (rest zero) */
+    uint32_t frame;                  /* Physical frame */
+    uint32_t mapcount;               /* Page table entries mapping the frame */
+    struct pagecache_page *key_next; /* (dev, ino, offset) hash chain */
+    struct pagecache_page *frame_next; /* Frame hash chain */
+    list_head_t lru;                 /* Unmapped pages, oldest first */
+} pagecache_page_t;
+
+static pagecache_page_t *key_hash[PAGECACHE_HASH_SIZE];
+static pagecache_page_t *frame_hash[PAGECACHE_HASH_SIZE];
+static list_head_t unmapped_lru = LIST_HEAD_INIT(unmapped_lru);
+static uint32_t nr_unmapped = 0;
+
+/* Statistics */
+static uint32_t pc_pages = 0;
+static uint32_t pc_hits = 0;
+static uint32_t pc_misses = 0;
+static uint32_t pc_races = 0;
+static uint32_t pc_evictions = 0;
+
+/* Files are told apart by their filesystem, or for in-memory files by
+ * their read operation, plus the inode number */
+static uint32_t pagecache_dev(vfs_node_t *node) {
+    return node->fs ? (uint32_t)node->fs : (uint32_t)node->read;
+}
+
+static uint32_t key_bucket(uint32_t dev, uint32_t ino, uint32_t offset) {
+    return ((dev >> 4) ^ (ino * 31) ^ (offset >> 12)) & (PAGECACHE_HASH_SIZE - 1);
+}
+
+static uint32_t frame_bucket(uint32_t frame) {
+    return (frame >> 12) & (PAGECACHE_HASH_SIZE - 1);
+}
+
+static pagecache_page_t *pagecache_find(uint32_t dev, uint32_t ino, uint32_t offset, uint32_t len) {
+    pagecache_page_t *page = key_hash[key_bucket(dev, ino, offset)];
+    for (; page; page = page->key_next) {
+        if (page->dev == dev && page->ino == ino && page->offset == offset && page->len == len) {
+            return page;
+        }
+    }
+    return NULL;
+}
+
+static pagecache_page_t *pagecache_find_frame(uint32_t frame) {
+    pagecache_page_t *page = frame_hash[frame_bucket(frame)];
+    for (; page; page = page->frame_next) {
+        if (page->frame == frame) {
+            return page;
+        }
+    }
+    return NULL;
+}
+
+/* Unlink a page from both hashes and free it with its frame */
+static void pagecache_remove(pagecache_page_t *page) {
+    pagecache_page_t **link = &key_hash[key_bucket(page->dev, page->ino, page->offset)];
+    while (*link != page) {
+        link = &(*link)->key_next;
+    }
+    *link = page->key_next;
+
+    link = &frame_hash[frame_bucket(page->frame)];
+    while (*link != page) {
+        link = &(*link)->frame_next;
+    }
+    *link = page->frame_next;
+
+    kfree((void *)page->frame);
+    kfree(page);
+    pc_pages--;
+}
+
+/* A mapping appeared: an unmapped page leaves the LRU */
+static void pagecache_map(pagecache_page_t *page) {
+    if (page->mapcount++ == 0 && !list_empty(&page->lru)) {
+        list_del(&page->lru);
+        list_init(&page->lru);
+        nr_unmapped--;
+    }
+}
+
+/* Get the frame holding len bytes of node at offset (zero-filled past
+ * len), reading it in on a miss; takes a mapping reference. Returns the
+ * frame address, or 0 on error. *bytes_read is 0 on a hit. With
+ * can_block, a caller running with interrupts off (the page-fault path)
+ * gets them on for the read and off again before it returns. */
+uint32_t pagecache_get_page(vfs_node_t *node, uint32_t offset, uint32_t len,
+                            bool can_block, uint32_t *bytes_read) {
+    uint32_t dev = pagecache_dev(node);
+    *bytes_read = 0;
+
+    bool flags = interrupts_save();
+    pagecache_page_t *page = pagecache_find(dev, node->inode, offset, len);
+    if (page) {
+        pagecache_map(page);
+        pc_hits++;
+        interrupts_restore(flags);
+        return page->frame;
+    }
+    pc_misses++;
+    interrupts_restore(flags);
+
+    /* Miss: read into a fresh frame (the disk read may sleep) */
+    uint8_t *frame = (uint8_t *)paging_alloc_frame();
+    page = (pagecache_page_t *)kmalloc(sizeof(pagecache_page_t));
+    if (!frame || !page) {
+        kfree(frame);
+        kfree(page);
+        return 0;
+    }
+    memset(frame, 0, PAGE_SIZE);
+
+    if (can_block) {
+        interrupts_enable();
+    }
+    int n = vfs_read(node, offset, len, frame);
+    if (can_block) {
+        interrupts_disable();  /* Back to the fault handler's state, lock included */
+    }
+    if (n < 0) {
+        kfree(frame);
+        kfree(page);
+        return 0;
+    }
+    *bytes_read = (uint32_t)n;
+
+    flags = interrupts_save();
+
+    /* Someone else read the same page while we slept: use theirs */
+    pagecache_page_t *other = pagecache_find(dev, node->inode, offset, len);
+    if (other) {
+        pagecache_map(other);
+        pc_races++;
+        interrupts_restore(flags);
+        kfree(frame);
+        kfree(page);
+        return other->frame;
+    }
+
+    page->dev = dev;
+    page->ino = node->inode;
+    page->offset = offset;
+    page->len = len;
+    page->frame = (uint32_t)frame;
+    page->mapcount = 1;
+    list_init(&page->lru);
+
+    uint32_t bucket = key_bucket(dev, page->ino, offset);
+    page->key_next = key_hash[bucket];
+    key_hash[bucket] = page;
+    bucket = frame_bucket(page->frame);
+    page->frame_next = frame_hash[bucket];
+    frame_hash[bucket] = page;
+    pc_pages++;
+
+    interrupts_restore(flags);
+    return page->frame;
+}
+
+/* Take another mapping reference (fork copies a PAGE_CACHED entry) */
+void pagecache_get(uint32_t frame) {
+    bool flags = interrupts_save();
+    pagecache_page_t *page = pagecache_find_frame(frame);
+    if (page) {
+        pagecache_map(page);
+    }
+    interrupts_restore(flags);
+}
+
+/* Drop a mapping reference; unmapped pages stay cached until evicted */
+void pagecache_put(uint32_t frame) {
+    bool flags = interrupts_save();
+
+    pagecache_page_t *page = pagecache_find_frame(frame);
+    if (page && page->mapcount > 0 && --page->mapcount == 0) {
+        list_add_tail(&page->lru, &unmapped_lru);
+        nr_unmapped++;
+
+        /* Keep only the most recently used unmapped pages */
+        while (nr_unmapped > PAGECACHE_MAX_UNMAPPED) {
+            pagecache_page_t *oldest = list_entry(unmapped_lru.next, pagecache_page_t, lru);
+            list_del(&oldest->lru);
+            nr_unmapped--;
+            pagecache_remove(oldest);
+            pc_evictions++;
+        }
+    }
+
+    interrupts_restore(flags);
+}
+
+/* Forget unmapped pages of a file that is being written (pages still
+ * mapped keep the old contents until their processes exit) */
+void pagecache_invalidate(vfs_node_t *node) {
+    uint32_t dev = pagecache_dev(node);
+    bool flags = interrupts_save();
+
+    list_head_t *pos, *tmp;
+    list_for_each_safe(pos, tmp, &unmapped_lru) {
+        pagecache_page_t *page = list_entry(pos, pagecache_page_t, lru);
+        if (page->dev == dev && page->ino == node->inode) {
+            list_del(&page->lru);
+            nr_unmapped--;
+            pagecache_remove(page);
+        }
+    }
+
+    interrupts_restore(flags);
+}
+
+/* Count mapped pages and the frames that sharing saved */
+static void pagecache_count(uint32_t *mapped, uint32_t *mappings) {
+    *mapped = 0;
+    *mappings = 0;
+    for (int i = 0; i < PAGECACHE_HASH_SIZE; i++) {
+        for (pagecache_page_t *page = key_hash[i]; page; page = page->key_next) {
+            if (page->mapcount) {
+                (*mapped)++;
+                *mappings += page->mapcount;
+            }
+        }
+    }
+}
+
+/* Print hit/miss counts and sharing */
+void pagecache_print_stats(void) {
+    uint32_t mapped, mappings;
+    bool flags = interrupts_save();
+    pagecache_count(&mapped, &mappings);
+    interrupts_restore(flags);
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Page cache ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    printk("Pages %u (%u mapped, %u unmapped of max %u)\n",
+           pc_pages, mapped, nr_unmapped, PAGECACHE_MAX_UNMAPPED);
+    printk("Mappings %u: %u frames (%u KB) saved by sharing\n",
+           mappings, mappings - mapped, (mappings - mapped) * (PAGE_SIZE / 1024));
+    printk("Lookups: %u hits, %u misses (%u lost read races), %u evictions\n",
+           pc_hits, pc_misses, pc_races, pc_evictions);
+}
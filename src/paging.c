@@ -5,6 +5,14 @@
 #include "../include/printf.h"
 #include "../include/string.h"
 #include "../include/kmalloc.h"
+#include "../include/process.h"
+#include "../include/idt.h"
+#include "../include/exec.h"
+#include "../include/pagecache.h"
+#include "../include/cpu.h"
+#include "../include/vdso.h"
+#include "../include/smp.h"
+#include "../include/preempt.h"
 
 /* Kernel page directory (must be page-aligned) */
 static page_directory_t kernel_directory __attribute__((aligned(PAGE_SIZE)));
@@ -13,8 +21,28 @@ static page_directory_t kernel_directory __attribute__((aligned(PAGE_SIZE)));
 static page_table_t kernel_table_0 __attribute__((aligned(PAGE_SIZE)));
 static page_table_t kernel_table_1 __attribute__((aligned(PAGE_SIZE)));
 
-/* Current page directory */
-static page_directory_t *current_directory = NULL;
+/* Kernel MMIO window page tables (top 16MB of the address space) */
+#define MMIO_PDE_FIRST (KERNEL_MMIO_BASE >> 22)
+#define MMIO_PDE_COUNT (KERNEL_MMIO_SIZE >> 22)
+static page_table_t kernel_mmio_tables[MMIO_PDE_COUNT] __attribute__((aligned(PAGE_SIZE)));
+
+/* vDSO page table, right below the MMIO window; shared like it */
+#define VDSO_PDE (VDSO_BASE >> 22)
+static page_table_t kernel_vdso_table __attribute__((aligned(PAGE_SIZE)));
+
+/* Pages handed out from the MMIO window so far */
+static uint32_t mmio_pages_used = 0;
+
+/* Page directory loaded on this CPU */
+#define current_directory (this_cpu()->directory)
+
+static bool paging_is_kernel_pde(uint32_t index);
+
+/* Invalidate a page wherever it may be cached: on every CPU for the
+ * shared kernel tables, else on the CPUs running dir */
+static void paging_flush_page(page_directory_t *dir, uint32_t virt_addr) {
+    smp_flush_tlb_page(paging_is_kernel_pde(virt_addr >> 22) ? NULL : dir, virt_addr);
+}
 
 /* Initialize paging */
 void paging_init(void) {
@@ -43,9 +71,25 @@ void paging_init(void) {
     kernel_directory.entries[0] = ((uint32_t)&kernel_table_0) | PAGE_PRESENT | PAGE_WRITE;
     kernel_directory.entries[1] = ((uint32_t)&kernel_table_1) | PAGE_PRESENT | PAGE_WRITE;
 
+    /* Install the MMIO window tables up front so every directory created
+     * later shares them and sees mappings added after its creation */
+    memset(kernel_mmio_tables, 0, sizeof(kernel_mmio_tables));
+    for (uint32_t i = 0; i < MMIO_PDE_COUNT; i++) {
+        kernel_directory.entries[MMIO_PDE_FIRST + i] =
+            ((uint32_t)&kernel_mmio_tables[i]) | PAGE_PRESENT | PAGE_WRITE;
+    }
+
+    /* Same for the vDSO table; its entries decide what user code may do */
+    memset(&kernel_vdso_table, 0, sizeof(kernel_vdso_table));
+    kernel_directory.entries[VDSO_PDE] =
+        ((uint32_t)&kernel_vdso_table) | PAGE_PRESENT | PAGE_WRITE | PAGE_USER;
+
     /* Set as current directory */
     current_directory = &kernel_directory;
 
+    /* Demand paging of exec'd images goes through the fault handler */
+    idt_register_handler(EXC_PAGE_FAULT, page_fault_handler);
+
     kernel_info("Paging initialized (identity mapped first 8MB)");
 }
 
@@ -62,6 +106,7 @@ void paging_enable(void) {
     uint32_t cr0;
     __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
     cr0 |= 0x80000000; /* Set PG bit */
+    cr0 |= CR0_WP;     /* Read-only (shared) user pages are read-only for ring 0 too */
     __asm__ volatile("mov %0, %%cr0" : : "r"(cr0));
 
     kernel_info("Paging enabled");
@@ -72,6 +117,11 @@ page_directory_t *paging_get_directory(void) {
     return current_directory;
 }
 
+/* Get the kernel page directory (used by tasks without an address space) */
+page_directory_t *paging_get_kernel_directory(void) {
+    return &kernel_directory;
+}
+
 /* Map a virtual address to a physical address */
 void paging_map_page(uint32_t virt_addr, uint32_t phys_addr, uint32_t flags) {
     /* Extract directory and table indices from virtual address */
@@ -113,7 +163,7 @@ void paging_unmap_page(uint32_t virt_addr) {
     table->entries[table_index] = 0;
 
     /* Invalidate TLB entry */
-    __asm__ volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
+    paging_flush_page(current_directory, virt_addr);
 }
 
 /* Get physical address from virtual address */
@@ -140,15 +190,64 @@ uint32_t paging_get_physical_address(uint32_t virt_addr) {
     return (table->entries[table_index] & ~0xFFF) | offset;
 }
 
-/* Page fault handler (called from ISR) */
-void page_fault_handler(void) {
+/* Map a physical MMIO range into the kernel MMIO window (uncached) */
+void *paging_map_mmio(uint32_t phys_addr, uint32_t size) {
+    uint32_t offset = phys_addr & (PAGE_SIZE - 1);
+    uint32_t phys_base = phys_addr & ~(PAGE_SIZE - 1);
+    uint32_t pages = (offset + size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    if (size == 0 || mmio_pages_used + pages > KERNEL_MMIO_SIZE / PAGE_SIZE) {
+        kernel_warning("paging_map_mmio: MMIO window exhausted");
+        return NULL;
+    }
+
+    uint32_t virt_base = KERNEL_MMIO_BASE + mmio_pages_used * PAGE_SIZE;
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t index = mmio_pages_used + i;
+        uint32_t virt = KERNEL_MMIO_BASE + index * PAGE_SIZE;
+        page_table_t *table = &kernel_mmio_tables[index / PAGE_ENTRIES];
+
+        table->entries[index % PAGE_ENTRIES] = (phys_base + i * PAGE_SIZE) |
+            PAGE_PRESENT | PAGE_WRITE | PAGE_NOCACHE | PAGE_WRITETHROUGH;
+        __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
+    }
+    mmio_pages_used += pages;
+
+    return (void *)(virt_base + offset);
+}
+
+/* Map a kernel page read-only for everyone at a vDSO address */
+void paging_map_vdso_page(uint32_t virt_addr, uint32_t phys_addr) {
+    uint32_t table_index = (virt_addr >> 12) & 0x3FF;
+    kernel_vdso_table.entries[table_index] = (phys_addr & ~0xFFF) | PAGE_PRESENT | PAGE_USER;
+    __asm__ volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
+}
+
+/* Check if a directory entry belongs to the shared kernel mappings */
+static bool paging_is_kernel_pde(uint32_t index) {
+    return index < 2 || index >= VDSO_PDE;
+}
+
+/* Page fault handler: fill in file-backed and demand-zero pages of the
+ * current address space, anything else is fatal */
+void page_fault_handler(struct interrupt_frame *frame) {
     /* Get the faulting address from CR2 */
     uint32_t faulting_address;
     __asm__ volatile("mov %%cr2, %0" : "=r"(faulting_address));
 
-    /* Get error code (would be passed as parameter in full implementation) */
-    printk("\nPage fault at address: 0x%x\n", faulting_address);
+    process_t *proc = process_get_current();
+    if (proc) {
+        proc->acct.page_faults++;
 
+        if (!(frame->err_code & PAGE_FAULT_PRESENT) && proc->cold->mm &&
+            vma_fault(proc->cold->mm, faulting_address, frame->err_code,
+                      (frame->eflags & 0x200) != 0) == 0) {
+            return;
+        }
+    }
+
+    printk("\nPage fault at address: 0x%x (error 0x%x, EIP 0x%x)\n",
+           faulting_address, frame->err_code, frame->eip);
     kernel_panic("Page fault");
 }
 
@@ -181,26 +280,106 @@ page_directory_t *paging_create_directory(void) {
     dir->entries[0] = kernel_directory.entries[0];
     dir->entries[1] = kernel_directory.entries[1];
 
+    /* Share the vDSO pages and the kernel MMIO window */
+    for (uint32_t i = VDSO_PDE; i < PAGE_ENTRIES; i++) {
+        dir->entries[i] = kernel_directory.entries[i];
+    }
+
     return dir;
 }
 
+/* Reference counts of MAP_SHARED frames. Private frames have exactly one
+ * mapping; a shared one is freed when its last mapping goes. */
+#define SHARED_FRAMES_MAX 64
+
+static struct {
+    uint32_t phys;
+    uint32_t refs;
+} shared_frames[SHARED_FRAMES_MAX];
+
+/* Register a newly mapped frame as shared (one reference) */
+int paging_share_frame(uint32_t phys) {
+    bool flags = interrupts_save();
+
+    for (uint32_t i = 0; i < SHARED_FRAMES_MAX; i++) {
+        if (!shared_frames[i].refs) {
+            shared_frames[i].phys = phys & ~0xFFF;
+            shared_frames[i].refs = 1;
+            interrupts_restore(flags);
+            return 0;
+        }
+    }
+
+    interrupts_restore(flags);
+    printk("[PAGING] Shared frame table full\n");
+    return -1;
+}
+
+/* Find the slot of a shared frame (-1 if not registered) */
+static int paging_find_shared_frame(uint32_t phys) {
+    for (int i = 0; i < SHARED_FRAMES_MAX; i++) {
+        if (shared_frames[i].refs && shared_frames[i].phys == phys) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Take another reference to a shared frame */
+void paging_shared_frame_get(uint32_t phys) {
+    bool flags = interrupts_save();
+    int slot = paging_find_shared_frame(phys);
+    if (slot >= 0) {
+        shared_frames[slot].refs++;
+    }
+    interrupts_restore(flags);
+}
+
+/* Allocate a page-aligned frame for a user mapping */
+void *paging_alloc_frame(void) {
+    return kmalloc_aligned(PAGE_SIZE, PAGE_SIZE);
+}
+
+/* Free the frame behind a removed page table entry */
+void paging_release_frame(uint32_t entry) {
+    uint32_t phys = entry & ~0xFFF;
+
+    if (entry & PAGE_CACHED) {
+        pagecache_put(phys);
+        return;
+    }
+
+    if (entry & PAGE_SHARED) {
+        bool flags = interrupts_save();
+        int slot = paging_find_shared_frame(phys);
+        bool last = slot < 0 || --shared_frames[slot].refs == 0;
+        interrupts_restore(flags);
+        if (!last) {
+            return;
+        }
+    }
+    kfree((void *)phys);
+}
+
 /* Destroy a page directory and its page tables */
 void paging_destroy_directory(page_directory_t *dir) {
     if (!dir) {
         return;
     }
 
-    /* Free all user page tables (skip kernel tables 0 and 1) */
+    /* Free all user page tables (skip shared kernel tables) */
     for (uint32_t i = 2; i < PAGE_ENTRIES; i++) {
+        if (paging_is_kernel_pde(i)) {
+            continue;
+        }
         if (dir->entries[i] & PAGE_PRESENT) {
             page_table_t *table = (page_table_t *)(dir->entries[i] & ~0xFFF);
 
             /* Free all physical pages in this table */
             for (uint32_t j = 0; j < PAGE_ENTRIES; j++) {
                 if (table->entries[j] & PAGE_PRESENT) {
-                    /* Free the physical page */
-                    void *phys_page = (void *)(table->entries[j] & ~0xFFF);
-                    kfree(phys_page);
+                    /* Free the physical page (shared ones with their last mapping) */
+                    paging_release_frame(table->entries[j]);
                 }
             }
 
@@ -213,6 +392,24 @@ void paging_destroy_directory(page_directory_t *dir) {
     kfree(dir);
 }
 
+/* Count present pages outside the shared kernel mappings */
+uint32_t paging_count_user_pages(page_directory_t *dir) {
+    uint32_t pages = 0;
+
+    for (uint32_t i = 2; i < PAGE_ENTRIES; i++) {
+        if (paging_is_kernel_pde(i) || !(dir->entries[i] & PAGE_PRESENT)) {
+            continue;
+        }
+        page_table_t *table = (page_table_t *)(dir->entries[i] & ~0xFFF);
+        for (uint32_t j = 0; j < PAGE_ENTRIES; j++) {
+            if (table->entries[j] & PAGE_PRESENT) {
+                pages++;
+            }
+        }
+    }
+    return pages;
+}
+
 /* Clone a page directory (for fork) */
 page_directory_t *paging_clone_directory(page_directory_t *src) {
     if (!src) {
@@ -232,8 +429,12 @@ page_directory_t *paging_clone_directory(page_directory_t *src) {
     dst->entries[0] = src->entries[0];
     dst->entries[1] = src->entries[1];
 
-    /* Clone user page tables (skip kernel tables 0 and 1) */
+    /* Clone user page tables (shared kernel tables are copied as-is) */
     for (uint32_t i = 2; i < PAGE_ENTRIES; i++) {
+        if (paging_is_kernel_pde(i)) {
+            dst->entries[i] = src->entries[i];
+            continue;
+        }
         if (src->entries[i] & PAGE_PRESENT) {
             /* Allocate new page table */
             page_table_t *src_table = (page_table_t *)(src->entries[i] & ~0xFFF);
@@ -246,9 +447,19 @@ page_directory_t *paging_clone_directory(page_directory_t *src) {
 
             /* Clone each page in the table */
             for (uint32_t j = 0; j < PAGE_ENTRIES; j++) {
-                if (src_table->entries[j] & PAGE_PRESENT) {
+                if ((src_table->entries[j] & (PAGE_PRESENT | PAGE_SHARED)) ==
+                    (PAGE_PRESENT | PAGE_SHARED)) {
+                    /* MAP_SHARED page: both directories map the same frame */
+                    paging_shared_frame_get(src_table->entries[j] & ~0xFFF);
+                    dst_table->entries[j] = src_table->entries[j];
+                } else if ((src_table->entries[j] & (PAGE_PRESENT | PAGE_CACHED)) ==
+                           (PAGE_PRESENT | PAGE_CACHED)) {
+                    /* Read-only file page: share the page cache frame */
+                    pagecache_get(src_table->entries[j] & ~0xFFF);
+                    dst_table->entries[j] = src_table->entries[j];
+                } else if (src_table->entries[j] & PAGE_PRESENT) {
                     /* Allocate NEW physical page for child */
-                    void *new_phys = kmalloc(PAGE_SIZE);
+                    void *new_phys = paging_alloc_frame();
                     if (!new_phys) {
                         /* Clean up and fail */
                         kfree(dst_table);
@@ -270,6 +481,9 @@ page_directory_t *paging_clone_directory(page_directory_t *src) {
 
             /* Update directory entry */
             dst->entries[i] = ((uint32_t)dst_table) | (src->entries[i] & 0xFFF);
+
+            /* Up to 4 MB copied per table: let a waiting process in */
+            cond_resched();
         }
     }
 
@@ -303,22 +517,64 @@ void paging_map_page_in_directory(page_directory_t *dir, uint32_t virt_addr,
     page_table_t *table = (page_table_t *)(dir->entries[dir_index] & ~0xFFF);
 
     /* Set the page table entry */
+    uint32_t old_entry = table->entries[table_index];
     table->entries[table_index] = (phys_addr & ~0xFFF) | (flags & 0xFFF) | PAGE_PRESENT;
 
-    /* Invalidate TLB entry if this is the current directory */
-    if (dir == current_directory) {
+    /* Invalidate TLB entry: everywhere if a mapping is replaced, a new
+     * one can only be cached here */
+    if (old_entry & PAGE_PRESENT) {
+        paging_flush_page(dir, virt_addr);
+    } else if (dir == current_directory) {
         __asm__ volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
     }
 }
 
+/* Remove a page from a specific directory, returning its old page table
+ * entry (0 if it was not mapped) for paging_release_frame() */
+uint32_t paging_unmap_page_in_directory(page_directory_t *dir, uint32_t virt_addr) {
+    uint32_t dir_index = virt_addr >> 22;
+    uint32_t table_index = (virt_addr >> 12) & 0x3FF;
+
+    if (!dir || !(dir->entries[dir_index] & PAGE_PRESENT)) {
+        return 0;
+    }
+
+    page_table_t *table = (page_table_t *)(dir->entries[dir_index] & ~0xFFF);
+    uint32_t entry = table->entries[table_index];
+    if (!(entry & PAGE_PRESENT)) {
+        return 0;
+    }
+    table->entries[table_index] = 0;
+
+    paging_flush_page(dir, virt_addr);
+    return entry;
+}
+
+/* Directory switch statistics */
+static uint32_t cr3_loads = 0;
+static uint32_t cr3_skips = 0;
+
 /* Switch to a different page directory */
 void paging_switch_directory(page_directory_t *dir) {
     if (!dir) {
         return;
     }
 
+    /* Threads of one process share the directory: keep CR3 and the TLB */
+    if (dir == current_directory) {
+        cr3_skips++;
+        return;
+    }
+
     current_directory = dir;
+    cr3_loads++;
 
     /* Load new page directory into CR3 */
     __asm__ volatile("mov %0, %%cr3" : : "r"(dir) : "memory");
 }
+
+/* Number of CR3 reloads and of switches that kept the directory */
+void paging_get_switch_stats(uint32_t *loads, uint32_t *skips) {
+    *loads = cr3_loads;
+    *skips = cr3_skips;
+}
@@ -4,6 +4,7 @@
 #include "../include/printf.h"
 #include "../include/vga.h"
 #include "../include/string.h"
+#include "../include/smp.h"
 
 /* Clean all general purpose registers before halt */
 void registers_clean(void) {
@@ -159,8 +160,9 @@ void kernel_panic(const char *message) {
 
 /* Kernel panic with register dump */
 void kernel_panic_with_registers(const char *message, struct register_state *regs) {
-    /* Disable interrupts */
+    /* Disable interrupts and halt the other CPUs */
     __asm__ volatile("cli");
+    smp_send_stop();
 
     /* Save stack snapshot */
     struct stack_snapshot stack;
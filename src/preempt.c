@@ -0,0 +1,112 @@
+/* preempt.c - Kernel preemption control
+ *
+ * A reschedule request (need_resched) is acted on at three kinds of
+ * point: on the way out of an interrupt, when the last preempt_disable()
+ * is dropped (every spinlock holds one), and at cond_resched() calls in
+ * long kernel loops. Each first checks the preempt count, so a process
+ * holding a spinlock or running an interrupt handler keeps the CPU and
+ * the switch happens as soon as it lets go.
+ *
+ * The mode only decides whether a wakeup asks for that reschedule: in
+ * low-latency mode the woken process takes over at the next point, in
+ * throughput mode it waits for the running one's time slice to end (an
+ * idle CPU still picks it up at once).
+ */
+
+#include "../include/preempt.h"
+#include "../include/process.h"
+#include "../include/softirq.h"
+#include "../include/idt.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+
+static volatile preempt_mode_t preempt_mode = PREEMPT_MODE_DEFAULT;
+
+bool preemptible(void) {
+    return preempt_count() == 0 && interrupts_enabled() && !in_softirq();
+}
+
+/* Switch out the running process involuntarily */
+static void preempt_schedule(void) {
+    this_cpu()->preemptions++;
+    process_preempt();
+}
+
+void preempt_enable(void) {
+    preempt_enable_no_resched();
+    if (process_need_resched && preemptible()) {
+        preempt_schedule();
+    }
+}
+
+bool cond_resched(void) {
+    if (!process_need_resched || !preemptible()) {
+        return false;
+    }
+    this_cpu()->cond_rescheds++;
+    process_preempt();
+    return true;
+}
+
+/* Interrupts are still disabled here, so only the count and softirq
+ * nesting say whether the interrupted code may be switched out */
+void preempt_irq_return(void) {
+    if (!process_need_resched) {
+        return;
+    }
+    if (preempt_count() != 0 || in_softirq()) {
+        this_cpu()->preempt_deferred++;
+        return;
+    }
+    preempt_schedule();
+}
+
+void preempt_check_schedule(void) {
+    uint32_t count = preempt_count();
+    if (count == 0) {
+        return;
+    }
+
+    /* The count is left alone: process_switch saves it with the process,
+     * so the locks it still holds unwind it when it runs again */
+    cpu_t *cpu = this_cpu();
+    cpu->atomic_schedules++;
+    printk("[PREEMPT] CPU %u: scheduling while atomic (count 0x%x)\n", cpu->id, count);
+}
+
+bool preempt_wakeup_preempts(cpu_t *cpu) {
+    return preempt_mode == PREEMPT_LOWLATENCY || cpu->current == cpu->idle;
+}
+
+void preempt_set_mode(preempt_mode_t mode) {
+    preempt_mode = mode;
+}
+
+preempt_mode_t preempt_get_mode(void) {
+    return preempt_mode;
+}
+
+const char *preempt_mode_name(preempt_mode_t mode) {
+    return mode == PREEMPT_LOWLATENCY ? "lowlatency" : "throughput";
+}
+
+void preempt_print_info(void) {
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Preemption (%s) ===\n", preempt_mode_name(preempt_mode));
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    printk("%s\n", preempt_mode == PREEMPT_LOWLATENCY ?
+           "Wakeups preempt the running process at the next preemption point" :
+           "Wakeups wait for the running process's time slice to end");
+
+    for (uint32_t i = 0; i < smp_online_cpus(); i++) {
+        cpu_t *cpu = smp_cpu(i);
+        printk("CPU %u: %u switches, %u preempted, %u deferred, %u at cond_resched",
+               cpu->id, cpu->switches, cpu->preemptions, cpu->preempt_deferred,
+               cpu->cond_rescheds);
+        if (cpu->atomic_schedules) {
+            printk(", %u while atomic", cpu->atomic_schedules);
+        }
+        printk("\n");
+    }
+}
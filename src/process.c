@@ -6,84 +6,882 @@
 #include "../include/kmalloc.h"
 #include "../include/paging.h"
 #include "../include/panic.h"
+#include "../include/idt.h"
+#include "../include/timer.h"
+#include "../include/workqueue.h"
+#include "../include/fpu.h"
+#include "../include/syscall.h"
+#include "../include/exec.h"
+#include "../include/signal.h"
+#include "../include/math64.h"
+#include "../include/vdso.h"
+#include "../include/uring.h"
+#include "../include/file.h"
+#include "../include/smp.h"
+#include "../include/spinlock.h"
+#include "../include/preempt.h"
+
+/* All live processes (idle excluded), in creation order */
+static list_head_t process_list = LIST_HEAD_INIT(process_list);
+static uint32_t process_nr = 0;
+
+/* PID lookup: hash buckets chained through pid_next, bitmap of used PIDs */
+static process_t *pid_hash[PID_HASH_SIZE];
+static uint32_t pid_bitmap[PID_MAX / 32];
+static uint32_t pid_last = 0;
+
+/* Load average (LOAD_FSHIFT fixed point) and ticks until the next sample */
+static uint32_t avenrun[3] = {0, 0, 0};
+static uint32_t load_countdown = LOAD_FREQ;
+
+/* Released PCBs (with cold data and kernel stack) waiting for reuse */
+static list_head_t pcb_cache = LIST_HEAD_INIT(pcb_cache);
+static uint32_t pcb_cache_nr = 0;
+
+/* Guards process_list, the PID hash and bitmap, and the PCB cache:
+ * lookups and walks read, creation and reaping write. Readers keep
+ * interrupts on, so they overlap on different CPUs instead of queueing
+ * on the interrupt lock. Writers take the interrupt lock inside the
+ * table lock, so nobody may take the table lock with interrupts off:
+ * a CPU spinning for it would hold up every interrupt handler. */
+static lock_class_t process_table_lock_class = LOCK_CLASS_INIT("process_table");
+static rwlock_t process_table_lock = RWLOCK_INIT_CLASS(process_table_lock_class);
+
+/* Process running on this CPU */
+#define current_process (this_cpu()->current)
+
+/* Idle task of the boot CPU: runs when nothing else is READY (not in the
+ * process table); application processors get theirs from process_create_idle */
+static process_t idle_process;
+static process_cold_t idle_cold;
+static sighand_t idle_sighand;
+static fs_struct_t idle_fs;
+static thread_group_t idle_group;
+static uint8_t idle_stack[KERNEL_STACK_SIZE] __attribute__((aligned(16)));
+
+/* Low-level stack switch (switch.s) */
+extern void context_switch(uint32_t *prev_esp, uint32_t next_esp);
+
+static void process_init_idle(void);
+static void process_reap_orphans(work_t *work);
+
+/* Frees orphaned zombies (no parent will ever wait for them) */
+static work_t process_reap_work;
+static void process_timeout(uint32_t data);
+static hrtimer_restart_t process_hrtimer_wakeup(hrtimer_t *timer);
 
-/* Process table */
-static process_t process_table[MAX_PROCESSES];
+/* Initialize process system */
+void process_init(void) {
+    memset(pid_hash, 0, sizeof(pid_hash));
+    memset(pid_bitmap, 0, sizeof(pid_bitmap));
+    pid_bitmap[0] = 1;  /* PID 0 is the idle task */
 
-/* Current running process */
-static process_t *current_process = NULL;
+    process_init_idle();
+    INIT_WORK(&process_reap_work, process_reap_orphans);
 
-/* Next PID to allocate */
-static uint32_t next_pid = 1;
+    kernel_info("Process system initialized");
+}
 
-/* Initialize process system */
-void process_init(void) {
-    /* Clear process table */
-    memset(process_table, 0, sizeof(process_table));
+/* First code run by a new process: enter its entry point, exit on return */
+static void process_start(void) {
+    /* Switched in from the scheduler with interrupts disabled */
+    interrupts_enable();
 
-    /* Mark all processes as unused */
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        process_table[i].state = PROCESS_STATE_UNUSED;
-        process_table[i].pid = 0;
+    if (current_process->thread_fn) {
+        int status = current_process->thread_fn(current_process->thread_data);
+        process_exit(current_process, status);
     }
 
-    kernel_info("Process system initialized");
+    void (*entry)(void) = (void (*)(void))current_process->context.eip;
+    entry();
+
+    process_exit(current_process, 0);
+}
+
+/* Build the initial kernel stack so context_switch() "returns" to process_start */
+static void process_setup_kernel_stack(process_t *proc, uint32_t stack_base) {
+    uint32_t *sp = (uint32_t *)(stack_base + KERNEL_STACK_SIZE);
+
+    *--sp = 0;                          /* Fake return address of process_start */
+    *--sp = (uint32_t)process_start;    /* context_switch return address */
+    *--sp = 0x002;                      /* EFLAGS (interrupts off) */
+    *--sp = 0;                          /* EBP */
+    *--sp = 0;                          /* EBX */
+    *--sp = 0;                          /* ESI */
+    *--sp = 0;                          /* EDI */
+
+    proc->kernel_esp = (uint32_t)sp;
+}
+
+/* Idle loop: sleep until the next interrupt */
+void process_idle(void) {
+    while (1) {
+        interrupts_enable();
+        __asm__ volatile("hlt");
+    }
+}
+
+/* Set up the idle task (needs paging_init for the kernel directory) */
+static void process_init_idle(void) {
+    memset(&idle_process, 0, sizeof(process_t));
+    memset(&idle_cold, 0, sizeof(process_cold_t));
+    idle_process.cold = &idle_cold;
+    list_init(&idle_process.run_list);
+    list_init(&idle_process.tasks);
+
+    /* Static shared resources that are never released */
+    idle_sighand.count = 1;
+    idle_fs.users = 1;
+    strcpy(idle_fs.pwd, "/");
+    idle_group.count = 1;
+    idle_group.nr_threads = 1;
+    list_init(&idle_group.threads);
+    list_add(&idle_process.thread_node, &idle_group.threads);
+    idle_cold.sighand = &idle_sighand;
+    idle_cold.fs = &idle_fs;
+    idle_cold.group = &idle_group;
+    idle_process.pid = 0;
+    idle_process.state = PROCESS_STATE_READY;
+    idle_process.flags = PROCESS_FLAG_KTHREAD;
+    strcpy(idle_process.name, "idle");
+    idle_process.page_directory = paging_get_kernel_directory();
+    idle_process.context.eip = (uint32_t)process_idle;
+    init_timer(&idle_process.sleep_timer, process_timeout, (uint32_t)&idle_process);
+    hrtimer_init(&idle_process.sleep_hrtimer, process_hrtimer_wakeup);
+    init_waitqueue_head(&idle_process.wait_chldexit);
+    process_setup_kernel_stack(&idle_process, (uint32_t)idle_stack);
+    this_cpu()->idle = &idle_process;
+}
+
+/* Idle task of application processor cpu: shares the boot idle task's
+ * resources, and its stack is the one the CPU starts on */
+process_t *process_create_idle(uint32_t cpu) {
+    process_t *idle = (process_t *)kmalloc(sizeof(process_t));
+    uint32_t stack = (uint32_t)kmalloc(KERNEL_STACK_SIZE);
+    if (!idle || !stack) {
+        kfree(idle);
+        kfree((void *)stack);
+        return NULL;
+    }
+
+    memset(idle, 0, sizeof(process_t));
+    idle->cold = &idle_cold;
+    list_init(&idle->run_list);
+    list_init(&idle->tasks);
+    list_init(&idle->thread_node);
+    idle->pid = 0;
+    idle->cpu = cpu;
+    idle->state = PROCESS_STATE_READY;
+    idle->flags = PROCESS_FLAG_KTHREAD;
+    snprintf(idle->name, PROCESS_NAME_LEN, "idle/%u", cpu);
+    idle->page_directory = paging_get_kernel_directory();
+    idle->kernel_stack = stack;
+    idle->context.eip = (uint32_t)process_idle;
+    init_timer(&idle->sleep_timer, process_timeout, (uint32_t)idle);
+    hrtimer_init(&idle->sleep_hrtimer, process_hrtimer_wakeup);
+    init_waitqueue_head(&idle->wait_chldexit);
+    return idle;
+}
+
+/* Free the idle task of a CPU that did not start (it never ran) */
+void process_free_idle(process_t *idle) {
+    kfree((void *)idle->kernel_stack);
+    kfree(idle);
+}
+
+/* Whether proc is running on some CPU (its stack is in use) */
+bool process_on_cpu(process_t *proc) {
+    cpu_t *cpu = smp_cpu(proc->cpu);
+    return cpu && cpu->current == proc;
+}
+
+/* Allocate the next free PID after the last one handed out (0 if none) */
+static uint32_t pid_alloc(void) {
+    uint32_t pid = pid_last + 1;
+
+    for (uint32_t scanned = 0; scanned < PID_MAX; ) {
+        if (pid >= PID_MAX) {
+            pid = 1;
+        }
+
+        uint32_t word = pid_bitmap[pid / 32] | ((1U << (pid % 32)) - 1);
+        if (word != 0xFFFFFFFF) {
+            /* Lowest clear bit at or above pid in this word */
+            uint32_t bit;
+            __asm__("bsf %1, %0" : "=r"(bit) : "r"(~word));
+            pid = (pid & ~31U) + bit;
+            pid_bitmap[pid / 32] |= 1U << (pid % 32);
+            pid_last = pid;
+            return pid;
+        }
+
+        scanned += 32 - (pid % 32);
+        pid = (pid & ~31U) + 32;
+    }
+    return 0;
+}
+
+static void pid_free(uint32_t pid) {
+    pid_bitmap[pid / 32] &= ~(1U << (pid % 32));
+}
+
+static void pid_hash_insert(process_t *proc) {
+    process_t **bucket = &pid_hash[proc->pid & (PID_HASH_SIZE - 1)];
+    proc->pid_next = *bucket;
+    *bucket = proc;
+}
+
+static void pid_hash_remove(process_t *proc) {
+    process_t **link = &pid_hash[proc->pid & (PID_HASH_SIZE - 1)];
+    while (*link && *link != proc) {
+        link = &(*link)->pid_next;
+    }
+    if (*link) {
+        *link = proc->pid_next;
+    }
+}
+
+/* Put a process on the run queue of its CPU (no-op if already there).
+ * Run queue locks nest inside the interrupt lock. */
+static void process_enqueue(process_t *proc) {
+    cpu_t *cpu = smp_cpu(proc->cpu);
+
+    if (proc != cpu->idle && list_empty(&proc->run_list)) {
+        spin_lock(&cpu->rq.lock);
+        list_add_tail(&proc->run_list, &cpu->rq.tasks);
+        cpu->rq.nr_running++;
+        spin_unlock(&cpu->rq.lock);
+        sched_info_queued(proc);
+    }
+}
+
+/* Take a process off its run queue */
+static void process_dequeue(process_t *proc) {
+    if (!list_empty(&proc->run_list)) {
+        runqueue_t *rq = &smp_cpu(proc->cpu)->rq;
+        spin_lock(&rq->lock);
+        list_del(&proc->run_list);
+        rq->nr_running--;
+        spin_unlock(&rq->lock);
+    }
+}
+
+/* A process was queued on a busy CPU: wake an idle one to take it */
+static void process_kick_idle_cpu(uint32_t busy) {
+    for (uint32_t i = 0; i < smp_online_cpus(); i++) {
+        cpu_t *cpu = smp_cpu(i);
+        if (i != busy && cpu->online && cpu->current == cpu->idle &&
+            cpu->rq.nr_running == 0) {
+            cpu->need_resched = true;
+            smp_send_reschedule(i);
+            return;
+        }
+    }
+}
+
+/* Queue a runnable process and make sure some CPU gets to it */
+static void process_enqueue_runnable(process_t *proc) {
+    cpu_t *cpu = smp_cpu(proc->cpu);
+    bool flags = interrupts_save();
+
+    process_enqueue(proc);
+    if (cpu->current != cpu->idle) {
+        process_kick_idle_cpu(proc->cpu);
+    }
+
+    interrupts_restore(flags);
+}
+
+/* ===== Shared Resources (clone) ===== */
+
+/* Allocate an address space around a page directory */
+static mm_t *mm_alloc(page_directory_t *pgd) {
+    mm_t *mm = (mm_t *)kmalloc(sizeof(mm_t));
+    if (!mm) {
+        return NULL;
+    }
+
+    memset(mm, 0, sizeof(mm_t));
+    mm->users = 1;
+    mm->pgd = pgd;
+    mm->stack_next = THREAD_STACK_TOP - 2 * PAGE_SIZE;
+    return mm;
+}
+
+/* Take a reference to an address space */
+void mm_get(mm_t *mm) {
+    bool flags = interrupts_save();
+    mm->users++;
+    interrupts_restore(flags);
+}
+
+/* Drop a reference to an address space; the last user frees it (ring
+ * workers drop theirs with interrupts on, so the count is locked here) */
+void mm_put(mm_t *mm) {
+    if (!mm) {
+        return;
+    }
+
+    bool flags = interrupts_save();
+    bool last = --mm->users == 0;
+    interrupts_restore(flags);
+    if (!last) {
+        return;
+    }
+
+    if (paging_get_directory() == mm->pgd) {
+        paging_switch_directory(paging_get_kernel_directory());
+    }
+    vma_free_all(mm);
+    paging_destroy_directory(mm->pgd);
+    kfree(mm);
+}
+
+/* Map a fresh per-thread stack page below the previous one (the page
+ * above it stays unmapped as a guard); returns its address or 0 */
+static uint32_t mm_alloc_thread_stack(mm_t *mm) {
+    void *page = paging_alloc_frame();
+    if (!page) {
+        return 0;
+    }
+
+    memset(page, 0, PAGE_SIZE);
+    uint32_t virt = mm->stack_next;
+    mm->stack_next -= 2 * PAGE_SIZE;
+    paging_map_page_in_directory(mm->pgd, virt, (uint32_t)page, PAGE_WRITE | PAGE_USER);
+    return virt;
+}
+
+/* Allocate signal handlers, copied from src or all default */
+static sighand_t *sighand_alloc(const sighand_t *src) {
+    sighand_t *sighand = (sighand_t *)kmalloc(sizeof(sighand_t));
+    if (!sighand) {
+        return NULL;
+    }
+
+    if (src) {
+        memcpy(sighand->handlers, src->handlers, sizeof(sighand->handlers));
+        memcpy(sighand->info_handlers, src->info_handlers, sizeof(sighand->info_handlers));
+    } else {
+        memset(sighand->handlers, 0, sizeof(sighand->handlers));
+        memset(sighand->info_handlers, 0, sizeof(sighand->info_handlers));
+    }
+    sighand->count = 1;
+    return sighand;
+}
+
+static void sighand_put(sighand_t *sighand) {
+    if (sighand && --sighand->count == 0) {
+        kfree(sighand);
+    }
+}
+
+/* Allocate a working directory holder */
+static fs_struct_t *fs_alloc(const char *pwd) {
+    fs_struct_t *fs = (fs_struct_t *)kmalloc(sizeof(fs_struct_t));
+    if (!fs) {
+        return NULL;
+    }
+
+    fs->users = 1;
+    strcpy(fs->pwd, pwd);
+    return fs;
+}
+
+static void fs_put(fs_struct_t *fs) {
+    if (fs && --fs->users == 0) {
+        kfree(fs);
+    }
+}
+
+/* Start a new thread group led by proc */
+static thread_group_t *thread_group_alloc(process_t *proc) {
+    thread_group_t *group = (thread_group_t *)kmalloc(sizeof(thread_group_t));
+    if (!group) {
+        return NULL;
+    }
+
+    group->count = 1;
+    group->tgid = proc->pid;
+    group->nr_threads = 1;
+    list_init(&group->threads);
+    list_add_tail(&proc->thread_node, &group->threads);
+    proc->tgid = proc->pid;
+    return group;
+}
+
+/* Add proc to an existing thread group */
+static void thread_group_join(thread_group_t *group, process_t *proc) {
+    bool flags = interrupts_save();
+    group->count++;
+    group->nr_threads++;
+    list_add_tail(&proc->thread_node, &group->threads);
+    proc->tgid = group->tgid;
+    interrupts_restore(flags);
+}
+
+/* Leave the live members of the group (on exit) */
+static void thread_group_exit(process_t *proc) {
+    thread_group_t *group = proc->cold->group;
+    if (group && !list_empty(&proc->thread_node)) {
+        list_del(&proc->thread_node);
+        list_init(&proc->thread_node);
+        group->nr_threads--;
+    }
+}
+
+static void thread_group_put(thread_group_t *group) {
+    if (group && --group->count == 0) {
+        kfree(group);
+    }
+}
+
+/* Give up the address space (unmapping our thread stack from it) */
+static void process_drop_mm(process_t *proc) {
+    mm_t *mm = proc->cold->mm;
+    if (!mm) {
+        return;
+    }
+
+    if (proc->thread_stack) {
+        uint32_t entry = paging_unmap_page_in_directory(mm->pgd, proc->thread_stack);
+        if (entry) {
+            paging_release_frame(entry);
+        }
+        proc->thread_stack = 0;
+    }
+
+    proc->cold->mm = NULL;
+    proc->page_directory = NULL;
+    mm_put(mm);
 }
 
-/* Allocate a new PID */
-static uint32_t process_alloc_pid(void) {
-    return next_pid++;
+/* Let a kernel thread work in a user address space, so that it can
+ * reach (and fault in) that process's buffers; takes a reference */
+void process_use_mm(mm_t *mm) {
+    process_t *proc = current_process;
+    bool flags = interrupts_save();
+    mm_get(mm);
+    proc->cold->mm = mm;
+    proc->page_directory = mm->pgd;
+    paging_switch_directory(mm->pgd);
+    interrupts_restore(flags);
 }
 
-/* Find a free process slot */
+/* Give the borrowed address space back (kernel directory again) */
+void process_unuse_mm(void) {
+    process_t *proc = current_process;
+    bool flags = interrupts_save();
+    mm_t *mm = proc->cold->mm;
+    proc->cold->mm = NULL;
+    proc->page_directory = paging_get_kernel_directory();
+    paging_switch_directory(proc->page_directory);
+    mm_put(mm);
+    interrupts_restore(flags);
+}
+
+/* Let a vfork parent run again (the child exec'd or exited) */
+static void process_vfork_release(process_t *proc) {
+    vfork_done_t *vfork = proc->cold->vfork_done;
+    if (vfork) {
+        proc->cold->vfork_done = NULL;
+        vfork->done = true;
+        wake_up(&vfork->wq);
+    }
+}
+
+/* Fresh signal handlers, working directory "/", descriptors (console
+ * only) and thread group */
+static int process_init_shared(process_t *proc) {
+    proc->cold->sighand = sighand_alloc(NULL);
+    proc->cold->fs = fs_alloc("/");
+    proc->cold->files = files_alloc();
+    proc->cold->group = thread_group_alloc(proc);
+    if (!proc->cold->sighand || !proc->cold->fs || !proc->cold->files || !proc->cold->group) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Drop every shared resource still held (before the PCB is recycled) */
+static void process_release_shared(process_t *proc) {
+    process_cold_t *cold = proc->cold;
+    bool flags = interrupts_save();
+
+    process_drop_mm(proc);
+    thread_group_exit(proc);
+    sighand_put(cold->sighand);
+    fs_put(cold->fs);
+    files_put(cold->files);
+    thread_group_put(cold->group);
+    cold->sighand = NULL;
+    cold->fs = NULL;
+    cold->files = NULL;
+    cold->group = NULL;
+
+    interrupts_restore(flags);
+}
+
+/* Fresh address space for exec (only the kernel mappings) */
+mm_t *process_mm_create(void) {
+    page_directory_t *pgd = paging_create_directory();
+    if (!pgd) {
+        return NULL;
+    }
+
+    mm_t *mm = mm_alloc(pgd);
+    if (!mm) {
+        paging_destroy_directory(pgd);
+    }
+    return mm;
+}
+
+/* Install a new address space in proc (exec): the old one is dropped,
+ * caught signals revert to default and shared handlers are unshared */
+void process_exec_mm(process_t *proc, mm_t *mm) {
+    process_cold_t *cold = proc->cold;
+    bool flags = interrupts_save();
+
+    process_drop_mm(proc);
+    cold->mm = mm;
+    proc->page_directory = mm->pgd;
+    if (proc == current_process) {
+        paging_switch_directory(mm->pgd);
+    }
+    process_vfork_release(proc);
+
+    if (cold->sighand->count > 1) {
+        sighand_t *sighand = sighand_alloc(NULL);
+        if (sighand) {
+            sighand_put(cold->sighand);
+            cold->sighand = sighand;
+        }
+    } else {
+        memset(cold->sighand->handlers, 0, sizeof(cold->sighand->handlers));
+        memset(cold->sighand->info_handlers, 0, sizeof(cold->sighand->info_handlers));
+    }
+
+    interrupts_restore(flags);
+}
+
+/* Enforce the lock order: taking the table lock with interrupts off
+ * could deadlock against a writer (harmless while the boot CPU is alone) */
+static void process_table_check(void *caller) {
+    if (!interrupts_enabled() && smp_online_cpus() > 1) {
+        printk("[PROCESS] process table locked with interrupts off (caller 0x%x)\n",
+               (uint32_t)caller);
+        kernel_panic("Process table lock taken with interrupts disabled");
+    }
+}
+
+static void process_table_read_lock(void) {
+    process_table_check(__builtin_return_address(0));
+    read_lock(&process_table_lock);
+}
+
+static void process_table_read_unlock(void) {
+    read_unlock(&process_table_lock);
+}
+
+/* Writers also change what the scheduler sees: table lock, then the
+ * interrupt lock */
+static bool process_table_write_lock(void) {
+    process_table_check(__builtin_return_address(0));
+    write_lock(&process_table_lock);
+    return interrupts_save();
+}
+
+static void process_table_write_unlock(bool flags) {
+    interrupts_restore(flags);
+    write_unlock(&process_table_lock);
+}
+
+/* Get a zeroed PCB with a PID, cold data and kernel stack (recycled if possible) */
 static process_t *process_alloc_slot(void) {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i].state == PROCESS_STATE_UNUSED) {
-            return &process_table[i];
+    process_t *proc = NULL;
+    process_cold_t *cold = NULL;
+    uint32_t stack = 0;
+    bool flags = process_table_write_lock();
+
+    if (!list_empty(&pcb_cache)) {
+        proc = list_entry(pcb_cache.next, process_t, tasks);
+        list_del(&proc->tasks);
+        pcb_cache_nr--;
+        cold = proc->cold;
+        stack = proc->kernel_stack;
+    }
+    process_table_write_unlock(flags);
+
+    if (!proc) {
+        proc = (process_t *)kmalloc(sizeof(process_t));
+        cold = (process_cold_t *)kmalloc(sizeof(process_cold_t));
+        stack = (uint32_t)kmalloc(KERNEL_STACK_SIZE);
+        if (!proc || !cold || !stack) {
+            kfree(proc);
+            kfree(cold);
+            kfree((void *)stack);
+            return NULL;
         }
     }
-    return NULL;
+
+    memset(proc, 0, sizeof(process_t));
+    memset(cold, 0, sizeof(process_cold_t));
+    proc->cold = cold;
+    proc->kernel_stack = stack;
+    proc->state = PROCESS_STATE_UNUSED;
+    proc->acct.start_ticks = timer_ticks;
+    proc->cpu = smp_processor_id();
+    list_init(&proc->run_list);
+    list_init(&proc->thread_node);
+
+    init_timer(&proc->sleep_timer, process_timeout, (uint32_t)proc);
+    hrtimer_init(&proc->sleep_hrtimer, process_hrtimer_wakeup);
+    init_waitqueue_head(&proc->wait_chldexit);
+
+    flags = process_table_write_lock();
+    proc->pid = pid_alloc();
+    if (proc->pid) {
+        pid_hash_insert(proc);
+        list_add_tail(&proc->tasks, &process_list);
+        process_nr++;
+    }
+    process_table_write_unlock(flags);
+
+    if (!proc->pid) {
+        printk("[PROCESS] Out of PIDs\n");
+        kfree(cold);
+        kfree((void *)stack);
+        kfree(proc);
+        return NULL;
+    }
+    return proc;
+}
+
+/* Unlink a PCB, free its PID and keep it for reuse (or free it) */
+static void process_free_slot(process_t *proc) {
+    process_release_shared(proc);
+
+    bool flags = process_table_write_lock();
+
+    process_dequeue(proc);
+    pid_hash_remove(proc);
+    pid_free(proc->pid);
+    list_del(&proc->tasks);
+    process_nr--;
+    for (uint32_t i = 0; i < smp_online_cpus(); i++) {
+        if (smp_cpu(i)->rq.wakeup_hint == proc) {
+            smp_cpu(i)->rq.wakeup_hint = NULL;
+        }
+    }
+    proc->state = PROCESS_STATE_UNUSED;
+
+    /* A zombie that was current had its stack kept until now */
+    if (proc->kernel_stack && pcb_cache_nr < PCB_CACHE_MAX) {
+        list_add(&proc->tasks, &pcb_cache);
+        pcb_cache_nr++;
+        process_table_write_unlock(flags);
+        return;
+    }
+    process_table_write_unlock(flags);
+
+    kfree((void *)proc->kernel_stack);
+    kfree(proc->cold);
+    kfree(proc);
+}
+
+/* Number of live processes (idle excluded) */
+uint32_t process_count(void) {
+    return process_nr;
+}
+
+/* Visit every process (idle tasks first) with the table read-locked and
+ * interrupts on: fn must not create or free processes, and changes to
+ * fields the scheduler also writes need their own locking */
+void process_for_each(void (*fn)(process_t *proc, void *data), void *data) {
+    list_head_t *pos;
+    process_table_read_lock();
+
+    for (uint32_t i = 0; i < smp_online_cpus(); i++) {
+        if (smp_cpu(i)->idle) {
+            fn(smp_cpu(i)->idle, data);
+        }
+    }
+    list_for_each(pos, &process_list) {
+        fn(list_entry(pos, process_t, tasks), data);
+    }
+
+    process_table_read_unlock();
+}
+
+/* ===== Resource Accounting ===== */
+
+/* Run-queue length: processes READY or RUNNING on any CPU (idle excluded) */
+uint32_t process_nr_running(void) {
+    uint32_t nr = 0;
+    list_head_t *pos;
+    bool flags = interrupts_save();
+
+    for (uint32_t i = 0; i < smp_online_cpus(); i++) {
+        list_for_each(pos, &smp_cpu(i)->rq.tasks) {
+            process_t *proc = list_entry(pos, process_t, run_list);
+            if (proc->state == PROCESS_STATE_READY || proc->state == PROCESS_STATE_RUNNING) {
+                nr++;
+            }
+        }
+    }
+
+    interrupts_restore(flags);
+    return nr;
+}
+
+/* Exponentially decay one load average towards the current run-queue length */
+static uint32_t calc_load(uint32_t load, uint32_t exp, uint32_t active) {
+    return (load * exp + active * (LOAD_FIXED_1 - exp)) >> LOAD_FSHIFT;
+}
+
+/* Timer tick: charge the tick to the current process and sample the load.
+ * cs is the code segment the tick interrupted: ring 3, or ring 0 code of
+ * a process outside any syscall, counts as user time. */
+void process_account_tick(uint32_t cs) {
+    process_t *proc = current_process;
+
+    if (proc) {
+        bool user = (cs & 3) == 3 ||
+                    (!proc->acct.in_syscall && !(proc->flags & PROCESS_FLAG_KTHREAD));
+        if (user) {
+            proc->acct.utime++;
+        } else {
+            proc->acct.stime++;
+        }
+    }
+
+    /* Every CPU ticks; sample the load on one */
+    if (smp_processor_id() == 0 && --load_countdown == 0) {
+        uint32_t active = process_nr_running() * LOAD_FIXED_1;
+        avenrun[0] = calc_load(avenrun[0], LOAD_EXP_1, active);
+        avenrun[1] = calc_load(avenrun[1], LOAD_EXP_5, active);
+        avenrun[2] = calc_load(avenrun[2], LOAD_EXP_15, active);
+        load_countdown = LOAD_FREQ;
+    }
+}
+
+/* Load averages over 1, 5 and 15 minutes (LOAD_FSHIFT fixed point) */
+void process_get_loadavg(uint32_t loadavg[3]) {
+    loadavg[0] = avenrun[0];
+    loadavg[1] = avenrun[1];
+    loadavg[2] = avenrun[2];
+}
+
+/* Syscall entry: count it and charge ticks to system time */
+void process_account_syscall_enter(void) {
+    if (current_process) {
+        current_process->acct.syscalls++;
+        current_process->acct.in_syscall++;
+    }
+}
+
+/* Syscall exit: account transferred bytes */
+void process_account_syscall_exit(uint32_t num, int result) {
+    process_t *proc = current_process;
+    if (!proc) {
+        return;
+    }
+
+    if (proc->acct.in_syscall) {
+        proc->acct.in_syscall--;
+    }
+    if (result > 0) {
+        if (num == SYS_READ || num == SYS_PREAD || num == SYS_READV || num == SYS_RECV) {
+            proc->acct.read_bytes += (uint32_t)result;
+        } else if (num == SYS_WRITE || num == SYS_PWRITE || num == SYS_WRITEV ||
+                   num == SYS_SEND) {
+            proc->acct.write_bytes += (uint32_t)result;
+        }
+    }
+}
+
+/* Resident pages: mapped user pages plus the kernel stack. The directory
+ * is counted under the interrupt lock, which process_drop_mm holds while
+ * it lets go of it (walkers reach here with interrupts on). */
+uint32_t process_rss_pages(process_t *proc) {
+    uint32_t pages = proc->kernel_stack ? KERNEL_STACK_SIZE / PAGE_SIZE : 0;
+
+    bool flags = interrupts_save();
+    if (proc->page_directory && !(proc->flags & PROCESS_FLAG_KTHREAD)) {
+        pages += paging_count_user_pages(proc->page_directory);
+    }
+    interrupts_restore(flags);
+    return pages;
+}
+
+/* One-letter state code as in ps */
+char process_state_char(process_state_t state) {
+    switch (state) {
+        case PROCESS_STATE_RUNNING: return 'R';
+        case PROCESS_STATE_READY:   return 'R';
+        case PROCESS_STATE_BLOCKED: return 'S';
+        case PROCESS_STATE_ZOMBIE:  return 'Z';
+        default:                    return '?';
+    }
+}
+
+/* Format the /proc/<pid>/stat line:
+ * pid (name) state ppid utime stime nvcsw nivcsw faults syscalls
+ * rss_pages read_kb write_kb start_ticks */
+int process_format_stat(process_t *proc, char *buf, size_t size) {
+    return snprintf(buf, size, "%u (%s) %c %u %u %u %u %u %u %u %u %u %u %u\n",
+                    proc->pid, proc->name[0] ? proc->name : "-",
+                    process_state_char(proc->state),
+                    proc->parent ? proc->parent->pid : 0,
+                    proc->acct.utime, proc->acct.stime,
+                    proc->acct.nvcsw, proc->acct.nivcsw,
+                    proc->acct.page_faults, proc->acct.syscalls,
+                    process_rss_pages(proc),
+                    (uint32_t)(proc->acct.read_bytes >> 10),
+                    (uint32_t)(proc->acct.write_bytes >> 10),
+                    proc->acct.start_ticks);
 }
 
 /* Create a new process */
 process_t *process_create(void (*entry_point)(void), uint32_t uid) {
-    /* Allocate a process slot */
+    /* Allocate a PCB (with PID and kernel stack) */
     process_t *proc = process_alloc_slot();
     if (!proc) {
-        return NULL;  /* No free slots */
+        return NULL;  /* No memory or PIDs */
     }
 
     /* Initialize process */
-    memset(proc, 0, sizeof(process_t));
-    proc->pid = process_alloc_pid();
-    proc->state = PROCESS_STATE_READY;
     proc->uid = uid;
     proc->gid = uid;
 
     /* Create page directory for process */
-    proc->page_directory = paging_create_directory();
-    if (!proc->page_directory) {
-        proc->state = PROCESS_STATE_UNUSED;
+    page_directory_t *pgd = paging_create_directory();
+    if (!pgd) {
+        process_free_slot(proc);
         return NULL;
     }
 
-    /* Allocate kernel stack (1 page = 4KB) */
-    proc->kernel_stack = (uint32_t)kmalloc(PAGE_SIZE);
-    if (!proc->kernel_stack) {
-        /* Clean up */
-        paging_destroy_directory(proc->page_directory);
-        proc->state = PROCESS_STATE_UNUSED;
+    /* From here on process_free_slot() releases the directory with the mm */
+    mm_t *mm = mm_alloc(pgd);
+    if (!mm) {
+        paging_destroy_directory(pgd);
+        process_free_slot(proc);
+        return NULL;
+    }
+    proc->cold->mm = mm;
+    proc->page_directory = pgd;
+
+    if (process_init_shared(proc) != 0) {
+        process_free_slot(proc);
         return NULL;
     }
 
     /* Allocate user stack in virtual memory (at high address) */
     /* Map user stack at 0x10000000 (256MB) - this is where the error occurs! */
-    uint32_t user_stack_virt = 0x10000000;
-    uint32_t user_stack_phys = (uint32_t)kmalloc(PAGE_SIZE);
+    uint32_t user_stack_virt = USER_STACK_BASE;
+    uint32_t user_stack_phys = (uint32_t)paging_alloc_frame();
     if (!user_stack_phys) {
-        kfree((void *)proc->kernel_stack);
-        paging_destroy_directory(proc->page_directory);
-        proc->state = PROCESS_STATE_UNUSED;
+        process_free_slot(proc);
         return NULL;
     }
 
@@ -95,28 +893,28 @@ process_t *process_create(void (*entry_point)(void), uint32_t uid) {
 
     /* Initialize process memory sections (KFS-5 Bonus) */
     /* .text section - executable code (Linux standard: 0x08048000) */
-    proc->text_section.start_addr = 0x08048000;
-    proc->text_section.size = 0;  /* Will be set when loading binary */
-    proc->text_section.flags = SECTION_READ | SECTION_EXEC;
+    mm->text_section.start_addr = 0x08048000;
+    mm->text_section.size = 0;  /* Will be set when loading binary */
+    mm->text_section.flags = SECTION_READ | SECTION_EXEC;
 
     /* .rodata section - read-only data */
-    proc->rodata_section.start_addr = 0x08050000;
-    proc->rodata_section.size = 0;
-    proc->rodata_section.flags = SECTION_READ;
+    mm->rodata_section.start_addr = 0x08050000;
+    mm->rodata_section.size = 0;
+    mm->rodata_section.flags = SECTION_READ;
 
     /* .data section - initialized data */
-    proc->data_section.start_addr = 0x08060000;
-    proc->data_section.size = 0;
-    proc->data_section.flags = SECTION_READ | SECTION_WRITE;
+    mm->data_section.start_addr = 0x08060000;
+    mm->data_section.size = 0;
+    mm->data_section.flags = SECTION_READ | SECTION_WRITE;
 
     /* .bss section - uninitialized data */
-    proc->bss_section.start_addr = 0x08070000;
-    proc->bss_section.size = 0;
-    proc->bss_section.flags = SECTION_READ | SECTION_WRITE;
+    mm->bss_section.start_addr = 0x08070000;
+    mm->bss_section.size = 0;
+    mm->bss_section.flags = SECTION_READ | SECTION_WRITE;
 
     /* Heap - dynamic memory allocation */
-    proc->heap_start = 0x08080000;
-    proc->heap_end = proc->heap_start;  /* Empty heap initially */
+    mm->heap_start = 0x08080000;
+    mm->heap_end = mm->heap_start;  /* Empty heap initially */
 
     /* Initialize context */
     proc->context.eip = (uint32_t)entry_point;
@@ -124,64 +922,252 @@ process_t *process_create(void (*entry_point)(void), uint32_t uid) {
     proc->context.ebp = proc->user_stack;
     proc->context.eflags = 0x202;  /* IF flag set */
 
-    /* Initialize signal handlers to default */
-    for (int i = 0; i < 32; i++) {
-        proc->signal_handlers[i] = NULL;
+    /* Initial kernel stack frame, then make it runnable */
+    process_setup_kernel_stack(proc, proc->kernel_stack);
+    proc->state = PROCESS_STATE_READY;
+    process_enqueue_runnable(proc);
+
+    return proc;
+}
+
+/* Create a kernel-only process running fn(data) in the kernel address space */
+process_t *process_create_kernel(int (*fn)(void *data), void *data, const char *name) {
+    process_t *proc = process_alloc_slot();
+    if (!proc) {
+        return NULL;
+    }
+
+    if (process_init_shared(proc) != 0) {
+        process_free_slot(proc);
+        return NULL;
+    }
+
+    proc->flags = PROCESS_FLAG_KTHREAD;
+    process_set_name(proc, name);
+    proc->page_directory = paging_get_kernel_directory();
+    proc->thread_fn = fn;
+    proc->thread_data = data;
+    process_setup_kernel_stack(proc, proc->kernel_stack);
+
+    /* Becomes visible to the scheduler last */
+    proc->state = PROCESS_STATE_READY;
+    process_enqueue_runnable(proc);
+    return proc;
+}
+
+/* Create a child of parent running fn(arg) in a ready-made address space
+ * (spawn): nothing is copied but the identity, working directory and
+ * descriptors. Takes over mm, which is released if the process cannot
+ * be created. */
+process_t *process_spawn(process_t *parent, mm_t *mm, int (*fn)(void *arg), void *arg,
+                         const char *name) {
+    process_t *proc = process_alloc_slot();
+    if (!proc) {
+        mm_put(mm);
+        return NULL;
+    }
+
+    /* From here on process_free_slot() releases the mm */
+    process_cold_t *cold = proc->cold;
+    cold->mm = mm;
+    proc->page_directory = mm->pgd;
+    cold->sighand = sighand_alloc(NULL);
+    cold->fs = fs_alloc(parent->cold->fs->pwd);
+    cold->files = files_copy(parent->cold->files);
+    cold->group = thread_group_alloc(proc);
+    if (!cold->sighand || !cold->fs || !cold->files || !cold->group) {
+        process_free_slot(proc);
+        return NULL;
     }
-    proc->signal_queue = NULL;
 
-    /* Initialize current working directory (KFS-6) */
-    strcpy(proc->pwd, "/");
+    proc->uid = parent->uid;
+    proc->gid = parent->gid;
+    process_set_name(proc, name);
+    proc->thread_fn = fn;
+    proc->thread_data = arg;
+    process_setup_kernel_stack(proc, proc->kernel_stack);
+
+    bool flags = interrupts_save();
+    proc->parent = parent;
+    proc->next_sibling = parent->children;
+    parent->children = proc;
+    proc->state = PROCESS_STATE_READY;
+    process_enqueue_runnable(proc);
+    interrupts_restore(flags);
 
     return proc;
 }
 
+/* Set the short name shown in process listings */
+void process_set_name(process_t *proc, const char *name) {
+    if (!proc || !name) {
+        return;
+    }
+    strncpy(proc->name, name, PROCESS_NAME_LEN - 1);
+    proc->name[PROCESS_NAME_LEN - 1] = '\0';
+}
+
 /* Fork a process (copy parent) */
 process_t *process_fork(process_t *parent) {
+    return process_clone(parent, 0, NULL, NULL, 0);
+}
+
+/* Create a child of parent sharing the resources selected by CLONE_*
+ * flags and copying the rest. With fn the child runs fn(arg) on the given
+ * stack (or, sharing the address space, a new per-thread stack page);
+ * without it the child restarts at the parent's entry point like fork.
+ * With CLONE_VFORK the calling parent sleeps until the child execs or
+ * exits, so the child can use the parent's stack and nothing is copied. */
+process_t *process_clone(process_t *parent, uint32_t flags,
+                         int (*fn)(void *arg), void *arg, uint32_t stack) {
     if (!parent) {
         return NULL;
     }
 
-    /* Allocate a process slot */
+    /* Shared handlers need a shared address space, threads shared handlers */
+    if ((flags & CLONE_SIGHAND) && !(flags & CLONE_VM)) {
+        return NULL;
+    }
+    if ((flags & CLONE_THREAD) && !(flags & CLONE_SIGHAND)) {
+        return NULL;
+    }
+
+    /* Allocate a PCB (with PID and kernel stack) */
     process_t *child = process_alloc_slot();
     if (!child) {
         return NULL;
     }
 
-    /* Copy parent process */
-    memcpy(child, parent, sizeof(process_t));
+    process_cold_t *pcold = parent->cold;
+    process_cold_t *ccold = child->cold;
+
+    /* Copy the parent's identity and context */
+    child->flags = parent->flags;
+    memcpy(child->name, parent->name, PROCESS_NAME_LEN);
+    child->context = parent->context;
+    child->user_stack = parent->user_stack;
+    child->uid = parent->uid;
+    child->gid = parent->gid;
+    child->thread_fn = fn ? fn : parent->thread_fn;
+    child->thread_data = fn ? arg : parent->thread_data;
+
+    /* Address space: share it, or copy it (copy-on-write would be better) */
+    if (flags & CLONE_VM) {
+        ccold->mm = pcold->mm;
+        if (ccold->mm) {
+            mm_get(ccold->mm);
+        }
+        child->page_directory = parent->page_directory;
+    } else {
+        page_directory_t *pgd = paging_clone_directory(parent->page_directory);
+        mm_t *mm = pgd ? mm_alloc(pgd) : NULL;
+        if (!mm) {
+            if (pgd) {
+                paging_destroy_directory(pgd);
+            }
+            process_free_slot(child);
+            return NULL;
+        }
+        if (pcold->mm) {
+            *mm = *pcold->mm;
+            mm->users = 1;
+            mm->pgd = pgd;
+            mm->vmas = NULL;
+        }
+        ccold->mm = mm;
+        child->page_directory = pgd;
+        if (pcold->mm && vma_dup(mm, pcold->mm) != 0) {
+            process_free_slot(child);
+            return NULL;
+        }
+    }
 
-    /* Give child a new PID */
-    child->pid = process_alloc_pid();
-    child->state = PROCESS_STATE_READY;
+    /* Stack of the new thread */
+    if (stack) {
+        child->user_stack = stack;
+    } else if (fn && (flags & CLONE_VM) && !(flags & CLONE_VFORK) && ccold->mm) {
+        child->thread_stack = mm_alloc_thread_stack(ccold->mm);
+        if (!child->thread_stack) {
+            process_free_slot(child);
+            return NULL;
+        }
+        child->user_stack = child->thread_stack + PAGE_SIZE - 4;
+    }
+    child->context.esp = child->user_stack;
+    child->context.ebp = child->user_stack;
+
+    /* Signal handlers, working directory and descriptors */
+    if (flags & CLONE_SIGHAND) {
+        ccold->sighand = pcold->sighand;
+        ccold->sighand->count++;
+    } else {
+        ccold->sighand = sighand_alloc(pcold->sighand);
+    }
+    if (flags & CLONE_FS) {
+        ccold->fs = pcold->fs;
+        ccold->fs->users++;
+    } else {
+        ccold->fs = fs_alloc(pcold->fs->pwd);
+    }
+    if (flags & CLONE_FILES) {
+        ccold->files = pcold->files;
+        files_get(ccold->files);
+    } else {
+        ccold->files = files_copy(pcold->files);
+    }
 
-    /* Set parent-child relationship */
-    child->parent = parent;
-    child->children = NULL;
-    child->next_sibling = parent->children;
-    parent->children = child;
+    /* A thread joins the caller's group, anything else leads a new one */
+    if (flags & CLONE_THREAD) {
+        ccold->group = pcold->group;
+        thread_group_join(ccold->group, child);
+    } else {
+        ccold->group = thread_group_alloc(child);
+    }
 
-    /* Create a new page directory (copy-on-write would be better, but simple copy for now) */
-    child->page_directory = paging_clone_directory(parent->page_directory);
-    if (!child->page_directory) {
-        child->state = PROCESS_STATE_UNUSED;
+    if (!ccold->sighand || !ccold->fs || !ccold->files || !ccold->group) {
+        process_free_slot(child);
         return NULL;
     }
 
-    /* Allocate new kernel stack */
-    child->kernel_stack = (uint32_t)kmalloc(PAGE_SIZE);
-    if (!child->kernel_stack) {
-        paging_destroy_directory(child->page_directory);
-        child->state = PROCESS_STATE_UNUSED;
+    /* The child continues with a copy of the parent's FPU/SSE registers */
+    if (fpu_fork(child, parent) != 0) {
+        process_free_slot(child);
         return NULL;
     }
 
-    /* Copy kernel stack contents */
-    memcpy((void *)child->kernel_stack, (void *)parent->kernel_stack, PAGE_SIZE);
+    /* Processes run in kernel mode, so the parent's kernel stack frames
+     * point into the parent's own stack and cannot be reused: the child
+     * starts over at its entry point with a fresh stack. */
+    process_setup_kernel_stack(child, child->kernel_stack);
 
     /* Child gets return value 0, parent gets child PID */
     child->context.eax = 0;
 
+    /* The vfork completion lives on our stack until the child lets go */
+    vfork_done_t vfork;
+    bool vfork_wait = (flags & CLONE_VFORK) && parent == current_process;
+    if (vfork_wait) {
+        vfork.done = false;
+        init_waitqueue_head(&vfork.wq);
+        ccold->vfork_done = &vfork;
+    }
+
+    /* Threads are not children: nobody waits for them, they are reaped
+     * when they exit. Anything else becomes a child of the caller. */
+    bool irq = interrupts_save();
+    if (!(flags & CLONE_THREAD)) {
+        child->parent = parent;
+        child->next_sibling = parent->children;
+        parent->children = child;
+    }
+    child->state = PROCESS_STATE_READY;
+    process_enqueue_runnable(child);
+    interrupts_restore(irq);
+
+    if (vfork_wait) {
+        wait_event(vfork.wq, vfork.done);
+    }
+
     return child;
 }
 
@@ -191,41 +1177,131 @@ void process_exit(process_t *proc, int status) {
         return;
     }
 
+    /* Submission rings it set up go away with it, and so do its
+     * descriptors (the last thread sharing the table closes the files).
+     * Before interrupts go off: closing a socket takes the socket table
+     * mutex, whose holder may be asleep on a page fault. */
+    uring_exit_task(proc);
+    files_put(proc->cold->files);
+    proc->cold->files = NULL;
+
+    bool flags = interrupts_save();
+
+    /* A sleeping process must not be woken after it is gone */
+    del_timer(&proc->sleep_timer);
+    hrtimer_cancel(&proc->sleep_hrtimer);
+
     proc->exit_status = status;
     proc->state = PROCESS_STATE_ZOMBIE;
+    process_dequeue(proc);
 
-    /* Free resources (but keep PCB for parent to read exit status) */
-    if (proc->page_directory) {
-        paging_destroy_directory(proc->page_directory);
-        proc->page_directory = NULL;
-    }
+    /* Its FPU registers will never be restored */
+    fpu_release(proc);
 
-    if (proc->kernel_stack) {
-        kfree((void *)proc->kernel_stack);
-        proc->kernel_stack = 0;
-    }
+    /* Free resources (but keep PCB for parent to read exit status): the
+     * last thread using the address space frees it; kernel threads borrow
+     * the kernel directory, which stays */
+    process_drop_mm(proc);
+    thread_group_exit(proc);
+    process_vfork_release(proc);
+
+    /* The kernel stack stays with the PCB until it is reaped: the running
+     * process is still on it, and released PCBs keep theirs for reuse */
 
     /* Orphan children - reparent to init (PID 1) */
     process_t *child = proc->children;
     while (child) {
         process_t *next = child->next_sibling;
         child->parent = NULL;  /* Or reparent to init */
+        if (child->state == PROCESS_STATE_ZOMBIE) {
+            schedule_work(&process_reap_work);
+        }
         child = next;
     }
 
+    /* Let a parent blocked in process_wait() collect the exit status,
+     * or have a worker free the slot once this process is switched out */
+    if (proc->parent) {
+        wake_up_all(&proc->parent->wait_chldexit);
+    } else {
+        schedule_work(&process_reap_work);
+    }
+
     printk("[PROCESS] Process %d exited with status %d\n", proc->pid, status);
+
+    if (proc == current_process) {
+        process_schedule();
+        kernel_panic("Zombie process was scheduled");
+    }
+
+    interrupts_restore(flags);
+}
+
+/* Release the PCB and kernel stack of a zombie */
+static void process_release(process_t *proc) {
+    process_free_slot(proc);
+}
+
+/* Find an orphaned zombie that is off every CPU (NULL if none) */
+static process_t *process_find_orphan(void) {
+    list_head_t *pos;
+    process_t *found = NULL;
+
+    process_table_read_lock();
+    list_for_each(pos, &process_list) {
+        process_t *proc = list_entry(pos, process_t, tasks);
+        if (proc->state == PROCESS_STATE_ZOMBIE && !proc->parent) {
+            /* Still switching out on another CPU: try again later */
+            if (process_on_cpu(proc)) {
+                schedule_work(&process_reap_work);
+                continue;
+            }
+            found = proc;
+            break;
+        }
+    }
+    process_table_read_unlock();
+    return found;
+}
+
+/* Workqueue item: free zombies nobody can wait for. Releasing write-locks
+ * the table, so each victim is found under the read lock and freed after
+ * it is dropped; this worker is the only one freeing orphans. */
+static void process_reap_orphans(work_t *work) {
+    (void)work;
+    process_t *proc;
+
+    while ((proc = process_find_orphan())) {
+        process_release(proc);
+    }
+}
+
+/* Find a zombie child that is off every CPU (NULL if none) */
+static process_t *process_find_zombie_child(process_t *parent) {
+    for (process_t *child = parent->children; child; child = child->next_sibling) {
+        if (child->state == PROCESS_STATE_ZOMBIE && !process_on_cpu(child)) {
+            return child;
+        }
+    }
+    return NULL;
 }
 
-/* Wait for a child process */
+/* Wait for a child process (blocks until one exits) */
 int process_wait(process_t *parent, int *status) {
     if (!parent) {
         return -1;
     }
 
+    /* Sleep until a child becomes a zombie; fail if there are no children */
+    if (parent == current_process) {
+        wait_event(parent->wait_chldexit,
+                   !parent->children || process_find_zombie_child(parent));
+    }
+
     /* Find a zombie child */
     process_t *child = parent->children;
     while (child) {
-        if (child->state == PROCESS_STATE_ZOMBIE) {
+        if (child->state == PROCESS_STATE_ZOMBIE && !process_on_cpu(child)) {
             /* Found a zombie child */
             uint32_t pid = child->pid;
             if (status) {
@@ -242,7 +1318,7 @@ int process_wait(process_t *parent, int *status) {
             }
 
             /* Free the process slot */
-            child->state = PROCESS_STATE_UNUSED;
+            process_release(child);
             return pid;
         }
         child = child->next_sibling;
@@ -267,13 +1343,23 @@ process_t *process_get_current(void) {
 
 /* Get process by PID */
 process_t *process_get_by_pid(uint32_t pid) {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i].state != PROCESS_STATE_UNUSED &&
-            process_table[i].pid == pid) {
-            return &process_table[i];
-        }
+    process_table_read_lock();
+    process_t *proc = pid_hash[pid & (PID_HASH_SIZE - 1)];
+    while (proc && proc->pid != pid) {
+        proc = proc->pid_next;
     }
-    return NULL;
+    process_table_read_unlock();
+    return proc;
+}
+
+/* Change a process's UID (and the vDSO copy if it is running) */
+void process_set_uid(process_t *proc, uint32_t uid) {
+    bool flags = interrupts_save();
+    proc->uid = uid;
+    if (proc == current_process) {
+        vdso_update_task(proc->tgid, proc->pid, proc->uid);
+    }
+    interrupts_restore(flags);
 }
 
 /* Get current UID */
@@ -284,52 +1370,133 @@ uint32_t process_get_current_uid(void) {
     return 0;  /* Root */
 }
 
+/* Signal delivery counters */
+static process_signal_stats_t signal_stats;
+
 /* Register a signal handler */
 int process_signal_register(process_t *proc, int signal, process_signal_handler_t handler) {
     if (!proc || signal < 0 || signal >= 32) {
         return -1;
     }
 
-    proc->signal_handlers[signal] = handler;
+    proc->cold->sighand->handlers[signal] = handler;
+    proc->cold->sighand->info_handlers[signal] = NULL;
     return 0;
 }
 
-/* Send a signal to a process (queue it) */
+/* Register a handler that also receives the value of a queued signal */
+int process_signal_register_info(process_t *proc, int signal, process_siginfo_handler_t handler) {
+    if (!proc || signal < 0 || signal >= 32) {
+        return -1;
+    }
+
+    proc->cold->sighand->handlers[signal] = NULL;
+    proc->cold->sighand->info_handlers[signal] = handler;
+    return 0;
+}
+
+/* Send a signal to a process: standard signals set their pending bit
+ * (sending one that is already pending delivers it once), real-time
+ * signals are queued with value 0 */
 int process_signal_send(process_t *proc, int signal) {
+    if (signal >= SIGRTMIN && signal <= SIGRTMAX) {
+        return process_signal_queue(proc, signal, 0);
+    }
     if (!proc || signal < 0 || signal >= 32) {
         return -1;
     }
 
-    /* Allocate signal queue entry */
-    signal_queue_entry_t *entry = (signal_queue_entry_t *)kmalloc(sizeof(signal_queue_entry_t));
-    if (!entry) {
+    uint32_t bit = 1u << signal;
+    bool flags = interrupts_save();
+    if (proc->signal_pending & bit) {
+        signal_stats.coalesced++;
+    } else {
+        proc->signal_pending |= bit;
+        signal_stats.sent++;
+    }
+    interrupts_restore(flags);
+    return 0;
+}
+
+/* Queue a real-time signal with a value; every queued instance is
+ * delivered, in order. Fails when the process's queue is full. */
+int process_signal_queue(process_t *proc, int signal, uint32_t value) {
+    if (!proc || signal < SIGRTMIN || signal > SIGRTMAX) {
         return -1;
     }
 
-    entry->signal = signal;
-    entry->next = proc->signal_queue;
-    proc->signal_queue = entry;
+    bool flags = interrupts_save();
+    process_cold_t *cold = proc->cold;
+    if (cold->sigqueue_len == PROCESS_SIGQUEUE_MAX) {
+        signal_stats.overflows++;
+        interrupts_restore(flags);
+        return -1;
+    }
 
+    cold->sigqueue[cold->sigqueue_len].signal = (uint8_t)signal;
+    cold->sigqueue[cold->sigqueue_len].value = value;
+    cold->sigqueue_len++;
+    proc->signal_pending |= 1u << signal;
+    signal_stats.sent++;
+    signal_stats.queued++;
+    interrupts_restore(flags);
     return 0;
 }
 
+/* Take the lowest-numbered pending signal, with the oldest queued value
+ * of a real-time signal. Returns -1 if nothing is pending. */
+static int signal_dequeue(process_t *proc, uint32_t *value) {
+    bool flags = interrupts_save();
+    uint32_t pending = proc->signal_pending;
+    if (!pending) {
+        interrupts_restore(flags);
+        return -1;
+    }
+
+    int signal = (int)ffs_u32(pending);
+    bool more = false;
+    *value = 0;
+
+    if (signal >= SIGRTMIN) {
+        process_cold_t *cold = proc->cold;
+        uint32_t i = 0;
+        while (cold->sigqueue[i].signal != signal) {
+            i++;
+        }
+        *value = cold->sigqueue[i].value;
+        cold->sigqueue_len--;
+        for (; i < cold->sigqueue_len; i++) {
+            cold->sigqueue[i] = cold->sigqueue[i + 1];
+            if (cold->sigqueue[i].signal == signal) {
+                more = true;
+            }
+        }
+    }
+    if (!more) {
+        proc->signal_pending &= ~(1u << signal);
+    }
+
+    interrupts_restore(flags);
+    return signal;
+}
+
 /* Process pending signals for a process */
 void process_signal_process(process_t *proc) {
     if (!proc) {
         return;
     }
 
-    /* Process all queued signals */
-    while (proc->signal_queue) {
-        signal_queue_entry_t *entry = proc->signal_queue;
-        proc->signal_queue = entry->next;
-
-        int signal = entry->signal;
-        kfree(entry);
+    int signal;
+    uint32_t value;
+    while ((signal = signal_dequeue(proc, &value)) >= 0) {
+        sighand_t *sighand = proc->cold->sighand;
+        signal_stats.delivered++;
 
         /* Call handler if registered */
-        if (proc->signal_handlers[signal]) {
-            proc->signal_handlers[signal](signal);
+        if (sighand->info_handlers[signal]) {
+            sighand->info_handlers[signal](signal, value);
+        } else if (sighand->handlers[signal]) {
+            sighand->handlers[signal](signal);
         } else {
             /* Default action */
             printk("[SIGNAL] Process %d received signal %d (no handler)\n",
@@ -338,6 +1505,13 @@ void process_signal_process(process_t *proc) {
     }
 }
 
+/* Snapshot of the signal delivery counters */
+void process_signal_get_stats(process_signal_stats_t *stats) {
+    bool flags = interrupts_save();
+    *stats = signal_stats;
+    interrupts_restore(flags);
+}
+
 /* ===== System Calls ===== */
 
 /* sys_fork - Fork the current process */
@@ -358,6 +1532,54 @@ int sys_fork(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unus
     return child->pid;
 }
 
+/* sys_clone - Create a thread or process sharing the resources in flags,
+ * starting in fn(arg) on stack (0 = allocate a per-thread stack) */
+int sys_clone(uint32_t flags, uint32_t fn, uint32_t arg, uint32_t stack, uint32_t unused) {
+    (void)unused;
+
+    process_t *parent = process_get_current();
+    if (!parent || !fn) {
+        return -1;
+    }
+
+    process_t *child = process_clone(parent, flags, (int (*)(void *))fn, (void *)arg, stack);
+    if (!child) {
+        return -1;
+    }
+    return child->pid;
+}
+
+/* sys_vfork - Start fn(arg) (or restart at our entry point) in our
+ * address space, sleeping until the child execs or exits */
+int sys_vfork(uint32_t fn, uint32_t arg, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
+    (void)unused1; (void)unused2; (void)unused3;
+
+    process_t *parent = process_get_current();
+    if (!parent) {
+        return -1;
+    }
+
+    process_t *child = process_clone(parent, CLONE_VM | CLONE_VFORK,
+                                     (int (*)(void *))fn, (void *)arg, 0);
+    return child ? (int)child->pid : -1;
+}
+
+/* sys_getpid - Thread group ID (shared by all threads of a process) */
+int sys_getpid(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5) {
+    (void)unused1; (void)unused2; (void)unused3; (void)unused4; (void)unused5;
+
+    process_t *proc = process_get_current();
+    return proc ? (int)proc->tgid : -1;
+}
+
+/* sys_gettid - ID of the calling thread */
+int sys_gettid(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5) {
+    (void)unused1; (void)unused2; (void)unused3; (void)unused4; (void)unused5;
+
+    process_t *proc = process_get_current();
+    return proc ? (int)proc->pid : -1;
+}
+
 /* sys_wait - Wait for a child process */
 int sys_wait(uint32_t status_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
     (void)unused1; (void)unused2; (void)unused3; (void)unused4;
@@ -395,7 +1617,7 @@ int sys_kill(uint32_t pid, uint32_t signal, uint32_t unused1, uint32_t unused2,
 
 /* process_mmap - Map memory for a process */
 void *process_mmap(process_t *proc, void *addr, size_t length, int prot, int flags) {
-    if (!proc || length == 0) {
+    if (!proc || length == 0 || !proc->cold->mm) {
         return (void *)-1;
     }
 
@@ -410,7 +1632,7 @@ void *process_mmap(process_t *proc, void *addr, size_t length, int prot, int fla
         virt_addr = (uint32_t)addr & ~(PAGE_SIZE - 1);
     } else {
         /* Allocate from heap area */
-        virt_addr = proc->heap_end;
+        virt_addr = proc->cold->mm->heap_end;
     }
 
     /* Convert protection flags to page flags */
@@ -418,22 +1640,28 @@ void *process_mmap(process_t *proc, void *addr, size_t length, int prot, int fla
     if (prot & PROT_WRITE) {
         page_flags |= PAGE_WRITE;
     }
+    if (flags & MAP_SHARED) {
+        page_flags |= PAGE_SHARED;  /* fork shares instead of copying */
+    }
 
     /* Allocate and map physical pages */
     for (size_t i = 0; i < pages_needed; i++) {
         uint32_t page_virt = virt_addr + (i * PAGE_SIZE);
 
         /* Allocate physical page */
-        void *phys_page = kmalloc(PAGE_SIZE);
+        void *phys_page = paging_alloc_frame();
+        if (phys_page && (flags & MAP_SHARED) && paging_share_frame((uint32_t)phys_page) != 0) {
+            kfree(phys_page);
+            phys_page = NULL;
+        }
         if (!phys_page) {
             /* Clean up already mapped pages */
             for (size_t j = 0; j < i; j++) {
                 uint32_t cleanup_virt = virt_addr + (j * PAGE_SIZE);
-                uint32_t cleanup_phys = paging_get_physical_address(cleanup_virt);
-                if (cleanup_phys) {
-                    kfree((void *)cleanup_phys);
+                uint32_t entry = paging_unmap_page_in_directory(proc->page_directory, cleanup_virt);
+                if (entry) {
+                    paging_release_frame(entry);
                 }
-                paging_unmap_page(cleanup_virt);
             }
             return (void *)-1;
         }
@@ -449,8 +1677,8 @@ void *process_mmap(process_t *proc, void *addr, size_t length, int prot, int fla
     }
 
     /* Update heap_end if we allocated past it */
-    if (virt_addr + total_size > proc->heap_end) {
-        proc->heap_end = virt_addr + total_size;
+    if (virt_addr + total_size > proc->cold->mm->heap_end) {
+        proc->cold->mm->heap_end = virt_addr + total_size;
     }
 
     printk("[MMAP] Mapped %d bytes at 0x%x for PID %d\n", total_size, virt_addr, proc->pid);
@@ -459,7 +1687,7 @@ void *process_mmap(process_t *proc, void *addr, size_t length, int prot, int fla
 
 /* process_munmap - Unmap memory for a process */
 int process_munmap(process_t *proc, void *addr, size_t length) {
-    if (!proc || !addr || length == 0) {
+    if (!proc || !addr || length == 0 || !proc->cold->mm) {
         return -1;
     }
 
@@ -469,13 +1697,12 @@ int process_munmap(process_t *proc, void *addr, size_t length) {
     /* Unmap each page */
     for (size_t i = 0; i < pages; i++) {
         uint32_t page_virt = virt_addr + (i * PAGE_SIZE);
-        uint32_t page_phys = paging_get_physical_address(page_virt);
 
-        if (page_phys) {
-            /* Free physical page */
-            kfree((void *)page_phys);
-            /* Unmap from virtual address space */
-            paging_unmap_page(page_virt);
+        /* Unmap from the process's address space, then free the frame
+         * (a shared one only once no other process maps it) */
+        uint32_t entry = paging_unmap_page_in_directory(proc->page_directory, page_virt);
+        if (entry) {
+            paging_release_frame(entry);
         }
     }
 
@@ -490,33 +1717,37 @@ int process_brk(process_t *proc, void *addr) {
         return -1;
     }
 
+    if (!proc->cold->mm) {
+        return -1;  /* Kernel threads have no heap */
+    }
+
     uint32_t new_brk = (uint32_t)addr;
 
     /* If addr is NULL, just return current brk */
     if (!addr) {
-        return (int)proc->heap_end;
+        return (int)proc->cold->mm->heap_end;
     }
 
     /* Align to page boundary */
     new_brk = (new_brk + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
 
     /* Check if we're growing or shrinking the heap */
-    if (new_brk > proc->heap_end) {
+    if (new_brk > proc->cold->mm->heap_end) {
         /* Growing heap - allocate more pages */
-        size_t size_to_add = new_brk - proc->heap_end;
-        void *result = process_mmap(proc, (void *)proc->heap_end, size_to_add,
+        size_t size_to_add = new_brk - proc->cold->mm->heap_end;
+        void *result = process_mmap(proc, (void *)proc->cold->mm->heap_end, size_to_add,
                                      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS);
         if (result == (void *)-1) {
             return -1;
         }
-    } else if (new_brk < proc->heap_end) {
+    } else if (new_brk < proc->cold->mm->heap_end) {
         /* Shrinking heap - free pages */
-        size_t size_to_remove = proc->heap_end - new_brk;
+        size_t size_to_remove = proc->cold->mm->heap_end - new_brk;
         process_munmap(proc, (void *)new_brk, size_to_remove);
-        proc->heap_end = new_brk;
+        proc->cold->mm->heap_end = new_brk;
     }
 
-    return (int)proc->heap_end;
+    return (int)proc->cold->mm->heap_end;
 }
 
 /* sys_mmap - System call for mmap */
@@ -546,81 +1777,168 @@ int sys_brk(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3,
 
 /* ===== Process Scheduling (KFS-5 MANDATORY) ===== */
 
-/* Round-robin scheduler - select next process to run */
-void process_schedule(void) {
-    process_t *next = NULL;
-
-    /* Find next READY process in round-robin fashion */
-    if (current_process) {
-        /* Start search from next process after current */
-        bool found_current = false;
-
-        /* First pass: search from current+1 to end */
-        for (int i = 0; i < MAX_PROCESSES; i++) {
-            if (&process_table[i] == current_process) {
-                found_current = true;
-                continue;
-            }
+/* Take a READY process that is waiting on the busiest other CPU's run
+ * queue (NULL if every other CPU has at most what it is running) */
+static process_t *process_steal(cpu_t *self) {
+    cpu_t *victim = NULL;
+
+    for (uint32_t i = 0; i < smp_online_cpus(); i++) {
+        cpu_t *cpu = smp_cpu(i);
+        /* A CPU without a current process yet (boot) keeps its queue */
+        if (cpu != self && cpu->online && cpu->current && cpu->rq.nr_running > 1 &&
+            (!victim || cpu->rq.nr_running > victim->rq.nr_running)) {
+            victim = cpu;
+        }
+    }
+    if (!victim) {
+        return NULL;
+    }
 
-            if (found_current && process_table[i].state == PROCESS_STATE_READY) {
-                next = &process_table[i];
-                break;
+    process_t *stolen = NULL;
+    list_head_t *pos;
+    spin_lock(&victim->rq.lock);
+    list_for_each(pos, &victim->rq.tasks) {
+        process_t *proc = list_entry(pos, process_t, run_list);
+        if (proc->state == PROCESS_STATE_READY && proc != victim->current) {
+            stolen = proc;
+            list_del(&proc->run_list);
+            victim->rq.nr_running--;
+            if (victim->rq.wakeup_hint == proc) {
+                victim->rq.wakeup_hint = NULL;
             }
+            break;
         }
+    }
+    spin_unlock(&victim->rq.lock);
+
+    if (stolen) {
+        spin_lock(&self->rq.lock);
+        stolen->cpu = self->id;
+        list_add_tail(&stolen->run_list, &self->rq.tasks);
+        self->rq.nr_running++;
+        spin_unlock(&self->rq.lock);
+        self->steals++;
+    }
+    return stolen;
+}
 
-        /* Second pass: wrap around from beginning if needed */
-        if (!next) {
-            for (int i = 0; i < MAX_PROCESSES; i++) {
-                if (&process_table[i] == current_process) {
-                    break;  /* Stop at current process */
-                }
+/* Pick the first READY process on this CPU's run queue (round-robin: a
+ * process that is switched out goes to the tail), else steal one */
+static process_t *process_pick_next(void) {
+    cpu_t *cpu = this_cpu();
+
+    /* A freshly woken process runs first */
+    process_t *hint = cpu->rq.wakeup_hint;
+    cpu->rq.wakeup_hint = NULL;
+    if (hint && hint->cpu == cpu->id && hint != current_process &&
+        hint->state == PROCESS_STATE_READY) {
+        return hint;
+    }
 
-                if (process_table[i].state == PROCESS_STATE_READY) {
-                    next = &process_table[i];
-                    break;
-                }
-            }
+    list_head_t *pos;
+    list_for_each(pos, &cpu->rq.tasks) {
+        process_t *proc = list_entry(pos, process_t, run_list);
+        if (proc->state == PROCESS_STATE_READY) {
+            return proc;
         }
+    }
+    return process_steal(cpu);
+}
 
-        /* If current process is still READY, it can continue running */
-        if (!next && current_process->state == PROCESS_STATE_READY) {
-            next = current_process;
-        }
-    } else {
-        /* No current process, find any READY process */
-        for (int i = 0; i < MAX_PROCESSES; i++) {
-            if (process_table[i].state == PROCESS_STATE_READY) {
-                next = &process_table[i];
-                break;
-            }
+/* Round-robin scheduler - select next process to run */
+void process_schedule(void) {
+    /* Nothing to switch away from until the first process is installed */
+    if (!current_process) {
+        return;
+    }
+
+    bool flags = interrupts_save();
+    process_need_resched = false;
+    preempt_check_schedule();
+
+    /* Woken up before it got to sleep: keep running */
+    if (current_process->state == PROCESS_STATE_READY) {
+        current_process->state = PROCESS_STATE_RUNNING;
+        sched_info_dequeued(current_process);
+    }
+
+    /* Going to sleep (or gone): leave the run list until woken */
+    if (current_process->state != PROCESS_STATE_RUNNING) {
+        process_dequeue(current_process);
+    }
+
+    process_t *next = process_pick_next();
+    if (!next) {
+        if (current_process->state == PROCESS_STATE_RUNNING) {
+            interrupts_restore(flags);
+            return;  /* Current process can continue running */
         }
+        next = this_cpu()->idle;
     }
 
-    /* Switch to next process if found and different from current */
-    if (next && next != current_process) {
+    /* Switch to next process if different from current */
+    if (next != current_process) {
         process_switch(next);
     }
+
+    interrupts_restore(flags);
+}
+
+/* Involuntary switch. A process caught between marking itself BLOCKED
+ * and calling the scheduler has not armed its wakeup yet, so it stays
+ * runnable; every sleeper re-marks itself in its wait loop. */
+void process_preempt(void) {
+    if (!current_process) {
+        return;
+    }
+
+    bool flags = interrupts_save();
+    if (current_process->state == PROCESS_STATE_BLOCKED) {
+        current_process->state = PROCESS_STATE_RUNNING;
+    }
+    process_schedule();
+    interrupts_restore(flags);
 }
 
 /* Switch to a different process */
 void process_switch(process_t *next) {
+    static uint32_t boot_esp;
+
     if (!next) {
         return;
     }
 
-    /* Save current process context if there is one */
-    if (current_process && current_process->state == PROCESS_STATE_RUNNING) {
-        /* Mark current process as READY (no longer running) */
-        current_process->state = PROCESS_STATE_READY;
+    bool flags = interrupts_save();
 
-        /* Context is saved by interrupt handler before calling schedule */
-        /* (The interrupt frame contains the saved context) */
+    /* Mark current process as READY (no longer running), back of the line */
+    cpu_t *cpu = this_cpu();
+    process_t *prev = current_process;
+    if (prev) {
+        /* Still runnable means it was preempted, otherwise it gave up the CPU */
+        if (prev->state == PROCESS_STATE_RUNNING) {
+            prev->acct.nivcsw++;
+        } else {
+            prev->acct.nvcsw++;
+        }
+    }
+    if (prev && prev->state == PROCESS_STATE_RUNNING) {
+        prev->state = PROCESS_STATE_READY;
+        if (!list_empty(&prev->run_list)) {
+            spin_lock(&cpu->rq.lock);
+            list_del(&prev->run_list);
+            list_add_tail(&prev->run_list, &cpu->rq.tasks);
+            spin_unlock(&cpu->rq.lock);
+            sched_info_queued(prev);
+        }
     }
 
     /* Switch to next process */
-    process_t *prev = current_process;
     current_process = next;
+    next->cpu = cpu->id;
     next->state = PROCESS_STATE_RUNNING;
+    cpu->switches++;
+    vdso_update_task(next->tgid, next->pid, next->uid);
+    sched_info_arrive(next);
 
     /* Switch page directory (memory context) */
     if (next->page_directory) {
@@ -628,17 +1946,90 @@ void process_switch(process_t *next) {
     }
 
     /* Process any pending signals for the new process */
-    process_signal_process(next);
+    if (next->signal_pending) {
+        process_signal_process(next);
+    }
 
-    /* Debug output */
+    /* Arm the lazy FPU trap unless next still owns the registers */
+    fpu_switch(prev, next);
+
+    /* The preempt count belongs to the process: one that scheduled while
+     * atomic gets its count back with the CPU, and the next one is not
+     * left holding it */
     if (prev) {
-        printk("[SCHED] Context switch: PID %d -> PID %d\n", prev->pid, next->pid);
-    } else {
-        printk("[SCHED] Starting process PID %d\n", next->pid);
+        prev->preempt_count = preempt_count();
     }
+    cpu->preempt_count = next->preempt_count;
+
+    /* Switch kernel stacks; returns when prev is scheduled again */
+    context_switch(prev ? &prev->kernel_esp : &boot_esp, next->kernel_esp);
+
+    interrupts_restore(flags);
+}
+
+/* Wake a blocked process (returns 1 if it was blocked) */
+int process_wakeup(process_t *proc) {
+    int woken = 0;
+    bool flags = interrupts_save();
+
+    if (proc && proc->state == PROCESS_STATE_BLOCKED) {
+        cpu_t *cpu = smp_cpu(proc->cpu);
+
+        /* Back on the CPU it last ran on (its cache is warm there) */
+        proc->state = PROCESS_STATE_READY;
+        process_enqueue(proc);
+        sched_info_woken(proc);
+        cpu->rq.wakeup_hint = proc;
+        if (preempt_wakeup_preempts(cpu)) {
+            cpu->need_resched = true;
+            smp_send_reschedule(proc->cpu);
+        }
+        if (cpu->current != cpu->idle) {
+            process_kick_idle_cpu(proc->cpu);
+        }
+        woken = 1;
+    }
+
+    interrupts_restore(flags);
+    return woken;
+}
+
+/* Timer wheel callback for schedule_timeout() */
+static void process_timeout(uint32_t data) {
+    process_wakeup((process_t *)data);
+}
+
+/* hrtimer callback for nanosleep */
+static hrtimer_restart_t process_hrtimer_wakeup(hrtimer_t *timer) {
+    process_wakeup(container_of(timer, process_t, sleep_hrtimer));
+    return HRTIMER_NORESTART;
+}
+
+/* Sleep until woken or timeout ticks elapse; returns the ticks left.
+ * The caller sets current->state to BLOCKED first, so a wakeup between
+ * that and the switch is not lost. A caller with no other wakeup source
+ * must do that with interrupts off (as timer_wait does), or a reschedule
+ * could switch it out BLOCKED before the timer is armed. */
+int32_t schedule_timeout(int32_t timeout) {
+    process_t *proc = current_process;
+
+    if (timeout == MAX_SCHEDULE_TIMEOUT) {
+        process_schedule();
+        return timeout;
+    }
+    if (timeout < 0) {
+        timeout = 0;
+    }
+
+    bool flags = interrupts_save();
+    uint32_t expire = timer_ticks + (uint32_t)timeout;
+    mod_timer(&proc->sleep_timer, expire);
+    process_schedule();
+    del_timer(&proc->sleep_timer);
+    interrupts_restore(flags);
 
-    /* The actual register context switch happens when we return from interrupt */
-    /* The interrupt handler will restore the context from next->context */
+    timeout = (int32_t)(expire - timer_ticks);
+    return timeout < 0 ? 0 : timeout;
 }
 
 /* Set current process (used during initialization) */
@@ -650,6 +2041,8 @@ void process_set_current(process_t *proc) {
     current_process = proc;
     if (proc) {
         proc->state = PROCESS_STATE_RUNNING;
+        vdso_update_task(proc->tgid, proc->pid, proc->uid);
+        sched_info_dequeued(proc);
         if (proc->page_directory) {
             paging_switch_directory(proc->page_directory);
         }
@@ -670,7 +2063,6 @@ static const struct {
     {4,  8,  "Overflow → SIGFPE"},              /* #OF */
     {5,  11, "Bound Range → SIGSEGV"},          /* #BR */
     {6,  4,  "Invalid Opcode → SIGILL"},        /* #UD */
-    {7,  8,  "Device Not Available → SIGFPE"},  /* #NM */
     {8,  6,  "Double Fault → SIGABRT"},         /* #DF */
     {10, 11, "Invalid TSS → SIGSEGV"},          /* #TS */
     {11, 11, "Segment Not Present → SIGSEGV"},  /* #NP */
@@ -723,7 +2115,7 @@ const char *process_get_pwd(process_t *proc) {
     if (!proc) {
         return NULL;
     }
-    return proc->pwd;
+    return proc->cold->fs->pwd;
 }
 
 /* Set current working directory for a process */
@@ -733,13 +2125,13 @@ int process_set_pwd(process_t *proc, const char *path) {
     }
 
     /* Validate path length */
-    if (strlen(path) >= sizeof(proc->pwd)) {
+    if (strlen(path) >= sizeof(proc->cold->fs->pwd)) {
         printk("[PROCESS] Path too long: %s\n", path);
         return -1;
     }
 
     /* Copy the new path */
-    strcpy(proc->pwd, path);
+    strcpy(proc->cold->fs->pwd, path);
 
     return 0;
 }
@@ -0,0 +1,193 @@
+/* procfs.c - Process information pseudo-filesystem mounted at /proc
+ *
+ * Nodes are generated on lookup: a PID directory or file node carries the
+ * PID in its inode field and its contents are formatted at read time, so
+ * they always reflect the live process. Like ext2 lookups, every returned
+ * node is a fresh allocation.
+ */
+
+#include "../include/procfs.h"
+#include "../include/process.h"
+#include "../include/kmalloc.h"
+#include "../include/string.h"
+#include "../include/printf.h"
+
+#define PROCFS_LINE_SIZE 160
+
+static vfs_node_t *procfs_pid_readdir(vfs_node_t *node, uint32_t index);
+static vfs_node_t *procfs_pid_finddir(vfs_node_t *node, const char *name);
+
+/* Allocate a blank procfs node */
+static vfs_node_t *procfs_new_node(const char *name, vfs_file_type_t type, uint32_t inode) {
+    vfs_node_t *node = (vfs_node_t *)kmalloc(sizeof(vfs_node_t));
+    if (!node) {
+        return NULL;
+    }
+
+    memset(node, 0, sizeof(vfs_node_t));
+    strncpy(node->name, name, 255);
+    node->name[255] = '\0';
+    node->type = type;
+    node->inode = inode;
+    node->mode = (type == VFS_FILE_TYPE_DIRECTORY) ? 0555 : 0444;
+    return node;
+}
+
+/* Copy a formatted line into a read buffer at offset */
+static int procfs_copy_out(const char *line, uint32_t offset, uint32_t size, void *buffer) {
+    uint32_t len = strlen(line);
+    if (offset >= len) {
+        return 0;
+    }
+    if (size > len - offset) {
+        size = len - offset;
+    }
+    memcpy(buffer, line + offset, size);
+    return (int)size;
+}
+
+/* /proc/<pid>/stat */
+static int procfs_stat_format(uint32_t pid, char *line) {
+    process_t *proc = process_get_by_pid(pid);
+    if (!proc) {
+        return -1;
+    }
+    return process_format_stat(proc, line, PROCFS_LINE_SIZE);
+}
+
+static int procfs_stat_read(vfs_node_t *node, uint32_t offset, uint32_t size, void *buffer) {
+    char line[PROCFS_LINE_SIZE];
+    if (procfs_stat_format(node->inode, line) < 0) {
+        return -1;  /* Process went away */
+    }
+    return procfs_copy_out(line, offset, size, buffer);
+}
+
+/* /proc/loadavg: "1min 5min 15min running/total" */
+static int procfs_loadavg_format(char *line) {
+    uint32_t load[3];
+    process_get_loadavg(load);
+
+    return snprintf(line, PROCFS_LINE_SIZE, "%u.%u%u %u.%u%u %u.%u%u %u/%u\n",
+                    LOAD_INT(load[0]), LOAD_FRAC(load[0]) / 10, LOAD_FRAC(load[0]) % 10,
+                    LOAD_INT(load[1]), LOAD_FRAC(load[1]) / 10, LOAD_FRAC(load[1]) % 10,
+                    LOAD_INT(load[2]), LOAD_FRAC(load[2]) / 10, LOAD_FRAC(load[2]) % 10,
+                    process_nr_running(), process_count());
+}
+
+static int procfs_loadavg_read(vfs_node_t *node, uint32_t offset, uint32_t size, void *buffer) {
+    char line[PROCFS_LINE_SIZE];
+    (void)node;
+    procfs_loadavg_format(line);
+    return procfs_copy_out(line, offset, size, buffer);
+}
+
+/* File nodes take their size from the current contents */
+static vfs_node_t *procfs_stat_node(uint32_t pid) {
+    char line[PROCFS_LINE_SIZE];
+    int len = procfs_stat_format(pid, line);
+    if (len < 0) {
+        return NULL;
+    }
+
+    vfs_node_t *node = procfs_new_node("stat", VFS_FILE_TYPE_REGULAR, pid);
+    if (node) {
+        node->size = (uint32_t)len;
+        node->read = procfs_stat_read;
+    }
+    return node;
+}
+
+static vfs_node_t *procfs_loadavg_node(void) {
+    char line[PROCFS_LINE_SIZE];
+    vfs_node_t *node = procfs_new_node("loadavg", VFS_FILE_TYPE_REGULAR, 0);
+    if (node) {
+        node->size = (uint32_t)procfs_loadavg_format(line);
+        node->read = procfs_loadavg_read;
+    }
+    return node;
+}
+
+/* /proc/<pid> directory */
+static vfs_node_t *procfs_pid_node(uint32_t pid) {
+    char name[12];
+    snprintf(name, sizeof(name), "%u", pid);
+
+    vfs_node_t *node = procfs_new_node(name, VFS_FILE_TYPE_DIRECTORY, pid);
+    if (node) {
+        node->readdir = procfs_pid_readdir;
+        node->finddir = procfs_pid_finddir;
+    }
+    return node;
+}
+
+static vfs_node_t *procfs_pid_readdir(vfs_node_t *node, uint32_t index) {
+    return index == 0 ? procfs_stat_node(node->inode) : NULL;
+}
+
+static vfs_node_t *procfs_pid_finddir(vfs_node_t *node, const char *name) {
+    return strcmp(name, "stat") == 0 ? procfs_stat_node(node->inode) : NULL;
+}
+
+/* Find the PID of the index-th process */
+typedef struct {
+    uint32_t index;
+    uint32_t current;
+    uint32_t pid;
+    bool found;
+} procfs_nth_ctx_t;
+
+static void procfs_nth_callback(process_t *proc, void *data) {
+    procfs_nth_ctx_t *ctx = (procfs_nth_ctx_t *)data;
+    if (!ctx->found && ctx->current++ == ctx->index) {
+        ctx->pid = proc->pid;
+        ctx->found = true;
+    }
+}
+
+/* /proc: loadavg first, then one directory per process */
+static vfs_node_t *procfs_root_readdir(vfs_node_t *node, uint32_t index) {
+    (void)node;
+
+    if (index == 0) {
+        return procfs_loadavg_node();
+    }
+
+    procfs_nth_ctx_t ctx = { .index = index - 1, .current = 0, .pid = 0, .found = false };
+    process_for_each(procfs_nth_callback, &ctx);
+    return ctx.found ? procfs_pid_node(ctx.pid) : NULL;
+}
+
+static vfs_node_t *procfs_root_finddir(vfs_node_t *node, const char *name) {
+    (void)node;
+
+    if (strcmp(name, "loadavg") == 0) {
+        return procfs_loadavg_node();
+    }
+
+    if (name[0] < '0' || name[0] > '9') {
+        return NULL;
+    }
+    uint32_t pid = (uint32_t)atoi(name);
+    if (pid != 0 && !process_get_by_pid(pid)) {
+        return NULL;
+    }
+    return procfs_pid_node(pid);
+}
+
+/* Create /proc under the VFS root */
+void procfs_init(void) {
+    vfs_node_t *proc_dir = procfs_new_node("proc", VFS_FILE_TYPE_DIRECTORY, 0);
+    if (!proc_dir) {
+        return;
+    }
+
+    proc_dir->readdir = procfs_root_readdir;
+    proc_dir->finddir = procfs_root_finddir;
+
+    if (vfs_add_child(vfs_get_root(), proc_dir) != 0) {
+        kfree(proc_dir);
+        return;
+    }
+    printk("[VFS] Created /proc (per-PID stat files)\n");
+}
@@ -0,0 +1,230 @@
+/* rbtree.c - Red-black tree balancing (insert/erase) */
+
+#include "../include/rbtree.h"
+
+/* Replace child old with new in parent (or at the root) */
+static void rb_change_child(rb_node_t *old, rb_node_t *new, rb_node_t *parent,
+                            rb_root_t *root) {
+    if (!parent) {
+        root->node = new;
+    } else if (parent->left == old) {
+        parent->left = new;
+    } else {
+        parent->right = new;
+    }
+}
+
+static void rb_rotate_left(rb_node_t *node, rb_root_t *root) {
+    rb_node_t *right = node->right;
+    rb_node_t *parent = node->parent;
+
+    node->right = right->left;
+    if (right->left) {
+        right->left->parent = node;
+    }
+    right->left = node;
+    right->parent = parent;
+    rb_change_child(node, right, parent, root);
+    node->parent = right;
+}
+
+static void rb_rotate_right(rb_node_t *node, rb_root_t *root) {
+    rb_node_t *left = node->left;
+    rb_node_t *parent = node->parent;
+
+    node->left = left->right;
+    if (left->right) {
+        left->right->parent = node;
+    }
+    left->right = node;
+    left->parent = parent;
+    rb_change_child(node, left, parent, root);
+    node->parent = left;
+}
+
+static inline bool rb_is_black(const rb_node_t *node) {
+    return !node || node->color == RB_BLACK;
+}
+
+/* Rebalance after rb_link_node() */
+void rb_insert_color(rb_node_t *node, rb_root_t *root, bool leftmost) {
+    if (leftmost) {
+        root->leftmost = node;
+    }
+
+    while (node->parent && node->parent->color == RB_RED) {
+        rb_node_t *parent = node->parent;
+        rb_node_t *gparent = parent->parent;
+
+        if (parent == gparent->left) {
+            rb_node_t *uncle = gparent->right;
+            if (!rb_is_black(uncle)) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                gparent->color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->right) {
+                rb_rotate_left(parent, root);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            gparent->color = RB_RED;
+            rb_rotate_right(gparent, root);
+        } else {
+            rb_node_t *uncle = gparent->left;
+            if (!rb_is_black(uncle)) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                gparent->color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->left) {
+                rb_rotate_right(parent, root);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            gparent->color = RB_RED;
+            rb_rotate_left(gparent, root);
+        }
+    }
+
+    root->node->color = RB_BLACK;
+}
+
+/* In-order successor */
+rb_node_t *rb_next(const rb_node_t *node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) {
+            node = node->left;
+        }
+        return (rb_node_t *)node;
+    }
+
+    rb_node_t *parent = node->parent;
+    while (parent && node == parent->right) {
+        node = parent;
+        parent = node->parent;
+    }
+    return parent;
+}
+
+/* Restore black height after removing a black node; node may be NULL */
+static void rb_erase_color(rb_node_t *node, rb_node_t *parent, rb_root_t *root) {
+    while (node != root->node && rb_is_black(node)) {
+        if (parent->left == node) {
+            rb_node_t *sibling = parent->right;
+            if (!rb_is_black(sibling)) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_left(parent, root);
+                sibling = parent->right;
+            }
+            if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+            } else {
+                if (rb_is_black(sibling->right)) {
+                    sibling->left->color = RB_BLACK;
+                    sibling->color = RB_RED;
+                    rb_rotate_right(sibling, root);
+                    sibling = parent->right;
+                }
+                sibling->color = parent->color;
+                parent->color = RB_BLACK;
+                sibling->right->color = RB_BLACK;
+                rb_rotate_left(parent, root);
+                node = root->node;
+                break;
+            }
+        } else {
+            rb_node_t *sibling = parent->left;
+            if (!rb_is_black(sibling)) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_right(parent, root);
+                sibling = parent->left;
+            }
+            if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+            } else {
+                if (rb_is_black(sibling->left)) {
+                    sibling->right->color = RB_BLACK;
+                    sibling->color = RB_RED;
+                    rb_rotate_left(sibling, root);
+                    sibling = parent->left;
+                }
+                sibling->color = parent->color;
+                parent->color = RB_BLACK;
+                sibling->left->color = RB_BLACK;
+                rb_rotate_right(parent, root);
+                node = root->node;
+                break;
+            }
+        }
+    }
+
+    if (node) {
+        node->color = RB_BLACK;
+    }
+}
+
+/* Remove a node from the tree */
+void rb_erase(rb_node_t *node, rb_root_t *root) {
+    rb_node_t *child, *parent;
+    int color;
+
+    if (root->leftmost == node) {
+        root->leftmost = rb_next(node);
+    }
+
+    if (node->left && node->right) {
+        /* Two children: splice out the successor and put it in node's place */
+        rb_node_t *successor = node->right;
+        while (successor->left) {
+            successor = successor->left;
+        }
+
+        child = successor->right;
+        parent = successor->parent;
+        color = successor->color;
+
+        if (parent == node) {
+            parent = successor;
+        } else {
+            if (child) {
+                child->parent = parent;
+            }
+            parent->left = child;
+            successor->right = node->right;
+            node->right->parent = successor;
+        }
+
+        successor->parent = node->parent;
+        successor->color = node->color;
+        successor->left = node->left;
+        node->left->parent = successor;
+        rb_change_child(node, successor, node->parent, root);
+    } else {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        color = node->color;
+
+        if (child) {
+            child->parent = parent;
+        }
+        rb_change_child(node, child, parent, root);
+    }
+
+    if (color == RB_BLACK) {
+        rb_erase_color(child, parent, root);
+    }
+}
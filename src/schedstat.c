@@ -0,0 +1,185 @@
+/* schedstat.c - Scheduler latency statistics (run delay, wakeup latency)
+ *
+ * A task is stamped with the clocksource time when it becomes READY and,
+ * if that happened through a wakeup, when it was woken. When the
+ * scheduler hands it the CPU the elapsed time goes into a log2 histogram
+ * of the task and a global one. Run delay covers every wait on the run
+ * list (including after preemption); wakeup latency only the waits that
+ * started with a wakeup, which is what interactive response depends on.
+ */
+
+#include "../include/schedstat.h"
+#include "../include/process.h"
+#include "../include/clocksource.h"
+#include "../include/math64.h"
+#include "../include/idt.h"
+#include "../include/string.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+
+/* Width of the longest histogram bar */
+#define SCHEDSTAT_BAR_WIDTH 32
+
+static sched_info_t sched_global;
+
+/* Task became runnable (created, forked or preempted) */
+void sched_info_queued(process_t *proc) {
+    if (!proc->sched_queued_ns) {
+        proc->sched_queued_ns = ktime_get_ns();
+    }
+}
+
+/* Task was woken from BLOCKED */
+void sched_info_woken(process_t *proc) {
+    uint64_t now = ktime_get_ns();
+    proc->sched_queued_ns = now;
+    proc->sched_woken_ns = now;
+}
+
+/* Task became runnable again without being switched out */
+void sched_info_dequeued(process_t *proc) {
+    proc->sched_queued_ns = 0;
+    proc->sched_woken_ns = 0;
+}
+
+/* Add one sample to a histogram */
+static void sched_hist_add(sched_hist_t *hist, uint64_t ns) {
+    uint64_t us = div_u64(ns, NSEC_PER_USEC);
+    uint32_t bucket = us ? ilog2_u64(us) + 1 : 0;
+
+    if (bucket >= SCHEDSTAT_BUCKETS) {
+        bucket = SCHEDSTAT_BUCKETS - 1;
+    }
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->sum_ns += ns;
+    if (ns > hist->max_ns) {
+        hist->max_ns = ns;
+    }
+}
+
+/* Task is about to get the CPU: record how long it waited */
+void sched_info_arrive(process_t *proc) {
+    if (!proc->sched_queued_ns) {
+        return;
+    }
+
+    uint64_t now = ktime_get_ns();
+    uint64_t delay = now - proc->sched_queued_ns;
+    sched_hist_add(&sched_global.run_delay, delay);
+    if (proc->cold) {
+        sched_hist_add(&proc->cold->sched.run_delay, delay);
+    }
+
+    if (proc->sched_woken_ns) {
+        uint64_t latency = now - proc->sched_woken_ns;
+        sched_hist_add(&sched_global.wakeup_latency, latency);
+        if (proc->cold) {
+            sched_hist_add(&proc->cold->sched.wakeup_latency, latency);
+        }
+    }
+
+    proc->sched_queued_ns = 0;
+    proc->sched_woken_ns = 0;
+}
+
+static void schedstat_reset_task(process_t *proc, void *data) {
+    (void)data;
+    /* process_switch updates these under the interrupt lock */
+    bool flags = interrupts_save();
+    if (proc->cold) {
+        memset(&proc->cold->sched, 0, sizeof(sched_info_t));
+    }
+    interrupts_restore(flags);
+}
+
+/* Clear the global and per-task histograms */
+void schedstat_reset(void) {
+    bool flags = interrupts_save();
+    memset(&sched_global, 0, sizeof(sched_global));
+    interrupts_restore(flags);
+
+    process_for_each(schedstat_reset_task, NULL);
+}
+
+/* Print a string padded to a column width */
+static void schedstat_print_padded(const char *str, int width) {
+    int len = (int)strlen(str);
+    printk("%s", str);
+    while (len++ < width) {
+        printk(" ");
+    }
+}
+
+/* Print one histogram with proportional bars */
+static void sched_hist_print(const char *title, const sched_hist_t *hist) {
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("%s: ", title);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    if (!hist->count) {
+        printk("no samples\n");
+        return;
+    }
+
+    printk("%u samples, avg %u us, max %u us\n", hist->count,
+           (uint32_t)div_u64(div_u64(hist->sum_ns, hist->count), NSEC_PER_USEC),
+           (uint32_t)div_u64(hist->max_ns, NSEC_PER_USEC));
+
+    uint32_t peak = 0;
+    for (int i = 0; i < SCHEDSTAT_BUCKETS; i++) {
+        if (hist->buckets[i] > peak) {
+            peak = hist->buckets[i];
+        }
+    }
+
+    for (int i = 0; i < SCHEDSTAT_BUCKETS; i++) {
+        uint32_t count = hist->buckets[i];
+        if (!count) {
+            continue;
+        }
+
+        char label[24];
+        if (i == 0) {
+            snprintf(label, sizeof(label), "  < 1 us");
+        } else if (i == SCHEDSTAT_BUCKETS - 1) {
+            snprintf(label, sizeof(label), "  >= %u us", 1U << (i - 1));
+        } else {
+            snprintf(label, sizeof(label), "  %u-%u us", 1U << (i - 1), 1U << i);
+        }
+        schedstat_print_padded(label, 20);
+
+        char num[12];
+        snprintf(num, sizeof(num), "%u", count);
+        schedstat_print_padded(num, 8);
+
+        uint32_t bar = (count * SCHEDSTAT_BAR_WIDTH + peak - 1) / peak;
+        while (bar--) {
+            printk("#");
+        }
+        printk("\n");
+    }
+}
+
+/* Print the global histograms, or one task's if proc is given */
+void schedstat_print(process_t *proc) {
+    sched_info_t snapshot;
+    bool flags = interrupts_save();
+    if (proc) {
+        memcpy(&snapshot, &proc->cold->sched, sizeof(snapshot));
+    } else {
+        memcpy(&snapshot, &sched_global, sizeof(snapshot));
+    }
+    interrupts_restore(flags);
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    if (proc) {
+        printk("\n=== Scheduler latency: PID %u (%s) ===\n", proc->pid, proc->name);
+    } else {
+        printk("\n=== Scheduler latency (all tasks) ===\n");
+    }
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    sched_hist_print("Run delay (READY -> RUNNING)", &snapshot.run_delay);
+    sched_hist_print("Wakeup latency (wakeup -> RUNNING)", &snapshot.wakeup_latency);
+}
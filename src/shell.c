@@ -19,6 +19,28 @@
 #include "../include/vfs.h"
 #include "../include/ide.h"
 #include "../include/ext2.h"
+#include "../include/clocksource.h"
+#include "../include/timer.h"
+#include "../include/workqueue.h"
+#include "../include/softirq.h"
+#include "../include/fpu.h"
+#include "../include/kthread.h"
+#include "../include/schedstat.h"
+#include "../include/futex.h"
+#include "../include/exec.h"
+#include "../include/math64.h"
+#include "../include/cpu.h"
+#include "../include/vdso.h"
+#include "../include/uring.h"
+#include "../include/sysstat.h"
+#include "../include/file.h"
+#include "../include/smp.h"
+#include "../include/irq.h"
+#include "../include/pic.h"
+#include "../include/apic.h"
+#include "../include/lockstat.h"
+#include "../include/preempt.h"
+#include "../include/irqsoff.h"
 
 /* Shell state */
 static char shell_buffer[SHELL_BUFFER_SIZE];
@@ -54,6 +76,28 @@ static void cmd_mount(int argc, char **argv);
 static void cmd_umount(int argc, char **argv);
 static void cmd_login(int argc, char **argv);
 static void cmd_whoami(int argc, char **argv);
+static void cmd_clocksource(int argc, char **argv);
+static void cmd_sleep(int argc, char **argv);
+static void cmd_workqueue(int argc, char **argv);
+static void cmd_softirq(int argc, char **argv);
+static void cmd_fpu(int argc, char **argv);
+static void cmd_top(int argc, char **argv);
+static void cmd_schedstat(int argc, char **argv);
+static void cmd_clone(int argc, char **argv);
+static void cmd_futex(int argc, char **argv);
+static void cmd_exec(int argc, char **argv);
+static void cmd_launch(int argc, char **argv);
+static void cmd_sigstorm(int argc, char **argv);
+static void cmd_syscallbench(int argc, char **argv);
+static void cmd_vdso(int argc, char **argv);
+static void cmd_uring(int argc, char **argv);
+static void cmd_sysstat(int argc, char **argv);
+static void cmd_fileio(int argc, char **argv);
+static void cmd_smp(int argc, char **argv);
+static void cmd_irq(int argc, char **argv);
+static void cmd_lockstat(int argc, char **argv);
+static void cmd_preempt(int argc, char **argv);
+static void cmd_irqsoff(int argc, char **argv);
 
 /* Command structure */
 struct shell_command {
@@ -89,6 +133,28 @@ static const struct shell_command commands[] = {
     {"umount",     "Unmount a filesystem (BONUS)", cmd_umount},
     {"login",      "Login as a user (BONUS)", cmd_login},
     {"whoami",     "Show current user (BONUS)", cmd_whoami},
+    {"clocksource", "List or select clocksource", cmd_clocksource},
+    {"sleep",      "Sleep for N milliseconds (nanosleep)", cmd_sleep},
+    {"workqueue",  "Show worker thread statistics", cmd_workqueue},
+    {"softirq",    "Show softirq (bottom half) statistics", cmd_softirq},
+    {"fpu",        "Show FPU/SSE state or test lazy switching", cmd_fpu},
+    {"top",        "Live per-process resource usage (q to quit)", cmd_top},
+    {"schedstat",  "Run-delay and wakeup-latency histograms", cmd_schedstat},
+    {"clone",      "Start threads sharing the shell's address space", cmd_clone},
+    {"futex",      "Futex statistics or mutex ping-pong benchmark", cmd_futex},
+    {"exec",       "Run an ELF binary with demand-paged segments", cmd_exec},
+    {"launch",     "Compare fork+exec, vfork+exec and spawn launch rates", cmd_launch},
+    {"sigstorm",   "Signal storm: coalesced and queued delivery, heap use", cmd_sigstorm},
+    {"syscallbench", "Null syscall cost: INT 0x80 vs SYSENTER", cmd_syscallbench},
+    {"vdso",       "Show the vDSO page and time trap-free vs syscall reads", cmd_vdso},
+    {"uring",      "Batched syscalls through submission/completion rings", cmd_uring},
+    {"sysstat",    "Per-syscall counters, latency histograms and trace", cmd_sysstat},
+    {"fileio",     "File descriptor syscalls: open/read/readv/pread/dup2", cmd_fileio},
+    {"smp",        "CPUs, run queues and IPIs; 'smp bench [n]' for scaling", cmd_smp},
+    {"irq",        "IRQ routing and handler cost; 'irq bench [n]' for EOI cost", cmd_irq},
+    {"lockstat",   "Lock contention per lock class ('lockstat on|off|reset')", cmd_lockstat},
+    {"preempt",    "Preemption counters; 'preempt throughput|lowlatency' sets the mode", cmd_preempt},
+    {"irqsoff",    "Longest interrupts-off/preemption-off windows ('irqsoff on|off|reset')", cmd_irqsoff},
     {"reboot",     "Reboot the system", cmd_reboot},
     {"halt",       "Halt the system", cmd_halt},
     {"echo",       "Echo arguments", cmd_echo},
@@ -670,7 +736,7 @@ static void cmd_mmap(int argc, char **argv) {
     }
 
     printk("Process created (PID: %d)\n", proc->pid);
-    printk("Initial heap: 0x%x - 0x%x\n", proc->heap_start, proc->heap_end);
+    printk("Initial heap: 0x%x - 0x%x\n", proc->cold->mm->heap_start, proc->cold->mm->heap_end);
 
     /* Test mmap - allocate 8KB */
     printk("\nMapping 8KB with mmap...\n");
@@ -688,11 +754,11 @@ static void cmd_mmap(int argc, char **argv) {
     printk("mmap successful!\n");
     vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
     printk("  Mapped at: 0x%x\n", (uint32_t)mapped);
-    printk("  New heap end: 0x%x\n", proc->heap_end);
+    printk("  New heap end: 0x%x\n", proc->cold->mm->heap_end);
 
     /* Test brk - grow heap */
     printk("\nTesting brk (grow heap by 4KB)...\n");
-    uint32_t new_brk = proc->heap_end + 4096;
+    uint32_t new_brk = proc->cold->mm->heap_end + 4096;
     int result = process_brk(proc, (void *)new_brk);
 
     if (result != -1) {
@@ -709,14 +775,14 @@ static void cmd_mmap(int argc, char **argv) {
     /* Display process memory layout */
     printk("\nProcess Memory Layout:\n");
     printk("  .text:   0x%x (size: %d, flags: 0x%x)\n",
-           proc->text_section.start_addr, proc->text_section.size, proc->text_section.flags);
+           proc->cold->mm->text_section.start_addr, proc->cold->mm->text_section.size, proc->cold->mm->text_section.flags);
     printk("  .rodata: 0x%x (size: %d, flags: 0x%x)\n",
-           proc->rodata_section.start_addr, proc->rodata_section.size, proc->rodata_section.flags);
+           proc->cold->mm->rodata_section.start_addr, proc->cold->mm->rodata_section.size, proc->cold->mm->rodata_section.flags);
     printk("  .data:   0x%x (size: %d, flags: 0x%x)\n",
-           proc->data_section.start_addr, proc->data_section.size, proc->data_section.flags);
+           proc->cold->mm->data_section.start_addr, proc->cold->mm->data_section.size, proc->cold->mm->data_section.flags);
     printk("  .bss:    0x%x (size: %d, flags: 0x%x)\n",
-           proc->bss_section.start_addr, proc->bss_section.size, proc->bss_section.flags);
-    printk("  heap:    0x%x - 0x%x\n", proc->heap_start, proc->heap_end);
+           proc->cold->mm->bss_section.start_addr, proc->cold->mm->bss_section.size, proc->cold->mm->bss_section.flags);
+    printk("  heap:    0x%x - 0x%x\n", proc->cold->mm->heap_start, proc->cold->mm->heap_end);
     printk("  stack:   0x%x\n", proc->user_stack);
 
     vga_set_color(VGA_COLOR_GREEN, VGA_COLOR_BLACK);
@@ -1132,7 +1198,7 @@ static void cmd_login(int argc, char **argv) {
                 /* Update current process UID */
                 process_t *proc = process_get_current();
                 if (proc) {
-                    proc->uid = current_uid;
+                    process_set_uid(proc, current_uid);
                 }
 
                 return;
@@ -1166,6 +1232,1269 @@ static void cmd_whoami(int argc, char **argv) {
     printk("unknown (UID: %d)\n", current_uid);
 }
 
+/* CLOCKSOURCE command - list clocksources or force one by name */
+static void cmd_clocksource(int argc, char **argv) {
+    if (argc >= 2) {
+        if (clocksource_select(argv[1]) != 0) {
+            vga_set_color(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK);
+            printk("Unknown clocksource: %s\n", argv[1]);
+            vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+            return;
+        }
+        printk("Switched to clocksource '%s'\n", argv[1]);
+    }
+
+    clocksource_print_info();
+}
+
+/* SLEEP command - block the shell in sys_nanosleep and report the overshoot */
+static void cmd_sleep(int argc, char **argv) {
+    if (argc < 2) {
+        printk("Usage: sleep <milliseconds>\n");
+        return;
+    }
+
+    int ms = atoi(argv[1]);
+    if (ms < 0) {
+        printk("sleep: invalid duration\n");
+        return;
+    }
+
+    timespec_t req = { ms / 1000, (ms % 1000) * (int32_t)NSEC_PER_MSEC };
+    uint64_t start = ktime_get_us();
+    int result;
+
+    __asm__ volatile(
+        "int $0x80"
+        : "=a"(result)
+        : "a"(SYS_NANOSLEEP), "b"(&req), "c"(0)
+        : "memory"
+    );
+
+    uint32_t elapsed = (uint32_t)(ktime_get_us() - start);
+    printk("Slept %d ms (measured %u us, result %d)\n", ms, elapsed, result);
+}
+
+/* Test work item for the workqueue command */
+static void test_work_func(work_t *work) {
+    (void)work;
+    printk("[WORKQUEUE] Test work ran in PID %d\n", process_get_current()->pid);
+}
+
+static work_t test_work;
+static delayed_work_t test_delayed_work;
+
+/* WORKQUEUE command - show worker stats, optionally queue test work */
+static void cmd_workqueue(int argc, char **argv) {
+    static bool test_work_ready = false;
+
+    if (argc >= 2 && strcmp(argv[1], "test") == 0) {
+        if (!test_work_ready) {
+            INIT_WORK(&test_work, test_work_func);
+            INIT_DELAYED_WORK(&test_delayed_work, test_work_func);
+            test_work_ready = true;
+        }
+        schedule_work(&test_work);
+        schedule_delayed_work(&test_delayed_work, msecs_to_ticks(500));
+        printk("Queued one work item now and one in 500 ms\n");
+        return;
+    }
+
+    workqueue_print_stats();
+}
+
+/* SOFTIRQ command - show bottom half statistics */
+static void cmd_softirq(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    softirq_print_stats();
+    printk("Disk completion:\n");
+    ide_print_irq_stats();
+}
+
+/* Kernel thread that loads its own pattern into xmm0 */
+static int fpu_clobber_thread(void *data) {
+    (void)data;
+    static uint32_t pattern[4] __attribute__((aligned(16))) = {
+        0xDEADBEEF, 0xDEADBEEF, 0xDEADBEEF, 0xDEADBEEF
+    };
+    __asm__ volatile("movaps (%0), %%xmm0" : : "r"(pattern) : "memory");
+    return 0;
+}
+
+/* FPU command - show lazy FPU state, or check xmm0 survives a switch */
+static void cmd_fpu(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "test") == 0) {
+        if (!fpu_has_sse()) {
+            printk("SSE not available\n");
+            return;
+        }
+
+        static uint32_t in[4] __attribute__((aligned(16))) = {1, 2, 3, 4};
+        static uint32_t out[4] __attribute__((aligned(16)));
+
+        __asm__ volatile("movaps (%0), %%xmm0" : : "r"(in) : "memory");
+        kthread_create(fpu_clobber_thread, NULL, "fpu-clobber");
+        timer_wait(msecs_to_ticks(50));
+        __asm__ volatile("movaps %%xmm0, (%0)" : : "r"(out) : "memory");
+
+        bool ok = true;
+        for (int i = 0; i < 4; i++) {
+            if (out[i] != in[i]) {
+                ok = false;
+            }
+        }
+        printk("xmm0 after switching to another SSE user: %s\n",
+               ok ? "preserved" : "CORRUPTED");
+    }
+
+    fpu_print_info();
+}
+
+/* One row of the top display */
+#define TOP_MAX_ROWS 16
+
+typedef struct {
+    uint32_t pid;
+    char name[PROCESS_NAME_LEN];
+    char state;
+    uint32_t cpu_ticks;              /* Ticks used since the previous refresh */
+    uint32_t utime;
+    uint32_t stime;
+    uint32_t csw;
+    uint32_t syscalls;
+    uint32_t faults;
+    uint32_t rss_kb;
+    uint32_t io_kb;
+} top_row_t;
+
+typedef struct {
+    top_row_t rows[TOP_MAX_ROWS];
+    uint32_t nrows;
+    uint32_t total;
+    uint32_t running;
+    uint32_t blocked;
+    uint32_t zombie;
+} top_snapshot_t;
+
+static top_snapshot_t top_snap;
+
+/* Collect one process into the snapshot (runs with interrupts disabled) */
+static void top_collect(process_t *proc, void *data) {
+    top_snapshot_t *snap = (top_snapshot_t *)data;
+    process_acct_t *acct = &proc->acct;
+    uint32_t used = acct->utime + acct->stime;
+
+    snap->total++;
+    if (proc->state == PROCESS_STATE_BLOCKED) {
+        snap->blocked++;
+    } else if (proc->state == PROCESS_STATE_ZOMBIE) {
+        snap->zombie++;
+    } else {
+        snap->running++;
+    }
+
+    if (snap->nrows < TOP_MAX_ROWS) {
+        top_row_t *row = &snap->rows[snap->nrows++];
+        row->pid = proc->pid;
+        strncpy(row->name, proc->name[0] ? proc->name : "-", PROCESS_NAME_LEN - 1);
+        row->name[PROCESS_NAME_LEN - 1] = '\0';
+        row->state = process_state_char(proc->state);
+        row->cpu_ticks = used - acct->sample_ticks;
+        row->utime = acct->utime;
+        row->stime = acct->stime;
+        row->csw = acct->nvcsw + acct->nivcsw;
+        row->syscalls = acct->syscalls;
+        row->faults = acct->page_faults;
+        row->rss_kb = process_rss_pages(proc) * (PAGE_SIZE / 1024);
+        row->io_kb = (uint32_t)((acct->read_bytes + acct->write_bytes) >> 10);
+    }
+    acct->sample_ticks = used;
+}
+
+/* Print a value left-aligned in a column of the given width */
+static void top_print_col(uint32_t value, int width) {
+    char buf[12];
+    int len = snprintf(buf, sizeof(buf), "%u", value);
+    printk("%s", buf);
+    while (len++ < width) {
+        printk(" ");
+    }
+}
+
+/* Draw one refresh of the top screen */
+static void top_draw(uint32_t elapsed) {
+    uint32_t load[3];
+    uint32_t secs = timer_ticks / TIMER_FREQUENCY;
+
+    memset(&top_snap, 0, sizeof(top_snap));
+    process_for_each(top_collect, &top_snap);
+    process_get_loadavg(load);
+
+    vga_clear();
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("top - up %u:%u%u:%u%u, load average: %u.%u%u %u.%u%u %u.%u%u\n",
+           secs / 3600, (secs / 600) % 6, (secs / 60) % 10, (secs % 60) / 10, secs % 10,
+           LOAD_INT(load[0]), LOAD_FRAC(load[0]) / 10, LOAD_FRAC(load[0]) % 10,
+           LOAD_INT(load[1]), LOAD_FRAC(load[1]) / 10, LOAD_FRAC(load[1]) % 10,
+           LOAD_INT(load[2]), LOAD_FRAC(load[2]) / 10, LOAD_FRAC(load[2]) % 10);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    printk("Tasks: %u total, %u runnable, %u sleeping, %u zombie; run queue %u\n",
+           top_snap.total, top_snap.running, top_snap.blocked, top_snap.zombie,
+           process_nr_running());
+    printk("\n");
+
+    vga_set_color(VGA_COLOR_BLACK, VGA_COLOR_LIGHT_GREY);
+    printk("PID   NAME            S %%CPU UTIME STIME CSW    SYSC   FLT   RSS-KB IO-KB \n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    for (uint32_t i = 0; i < top_snap.nrows; i++) {
+        top_row_t *row = &top_snap.rows[i];
+        uint32_t cpu = elapsed ? (row->cpu_ticks * 100) / elapsed : 0;
+        int pad = PROCESS_NAME_LEN - (int)strlen(row->name);
+
+        top_print_col(row->pid, 6);
+        printk("%s", row->name);
+        while (pad-- > 0) {
+            printk(" ");
+        }
+        printk("%c ", row->state);
+        top_print_col(cpu > 100 ? 100 : cpu, 5);
+        top_print_col(row->utime, 6);
+        top_print_col(row->stime, 6);
+        top_print_col(row->csw, 7);
+        top_print_col(row->syscalls, 7);
+        top_print_col(row->faults, 6);
+        top_print_col(row->rss_kb, 7);
+        top_print_col(row->io_kb, 6);
+        printk("\n");
+    }
+    if (top_snap.total > top_snap.nrows) {
+        printk("... %u more\n", top_snap.total - top_snap.nrows);
+    }
+    printk("\nRefresh 1s, q to quit\n");
+}
+
+/* TOP command - refreshing per-process resource usage */
+static void cmd_top(int argc, char **argv) {
+    int iterations = argc >= 2 ? atoi(argv[1]) : 0;   /* 0 = until q */
+    uint32_t last = timer_ticks;
+
+    for (int n = 0; iterations <= 0 || n < iterations; n++) {
+        uint32_t now = timer_ticks;
+        top_draw(now - last);
+        last = now;
+
+        /* Wait about a second, polling for q */
+        for (int step = 0; step < 10; step++) {
+            if (keyboard_haskey()) {
+                int c = keyboard_getchar();
+                if (c == 'q' || c == 'Q') {
+                    return;
+                }
+            }
+            timer_wait(msecs_to_ticks(100));
+        }
+    }
+}
+
+/* SCHEDSTAT command - dump (globally or for one PID) or reset latency histograms */
+static void cmd_schedstat(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+        schedstat_reset();
+        printk("Scheduler statistics reset\n");
+        return;
+    }
+
+    if (argc >= 2) {
+        process_t *proc = process_get_by_pid((uint32_t)atoi(argv[1]));
+        if (!proc) {
+            printk("schedstat: no such process: %s\n", argv[1]);
+            return;
+        }
+        schedstat_print(proc);
+        return;
+    }
+
+    schedstat_print(NULL);
+}
+
+/* Threads started by the clone command record their IDs in a page of
+ * the shell's address space, which only they and the shell can see */
+#define CLONE_TEST_THREADS 4
+
+static volatile uint32_t *clone_test_page;
+
+static int clone_test_thread(void *arg) {
+    uint32_t slot = (uint32_t)arg;
+    int tid, tgid;
+
+    __asm__ volatile("int $0x80" : "=a"(tid) : "a"(SYS_GETTID) : "memory");
+    __asm__ volatile("int $0x80" : "=a"(tgid) : "a"(SYS_GETPID) : "memory");
+
+    clone_test_page[slot * 2] = (uint32_t)tid;
+    clone_test_page[slot * 2 + 1] = (uint32_t)tgid;
+    return 0;
+}
+
+/* CLONE command - start threads in the shell's thread group */
+static void cmd_clone(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    process_t *shell = process_get_current();
+    void *page = process_mmap(shell, NULL, PAGE_SIZE, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS);
+    if (page == (void *)-1) {
+        printk("clone: cannot map the shared page\n");
+        return;
+    }
+    clone_test_page = (volatile uint32_t *)page;
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== clone(CLONE_VM | CLONE_FS | CLONE_SIGHAND | CLONE_THREAD) ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    uint32_t loads_before, skips_before;
+    paging_get_switch_stats(&loads_before, &skips_before);
+
+    uint32_t flags = CLONE_VM | CLONE_FS | CLONE_SIGHAND | CLONE_THREAD;
+    for (uint32_t i = 0; i < CLONE_TEST_THREADS; i++) {
+        int tid;
+        __asm__ volatile(
+            "int $0x80"
+            : "=a"(tid)
+            : "a"(SYS_CLONE), "b"(flags), "c"(clone_test_thread), "d"(i), "S"(0)
+            : "memory"
+        );
+        printk("Started thread %d\n", tid);
+    }
+    printk("Thread group %u now has %u live threads\n",
+           shell->tgid, shell->cold->group->nr_threads);
+
+    timer_wait(msecs_to_ticks(50));
+
+    for (uint32_t i = 0; i < CLONE_TEST_THREADS; i++) {
+        printk("  thread %u: tid %u, tgid %u (shell pid %u)\n", i,
+               clone_test_page[i * 2], clone_test_page[i * 2 + 1], shell->pid);
+    }
+
+    uint32_t loads, skips;
+    paging_get_switch_stats(&loads, &skips);
+    printk("Directory switches: %u CR3 reloads, %u kept (same address space)\n",
+           loads - loads_before, skips - skips_before);
+
+    process_munmap(shell, page, PAGE_SIZE);
+}
+
+/* State shared by the futex benchmark processes (in a MAP_SHARED page) */
+typedef struct {
+    volatile uint32_t turn;          /* 0: shell's move, 1: child's move */
+    volatile uint32_t mutex;         /* futex_mutex_lock word */
+    volatile uint32_t counter;       /* Protected by mutex */
+    uint32_t rounds;
+} futex_bench_t;
+
+/* Benchmark partner: answer each ping, then hammer the mutex */
+static int futex_bench_child(void *arg) {
+    futex_bench_t *bench = (futex_bench_t *)arg;
+
+    for (uint32_t i = 0; i < bench->rounds; i++) {
+        while (bench->turn != 1) {
+            futex_call(&bench->turn, FUTEX_WAIT, 0, 0, NULL);
+        }
+        bench->turn = 0;
+        futex_call(&bench->turn, FUTEX_WAKE, 1, 0, NULL);
+    }
+
+    for (uint32_t i = 0; i < bench->rounds; i++) {
+        futex_mutex_lock(&bench->mutex);
+        bench->counter++;
+        futex_mutex_unlock(&bench->mutex);
+    }
+    return 0;
+}
+
+/* FUTEX command - statistics, or ping-pong between two processes */
+static void cmd_futex(int argc, char **argv) {
+    if (argc < 2 || strcmp(argv[1], "bench") != 0) {
+        futex_print_stats();
+        return;
+    }
+
+    uint32_t rounds = argc >= 3 ? (uint32_t)atoi(argv[2]) : 1000;
+    if (rounds == 0) {
+        rounds = 1000;
+    }
+
+    process_t *shell = process_get_current();
+    futex_bench_t *bench = (futex_bench_t *)process_mmap(shell, NULL, PAGE_SIZE,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS);
+    if (bench == (void *)-1) {
+        printk("futex: cannot map the shared page\n");
+        return;
+    }
+    bench->rounds = rounds;
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Futex benchmark (%u rounds, MAP_SHARED page at 0x%x) ===\n",
+           rounds, (uint32_t)bench);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    /* Uncontended lock/unlock never enters the kernel */
+    uint32_t sys_before = shell->acct.syscalls;
+    uint64_t start = ktime_get_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+        futex_mutex_lock(&bench->mutex);
+        futex_mutex_unlock(&bench->mutex);
+    }
+    uint64_t elapsed = ktime_get_ns() - start;
+    printk("Uncontended lock+unlock: %u ns each, %u syscalls\n",
+           (uint32_t)div_u64(elapsed, rounds), shell->acct.syscalls - sys_before);
+
+    /* Timed wait on a value nobody changes */
+    timespec_t timeout = { 0, 20 * (int32_t)NSEC_PER_MSEC };
+    start = ktime_get_ns();
+    int result = futex_call(&bench->turn, FUTEX_WAIT, 0, (uint32_t)&timeout, NULL);
+    printk("FUTEX_WAIT with 20 ms timeout: returned %d after %u us\n", result,
+           (uint32_t)div_u64(ktime_get_ns() - start, NSEC_PER_USEC));
+
+    /* Partner process: own (copied) address space, same shared page */
+    int pid;
+    __asm__ volatile(
+        "int $0x80"
+        : "=a"(pid)
+        : "a"(SYS_CLONE), "b"(0), "c"(futex_bench_child), "d"(bench), "S"(0)
+        : "memory"
+    );
+    if (pid < 0) {
+        printk("futex: clone failed\n");
+        process_munmap(shell, bench, PAGE_SIZE);
+        return;
+    }
+
+    /* Ping-pong: hand the turn over and sleep until it comes back */
+    start = ktime_get_ns();
+    for (uint32_t i = 0; i < rounds; i++) {
+        bench->turn = 1;
+        futex_call(&bench->turn, FUTEX_WAKE, 1, 0, NULL);
+        while (bench->turn != 0) {
+            futex_call(&bench->turn, FUTEX_WAIT, 1, 0, NULL);
+        }
+    }
+    elapsed = ktime_get_ns() - start;
+    printk("Ping-pong with PID %d: %u ns per round trip\n", pid,
+           (uint32_t)div_u64(elapsed, rounds));
+
+    /* Contended mutex: both processes increment the shared counter */
+    sys_before = shell->acct.syscalls;
+    for (uint32_t i = 0; i < rounds; i++) {
+        futex_mutex_lock(&bench->mutex);
+        bench->counter++;
+        futex_mutex_unlock(&bench->mutex);
+    }
+
+    /* Reap the partner (and any older zombie children of the shell) */
+    int status;
+    do {
+        __asm__ volatile("int $0x80" : "=a"(result) : "a"(SYS_WAIT), "b"(&status) : "memory");
+    } while (result >= 0 && result != pid);
+    printk("Shared counter: %u (expected %u), shell lock syscalls %u\n",
+           bench->counter, 2 * rounds, shell->acct.syscalls - sys_before);
+
+    process_munmap(shell, bench, PAGE_SIZE);
+    futex_print_stats();
+}
+
+/* Child of the exec command: replace itself with the binary */
+static int exec_child(void *arg) {
+    int result;
+    __asm__ volatile("int $0x80" : "=a"(result) : "a"(SYS_EXECVE), "b"(arg), "c"(0), "d"(0) : "memory");
+
+    printk("exec: %s: cannot execute\n", (const char *)arg);
+    return 127;
+}
+
+/* Command: exec [path] - run a binary and report what it faulted in */
+static void cmd_exec(int argc, char **argv) {
+    if (argc < 2) {
+        exec_print_stats();
+        return;
+    }
+
+    vfs_node_t *file = resolve_path_from_pwd(argv[1]);
+    if (!file || file->type != VFS_FILE_TYPE_REGULAR) {
+        printk("exec: %s: No such file\n", argv[1]);
+        return;
+    }
+    uint32_t image_size = file->size;
+
+    /* The child reads the path after the shell's stack frame may change */
+    char *path = (char *)kmalloc(strlen(argv[1]) + 1);
+    if (!path) {
+        printk("exec: out of memory\n");
+        return;
+    }
+    strcpy(path, argv[1]);
+
+    exec_stats_t before;
+    exec_get_stats(&before);
+    uint64_t start = ktime_get_ns();
+
+    int pid;
+    __asm__ volatile(
+        "int $0x80"
+        : "=a"(pid)
+        : "a"(SYS_CLONE), "b"(0), "c"(exec_child), "d"(path), "S"(0)
+        : "memory"
+    );
+    if (pid < 0) {
+        printk("exec: clone failed\n");
+        kfree(path);
+        return;
+    }
+
+    int result, status = 0;
+    do {
+        __asm__ volatile("int $0x80" : "=a"(result) : "a"(SYS_WAIT), "b"(&status) : "memory");
+    } while (result >= 0 && result != pid);
+    uint64_t elapsed = ktime_get_ns() - start;
+    kfree(path);
+
+    exec_stats_t after;
+    exec_get_stats(&after);
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== exec %s (PID %d) ===\n", argv[1], pid);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+    printk("Exit status %d, run time %u us (execve %u us)\n", status,
+           (uint32_t)div_u64(elapsed, NSEC_PER_USEC),
+           (uint32_t)div_u64(after.load_ns - before.load_ns, NSEC_PER_USEC));
+    printk("Image %u bytes (%u pages); faulted in %u from file (%u shared from the page cache, %u bytes read), %u demand-zero\n",
+           image_size, (image_size + PAGE_SIZE - 1) / PAGE_SIZE,
+           after.file_faults - before.file_faults,
+           after.cache_faults - before.cache_faults,
+           (uint32_t)(after.bytes_read - before.bytes_read),
+           after.zero_faults - before.zero_faults);
+}
+
+/* Quiet child for the launch benchmark: exec or fail with 127 */
+static int launch_exec_child(void *arg) {
+    int result;
+    __asm__ volatile("int $0x80" : "=a"(result) : "a"(SYS_EXECVE), "b"(arg), "c"(0), "d"(0) : "memory");
+    return 127;
+}
+
+/* Start one child with the given method and reap it; returns its exit status */
+static int launch_one(int method, const char *path) {
+    int pid;
+    switch (method) {
+        case 0:  /* fork + exec: the child gets a copy of our address space */
+            __asm__ volatile("int $0x80" : "=a"(pid)
+                             : "a"(SYS_CLONE), "b"(0), "c"(launch_exec_child), "d"(path), "S"(0)
+                             : "memory");
+            break;
+        case 1:  /* vfork + exec: the child borrows it, we sleep until the exec */
+            __asm__ volatile("int $0x80" : "=a"(pid)
+                             : "a"(SYS_VFORK), "b"(launch_exec_child), "c"(path)
+                             : "memory");
+            break;
+        default: /* spawn: a fresh image, nothing borrowed */
+            __asm__ volatile("int $0x80" : "=a"(pid)
+                             : "a"(SYS_SPAWN), "b"(path), "c"(0)
+                             : "memory");
+            break;
+    }
+    if (pid < 0) {
+        return -1;
+    }
+
+    int result, status = -1;
+    do {
+        __asm__ volatile("int $0x80" : "=a"(result) : "a"(SYS_WAIT), "b"(&status) : "memory");
+    } while (result >= 0 && result != pid);
+    return status;
+}
+
+/* Command: launch [count] [path] - process creation throughput */
+static void cmd_launch(int argc, char **argv) {
+    static const char *methods[] = { "fork+exec", "vfork+exec", "spawn" };
+    uint32_t count = argc >= 2 ? (uint32_t)atoi(argv[1]) : 100;
+    const char *path = argc >= 3 ? argv[2] : "/bin/true";
+    if (count == 0) {
+        count = 100;
+    }
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Process launch: %u x %s ===\n", count, path);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    process_t *shell = process_get_current();
+    printk("Shell address space: %u resident pages\n",
+           shell->page_directory ? paging_count_user_pages(shell->page_directory) : 0);
+
+    for (int method = 0; method < 3; method++) {
+        uint32_t failed = 0;
+        uint64_t start = ktime_get_ns();
+        for (uint32_t i = 0; i < count; i++) {
+            if (launch_one(method, path) != 0) {
+                failed++;
+            }
+        }
+        uint64_t elapsed = ktime_get_ns() - start;
+        uint32_t per_launch = (uint32_t)div_u64(elapsed, count);
+
+        printk("  %s: %u us per launch, %u launches/s", methods[method],
+               per_launch / 1000,
+               per_launch ? (uint32_t)div_u64(1000000000ULL, per_launch) : 0);
+        if (failed) {
+            printk(" (%u failed)", failed);
+        }
+        printk("\n");
+    }
+}
+
+/* Signal storm handlers: count deliveries and sum the queued values */
+static volatile uint32_t sigstorm_delivered;
+static volatile uint32_t sigstorm_value_sum;
+
+static void sigstorm_handler(int sig) {
+    (void)sig;
+    sigstorm_delivered++;
+}
+
+static void sigstorm_info_handler(int sig, uint32_t value) {
+    (void)sig;
+    sigstorm_delivered++;
+    sigstorm_value_sum += value;
+}
+
+/* Command: sigstorm [count] - send and deliver signals to the shell */
+static void cmd_sigstorm(int argc, char **argv) {
+    uint32_t count = argc >= 2 ? (uint32_t)atoi(argv[1]) : 10000;
+    if (count == 0) {
+        count = 10000;
+    }
+
+    process_t *shell = process_get_current();
+    if (!shell) {
+        printk("sigstorm: no current process\n");
+        return;
+    }
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Signal storm: %u signals ===\n", count);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    process_signal_register(shell, SIGUSR1, sigstorm_handler);
+    for (int sig = SIGRTMIN; sig <= SIGRTMAX; sig++) {
+        process_signal_register_info(shell, sig, sigstorm_info_handler);
+    }
+
+    size_t allocs_before, frees_before;
+    process_signal_stats_t before;
+    kmalloc_get_counts(&allocs_before, &frees_before);
+    process_signal_get_stats(&before);
+
+    /* Standard signal: repeated sends coalesce into one pending bit */
+    sigstorm_delivered = 0;
+    uint64_t start = ktime_get_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        process_signal_send(shell, SIGUSR1);
+        if ((i & 63) == 63) {
+            process_signal_process(shell);
+        }
+    }
+    process_signal_process(shell);
+    uint64_t std_ns = ktime_get_ns() - start;
+    uint32_t std_delivered = sigstorm_delivered;
+
+    /* Real-time signals: every one is queued with its value and
+     * delivered; drain the queue whenever it fills up */
+    uint32_t expected_sum = 0, overflows = 0;
+    sigstorm_delivered = 0;
+    sigstorm_value_sum = 0;
+    start = ktime_get_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        int sig = SIGRTMIN + (int)(i % (SIGRTMAX - SIGRTMIN + 1));
+        while (process_signal_queue(shell, sig, i) != 0) {
+            overflows++;
+            process_signal_process(shell);
+        }
+        expected_sum += i;
+    }
+    process_signal_process(shell);
+    uint64_t rt_ns = ktime_get_ns() - start;
+
+    size_t allocs_after, frees_after;
+    process_signal_stats_t after;
+    kmalloc_get_counts(&allocs_after, &frees_after);
+    process_signal_get_stats(&after);
+
+    process_signal_register(shell, SIGUSR1, NULL);
+    for (int sig = SIGRTMIN; sig <= SIGRTMAX; sig++) {
+        process_signal_register(shell, sig, NULL);
+    }
+
+    printk("Standard (SIGUSR1): %u ns per send+deliver, %u delivered, %u coalesced\n",
+           (uint32_t)div_u64(std_ns, count), std_delivered,
+           after.coalesced - before.coalesced);
+    printk("Real-time (%d-%d): %u ns per queue+deliver, %u delivered, %u queue-full drains\n",
+           SIGRTMIN, SIGRTMAX, (uint32_t)div_u64(rt_ns, count),
+           sigstorm_delivered, overflows);
+    printk("Payloads %s\n", sigstorm_value_sum == expected_sum && sigstorm_delivered == count
+           ? "all delivered" : "LOST");
+    printk("Heap traffic during the storm: %u kmalloc, %u kfree\n",
+           (uint32_t)(allocs_after - allocs_before), (uint32_t)(frees_after - frees_before));
+}
+
+/* Time count null syscalls (getpid) through one entry stub; returns
+ * cycles per call and stores nanoseconds per call */
+static uint32_t syscallbench_run(void (*entry)(void), uint32_t count, uint32_t *ns_per_call) {
+    syscall_call(entry, SYS_GETPID, 0, 0, 0, 0, 0);  /* Warm up */
+
+    uint64_t start_ns = ktime_get_ns();
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        syscall_call(entry, SYS_GETPID, 0, 0, 0, 0, 0);
+    }
+    uint64_t cycles = rdtsc() - start;
+    *ns_per_call = (uint32_t)div_u64(ktime_get_ns() - start_ns, count);
+    return (uint32_t)div_u64(cycles, count);
+}
+
+/* Command: syscallbench [count] - null syscall cost per entry path */
+static void cmd_syscallbench(int argc, char **argv) {
+    uint32_t count = argc >= 2 ? (uint32_t)atoi(argv[1]) : 100000;
+    if (count == 0) {
+        count = 100000;
+    }
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Null syscall (getpid) x %u ===\n", count);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    uint32_t int80_ns, sysenter_ns;
+    uint32_t int80 = syscallbench_run(syscall_int80, count, &int80_ns);
+    printk("  INT 0x80: %u cycles, %u ns per call\n", int80, int80_ns);
+
+    if (!syscall_sysenter_enabled()) {
+        printk("  SYSENTER: not supported by this CPU\n");
+        return;
+    }
+
+    uint32_t sysenter = syscallbench_run(syscall_sysenter, count, &sysenter_ns);
+    printk("  SYSENTER: %u cycles, %u ns per call\n", sysenter, sysenter_ns);
+    if (sysenter) {
+        uint32_t ratio = int80 * 10 / sysenter;
+        printk("  SYSENTER is %u.%u times faster\n", ratio / 10, ratio % 10);
+    }
+}
+
+/* Command: vdso [count] - vDSO contents, and the cost of reading the
+ * uid and the time through it versus through the kernel */
+static void cmd_vdso(int argc, char **argv) {
+    uint32_t count = argc >= 2 ? (uint32_t)atoi(argv[1]) : 100000;
+    if (count == 0) {
+        count = 100000;
+    }
+
+    vdso_print_info();
+
+    uint64_t (*gettime)(void) = vdso_sym(vdso_clock_gettime_ns);
+    uint32_t (*getuid)(void) = vdso_sym(vdso_getuid);
+    uint32_t (*getpid)(void) = vdso_sym(vdso_getpid);
+
+    printk("Through the code page: pid %u, uid %u, %u ms since boot\n",
+           getpid(), getuid(), (uint32_t)div_u64(gettime(), NSEC_PER_MSEC));
+    printk("Through the kernel:    pid %d, uid %d, %u ms since boot\n",
+           syscall_call(syscall_entry, SYS_GETPID, 0, 0, 0, 0, 0),
+           syscall_call(syscall_entry, SYS_GETUID, 0, 0, 0, 0, 0),
+           (uint32_t)div_u64(ktime_get_ns(), NSEC_PER_MSEC));
+
+    /* getuid: vDSO load versus system call */
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        getuid();
+    }
+    uint32_t vdso_uid = (uint32_t)div_u64(rdtsc() - start, count);
+
+    start = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        syscall_call(syscall_entry, SYS_GETUID, 0, 0, 0, 0, 0);
+    }
+    uint32_t sys_uid = (uint32_t)div_u64(rdtsc() - start, count);
+
+    /* Time: vDSO seqlock read versus ktime_get_ns(), checking that it
+     * never goes backwards */
+    uint32_t backwards = 0;
+    uint64_t last = 0;
+    start = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t now = gettime();
+        if (now < last) {
+            backwards++;
+        }
+        last = now;
+    }
+    uint32_t vdso_time = (uint32_t)div_u64(rdtsc() - start, count);
+
+    start = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        ktime_get_ns();
+    }
+    uint32_t kernel_time = (uint32_t)div_u64(rdtsc() - start, count);
+
+    printk("getuid: %u cycles via vDSO, %u cycles via %s\n", vdso_uid, sys_uid,
+           syscall_sysenter_enabled() ? "SYSENTER" : "INT 0x80");
+    printk("time:   %u cycles via vDSO, %u cycles in-kernel ktime_get_ns (%u went backwards)\n",
+           vdso_time, kernel_time, backwards);
+}
+
+/* Queue one entry (the caller checked there is room) */
+static void uring_queue(uring_shared_t *sh, uint8_t opcode, uint32_t user_data) {
+    uring_sqe_t *sqe = &sh->sqes[sh->sq_tail & (URING_SQ_ENTRIES - 1)];
+    memset(sqe, 0, sizeof(uring_sqe_t));
+    sqe->opcode = opcode;
+    sqe->user_data = user_data;
+    __asm__ volatile("" ::: "memory");
+    sh->sq_tail++;
+}
+
+/* Reap every available completion; returns how many */
+static uint32_t uring_reap(uring_shared_t *sh) {
+    uint32_t n = sh->cq_tail - sh->cq_head;
+    sh->cq_head += n;
+    return n;
+}
+
+/* Run count nops through a ring in batches; returns cycles per op and
+ * stores the number of system calls it took */
+static uint32_t uring_nop_run(uint32_t flags, uint32_t count, uint32_t batch, uint32_t *syscalls) {
+    uint32_t addr;
+    *syscalls = 0;
+    int ring = syscall_call(syscall_entry, SYS_URING_SETUP, flags, (uint32_t)&addr, 0, 0, 0);
+    if (ring < 0) {
+        return 0;
+    }
+    uring_shared_t *sh = (uring_shared_t *)addr;
+
+    uint64_t start = rdtsc();
+    for (uint32_t done = 0; done < count; ) {
+        uint32_t n = count - done < batch ? count - done : batch;
+        for (uint32_t i = 0; i < n; i++) {
+            uring_queue(sh, URING_OP_NOP, done + i);
+        }
+
+        uint32_t enter_flags = URING_ENTER_GETEVENTS;
+        if ((flags & URING_SETUP_SQPOLL) && (sh->flags & URING_SQ_NEED_WAKEUP)) {
+            enter_flags |= URING_ENTER_SQ_WAKEUP;
+        }
+        syscall_call(syscall_entry, SYS_URING_ENTER, (uint32_t)ring, n, n, enter_flags, 0);
+        (*syscalls)++;
+        done += uring_reap(sh);
+    }
+    uint32_t cycles = (uint32_t)div_u64(rdtsc() - start, count);
+
+    syscall_call(syscall_entry, SYS_URING_CLOSE, (uint32_t)ring, 0, 0, 0, 0);
+    return cycles;
+}
+
+/* Command: uring [count] - batched nops vs one syscall each, and a mix
+ * of inline and asynchronous operations */
+static void cmd_uring(int argc, char **argv) {
+    uint32_t count = argc >= 2 ? (uint32_t)atoi(argv[1]) : 10000;
+    if (count == 0) {
+        count = 10000;
+    }
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Submission rings: %u operations ===\n", count);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        syscall_call(syscall_entry, SYS_GETPID, 0, 0, 0, 0, 0);
+    }
+    printk("  One syscall each:     %u cycles per op, %u syscalls\n",
+           (uint32_t)div_u64(rdtsc() - start, count), count);
+
+    uint32_t syscalls;
+    uint32_t cycles = uring_nop_run(0, count, 32, &syscalls);
+    printk("  Ring, batches of 32:  %u cycles per op, %u syscalls\n", cycles, syscalls);
+    cycles = uring_nop_run(URING_SETUP_SQPOLL, count, 32, &syscalls);
+    printk("  SQPOLL ring:          %u cycles per op, %u syscalls (waits only)\n", cycles, syscalls);
+
+    /* Mixed batch: a file read and a timeout run in the ring's thread
+     * while the nops complete in the doorbell call */
+    uint32_t addr;
+    int ring = syscall_call(syscall_entry, SYS_URING_SETUP, 0, (uint32_t)&addr, 0, 0, 0);
+    if (ring < 0) {
+        printk("uring: setup failed\n");
+        return;
+    }
+    uring_shared_t *sh = (uring_shared_t *)addr;
+    static char buf[64];
+    static const char path[] = "/bin/hello";
+
+    uring_sqe_t *sqe = &sh->sqes[sh->sq_tail & (URING_SQ_ENTRIES - 1)];
+    memset(sqe, 0, sizeof(uring_sqe_t));
+    sqe->opcode = URING_OP_TIMEOUT;
+    sqe->off = 50;
+    sqe->user_data = 1;
+    sh->sq_tail++;
+
+    sqe = &sh->sqes[sh->sq_tail & (URING_SQ_ENTRIES - 1)];
+    memset(sqe, 0, sizeof(uring_sqe_t));
+    sqe->opcode = URING_OP_READ;
+    sqe->addr = (uint32_t)buf;
+    sqe->len = sizeof(buf);
+    sqe->path = (uint32_t)path;
+    sqe->user_data = 2;
+    sh->sq_tail++;
+
+    uring_queue(sh, URING_OP_NOP, 3);
+
+    uint64_t t0 = ktime_get_ns();
+    int submitted = syscall_call(syscall_entry, SYS_URING_ENTER, (uint32_t)ring, 3, 3,
+                                 URING_ENTER_GETEVENTS, 0);
+    uint32_t waited = (uint32_t)div_u64(ktime_get_ns() - t0, NSEC_PER_USEC);
+
+    printk("  Mixed batch: %d submitted in one call, all done after %u us:\n", submitted, waited);
+    while (sh->cq_head != sh->cq_tail) {
+        uring_cqe_t *cqe = &sh->cqes[sh->cq_head & (URING_CQ_ENTRIES - 1)];
+        static const char *names[] = { "", "timeout 50 ms", "read /bin/hello", "nop" };
+        printk("    %s: %d\n", cqe->user_data < 4 ? names[cqe->user_data] : "?", cqe->res);
+        sh->cq_head++;
+    }
+
+    uring_print_stats();
+    syscall_call(syscall_entry, SYS_URING_CLOSE, (uint32_t)ring, 0, 0, 0, 0);
+}
+
+static void sysstat_untrace(process_t *proc, void *data) {
+    (void)data;
+    __sync_fetch_and_and(&proc->flags, ~PROCESS_FLAG_STRACE);
+}
+
+/* SYSSTAT command - per-syscall statistics and the syscall trace */
+static void cmd_sysstat(int argc, char **argv) {
+    if (argc < 2) {
+        sysstat_print();
+        return;
+    }
+
+    if (strcmp(argv[1], "on") == 0) {
+        if (sysstat_enable(SYSSTAT_COUNT) < 0) {
+            printk("sysstat: no TSC\n");
+            return;
+        }
+        printk("Syscall statistics on\n");
+    } else if (strcmp(argv[1], "off") == 0) {
+        sysstat_disable(SYSSTAT_COUNT | SYSSTAT_TRACE);
+        process_for_each(sysstat_untrace, NULL);
+        printk("Syscall statistics and trace off\n");
+    } else if (strcmp(argv[1], "reset") == 0) {
+        sysstat_reset();
+        printk("Syscall statistics reset\n");
+    } else if (strcmp(argv[1], "hist") == 0 && argc >= 3) {
+        sysstat_print_hist((uint32_t)atoi(argv[2]));
+    } else if (strcmp(argv[1], "log") == 0) {
+        sysstat_print_trace();
+    } else if (strcmp(argv[1], "trace") == 0 && argc >= 3) {
+        if (strcmp(argv[2], "off") == 0) {
+            sysstat_disable(SYSSTAT_TRACE);
+            process_for_each(sysstat_untrace, NULL);
+            printk("Syscall trace off\n");
+            return;
+        }
+        process_t *proc = process_get_by_pid((uint32_t)atoi(argv[2]));
+        if (!proc) {
+            printk("sysstat: no such process: %s\n", argv[2]);
+            return;
+        }
+        if (sysstat_enable(SYSSTAT_TRACE) < 0) {
+            printk("sysstat: no TSC\n");
+            return;
+        }
+        proc->flags |= PROCESS_FLAG_STRACE;
+        printk("Tracing syscalls of PID %u (%s)\n", proc->pid, proc->name);
+    } else {
+        printk("Usage: sysstat [on|off|reset|log|hist <nr>|trace <pid>|trace off]\n");
+    }
+}
+
+/* Read a whole descriptor in len-byte calls; returns bytes, counts calls */
+static uint32_t fileio_read_all(int fd, char *buf, uint32_t len, uint32_t *calls) {
+    uint32_t total = 0;
+    *calls = 0;
+    syscall_call(syscall_entry, SYS_LSEEK, (uint32_t)fd, 0, SEEK_SET, 0, 0);
+    for (;;) {
+        int n = syscall_call(syscall_entry, SYS_READ, (uint32_t)fd, (uint32_t)buf, len, 0, 0);
+        (*calls)++;
+        if (n <= 0) {
+            break;
+        }
+        total += (uint32_t)n;
+    }
+    return total;
+}
+
+/* FILEIO command - walk a file through the descriptor syscalls */
+static void cmd_fileio(int argc, char **argv) {
+    const char *path = argc >= 2 ? argv[1] : "/bin/hello";
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== File descriptors: %s ===\n", path);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    int fd = syscall_call(syscall_entry, SYS_OPEN, (uint32_t)path, O_RDONLY, 0, 0, 0);
+    if (fd < 0) {
+        printk("fileio: cannot open %s\n", path);
+        return;
+    }
+    int size = syscall_call(syscall_entry, SYS_LSEEK, (uint32_t)fd, 0, SEEK_END, 0, 0);
+    printk("  open -> fd %d, lseek(SEEK_END) -> %d bytes\n", fd, size);
+
+    /* Small reads against one large one */
+    uint32_t big = size > 0 ? (uint32_t)size : 4096;
+    if (big > 256 * 1024) {
+        big = 256 * 1024;
+    }
+    char *buf = (char *)kmalloc(big);
+    if (!buf) {
+        printk("fileio: out of memory\n");
+        syscall_call(syscall_entry, SYS_CLOSE, (uint32_t)fd, 0, 0, 0, 0);
+        return;
+    }
+    uint32_t calls;
+    uint64_t start = rdtsc();
+    uint32_t bytes = fileio_read_all(fd, buf, 512, &calls);
+    printk("  read(512) loop:  %u bytes in %u calls, %u cycles\n",
+           bytes, calls, (uint32_t)(rdtsc() - start));
+    start = rdtsc();
+    bytes = fileio_read_all(fd, buf, big, &calls);
+    printk("  read(%u):  %u bytes in %u calls, %u cycles\n",
+           big, bytes, calls, (uint32_t)(rdtsc() - start));
+
+    /* Scatter read, positional read, shared offset through dup2 */
+    static char head[8], tail[8];
+    iovec_t iov[2] = {
+        { (uint32_t)head, sizeof(head) },
+        { (uint32_t)tail, sizeof(tail) },
+    };
+    syscall_call(syscall_entry, SYS_LSEEK, (uint32_t)fd, 0, SEEK_SET, 0, 0);
+    int n = syscall_call(syscall_entry, SYS_READV, (uint32_t)fd, (uint32_t)iov, 2, 0, 0);
+    printk("  readv(2 x 8) -> %d, offset now %d\n", n,
+           syscall_call(syscall_entry, SYS_LSEEK, (uint32_t)fd, 0, SEEK_CUR, 0, 0));
+    n = syscall_call(syscall_entry, SYS_PREAD, (uint32_t)fd, (uint32_t)head, 4, 1, 0);
+    printk("  pread(4 at 1) -> %d, offset still %d\n", n,
+           syscall_call(syscall_entry, SYS_LSEEK, (uint32_t)fd, 0, SEEK_CUR, 0, 0));
+    int dup = syscall_call(syscall_entry, SYS_DUP2, (uint32_t)fd, 10, 0, 0, 0);
+    syscall_call(syscall_entry, SYS_READ, (uint32_t)dup, (uint32_t)head, 4, 0, 0);
+    printk("  dup2 -> fd %d; after reading 4 there, fd %d is at %d\n", dup, fd,
+           syscall_call(syscall_entry, SYS_LSEEK, (uint32_t)fd, 0, SEEK_CUR, 0, 0));
+
+    /* Gather write to the console */
+    static const char part1[] = "  writev to fd 1: ";
+    static const char part2[] = "two buffers, one call\n";
+    iovec_t out[2] = {
+        { (uint32_t)part1, sizeof(part1) - 1 },
+        { (uint32_t)part2, sizeof(part2) - 1 },
+    };
+    syscall_call(syscall_entry, SYS_WRITEV, STDOUT_FILENO, (uint32_t)out, 2, 0, 0);
+
+    files_print();
+
+    syscall_call(syscall_entry, SYS_CLOSE, (uint32_t)dup, 0, 0, 0, 0);
+    syscall_call(syscall_entry, SYS_CLOSE, (uint32_t)fd, 0, 0, 0, 0);
+    kfree(buf);
+}
+
+/* SMP benchmark: every worker runs the same CPU-bound loop */
+#define SMP_BENCH_LOOPS 5000000
+static volatile uint32_t smp_bench_done;
+
+static int smp_bench_worker(void *data) {
+    (void)data;
+    volatile uint32_t x = 1;
+    for (uint32_t i = 0; i < SMP_BENCH_LOOPS; i++) {
+        x = x * 1103515245 + 12345;
+    }
+    __sync_fetch_and_add(&smp_bench_done, 1);
+    return 0;
+}
+
+/* Run n workers to completion; returns the elapsed ns (0 on failure) */
+static uint64_t smp_bench_run(uint32_t n) {
+    smp_bench_done = 0;
+    uint64_t start = ktime_get_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        if (!kthread_create(smp_bench_worker, NULL, "smpbench")) {
+            printk("smp: cannot create worker %u\n", i);
+            while (smp_bench_done < i) {
+                timer_wait(1);
+            }
+            return 0;
+        }
+    }
+    while (smp_bench_done < n) {
+        timer_wait(1);
+    }
+    return ktime_get_ns() - start;
+}
+
+/* SMP command - CPU table, or throughput of 1..n CPU-bound workers */
+static void cmd_smp(int argc, char **argv) {
+    if (argc < 2 || strcmp(argv[1], "bench") != 0) {
+        smp_print_info();
+        return;
+    }
+
+    uint32_t max = argc >= 3 ? (uint32_t)atoi(argv[2]) : smp_online_cpus();
+    if (max == 0) {
+        max = 1;
+    }
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== SMP scaling: 1..%u workers x %u iterations, %u CPUs ===\n",
+           max, SMP_BENCH_LOOPS, smp_online_cpus());
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    uint64_t base_rate = 0;
+    for (uint32_t n = 1; n <= max; n++) {
+        uint64_t elapsed = smp_bench_run(n);
+        if (!elapsed) {
+            return;
+        }
+
+        /* Iterations per ms across all workers; speedup against one */
+        uint64_t rate = div_u64((uint64_t)n * SMP_BENCH_LOOPS * NSEC_PER_MSEC, elapsed);
+        if (n == 1) {
+            base_rate = rate ? rate : 1;
+        }
+        uint32_t speedup = (uint32_t)div_u64(rate * 100, base_rate);
+        printk("  %u worker%s: %u ms, %u iterations/ms, speedup %u.%u%ux\n",
+               n, n == 1 ? " " : "s", (uint32_t)div_u64(elapsed, NSEC_PER_MSEC),
+               (uint32_t)rate, speedup / 100, (speedup / 10) % 10, speedup % 10);
+    }
+}
+
+/* irq bench: acknowledgements timed on each controller */
+#define IRQ_BENCH_DEFAULT 100000
+
+/* irq - Show the interrupt controller, per-line counts and handler
+ * cycles and the I/O APIC routes, or time EOIs on the PIC and the APIC */
+static void cmd_irq(int argc, char **argv) {
+    if (argc < 2 || strcmp(argv[1], "bench") != 0) {
+        irq_print_info();
+        if (apic_timer_enabled()) {
+            printk("\nLocal APIC timer: %u kHz, %d Hz on every CPU\n",
+                   apic_timer_frequency() / 1000, TIMER_FREQUENCY);
+        } else {
+            printk("\nTicks: PIT on CPU 0%s\n",
+                   smp_online_cpus() > 1 ? ", relayed by IPI" : "");
+        }
+        return;
+    }
+
+    uint32_t count = argc >= 3 ? (uint32_t)atoi(argv[2]) : IRQ_BENCH_DEFAULT;
+    if (count == 0) {
+        count = IRQ_BENCH_DEFAULT;
+    }
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== EOI cost: %u acknowledgements (in use: %s) ===\n",
+           count, irq_controller_name());
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    /* Nothing is in service on this CPU outside a handler, so these
+     * acknowledge nothing; handlers acknowledge before switching away */
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        pic_send_eoi(0);
+    }
+    uint32_t pic_cycles = (uint32_t)div_u64(rdtsc() - start, count);
+    printk("8259 PIC:   %u cycles per EOI (outb)\n", pic_cycles);
+
+    if (!apic_enabled()) {
+        printk("Local APIC: not available\n");
+        return;
+    }
+
+    start = rdtsc();
+    for (uint32_t i = 0; i < count; i++) {
+        apic_eoi();
+    }
+    uint32_t apic_cycles = (uint32_t)div_u64(rdtsc() - start, count);
+    uint32_t ratio = apic_cycles ? pic_cycles * 10 / apic_cycles : 0;
+    printk("Local APIC: %u cycles per EOI (MMIO write), %u.%ux cheaper\n",
+           apic_cycles, ratio / 10, ratio % 10);
+    printk("Per-line handler cycles (EOI included): 'irq'\n");
+}
+
+/* lockstat - Show lock contention per class, or start, stop or clear it */
+static void cmd_lockstat(int argc, char **argv) {
+    if (argc >= 2) {
+        if (strcmp(argv[1], "on") == 0) {
+            lockstat_enable(true);
+            printk("Lock statistics on\n");
+        } else if (strcmp(argv[1], "off") == 0) {
+            lockstat_enable(false);
+            printk("Lock statistics off\n");
+        } else if (strcmp(argv[1], "reset") == 0) {
+            lockstat_reset();
+            printk("Lock statistics cleared\n");
+        } else {
+            printk("Usage: lockstat [on|off|reset]\n");
+        }
+        return;
+    }
+
+    lockstat_print();
+}
+
+/* preempt - Show the preemption mode and counters, or change the mode */
+static void cmd_preempt(int argc, char **argv) {
+    if (argc >= 2) {
+        if (strcmp(argv[1], "throughput") == 0) {
+            preempt_set_mode(PREEMPT_THROUGHPUT);
+        } else if (strcmp(argv[1], "lowlatency") == 0) {
+            preempt_set_mode(PREEMPT_LOWLATENCY);
+        } else {
+            printk("Usage: preempt [throughput|lowlatency]\n");
+            return;
+        }
+        printk("Preemption mode: %s\n", preempt_mode_name(preempt_get_mode()));
+        return;
+    }
+
+    preempt_print_info();
+}
+
+/* irqsoff - Show the longest interrupts-off and preemption-off windows,
+ * or start, stop or clear tracing */
+static void cmd_irqsoff(int argc, char **argv) {
+    if (argc >= 2) {
+        if (strcmp(argv[1], "on") == 0) {
+            irqsoff_enable(true);
+            printk("Latency tracer on\n");
+        } else if (strcmp(argv[1], "off") == 0) {
+            irqsoff_enable(false);
+            printk("Latency tracer off\n");
+        } else if (strcmp(argv[1], "reset") == 0) {
+            irqsoff_reset();
+            printk("Latency tracer cleared\n");
+        } else {
+            printk("Usage: irqsoff [on|off|reset]\n");
+        }
+        return;
+    }
+
+    irqsoff_print();
+}
+
 /* Dummy entry point for shell process (never actually called) */
 static void shell_process_entry(void) {
     /* This function is never called - the shell runs in kernel mode
@@ -1179,6 +2508,8 @@ static void shell_process_entry(void) {
 static void shell_create_process(void) {
     process_t *shell_proc = process_create(shell_process_entry, 0);  /* UID 0 = root initially */
     if (shell_proc) {
+        process_set_name(shell_proc, "shell");
+
         /* Set shell process as current so cd/pwd/etc work */
         process_set_current(shell_proc);
     }
@@ -1266,7 +2597,7 @@ static int shell_login(void) {
                             /* Update current process UID */
                             process_t *proc = process_get_current();
                             if (proc) {
-                                proc->uid = current_uid;
+                                process_set_uid(proc, current_uid);
                             }
 
                             return 0;  /* Success */
@@ -1306,7 +2637,7 @@ static int shell_login(void) {
                 }
             }
         } else {
-            __asm__ volatile("hlt");
+            keyboard_wait();
         }
     }
 }
@@ -1362,8 +2693,8 @@ void shell_run(void) {
             /* Handle shell input */
             shell_handle_input(c);
         } else {
-            /* No input available - halt CPU until next interrupt (saves CPU!) */
-            __asm__ volatile("hlt");
+            /* No input available - sleep until the keyboard IRQ wakes us */
+            keyboard_wait();
         }
     }
 }
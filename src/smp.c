@@ -0,0 +1,353 @@
+/* smp.c - Symmetric multiprocessing: per-CPU data, AP startup, IPIs
+ *
+ * The boot CPU finds the others in the ACPI MADT and starts each one with
+ * INIT and STARTUP IPIs into trampoline.s, which brings it to
+ * smp_ap_entry in protected mode with paging on, running on the stack of
+ * its idle task. Every CPU has a cpu_t reached through its own GS segment
+ * (this_cpu()): current process, run queue, FPU owner, loaded directory.
+ *
+ * The rest of the kernel protects shared data by turning interrupts off;
+ * turning them off also takes the interrupt lock (idt.c), so those
+ * sections still exclude every other CPU. Processes running with
+ * interrupts on, which is where CPU-bound work spends its time, run in
+ * parallel. Every CPU takes its scheduling tick from its own local APIC
+ * timer, and the boot CPU's also keeps the global time. Only if the APIC
+ * timer is unusable does the PIT keep time, relaying its ticks to the
+ * others with an IPI.
+ *
+ * smp_init also moves device interrupts from the 8259 PIC to the I/O
+ * APIC (irq.c) once the local APIC is up, before the APs start.
+ */
+
+#include "../include/smp.h"
+#include "../include/apic.h"
+#include "../include/irq.h"
+#include "../include/idt.h"
+#include "../include/gdt.h"
+#include "../include/process.h"
+#include "../include/timer.h"
+#include "../include/clocksource.h"
+#include "../include/fpu.h"
+#include "../include/syscall.h"
+#include "../include/string.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+#include "../include/cpu.h"
+
+/* Wait for an AP to come online after its STARTUP IPIs */
+#define SMP_BOOT_TIMEOUT_NS (100 * NSEC_PER_MSEC)
+
+/* Startup code (trampoline.s) */
+extern uint8_t trampoline_start[];
+extern uint8_t trampoline_end[];
+extern uint8_t trampoline_params[];
+
+/* Parameter block at the end of the trampoline */
+typedef struct {
+    uint16_t gdt_limit;
+    uint32_t gdt_base;
+    uint16_t pad;
+    uint32_t cr3;
+    uint32_t stack;
+    uint32_t entry;
+    uint32_t arg;
+} __attribute__((packed)) trampoline_params_t;
+
+static cpu_t cpus[SMP_MAX_CPUS];
+
+/* One lockstat class for every run queue lock */
+static lock_class_t runqueue_lock_class = LOCK_CLASS_INIT("runqueue");
+static uint32_t smp_cpus = 1;
+
+/* The TLB shootdown in flight: only one at a time, since the sender
+ * holds the interrupt lock until every target has answered */
+static volatile uint32_t tlb_shootdown_mask = 0;     /* CPUs yet to flush */
+static volatile uint32_t tlb_shootdown_addr = 0;
+static uint32_t tlb_shootdowns = 0;
+
+/* Point GS at a CPU's per-CPU data */
+static void smp_load_gs(cpu_t *cpu) {
+    uint16_t selector = GDT_PERCPU_SELECTOR(cpu->id);
+    __asm__ volatile("mov %0, %%gs" : : "r"(selector) : "memory");
+}
+
+/* Fresh per-CPU data with an empty run queue */
+static void smp_init_cpu_data(cpu_t *cpu, uint32_t id) {
+    memset(cpu, 0, sizeof(cpu_t));
+    cpu->self = cpu;
+    cpu->id = id;
+    spin_lock_init_class(&cpu->rq.lock, &runqueue_lock_class);
+    list_init(&cpu->rq.tasks);
+    gdt_set_percpu(id, (uint32_t)cpu, sizeof(cpu_t));
+}
+
+/* Set up the boot CPU's per-CPU data and GS (right after gdt_init) */
+void smp_prepare_boot_cpu(void) {
+    smp_init_cpu_data(&cpus[0], 0);
+    cpus[0].online = true;
+    smp_load_gs(&cpus[0]);
+}
+
+/* Per-CPU data of CPU id */
+cpu_t *smp_cpu(uint32_t id) {
+    return id < SMP_MAX_CPUS ? &cpus[id] : NULL;
+}
+
+/* CPUs running the kernel */
+uint32_t smp_online_cpus(void) {
+    return smp_cpus;
+}
+
+/* Invalidate one page (or everything) in this CPU's TLB */
+static void smp_flush_local(uint32_t addr) {
+    if (addr == TLB_FLUSH_ALL) {
+        uint32_t cr3;
+        __asm__ volatile("mov %%cr3, %0; mov %0, %%cr3" : "=r"(cr3) : : "memory");
+    } else {
+        __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+    }
+}
+
+/* Answer a pending TLB shootdown */
+void smp_poll_ipis(void) {
+    uint32_t bit = 1u << smp_processor_id();
+
+    if (tlb_shootdown_mask & bit) {
+        smp_flush_local(tlb_shootdown_addr);
+        this_cpu()->tlb_flushes++;
+        __sync_fetch_and_and(&tlb_shootdown_mask, ~bit);
+    }
+}
+
+/* Invalidate addr here and on the other CPUs that may cache it */
+void smp_flush_tlb_page(page_directory_t *dir, uint32_t addr) {
+    if (smp_cpus == 1) {
+        smp_flush_local(addr);
+        return;
+    }
+
+    /* Interrupts off first: the caller must not move to another CPU
+     * between the local flush and picking the targets */
+    bool flags = interrupts_save();
+    uint32_t self = smp_processor_id();
+    uint32_t mask = 0;
+
+    smp_flush_local(addr);
+
+    /* A CPU that loads dir later starts with a clean TLB for it */
+    for (uint32_t i = 0; i < smp_cpus; i++) {
+        if (i != self && cpus[i].online && (!dir || cpus[i].directory == dir)) {
+            mask |= 1u << i;
+        }
+    }
+
+    if (mask) {
+        tlb_shootdown_addr = addr;
+        tlb_shootdown_mask = mask;
+        for (uint32_t i = 0; i < smp_cpus; i++) {
+            if (mask & (1u << i)) {
+                apic_send_ipi(cpus[i].apic_id, IPI_TLB_VECTOR);
+            }
+        }
+        while (tlb_shootdown_mask) {
+            cpu_relax();
+        }
+        tlb_shootdowns++;
+    }
+
+    interrupts_restore(flags);
+}
+
+/* Ask CPU id to reschedule (a no-op for this CPU: the flag is enough) */
+void smp_send_reschedule(uint32_t id) {
+    if (id < smp_cpus && id != smp_processor_id() && cpus[id].online) {
+        apic_send_ipi(cpus[id].apic_id, IPI_RESCHEDULE_VECTOR);
+    }
+}
+
+/* Relay a timer tick from the boot CPU to the others */
+void smp_send_tick(void) {
+    for (uint32_t i = 1; i < smp_cpus; i++) {
+        if (cpus[i].online) {
+            apic_send_ipi(cpus[i].apic_id, LOCAL_TIMER_VECTOR);
+        }
+    }
+}
+
+/* Halt the other CPUs */
+void smp_send_stop(void) {
+    uint32_t self = smp_processor_id();
+
+    for (uint32_t i = 0; i < smp_cpus; i++) {
+        if (i != self && cpus[i].online) {
+            apic_send_ipi(cpus[i].apic_id, IPI_STOP_VECTOR);
+        }
+    }
+}
+
+/* IPI handlers */
+static void smp_reschedule_ipi(struct interrupt_frame *frame) {
+    (void)frame;
+    this_cpu()->ipis++;
+    apic_eoi();
+    process_need_resched = true;
+}
+
+/* Local APIC timer or relayed tick */
+static void smp_local_timer(struct interrupt_frame *frame) {
+    if (!apic_timer_enabled()) {
+        this_cpu()->ipis++;
+    }
+    apic_eoi();
+    if (apic_timer_enabled() && smp_processor_id() == 0) {
+        timer_global_tick();
+    }
+    timer_local_tick(frame);
+}
+
+static void smp_tlb_ipi(struct interrupt_frame *frame) {
+    (void)frame;
+    this_cpu()->ipis++;
+    smp_poll_ipis();
+    apic_eoi();
+}
+
+static void smp_stop_ipi(struct interrupt_frame *frame) {
+    (void)frame;
+    this_cpu()->online = false;
+    while (1) {
+        __asm__ volatile("cli; hlt");
+    }
+}
+
+/* Busy-wait on the clocksource */
+static void smp_delay_ns(uint64_t ns) {
+    uint64_t deadline = ktime_get_ns() + ns;
+    while (ktime_get_ns() < deadline) {
+        cpu_relax();
+    }
+}
+
+/* C entry of an AP (trampoline.s): interrupts off, paging on, on the
+ * stack of its idle task, which it becomes */
+static void smp_ap_entry(cpu_t *cpu) {
+    smp_load_gs(cpu);
+    idt_load();
+    fpu_init_ap();
+    syscall_init_ap();
+    apic_init_ap();
+
+    cpu->directory = paging_get_kernel_directory();
+    cpu->current = cpu->idle;
+    cpu->idle->state = PROCESS_STATE_RUNNING;
+    __sync_synchronize();
+    cpu->online = true;
+
+    process_idle();
+}
+
+/* Start one AP as CPU id */
+static int smp_boot_cpu(uint32_t id, uint32_t apic) {
+    cpu_t *cpu = &cpus[id];
+
+    smp_init_cpu_data(cpu, id);
+    cpu->apic_id = apic;
+    cpu->idle = process_create_idle(id);
+    if (!cpu->idle) {
+        printk("[SMP] No memory for the idle task of CPU %d\n", id);
+        return -1;
+    }
+
+    trampoline_params_t *params = (trampoline_params_t *)
+        (SMP_TRAMPOLINE_BASE + (trampoline_params - trampoline_start));
+    __asm__ volatile("sgdt %0" : "=m"(*params));
+    params->cr3 = (uint32_t)paging_get_kernel_directory();
+    params->stack = cpu->idle->kernel_stack + KERNEL_STACK_SIZE;
+    params->entry = (uint32_t)smp_ap_entry;
+    params->arg = (uint32_t)cpu;
+
+    /* INIT, then up to two STARTUPs (MP specification sequence) */
+    apic_send_init(apic);
+    smp_delay_ns(10 * NSEC_PER_MSEC);
+    for (int i = 0; i < 2 && !cpu->online; i++) {
+        apic_send_startup(apic, SMP_TRAMPOLINE_BASE >> 12);
+        smp_delay_ns(200 * NSEC_PER_USEC);
+    }
+
+    uint64_t deadline = ktime_get_ns() + SMP_BOOT_TIMEOUT_NS;
+    while (!cpu->online && ktime_get_ns() < deadline) {
+        cpu_relax();
+    }
+    if (!cpu->online) {
+        /* INIT puts it back to waiting for a STARTUP, so it cannot run on
+         * this block or stack after all: free the idle task, and the slot
+         * goes to the next CPU that starts */
+        apic_send_init(apic);
+        process_free_idle(cpu->idle);
+        cpu->idle = NULL;
+        printk("[SMP] CPU with APIC ID %d did not start\n", apic);
+        return -1;
+    }
+    return 0;
+}
+
+/* Find the other CPUs and start them */
+void smp_init(void) {
+    if (apic_init() != 0) {
+        printk("[SMP] Uniprocessor\n");
+        return;
+    }
+    cpus[0].apic_id = apic_id();
+
+    idt_set_gate(IPI_RESCHEDULE_VECTOR, (uint32_t)isr240, 0x08, IDT_INTERRUPT | IDT_RING0);
+    idt_set_gate(LOCAL_TIMER_VECTOR, (uint32_t)isr241, 0x08, IDT_INTERRUPT | IDT_RING0);
+    idt_set_gate(IPI_TLB_VECTOR, (uint32_t)isr252, 0x08, IDT_INTERRUPT | IDT_RING0);
+    idt_set_gate(IPI_STOP_VECTOR, (uint32_t)isr253, 0x08, IDT_INTERRUPT | IDT_RING0);
+    idt_set_gate(APIC_SPURIOUS_VECTOR, (uint32_t)isr255, 0x08, IDT_INTERRUPT | IDT_RING0);
+    idt_register_handler(IPI_RESCHEDULE_VECTOR, smp_reschedule_ipi);
+    idt_register_handler(LOCAL_TIMER_VECTOR, smp_local_timer);
+    idt_register_handler(IPI_TLB_VECTOR, smp_tlb_ipi);
+    idt_register_handler(IPI_STOP_VECTOR, smp_stop_ipi);
+
+    /* Device interrupts through the I/O APIC (the PIC stays otherwise),
+     * then a local timer on every CPU, which the APs start themselves */
+    irq_use_ioapic();
+    if (apic_timer_init(TIMER_FREQUENCY) == 0) {
+        timer_apic_takeover();
+    }
+
+    memcpy((void *)SMP_TRAMPOLINE_BASE, trampoline_start,
+           (uint32_t)(trampoline_end - trampoline_start));
+
+    uint32_t present = apic_cpu_count();
+    for (uint32_t i = 1; i < present; i++) {
+        if (smp_boot_cpu(smp_cpus, apic_cpu_apic_id(i)) == 0) {
+            smp_cpus++;
+        }
+    }
+
+    printk("[SMP] %d of %d CPU%s online\n", smp_cpus, present, present == 1 ? "" : "s");
+}
+
+/* Print the CPU table */
+void smp_print_info(void) {
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== CPUs ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    for (uint32_t i = 0; i < smp_cpus; i++) {
+        cpu_t *cpu = &cpus[i];
+        struct process *curr = cpu->current;
+        uint32_t idle_pct = cpu->ticks ? cpu->idle_ticks * 100 / cpu->ticks : 0;
+
+        printk("CPU %d (APIC %d)%s: %s, %d on run queue\n", cpu->id, cpu->apic_id,
+               i == smp_processor_id() ? " [this CPU]" : "",
+               !cpu->online ? "offline" : (!curr || curr == cpu->idle) ? "idle" : curr->name,
+               cpu->rq.nr_running);
+        printk("  ticks %u (%u%% idle), %u switches, %u steals, %u IPIs, "
+               "%u TLB flushes, %u lock waits\n",
+               cpu->ticks, idle_pct, cpu->switches, cpu->steals, cpu->ipis,
+               cpu->tlb_flushes, cpu->irq_lock_waits);
+    }
+    printk("TLB shootdowns sent: %u\n", tlb_shootdowns);
+}
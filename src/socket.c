@@ -6,10 +6,17 @@
 #include "../include/kmalloc.h"
 #include "../include/process.h"
 #include "../include/panic.h"
+#include "../include/file.h"
+#include "../include/mutex.h"
 
 /* Socket table */
 static socket_t socket_table[MAX_SOCKETS];
 
+/* Guards the table and every socket in it. A mutex rather than a
+ * spinlock: send and recv copy caller buffers and allocate under it. */
+static lock_class_t socket_table_lock_class = LOCK_CLASS_INIT("socket_table");
+static mutex_t socket_table_lock = MUTEX_INIT(socket_table_lock, socket_table_lock_class);
+
 /* Next socket FD to allocate */
 static int next_sockfd = 1;
 
@@ -35,18 +42,23 @@ static socket_t *socket_alloc(void) {
     return NULL;
 }
 
-/* Get socket by file descriptor */
-socket_t *socket_get_by_fd(int fd) {
+/* Get socket by id (a slot is in use from socket_create to socket_close,
+ * whatever its state: new and disconnected sockets are CLOSED too).
+ * Caller holds socket_table_lock. */
+static socket_t *socket_lookup(int fd) {
+    if (fd < 0) {
+        return NULL;
+    }
     for (int i = 0; i < MAX_SOCKETS; i++) {
-        if (socket_table[i].fd == fd && socket_table[i].state != SOCKET_STATE_CLOSED) {
+        if (socket_table[i].fd == fd) {
             return &socket_table[i];
         }
     }
     return NULL;
 }
 
-/* Find socket by address */
-socket_t *socket_find_by_address(socket_address_t *addr) {
+/* Find the socket listening at an address (caller holds socket_table_lock) */
+static socket_t *socket_lookup_listener(socket_address_t *addr) {
     if (!addr) {
         return NULL;
     }
@@ -63,8 +75,22 @@ socket_t *socket_find_by_address(socket_address_t *addr) {
     return NULL;
 }
 
+socket_t *socket_get_by_fd(int fd) {
+    mutex_lock(&socket_table_lock);
+    socket_t *sock = socket_lookup(fd);
+    mutex_unlock(&socket_table_lock);
+    return sock;
+}
+
+socket_t *socket_find_by_address(socket_address_t *addr) {
+    mutex_lock(&socket_table_lock);
+    socket_t *sock = socket_lookup_listener(addr);
+    mutex_unlock(&socket_table_lock);
+    return sock;
+}
+
 /* Create a new socket */
-int socket_create(uint32_t pid, int family, int type, int protocol) {
+static int socket_create_locked(uint32_t pid, int family, int type, int protocol) {
     (void)protocol;  /* Unused */
 
     /* Validate parameters */
@@ -95,9 +121,16 @@ int socket_create(uint32_t pid, int family, int type, int protocol) {
     return sock->fd;
 }
 
+int socket_create(uint32_t pid, int family, int type, int protocol) {
+    mutex_lock(&socket_table_lock);
+    int ret = socket_create_locked(pid, family, type, protocol);
+    mutex_unlock(&socket_table_lock);
+    return ret;
+}
+
 /* Bind socket to address */
-int socket_bind(int sockfd, socket_address_t *addr) {
-    socket_t *sock = socket_get_by_fd(sockfd);
+static int socket_bind_locked(int sockfd, socket_address_t *addr) {
+    socket_t *sock = socket_lookup(sockfd);
     if (!sock || !addr) {
         return -1;
     }
@@ -108,7 +141,7 @@ int socket_bind(int sockfd, socket_address_t *addr) {
     }
 
     /* Check if address is already in use */
-    if (socket_find_by_address(addr)) {
+    if (socket_lookup_listener(addr)) {
         return -1;  /* Address in use */
     }
 
@@ -120,9 +153,16 @@ int socket_bind(int sockfd, socket_address_t *addr) {
     return 0;
 }
 
+int socket_bind(int sockfd, socket_address_t *addr) {
+    mutex_lock(&socket_table_lock);
+    int ret = socket_bind_locked(sockfd, addr);
+    mutex_unlock(&socket_table_lock);
+    return ret;
+}
+
 /* Listen for connections */
-int socket_listen(int sockfd, int backlog) {
-    socket_t *sock = socket_get_by_fd(sockfd);
+static int socket_listen_locked(int sockfd, int backlog) {
+    socket_t *sock = socket_lookup(sockfd);
     if (!sock) {
         return -1;
     }
@@ -149,9 +189,16 @@ int socket_listen(int sockfd, int backlog) {
     return 0;
 }
 
+int socket_listen(int sockfd, int backlog) {
+    mutex_lock(&socket_table_lock);
+    int ret = socket_listen_locked(sockfd, backlog);
+    mutex_unlock(&socket_table_lock);
+    return ret;
+}
+
 /* Accept a connection */
-int socket_accept(int sockfd, socket_address_t *addr) {
-    socket_t *listen_sock = socket_get_by_fd(sockfd);
+static int socket_accept_locked(int sockfd, socket_address_t *addr) {
+    socket_t *listen_sock = socket_lookup(sockfd);
     if (!listen_sock) {
         return -1;
     }
@@ -182,15 +229,22 @@ int socket_accept(int sockfd, socket_address_t *addr) {
     return client_sock->fd;
 }
 
+int socket_accept(int sockfd, socket_address_t *addr) {
+    mutex_lock(&socket_table_lock);
+    int ret = socket_accept_locked(sockfd, addr);
+    mutex_unlock(&socket_table_lock);
+    return ret;
+}
+
 /* Connect to remote socket */
-int socket_connect(int sockfd, socket_address_t *addr) {
-    socket_t *sock = socket_get_by_fd(sockfd);
+static int socket_connect_locked(int sockfd, socket_address_t *addr) {
+    socket_t *sock = socket_lookup(sockfd);
     if (!sock || !addr) {
         return -1;
     }
 
     /* Find listening socket */
-    socket_t *listen_sock = socket_find_by_address(addr);
+    socket_t *listen_sock = socket_lookup_listener(addr);
     if (!listen_sock) {
         return -1;  /* No socket listening at address */
     }
@@ -233,11 +287,18 @@ int socket_connect(int sockfd, socket_address_t *addr) {
     return 0;
 }
 
+int socket_connect(int sockfd, socket_address_t *addr) {
+    mutex_lock(&socket_table_lock);
+    int ret = socket_connect_locked(sockfd, addr);
+    mutex_unlock(&socket_table_lock);
+    return ret;
+}
+
 /* Send data to socket */
-int socket_send(int sockfd, const void *buf, size_t len, int flags) {
+static int socket_send_locked(int sockfd, const void *buf, size_t len, int flags) {
     (void)flags;  /* Unused */
 
-    socket_t *sock = socket_get_by_fd(sockfd);
+    socket_t *sock = socket_lookup(sockfd);
     if (!sock || !buf || len == 0) {
         return -1;
     }
@@ -278,11 +339,18 @@ int socket_send(int sockfd, const void *buf, size_t len, int flags) {
     return (int)len;
 }
 
+int socket_send(int sockfd, const void *buf, size_t len, int flags) {
+    mutex_lock(&socket_table_lock);
+    int ret = socket_send_locked(sockfd, buf, len, flags);
+    mutex_unlock(&socket_table_lock);
+    return ret;
+}
+
 /* Receive data from socket */
-int socket_recv(int sockfd, void *buf, size_t len, int flags) {
+static int socket_recv_locked(int sockfd, void *buf, size_t len, int flags) {
     (void)flags;  /* Unused */
 
-    socket_t *sock = socket_get_by_fd(sockfd);
+    socket_t *sock = socket_lookup(sockfd);
     if (!sock || !buf || len == 0) {
         return -1;
     }
@@ -311,9 +379,16 @@ int socket_recv(int sockfd, void *buf, size_t len, int flags) {
     return (int)copy_len;
 }
 
+int socket_recv(int sockfd, void *buf, size_t len, int flags) {
+    mutex_lock(&socket_table_lock);
+    int ret = socket_recv_locked(sockfd, buf, len, flags);
+    mutex_unlock(&socket_table_lock);
+    return ret;
+}
+
 /* Close socket */
-int socket_close(int sockfd) {
-    socket_t *sock = socket_get_by_fd(sockfd);
+static int socket_close_locked(int sockfd) {
+    socket_t *sock = socket_lookup(sockfd);
     if (!sock) {
         return -1;
     }
@@ -341,9 +416,16 @@ int socket_close(int sockfd) {
     return 0;
 }
 
+int socket_close(int sockfd) {
+    mutex_lock(&socket_table_lock);
+    int ret = socket_close_locked(sockfd);
+    mutex_unlock(&socket_table_lock);
+    return ret;
+}
+
 /* Check if socket can read */
-int socket_can_read(int sockfd) {
-    socket_t *sock = socket_get_by_fd(sockfd);
+static int socket_can_read_locked(int sockfd) {
+    socket_t *sock = socket_lookup(sockfd);
     if (!sock) {
         return 0;
     }
@@ -351,9 +433,16 @@ int socket_can_read(int sockfd) {
     return (sock->msg_count > 0) ? 1 : 0;
 }
 
+int socket_can_read(int sockfd) {
+    mutex_lock(&socket_table_lock);
+    int ret = socket_can_read_locked(sockfd);
+    mutex_unlock(&socket_table_lock);
+    return ret;
+}
+
 /* Check if socket can write */
-int socket_can_write(int sockfd) {
-    socket_t *sock = socket_get_by_fd(sockfd);
+static int socket_can_write_locked(int sockfd) {
+    socket_t *sock = socket_lookup(sockfd);
     if (!sock) {
         return 0;
     }
@@ -361,8 +450,18 @@ int socket_can_write(int sockfd) {
     return (sock->state == SOCKET_STATE_CONNECTED) ? 1 : 0;
 }
 
+int socket_can_write(int sockfd) {
+    mutex_lock(&socket_table_lock);
+    int ret = socket_can_write_locked(sockfd);
+    mutex_unlock(&socket_table_lock);
+    return ret;
+}
+
 /* ===== System Calls ===== */
 
+/* The calls take and return descriptors of the caller's table (file.c);
+ * the socket functions above work on socket ids. */
+
 /* sys_socket - Create a socket */
 int sys_socket(uint32_t family, uint32_t type, uint32_t protocol, uint32_t unused1, uint32_t unused2) {
     (void)unused1; (void)unused2;
@@ -372,7 +471,15 @@ int sys_socket(uint32_t family, uint32_t type, uint32_t protocol, uint32_t unuse
         return -1;
     }
 
-    return socket_create(proc->pid, (int)family, (int)type, (int)protocol);
+    int sock = socket_create(proc->pid, (int)family, (int)type, (int)protocol);
+    if (sock < 0) {
+        return -1;
+    }
+    int fd = fd_install_socket(sock);
+    if (fd < 0) {
+        socket_close(sock);
+    }
+    return fd;
 }
 
 /* sys_bind - Bind socket to address */
@@ -380,22 +487,30 @@ int sys_bind(uint32_t sockfd, uint32_t addr_ptr, uint32_t unused1, uint32_t unus
     (void)unused1; (void)unused2; (void)unused3;
 
     socket_address_t *addr = (socket_address_t *)addr_ptr;
-    return socket_bind((int)sockfd, addr);
+    return socket_bind(fd_to_socket((int)sockfd), addr);
 }
 
 /* sys_listen - Listen for connections */
 int sys_listen(uint32_t sockfd, uint32_t backlog, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
     (void)unused1; (void)unused2; (void)unused3;
 
-    return socket_listen((int)sockfd, (int)backlog);
+    return socket_listen(fd_to_socket((int)sockfd), (int)backlog);
 }
 
-/* sys_accept - Accept a connection */
+/* sys_accept - Accept a connection (the new socket gets a descriptor) */
 int sys_accept(uint32_t sockfd, uint32_t addr_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
     (void)unused1; (void)unused2; (void)unused3;
 
     socket_address_t *addr = (socket_address_t *)addr_ptr;
-    return socket_accept((int)sockfd, addr);
+    int sock = socket_accept(fd_to_socket((int)sockfd), addr);
+    if (sock < 0) {
+        return -1;
+    }
+    int fd = fd_install_socket(sock);
+    if (fd < 0) {
+        socket_close(sock);
+    }
+    return fd;
 }
 
 /* sys_connect - Connect to remote socket */
@@ -403,7 +518,7 @@ int sys_connect(uint32_t sockfd, uint32_t addr_ptr, uint32_t unused1, uint32_t u
     (void)unused1; (void)unused2; (void)unused3;
 
     socket_address_t *addr = (socket_address_t *)addr_ptr;
-    return socket_connect((int)sockfd, addr);
+    return socket_connect(fd_to_socket((int)sockfd), addr);
 }
 
 /* sys_send - Send data to socket */
@@ -411,7 +526,7 @@ int sys_send(uint32_t sockfd, uint32_t buf_ptr, uint32_t len, uint32_t flags, ui
     (void)unused;
 
     void *buf = (void *)buf_ptr;
-    return socket_send((int)sockfd, buf, (size_t)len, (int)flags);
+    return socket_send(fd_to_socket((int)sockfd), buf, (size_t)len, (int)flags);
 }
 
 /* sys_recv - Receive data from socket */
@@ -419,12 +534,15 @@ int sys_recv(uint32_t sockfd, uint32_t buf_ptr, uint32_t len, uint32_t flags, ui
     (void)unused;
 
     void *buf = (void *)buf_ptr;
-    return socket_recv((int)sockfd, buf, (size_t)len, (int)flags);
+    return socket_recv(fd_to_socket((int)sockfd), buf, (size_t)len, (int)flags);
 }
 
-/* sys_socket_close - Close socket */
+/* sys_socket_close - Close socket (same as close() on its descriptor) */
 int sys_socket_close(uint32_t sockfd, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
     (void)unused1; (void)unused2; (void)unused3; (void)unused4;
 
-    return socket_close((int)sockfd);
+    if (fd_to_socket((int)sockfd) < 0) {
+        return -1;
+    }
+    return sys_close(sockfd, 0, 0, 0, 0);
 }
@@ -0,0 +1,179 @@
+/* softirq.c - Deferred interrupt work (bottom halves)
+ *
+ * Top halves acknowledge their device and raise a softirq bit with
+ * interrupts still disabled. On the way out of interrupt_handler_common
+ * the pending bits are run with interrupts re-enabled, so a long bottom
+ * half no longer delays other IRQs. Interrupts that arrive meanwhile only
+ * raise more bits, which the outer loop picks up. If work keeps arriving
+ * past the restart/time budget, the rest is left to ksoftirqd so the
+ * interrupted task is not starved.
+ */
+
+#include "../include/softirq.h"
+#include "../include/kthread.h"
+#include "../include/wait.h"
+#include "../include/clocksource.h"
+#include "../include/math64.h"
+#include "../include/idt.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+#include "../include/smp.h"
+
+typedef struct {
+    void (*action)(void);
+    uint32_t raised;       /* raise_softirq() calls */
+    uint32_t runs;         /* Handler invocations */
+    uint64_t busy_ns;      /* Time spent in the handler */
+    uint64_t max_ns;       /* Longest single run */
+} softirq_vec_t;
+
+static softirq_vec_t softirq_vec[NR_SOFTIRQS];
+
+static const char *softirq_names[NR_SOFTIRQS] = {
+    "TIMER", "KEYBOARD", "BLOCK"
+};
+
+/* Pending vector bits (only changed with interrupts disabled) */
+static volatile uint32_t softirq_pending = 0;
+
+/* Non-zero while handlers run: nested interrupt exits leave work to us,
+ * and so do other CPUs' (one CPU runs softirqs at a time) */
+static volatile uint32_t softirq_nesting = 0;
+static uint32_t softirq_cpu = 0;
+
+/* Overload fallback */
+static process_t *ksoftirqd = NULL;
+static wait_queue_head_t ksoftirqd_wq;
+
+/* Statistics */
+static uint32_t softirq_restarts = 0;
+static uint32_t softirq_overruns = 0;
+static uint32_t ksoftirqd_runs = 0;
+
+/* Install the handler of a softirq vector */
+void open_softirq(softirq_nr_t nr, void (*action)(void)) {
+    if (nr < NR_SOFTIRQS) {
+        softirq_vec[nr].action = action;
+    }
+}
+
+/* Mark a softirq pending (safe from top halves and process context) */
+void raise_softirq(softirq_nr_t nr) {
+    bool flags = interrupts_save();
+    softirq_pending |= 1U << nr;
+    softirq_vec[nr].raised++;
+    interrupts_restore(flags);
+}
+
+/* Check whether softirq handlers are running on this CPU */
+bool in_softirq(void) {
+    return softirq_nesting != 0 && softirq_cpu == smp_processor_id();
+}
+
+/* Run each pending vector once (called with interrupts enabled) */
+static void softirq_run_vectors(uint32_t pending) {
+    for (uint32_t nr = 0; pending; nr++, pending >>= 1) {
+        softirq_vec_t *vec = &softirq_vec[nr];
+        if (!(pending & 1) || !vec->action) {
+            continue;
+        }
+
+        uint64_t start = ktime_get_ns();
+        vec->action();
+        uint64_t elapsed = ktime_get_ns() - start;
+
+        vec->runs++;
+        vec->busy_ns += elapsed;
+        if (elapsed > vec->max_ns) {
+            vec->max_ns = elapsed;
+        }
+    }
+}
+
+/* Run pending softirqs with interrupts enabled (no-op when nested) */
+void do_softirq(void) {
+    bool flags = interrupts_save();
+
+    if (softirq_nesting || !softirq_pending) {
+        interrupts_restore(flags);
+        return;
+    }
+
+    softirq_nesting++;
+    softirq_cpu = smp_processor_id();
+    uint64_t start = ktime_get_ns();
+    int restart = MAX_SOFTIRQ_RESTART;
+
+    while (softirq_pending) {
+        uint32_t pending = softirq_pending;
+        softirq_pending = 0;
+
+        interrupts_enable();
+        softirq_run_vectors(pending);
+        interrupts_disable();
+
+        if (!softirq_pending) {
+            break;
+        }
+
+        /* Raised again while we ran: loop within budget, else defer */
+        if (--restart == 0 || ktime_get_ns() - start >= MAX_SOFTIRQ_TIME_NS) {
+            softirq_overruns++;
+            if (ksoftirqd) {
+                wake_up(&ksoftirqd_wq);
+            }
+            break;
+        }
+        softirq_restarts++;
+    }
+
+    softirq_nesting--;
+    interrupts_restore(flags);
+}
+
+/* ksoftirqd: drain softirqs left over by overloaded interrupt exits */
+static int ksoftirqd_thread(void *data) {
+    (void)data;
+
+    while (1) {
+        wait_event(ksoftirqd_wq, softirq_pending != 0);
+
+        ksoftirqd_runs++;
+        do_softirq();
+
+        /* Let the tasks we were protecting run between batches */
+        if (process_need_resched) {
+            process_schedule();
+        }
+    }
+
+    return 0;
+}
+
+/* Start the ksoftirqd fallback thread */
+void softirq_init(void) {
+    init_waitqueue_head(&ksoftirqd_wq);
+    ksoftirqd = kthread_create(ksoftirqd_thread, NULL, "ksoftirqd");
+}
+
+/* Print per-vector statistics */
+void softirq_print_stats(void) {
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Softirqs ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    for (int nr = 0; nr < NR_SOFTIRQS; nr++) {
+        softirq_vec_t *vec = &softirq_vec[nr];
+        uint32_t avg_ns = vec->runs ? (uint32_t)div_u64(vec->busy_ns, vec->runs) : 0;
+
+        printk("  %s: raised %u, runs %u, busy %u us, avg %u ns, max %u us%s\n",
+               softirq_names[nr], vec->raised, vec->runs,
+               (uint32_t)div_u64(vec->busy_ns, NSEC_PER_USEC), avg_ns,
+               (uint32_t)div_u64(vec->max_ns, NSEC_PER_USEC),
+               (softirq_pending & (1U << nr)) ? " (pending)" : "");
+    }
+
+    printk("Restarts %u, budget overruns %u, ksoftirqd runs %u (PID %d)\n",
+           softirq_restarts, softirq_overruns, ksoftirqd_runs,
+           ksoftirqd ? ksoftirqd->pid : 0);
+}
@@ -0,0 +1,193 @@
+/* spinlock.c - Busy-waiting locks for data shared between CPUs
+ *
+ * The _irqsave forms turn interrupts off first, which also takes the
+ * interrupt lock (idt.c), so a lock taken that way nests inside it and
+ * cannot deadlock against an interrupt handler on any CPU. While the
+ * interrupt lock still serializes those sections, lockstat shows their
+ * hold times rather than contention; contention on the interrupt lock
+ * itself is counted under "irq_lock".
+ *
+ * Every holder also counts in the preempt count (preempt.h), so it keeps
+ * its CPU until the lock is dropped. The _irqrestore forms drop that
+ * count only after interrupts are back on, so a reschedule that came due
+ * meanwhile happens right there.
+ */
+
+#include "../include/spinlock.h"
+#include "../include/cpu.h"
+#include "../include/idt.h"
+#include "../include/preempt.h"
+
+/* Atomically store 1, returning the previous value (XCHG locks the bus) */
+static uint32_t spin_xchg(volatile uint32_t *word, uint32_t value) {
+    __asm__ volatile("xchg %0, %1" : "+r"(value), "+m"(*word) : : "memory");
+    return value;
+}
+
+void spin_lock_init(spinlock_t *lock) {
+    spin_lock_init_class(lock, NULL);
+}
+
+void spin_lock_init_class(spinlock_t *lock, lock_class_t *class) {
+    lock->locked = 0;
+    lock->class = class;
+    lock->held_since = 0;
+}
+
+/* Spin until the lock is ours */
+void spin_lock(spinlock_t *lock) {
+    uint64_t wait_start = 0;
+
+    preempt_disable();
+    if (spin_xchg(&lock->locked, 1)) {
+        if (lockstat_active(lock->class)) {
+            wait_start = rdtsc();
+        }
+        do {
+            while (lock->locked) {
+                cpu_relax();
+            }
+        } while (spin_xchg(&lock->locked, 1));
+    }
+
+    if (lockstat_active(lock->class)) {
+        lock->held_since = lockstat_acquired(lock->class, wait_start);
+    }
+}
+
+/* Release the lock word (stores are not reordered with older accesses on x86) */
+static void spin_release(spinlock_t *lock) {
+    if (lock->held_since) {
+        lockstat_released(lock->class, lock->held_since);
+        lock->held_since = 0;
+    }
+    __asm__ volatile("" ::: "memory");
+    lock->locked = 0;
+}
+
+void spin_unlock(spinlock_t *lock) {
+    spin_release(lock);
+    preempt_enable();
+}
+
+/* Take the lock only if it is free */
+bool spin_trylock(spinlock_t *lock) {
+    preempt_disable();
+    if (spin_xchg(&lock->locked, 1)) {
+        preempt_enable();
+        return false;
+    }
+    if (lockstat_active(lock->class)) {
+        lock->held_since = lockstat_acquired(lock->class, 0);
+    }
+    return true;
+}
+
+/* Check whether some CPU holds the lock */
+bool spin_is_locked(spinlock_t *lock) {
+    return lock->locked != 0;
+}
+
+/* Interrupts off, then the lock */
+bool spin_lock_irqsave(spinlock_t *lock) {
+    bool flags = interrupts_save();
+    spin_lock(lock);
+    return flags;
+}
+
+void spin_unlock_irqrestore(spinlock_t *lock, bool flags) {
+    spin_release(lock);
+    interrupts_restore(flags);
+    preempt_enable();
+}
+
+/* ===== Reader/writer locks ===== */
+
+void rwlock_init(rwlock_t *lock, lock_class_t *class) {
+    lock->count = 0;
+    lock->class = class;
+    lock->held_since = 0;
+}
+
+/* Join the readers once no writer holds the lock */
+void read_lock(rwlock_t *lock) {
+    uint64_t wait_start = 0;
+
+    preempt_disable();
+    for (;;) {
+        int32_t count = lock->count;
+        if (count >= 0 && __sync_bool_compare_and_swap(&lock->count, count, count + 1)) {
+            break;
+        }
+        if (!wait_start && lockstat_active(lock->class)) {
+            wait_start = rdtsc();
+        }
+        cpu_relax();
+    }
+
+    if (lockstat_active(lock->class)) {
+        lockstat_acquired(lock->class, wait_start);
+    }
+}
+
+void read_unlock(rwlock_t *lock) {
+    __sync_fetch_and_sub(&lock->count, 1);
+    preempt_enable();
+}
+
+/* Wait until neither readers nor a writer hold the lock */
+void write_lock(rwlock_t *lock) {
+    uint64_t wait_start = 0;
+
+    preempt_disable();
+    while (!__sync_bool_compare_and_swap(&lock->count, 0, -1)) {
+        if (!wait_start && lockstat_active(lock->class)) {
+            wait_start = rdtsc();
+        }
+        while (lock->count != 0) {
+            cpu_relax();
+        }
+    }
+
+    if (lockstat_active(lock->class)) {
+        lock->held_since = lockstat_acquired(lock->class, wait_start);
+    }
+}
+
+static void write_release(rwlock_t *lock) {
+    if (lock->held_since) {
+        lockstat_released(lock->class, lock->held_since);
+        lock->held_since = 0;
+    }
+    __asm__ volatile("" ::: "memory");
+    lock->count = 0;
+}
+
+void write_unlock(rwlock_t *lock) {
+    write_release(lock);
+    preempt_enable();
+}
+
+bool read_lock_irqsave(rwlock_t *lock) {
+    bool flags = interrupts_save();
+    read_lock(lock);
+    return flags;
+}
+
+void read_unlock_irqrestore(rwlock_t *lock, bool flags) {
+    __sync_fetch_and_sub(&lock->count, 1);
+    interrupts_restore(flags);
+    preempt_enable();
+}
+
+bool write_lock_irqsave(rwlock_t *lock) {
+    bool flags = interrupts_save();
+    write_lock(lock);
+    return flags;
+}
+
+void write_unlock_irqrestore(rwlock_t *lock, bool flags) {
+    write_release(lock);
+    interrupts_restore(flags);
+    preempt_enable();
+}
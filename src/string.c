@@ -84,7 +84,7 @@ char *strchr(const char *s, int c) {
     return NULL;
 }
 
-/* Simplified snprintf - supports %s, %d, %x only */
+/* Simplified snprintf - supports %s, %c, %d, %u, %x only */
 int snprintf(char *str, size_t size, const char *format, ...) {
     if (!str || size == 0) {
         return 0;
@@ -135,6 +135,23 @@ int snprintf(char *str, size_t size, const char *format, ...) {
                 while (i > 0 && written < size - 1) {
                     str[written++] = buffer[--i];
                 }
+            } else if (*p == 'u') {
+                /* Unsigned integer */
+                unsigned int num = __builtin_va_arg(args, unsigned int);
+                char buffer[11];
+                int i = 0;
+
+                do {
+                    buffer[i++] = '0' + (num % 10);
+                    num /= 10;
+                } while (num > 0);
+
+                while (i > 0 && written < size - 1) {
+                    str[written++] = buffer[--i];
+                }
+            } else if (*p == 'c') {
+                /* Character */
+                str[written++] = (char)__builtin_va_arg(args, int);
             } else if (*p == 'x') {
                 /* Hexadecimal */
                 unsigned int num = __builtin_va_arg(args, unsigned int);
@@ -168,3 +185,21 @@ int snprintf(char *str, size_t size, const char *format, ...) {
 
     return written;
 }
+
+/* Convert a decimal string to an integer (stops at the first non-digit) */
+int atoi(const char *str) {
+    int result = 0;
+    int sign = 1;
+
+    if (*str == '-') {
+        sign = -1;
+        str++;
+    }
+
+    while (*str >= '0' && *str <= '9') {
+        result = result * 10 + (*str - '0');
+        str++;
+    }
+
+    return sign * result;
+}
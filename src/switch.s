@@ -0,0 +1,32 @@
+# switch.s - Kernel stack context switch
+
+# Mark stack as non-executable
+.section .note.GNU-stack,"",@progbits
+
+.section .text
+
+# void context_switch(uint32_t *prev_esp, uint32_t next_esp)
+# Save callee-saved registers and EFLAGS on the current kernel stack,
+# store the stack pointer in *prev_esp, then resume the stack at next_esp.
+# The caller-saved registers are already preserved by the C calling
+# convention, and EFLAGS carries each task's interrupt flag across.
+.global context_switch
+context_switch:
+    mov 4(%esp), %eax       # prev_esp
+    mov 8(%esp), %edx       # next_esp
+
+    pushfl
+    push %ebp
+    push %ebx
+    push %esi
+    push %edi
+
+    mov %esp, (%eax)
+    mov %edx, %esp
+
+    pop %edi
+    pop %esi
+    pop %ebx
+    pop %ebp
+    popfl
+    ret
@@ -4,37 +4,22 @@
 #include "../include/idt.h"
 #include "../include/printf.h"
 #include "../include/panic.h"
+#include "../include/process.h"
+#include "../include/cpu.h"
+#include "../include/gdt.h"
+#include "../include/sysstat.h"
+#include "../include/file.h"
 
 /* Syscall handler table */
 static syscall_handler_t syscall_handlers[MAX_SYSCALLS];
 
-/* Example syscall: write */
-int sys_write(uint32_t fd, uint32_t buf, uint32_t count, uint32_t unused1, uint32_t unused2) {
-    (void)unused1;
-    (void)unused2;
+/* SYSENTER entry and its scratch stack (sysenter.s) */
+extern void sysenter_entry(void);
+extern uint8_t sysenter_stack_top[];
 
-    /* For now, just print to screen if fd=1 (stdout) */
-    if (fd == 1 && buf && count > 0) {
-        char *str = (char *)buf;
-        for (uint32_t i = 0; i < count; i++) {
-            printk("%c", str[i]);
-        }
-        return (int)count;
-    }
-    return -1;
-}
-
-/* Example syscall: read */
-int sys_read(uint32_t fd, uint32_t buf, uint32_t count, uint32_t unused1, uint32_t unused2) {
-    (void)fd;
-    (void)buf;
-    (void)count;
-    (void)unused1;
-    (void)unused2;
-
-    /* Not implemented yet - would need process support */
-    return -1;
-}
+/* Fastest entry stub available */
+static bool sysenter_enabled = false;
+void (*syscall_entry)(void) = syscall_int80;
 
 /* Example syscall: exit */
 int sys_exit(uint32_t status, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
@@ -51,6 +36,16 @@ int sys_exit(uint32_t status, uint32_t unused1, uint32_t unused2, uint32_t unuse
 
 /* Forward declarations for process syscalls */
 extern int sys_fork(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5);
+extern int sys_clone(uint32_t flags, uint32_t fn, uint32_t arg, uint32_t stack, uint32_t unused);
+extern int sys_getpid(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5);
+extern int sys_gettid(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5);
+extern int sys_futex(uint32_t uaddr, uint32_t op, uint32_t val, uint32_t arg4, uint32_t uaddr2);
+extern int sys_execve(uint32_t path, uint32_t argv, uint32_t envp, uint32_t unused1, uint32_t unused2);
+extern int sys_vfork(uint32_t fn, uint32_t arg, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+extern int sys_spawn(uint32_t path, uint32_t argv, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+extern int sys_uring_setup(uint32_t flags, uint32_t addr_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+extern int sys_uring_enter(uint32_t ring, uint32_t to_submit, uint32_t min_complete, uint32_t flags, uint32_t unused);
+extern int sys_uring_close(uint32_t ring, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
 extern int sys_wait(uint32_t status_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
 extern int sys_getuid(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5);
 extern int sys_kill(uint32_t pid, uint32_t signal, uint32_t unused1, uint32_t unused2, uint32_t unused3);
@@ -66,6 +61,9 @@ extern int sys_connect(uint32_t sockfd, uint32_t addr_ptr, uint32_t unused1, uin
 extern int sys_send(uint32_t sockfd, uint32_t buf_ptr, uint32_t len, uint32_t flags, uint32_t unused);
 extern int sys_recv(uint32_t sockfd, uint32_t buf_ptr, uint32_t len, uint32_t flags, uint32_t unused);
 
+/* Forward declarations for timer syscalls */
+extern int sys_nanosleep(uint32_t req_ptr, uint32_t rem_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+
 /* Syscall dispatcher - called from INT 0x80 */
 void syscall_dispatcher(struct interrupt_frame *frame) {
     /* Syscall number in EAX */
@@ -81,17 +79,99 @@ void syscall_dispatcher(struct interrupt_frame *frame) {
     /* Check if syscall number is valid */
     if (syscall_num >= MAX_SYSCALLS || !syscall_handlers[syscall_num]) {
         printk("[SYSCALL] Invalid syscall number: %d\n", syscall_num);
+        if (sysstat_mask) {
+            sysstat_invalid(syscall_num);
+        }
         frame->eax = -1;  /* Return error */
         return;
     }
 
-    /* Call the syscall handler */
-    int result = syscall_handlers[syscall_num](arg1, arg2, arg3, arg4, arg5);
+    /* Call the syscall handler with interrupts enabled so it can block;
+     * statistics cost this one branch while they are off */
+    process_account_syscall_enter();
+    interrupts_enable();
+    int result;
+    if (__builtin_expect(sysstat_mask != 0, 0)) {
+        result = sysstat_run(syscall_handlers[syscall_num], syscall_num,
+                             arg1, arg2, arg3, arg4, arg5);
+    } else {
+        result = syscall_handlers[syscall_num](arg1, arg2, arg3, arg4, arg5);
+    }
+    interrupts_disable();
+    process_account_syscall_exit(syscall_num, result);
 
     /* Return value in EAX */
     frame->eax = result;
 }
 
+/* Syscall dispatcher - called from the SYSENTER entry with interrupts
+ * disabled, on the caller's stack; no frame to fill in */
+int sysenter_dispatch(uint32_t syscall_num, uint32_t arg1, uint32_t arg2,
+                      uint32_t arg3, uint32_t arg4, uint32_t arg5) {
+    /* SYSENTER cleared IF without taking the interrupt lock (the entry
+     * drops it again on the way out) */
+    irq_lock_acquire();
+
+    if (syscall_num >= MAX_SYSCALLS || !syscall_handlers[syscall_num]) {
+        printk("[SYSCALL] Invalid syscall number: %d\n", syscall_num);
+        if (sysstat_mask) {
+            sysstat_invalid(syscall_num);
+        }
+        return -1;
+    }
+
+    process_account_syscall_enter();
+    interrupts_enable();
+    int result;
+    if (__builtin_expect(sysstat_mask != 0, 0)) {
+        result = sysstat_run(syscall_handlers[syscall_num], syscall_num,
+                             arg1, arg2, arg3, arg4, arg5);
+    } else {
+        result = syscall_handlers[syscall_num](arg1, arg2, arg3, arg4, arg5);
+    }
+    interrupts_disable();
+    process_account_syscall_exit(syscall_num, result);
+    return result;
+}
+
+/* Point the SYSENTER MSRs at sysenter_entry if the CPU has SEP (the
+ * first Pentium Pro steppings report it without supporting it) */
+static void sysenter_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_FEAT_EDX_SEP)) {
+        return;
+    }
+
+    uint32_t family = (eax >> 8) & 0xF;
+    uint32_t model = (eax >> 4) & 0xF;
+    uint32_t stepping = eax & 0xF;
+    if (family == 6 && model < 3 && stepping < 3) {
+        return;
+    }
+
+    wrmsr(MSR_IA32_SYSENTER_CS, KERNEL_CODE_SEGMENT);
+    wrmsr(MSR_IA32_SYSENTER_ESP, (uint32_t)sysenter_stack_top);
+    wrmsr(MSR_IA32_SYSENTER_EIP, (uint32_t)sysenter_entry);
+
+    sysenter_enabled = true;
+    syscall_entry = syscall_sysenter;
+}
+
+/* Point an application processor's SYSENTER MSRs at the same entry */
+void syscall_init_ap(void) {
+    if (sysenter_enabled) {
+        wrmsr(MSR_IA32_SYSENTER_CS, KERNEL_CODE_SEGMENT);
+        wrmsr(MSR_IA32_SYSENTER_ESP, (uint32_t)sysenter_stack_top);
+        wrmsr(MSR_IA32_SYSENTER_EIP, (uint32_t)sysenter_entry);
+    }
+}
+
+/* Whether the SYSENTER MSRs were set up at boot */
+bool syscall_sysenter_enabled(void) {
+    return sysenter_enabled;
+}
+
 /* Initialize syscall system */
 void syscall_init(void) {
     /* Clear syscall handlers */
@@ -99,16 +179,37 @@ void syscall_init(void) {
         syscall_handlers[i] = NULL;
     }
 
-    /* Register INT 0x80 handler */
+    /* Register INT 0x80 handler, and SYSENTER where available */
     idt_register_handler(INT_SYSCALL, syscall_dispatcher);
+    sysenter_init();
 
     /* Register default syscalls */
-    syscall_register(SYS_WRITE, sys_write);
-    syscall_register(SYS_READ, sys_read);
     syscall_register(SYS_EXIT, sys_exit);
 
+    /* Register file syscalls (descriptor table, file.c) */
+    syscall_register(SYS_OPEN, sys_open);
+    syscall_register(SYS_CLOSE, sys_close);
+    syscall_register(SYS_READ, sys_read);
+    syscall_register(SYS_WRITE, sys_write);
+    syscall_register(SYS_LSEEK, sys_lseek);
+    syscall_register(SYS_PREAD, sys_pread);
+    syscall_register(SYS_PWRITE, sys_pwrite);
+    syscall_register(SYS_READV, sys_readv);
+    syscall_register(SYS_WRITEV, sys_writev);
+    syscall_register(SYS_DUP2, sys_dup2);
+
     /* Register process syscalls (KFS_5) */
     syscall_register(SYS_FORK, sys_fork);
+    syscall_register(SYS_CLONE, sys_clone);
+    syscall_register(SYS_GETPID, sys_getpid);
+    syscall_register(SYS_GETTID, sys_gettid);
+    syscall_register(SYS_FUTEX, sys_futex);
+    syscall_register(SYS_EXECVE, sys_execve);
+    syscall_register(SYS_VFORK, sys_vfork);
+    syscall_register(SYS_SPAWN, sys_spawn);
+    syscall_register(SYS_URING_SETUP, sys_uring_setup);
+    syscall_register(SYS_URING_ENTER, sys_uring_enter);
+    syscall_register(SYS_URING_CLOSE, sys_uring_close);
     syscall_register(SYS_WAIT, sys_wait);
     syscall_register(SYS_GETUID, sys_getuid);
     syscall_register(SYS_KILL, sys_kill);
@@ -126,7 +227,11 @@ void syscall_init(void) {
     syscall_register(SYS_SEND, sys_send);
     syscall_register(SYS_RECV, sys_recv);
 
-    printk("[SYSCALL] Syscall system initialized\n");
+    /* Register timer syscalls */
+    syscall_register(SYS_NANOSLEEP, sys_nanosleep);
+
+    printk("[SYSCALL] Syscall system initialized (%s)\n",
+           sysenter_enabled ? "SYSENTER, INT 0x80 fallback" : "INT 0x80");
 }
 
 /* Register a syscall handler */
@@ -0,0 +1,95 @@
+# sysenter.s - SYSENTER fast system call entry and the kernel-side stubs
+#
+# Both stubs take the INT 0x80 register convention: eax = syscall number,
+# ebx, ecx, edx, esi, edi = arguments; the result comes back in eax and
+# every other register is preserved.
+#
+# SYSENTER saves neither a return address nor a stack pointer, so
+# syscall_sysenter leaves them where the entry can find them: the
+# caller's stack pointer in ebp, with the caller's ecx, edx, ebp and
+# EFLAGS saved on that stack. Every caller runs in ring 0 on its own
+# kernel stack, so the entry switches straight back to it and the
+# handler may sleep like any other. SYSEXIT can only return to ring 3,
+# so the way back is a jump to sysenter_return, which reloads the saved
+# registers and EFLAGS (SYSENTER cleared IF).
+
+# Mark stack as non-executable
+.section .note.GNU-stack,"",@progbits
+
+.section .text
+
+.extern sysenter_dispatch
+.extern irq_lock_release
+.extern irqsoff_tracing
+.extern trace_irqs_off
+.extern trace_irqs_on
+
+# int syscall_int80(void) - INT 0x80 path
+.global syscall_int80
+syscall_int80:
+    int $0x80
+    ret
+
+# int syscall_sysenter(void) - SYSENTER path
+.global syscall_sysenter
+syscall_sysenter:
+    pushfl
+    push %ecx
+    push %edx
+    push %ebp
+    mov %esp, %ebp
+    sysenter
+.global sysenter_return
+sysenter_return:
+    pop %ebp
+    pop %edx
+    pop %ecx
+    popfl
+    ret
+
+# SYSENTER_EIP: arrives with IF clear on sysenter_stack
+.global sysenter_entry
+sysenter_entry:
+    mov %ebp, %esp          # Back onto the caller's kernel stack
+
+    push %edi               # arg5
+    push %esi               # arg4
+    push %edx               # arg3
+    push %ecx               # arg2
+    push %ebx               # arg1
+    push %eax               # Syscall number
+
+    # SYSENTER cleared IF behind interrupts_disable's back: open the
+    # tracer's window here if the caller had them on (the arguments are
+    # already saved, so the hook may clobber eax, ecx and edx)
+    cmpb $0, irqsoff_tracing
+    je 2f
+    testl $0x200, 12(%ebp)  # Saved EFLAGS.IF
+    jz 2f
+    call trace_irqs_off
+2:
+    call sysenter_dispatch  # Preserves ebx, esi, edi, ebp
+    add $24, %esp
+
+    # The dispatcher took the interrupt lock; a caller that had interrupts
+    # on gets them back from popfl and must not keep it
+    testl $0x200, 12(%ebp)  # Saved EFLAGS.IF
+    jz 1f
+    push %eax
+    cmpb $0, irqsoff_tracing
+    je 3f
+    call trace_irqs_on      # Closes before popfl sets IF again
+3:
+    call irq_lock_release
+    pop %eax
+1:
+    jmp sysenter_return
+
+# SYSENTER_ESP: only used until the entry switches stacks (or by an NMI
+# arriving before that)
+.section .bss
+.align 16
+sysenter_stack_bottom:
+    .skip 512
+.global sysenter_stack_top
+sysenter_stack_top:
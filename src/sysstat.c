@@ -0,0 +1,340 @@
+/* sysstat.c - Per-syscall statistics and an opt-in syscall trace
+ *
+ * When sysstat_mask is zero the dispatchers call the handler directly and
+ * this file costs one well-predicted branch per system call. Once enabled
+ * they go through sysstat_run, which reads the TSC around the handler and
+ * adds the result to the syscall's counters and log2 cycle histogram. The
+ * time includes any sleep inside the handler, so blocking calls show up
+ * with their full latency. Processes flagged PROCESS_FLAG_STRACE also get
+ * every call (number, arguments, result, cycles) logged to a small ring.
+ */
+
+#include "../include/sysstat.h"
+#include "../include/process.h"
+#include "../include/timer.h"
+#include "../include/cpu.h"
+#include "../include/math64.h"
+#include "../include/idt.h"
+#include "../include/string.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+
+/* Width of the longest histogram bar */
+#define SYSSTAT_BAR_WIDTH 32
+
+/* Counters of one syscall number */
+typedef struct sysstat_entry {
+    uint32_t count;
+    uint32_t errors;                 /* Handler returned < 0 */
+    uint64_t sum_cycles;
+    uint64_t max_cycles;
+    uint32_t buckets[SYSSTAT_BUCKETS];
+} sysstat_entry_t;
+
+/* One traced call */
+typedef struct sysstat_trace_entry {
+    uint32_t pid;
+    uint32_t num;
+    uint32_t args[5];
+    int32_t result;
+    uint32_t cycles;
+    uint32_t tick;
+} sysstat_trace_entry_t;
+
+volatile uint32_t sysstat_mask = 0;
+
+/* Numbers >= SYSSTAT_NR share the last slot */
+static sysstat_entry_t sysstat_table[SYSSTAT_NR + 1];
+static uint32_t sysstat_invalid_count = 0;
+
+/* Trace ring; trace_total counts every entry ever written */
+static sysstat_trace_entry_t sysstat_trace[SYSSTAT_TRACE_ENTRIES];
+static uint32_t sysstat_trace_total = 0;
+
+static const char *sysstat_names[SYSSTAT_NR] = {
+    [SYS_EXIT] = "exit",
+    [SYS_WRITE] = "write",
+    [SYS_READ] = "read",
+    [SYS_OPEN] = "open",
+    [SYS_CLOSE] = "close",
+    [SYS_GETPID] = "getpid",
+    [SYS_SLEEP] = "sleep",
+    [SYS_SIGNAL] = "signal",
+    [SYS_KILL] = "kill",
+    [SYS_FORK] = "fork",
+    [SYS_WAIT] = "wait",
+    [SYS_GETUID] = "getuid",
+    [SYS_MMAP] = "mmap",
+    [SYS_BRK] = "brk",
+    [SYS_SOCKET] = "socket",
+    [SYS_BIND] = "bind",
+    [SYS_LISTEN] = "listen",
+    [SYS_ACCEPT] = "accept",
+    [SYS_CONNECT] = "connect",
+    [SYS_SEND] = "send",
+    [SYS_RECV] = "recv",
+    [SYS_NANOSLEEP] = "nanosleep",
+    [SYS_CLONE] = "clone",
+    [SYS_GETTID] = "gettid",
+    [SYS_FUTEX] = "futex",
+    [SYS_EXECVE] = "execve",
+    [SYS_VFORK] = "vfork",
+    [SYS_SPAWN] = "spawn",
+    [SYS_URING_SETUP] = "uring_setup",
+    [SYS_URING_ENTER] = "uring_enter",
+    [SYS_URING_CLOSE] = "uring_close",
+    [SYS_LSEEK] = "lseek",
+    [SYS_PREAD] = "pread",
+    [SYS_PWRITE] = "pwrite",
+    [SYS_READV] = "readv",
+    [SYS_WRITEV] = "writev",
+    [SYS_DUP2] = "dup2",
+};
+
+static const char *sysstat_name(uint32_t num) {
+    if (num < SYSSTAT_NR && sysstat_names[num]) {
+        return sysstat_names[num];
+    }
+    return "?";
+}
+
+/* Add one call to the counters (interrupts disabled) */
+static void sysstat_account(uint32_t num, int result, uint64_t cycles) {
+    sysstat_entry_t *entry = &sysstat_table[num < SYSSTAT_NR ? num : SYSSTAT_NR];
+    uint32_t bucket = 0;
+
+    if (cycles >> SYSSTAT_MIN_LOG2) {
+        bucket = ilog2_u64(cycles) - SYSSTAT_MIN_LOG2 + 1;
+        if (bucket >= SYSSTAT_BUCKETS) {
+            bucket = SYSSTAT_BUCKETS - 1;
+        }
+    }
+
+    entry->count++;
+    if (result < 0) {
+        entry->errors++;
+    }
+    entry->sum_cycles += cycles;
+    if (cycles > entry->max_cycles) {
+        entry->max_cycles = cycles;
+    }
+    entry->buckets[bucket]++;
+}
+
+/* Log one call to the trace ring (interrupts disabled) */
+static void sysstat_log(process_t *proc, uint32_t num, const uint32_t *args,
+                        int result, uint64_t cycles) {
+    sysstat_trace_entry_t *entry = &sysstat_trace[sysstat_trace_total % SYSSTAT_TRACE_ENTRIES];
+
+    entry->pid = proc->pid;
+    entry->num = num;
+    memcpy(entry->args, args, sizeof(entry->args));
+    entry->result = result;
+    entry->cycles = cycles > 0xFFFFFFFFULL ? 0xFFFFFFFF : (uint32_t)cycles;
+    entry->tick = timer_ticks;
+    sysstat_trace_total++;
+}
+
+/* Run a handler, timing and recording it */
+int sysstat_run(syscall_handler_t handler, uint32_t num, uint32_t arg1, uint32_t arg2,
+                uint32_t arg3, uint32_t arg4, uint32_t arg5) {
+    process_t *proc = process_get_current();
+
+    uint64_t start = rdtsc();
+    int result = handler(arg1, arg2, arg3, arg4, arg5);
+    uint64_t cycles = rdtsc() - start;
+
+    bool flags = interrupts_save();
+    uint32_t mask = sysstat_mask;
+    if (mask & SYSSTAT_COUNT) {
+        sysstat_account(num, result, cycles);
+    }
+    if ((mask & SYSSTAT_TRACE) && proc && (proc->flags & PROCESS_FLAG_STRACE)) {
+        uint32_t args[5] = { arg1, arg2, arg3, arg4, arg5 };
+        sysstat_log(proc, num, args, result, cycles);
+    }
+    interrupts_restore(flags);
+
+    return result;
+}
+
+/* Count a call of an unregistered number */
+void sysstat_invalid(uint32_t num) {
+    (void)num;
+    if (sysstat_mask & SYSSTAT_COUNT) {
+        sysstat_invalid_count++;
+    }
+}
+
+/* Turn collection bits on (on needs a TSC) */
+int sysstat_enable(uint32_t bits) {
+    if (!cpu_has_feature(CPUID_FEAT_EDX_TSC)) {
+        return -1;
+    }
+    sysstat_mask |= bits;
+    return 0;
+}
+
+void sysstat_disable(uint32_t bits) {
+    sysstat_mask &= ~bits;
+}
+
+/* Clear the counters, histograms and trace ring */
+void sysstat_reset(void) {
+    bool flags = interrupts_save();
+    memset(sysstat_table, 0, sizeof(sysstat_table));
+    sysstat_invalid_count = 0;
+    memset(sysstat_trace, 0, sizeof(sysstat_trace));
+    sysstat_trace_total = 0;
+    interrupts_restore(flags);
+}
+
+static void sysstat_print_padded(const char *str, int width) {
+    int len = (int)strlen(str);
+    printk("%s", str);
+    while (len++ < width) {
+        printk(" ");
+    }
+}
+
+/* Print a number left-aligned in a column */
+static void sysstat_print_num(uint32_t value, int width) {
+    char num[12];
+    snprintf(num, sizeof(num), "%u", value);
+    sysstat_print_padded(num, width);
+}
+
+static void sysstat_print_header(const char *title) {
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== %s ===\n", title);
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+}
+
+/* Print the per-syscall table */
+void sysstat_print(void) {
+    static sysstat_entry_t snapshot[SYSSTAT_NR + 1];
+
+    bool flags = interrupts_save();
+    memcpy(snapshot, sysstat_table, sizeof(snapshot));
+    uint32_t invalid = sysstat_invalid_count;
+    interrupts_restore(flags);
+
+    sysstat_print_header("Syscall statistics (cycles)");
+    printk("Counting: %s, trace: %s\n",
+           (sysstat_mask & SYSSTAT_COUNT) ? "on" : "off",
+           (sysstat_mask & SYSSTAT_TRACE) ? "on" : "off");
+
+    printk("NR  NAME          CALLS     ERRORS    AVG       MAX\n");
+    uint32_t total = 0;
+    for (uint32_t i = 0; i <= SYSSTAT_NR; i++) {
+        sysstat_entry_t *entry = &snapshot[i];
+        if (!entry->count) {
+            continue;
+        }
+        total += entry->count;
+
+        if (i < SYSSTAT_NR) {
+            sysstat_print_num(i, 4);
+        } else {
+            sysstat_print_padded(">=", 4);
+        }
+        sysstat_print_padded(i < SYSSTAT_NR ? sysstat_name(i) : "(other)", 14);
+        sysstat_print_num(entry->count, 10);
+        sysstat_print_num(entry->errors, 10);
+        sysstat_print_num((uint32_t)div_u64(entry->sum_cycles, entry->count), 10);
+        printk("%u\n", (uint32_t)entry->max_cycles);
+    }
+
+    if (!total) {
+        printk("No calls recorded\n");
+    }
+    if (invalid) {
+        printk("Invalid syscall numbers: %u\n", invalid);
+    }
+}
+
+/* Print one syscall's latency histogram */
+void sysstat_print_hist(uint32_t num) {
+    sysstat_entry_t entry;
+    if (num > SYSSTAT_NR) {
+        num = SYSSTAT_NR;
+    }
+
+    bool flags = interrupts_save();
+    memcpy(&entry, &sysstat_table[num], sizeof(entry));
+    interrupts_restore(flags);
+
+    char title[48];
+    snprintf(title, sizeof(title), "Syscall %u (%s) latency",
+             num, num < SYSSTAT_NR ? sysstat_name(num) : "other");
+    sysstat_print_header(title);
+
+    if (!entry.count) {
+        printk("No samples\n");
+        return;
+    }
+    printk("%u calls, %u errors, avg %u cycles, max %u cycles\n", entry.count, entry.errors,
+           (uint32_t)div_u64(entry.sum_cycles, entry.count), (uint32_t)entry.max_cycles);
+
+    uint32_t peak = 0;
+    for (int i = 0; i < SYSSTAT_BUCKETS; i++) {
+        if (entry.buckets[i] > peak) {
+            peak = entry.buckets[i];
+        }
+    }
+
+    for (int i = 0; i < SYSSTAT_BUCKETS; i++) {
+        uint32_t count = entry.buckets[i];
+        if (!count) {
+            continue;
+        }
+
+        char label[24];
+        uint32_t low = 1U << (i + SYSSTAT_MIN_LOG2 - 1);
+        if (i == 0) {
+            snprintf(label, sizeof(label), "  < %u", 1U << SYSSTAT_MIN_LOG2);
+        } else if (i == SYSSTAT_BUCKETS - 1) {
+            snprintf(label, sizeof(label), "  >= %u", low);
+        } else {
+            snprintf(label, sizeof(label), "  %u-%u", low, low << 1);
+        }
+        sysstat_print_padded(label, 24);
+        sysstat_print_num(count, 8);
+
+        uint32_t bar = (count * SYSSTAT_BAR_WIDTH + peak - 1) / peak;
+        while (bar--) {
+            printk("#");
+        }
+        printk("\n");
+    }
+}
+
+/* Print the trace ring, oldest first */
+void sysstat_print_trace(void) {
+    static sysstat_trace_entry_t snapshot[SYSSTAT_TRACE_ENTRIES];
+
+    bool flags = interrupts_save();
+    memcpy(snapshot, sysstat_trace, sizeof(snapshot));
+    uint32_t total = sysstat_trace_total;
+    interrupts_restore(flags);
+
+    sysstat_print_header("Syscall trace");
+
+    if (!total) {
+        printk("Empty (trace a process with: sysstat trace <pid>)\n");
+        return;
+    }
+
+    uint32_t first = total > SYSSTAT_TRACE_ENTRIES ? total - SYSSTAT_TRACE_ENTRIES : 0;
+    if (first) {
+        printk("(%u older entries overwritten)\n", first);
+    }
+
+    for (uint32_t i = first; i < total; i++) {
+        sysstat_trace_entry_t *entry = &snapshot[i % SYSSTAT_TRACE_ENTRIES];
+        printk("[%u] pid %u %s(0x%x, 0x%x, 0x%x, 0x%x, 0x%x) = %d  %u cycles\n",
+               entry->tick, entry->pid, sysstat_name(entry->num),
+               entry->args[0], entry->args[1], entry->args[2],
+               entry->args[3], entry->args[4], entry->result, entry->cycles);
+    }
+}
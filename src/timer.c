@@ -1,12 +1,29 @@
-/* timer.c - Programmable Interval Timer implementation */
+/* timer.c - Programmable Interval Timer implementation
+ *
+ * The PIT drives global time (timer_ticks, the clocksource time base and
+ * timer expiry) until the boot CPU's local APIC timer is calibrated; from
+ * then on that timer does, and IRQ0 is masked so the boot CPU takes one
+ * timer interrupt per tick. IRQ0 stays on only while the PIT is the
+ * clocksource in use (its counter is extended by the IRQ0 periods) or
+ * when the APIC timer is unusable, in which case the PIT relays every
+ * tick to the other CPUs as before.
+ */
 
 #include "../include/timer.h"
 #include "../include/idt.h"
-#include "../include/pic.h"
+#include "../include/irq.h"
+#include "../include/apic.h"
 #include "../include/printf.h"
 #include "../include/process.h"
 #include "../include/panic.h"
 #include "../include/io.h"
+#include "../include/clocksource.h"
+#include "../include/ktimer.h"
+#include "../include/hrtimer.h"
+#include "../include/cpu.h"
+#include "../include/math64.h"
+#include "../include/softirq.h"
+#include "../include/smp.h"
 
 /* PIT I/O ports */
 #define PIT_CHANNEL0 0x40  /* Channel 0 data port (used for system timer) */
@@ -14,30 +31,133 @@
 
 /* PIT command bits */
 #define PIT_CMD_BINARY     0x00  /* Use binary counter (not BCD) */
-#define PIT_CMD_MODE3      0x06  /* Mode 3: Square Wave Generator */
+#define PIT_CMD_MODE2      0x04  /* Mode 2: Rate Generator (linear countdown) */
+#define PIT_CMD_LATCH      0x00  /* Counter latch command */
 #define PIT_CMD_RW_BOTH    0x30  /* Read/Write: LSB then MSB */
 #define PIT_CMD_CHANNEL0   0x00  /* Select channel 0 */
 
 /* Timer ticks counter */
 volatile uint32_t timer_ticks = 0;
 
+/* Programmed channel 0 reload value */
+static uint32_t pit_divisor = 0;
+
+/* IRQ0 periods counted, the high part of the PIT clocksource */
+static volatile uint32_t pit_periods = 0;
+
+/* PIT clocksource: ticks * divisor plus the progress of the current period */
+static uint64_t pit_read(void) {
+    static uint64_t pit_last = 0;
+    bool was_enabled = interrupts_save();
+
+    outb(PIT_COMMAND, PIT_CMD_CHANNEL0 | PIT_CMD_LATCH);
+    uint32_t count = inb(PIT_CHANNEL0);
+    count |= (uint32_t)inb(PIT_CHANNEL0) << 8;
+
+    uint64_t cycles = (uint64_t)pit_periods * pit_divisor + (pit_divisor - count);
+
+    /* The counter may have reloaded before the tick IRQ was handled */
+    if (cycles < pit_last) {
+        cycles = pit_last;
+    }
+    pit_last = cycles;
+
+    interrupts_restore(was_enabled);
+    return cycles;
+}
+
+/* The clocksource needs IRQ0 to count periods, even after the local
+ * APIC timer took over the tick */
+static void pit_enable(void) {
+    irq_unmask(0);
+}
+
+static void pit_disable(void) {
+    if (apic_timer_enabled()) {
+        irq_mask(0);
+    }
+}
+
+static clocksource_t clocksource_pit = {
+    .name = "pit",
+    .rating = CLOCKSOURCE_RATING_PIT,
+    .read = pit_read,
+    .mask = 0xFFFFFFFFFFFFFFFFULL,
+    .enable = pit_enable,
+    .disable = pit_disable,
+};
+
 /* Scheduling frequency (call scheduler every N ticks) */
 #define SCHEDULE_FREQUENCY 10  /* Schedule every 10 ticks (100ms at 100Hz) */
 
-/* Timer interrupt handler */
-static void timer_irq_handler(struct interrupt_frame *frame) {
-    (void)frame;  /* Unused */
+/* Timer softirq: expire wheel timers and due hrtimers (may wake processes) */
+static void timer_softirq(void) {
+    run_timers();
+    hrtimer_run_queues();
+}
+
+/* Per-CPU part of a tick: charge it to the interrupted process and end
+ * the time slice (from the local APIC timer, or the relayed PIT tick) */
+void timer_local_tick(struct interrupt_frame *frame) {
+    cpu_t *cpu = this_cpu();
+
+    cpu->ticks++;
+    if (cpu->current == cpu->idle) {
+        cpu->idle_ticks++;
+    }
+
+    /* Charge the tick to the interrupted process, update the load average */
+    process_account_tick(frame->cs);
 
+    /* Time slice over: switch on interrupt exit. An idle CPU looks for
+     * work to steal on every tick. */
+    if (cpu->ticks % SCHEDULE_FREQUENCY == 0 || cpu->current == cpu->idle) {
+        process_need_resched = true;
+    }
+}
+
+/* Global part of a tick, on the boot CPU only */
+void timer_global_tick(void) {
     /* Increment tick counter */
     timer_ticks++;
 
-    /* Call scheduler periodically for preemptive multitasking */
-    if (timer_ticks % SCHEDULE_FREQUENCY == 0) {
-        process_schedule();
+    /* Advance the clocksource time base */
+    clocksource_tick();
+
+    /* Timer expiry runs as a softirq once interrupts are back on */
+    raise_softirq(TIMER_SOFTIRQ);
+}
+
+/* Timer interrupt handler (top half) */
+static void timer_irq_handler(struct interrupt_frame *frame) {
+    pit_periods++;
+
+    /* Send EOI before anything below can switch to another task */
+    irq_eoi(0);  /* IRQ0 */
+
+    /* The local APIC timer keeps time once it runs; left unmasked, IRQ0
+     * only extends the PIT clocksource */
+    if (apic_timer_enabled()) {
+        return;
     }
 
-    /* Send EOI to PIC */
-    pic_send_eoi(0);  /* IRQ0 */
+    /* Without local APIC timers, the PIT ticks for every CPU: pass the
+     * tick on to the others and take our own share */
+    timer_global_tick();
+    smp_send_tick();
+    timer_local_tick(frame);
+}
+
+/* The boot CPU's local APIC timer runs: stop IRQ0 unless the PIT
+ * clocksource still needs it */
+void timer_apic_takeover(void) {
+    bool flags = interrupts_save();
+    if (clocksource_get_current() != &clocksource_pit) {
+        pit_disable();
+    }
+    interrupts_restore(flags);
+    printk("[TIMER] Global tick from the local APIC timer%s\n",
+           clocksource_get_current() == &clocksource_pit ? " (IRQ0 kept for the PIT clocksource)" : "");
 }
 
 /* Initialize the PIT timer */
@@ -53,18 +173,29 @@ void timer_init(uint32_t frequency) {
         divisor = 1;
     }
 
+    /* Kernel timers are driven from the tick */
+    ktimer_init();
+    open_softirq(TIMER_SOFTIRQ, timer_softirq);
+
     /* Register IRQ0 handler */
     idt_register_handler(IRQ0, timer_irq_handler);
 
-    /* Send command byte to PIT */
-    outb(PIT_COMMAND, PIT_CMD_CHANNEL0 | PIT_CMD_RW_BOTH | PIT_CMD_MODE3 | PIT_CMD_BINARY);
+    /* Send command byte to PIT (rate generator so latched counts are linear) */
+    outb(PIT_COMMAND, PIT_CMD_CHANNEL0 | PIT_CMD_RW_BOTH | PIT_CMD_MODE2 | PIT_CMD_BINARY);
 
     /* Send divisor (low byte then high byte) */
     outb(PIT_CHANNEL0, divisor & 0xFF);
     outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
 
+    /* Expose the PIT counter as a clocksource */
+    pit_divisor = divisor;
+    clocksource_calc_mult_shift(&clocksource_pit.mult, &clocksource_pit.shift,
+                                PIT_FREQUENCY, NSEC_PER_SEC);
+    clocksource_pit.freq_khz = PIT_FREQUENCY / 1000;
+    clocksource_register(&clocksource_pit);
+
     /* Unmask IRQ0 (enable timer interrupts) */
-    pic_unmask_irq(0);
+    irq_unmask(0);
 
     printk("[TIMER] Initialized at %d Hz (divisor %d)\n", frequency, divisor);
 }
@@ -77,8 +208,67 @@ uint32_t timer_get_ticks(void) {
 /* Wait for specified number of ticks */
 void timer_wait(uint32_t ticks) {
     uint32_t end_ticks = timer_ticks + ticks;
-    while (timer_ticks < end_ticks) {
-        /* Busy wait */
-        __asm__ volatile("hlt");  /* Halt until next interrupt */
+    process_t *proc = process_get_current();
+
+    /* Before the first process (or with interrupts off) there is nothing
+     * to switch to: halt until the tick arrives */
+    if (!proc || !interrupts_enabled()) {
+        while (time_before(timer_ticks, end_ticks)) {
+            __asm__ volatile("hlt");  /* Halt until next interrupt */
+        }
+        return;
+    }
+
+    /* Block and arm the wakeup in one section: switched out BLOCKED
+     * before the timer is armed, nothing would wake it */
+    while (time_before(timer_ticks, end_ticks)) {
+        bool flags = interrupts_save();
+        proc->state = PROCESS_STATE_BLOCKED;
+        schedule_timeout((int32_t)(end_ticks - timer_ticks));
+        interrupts_restore(flags);
+    }
+}
+
+/* Sleep for a number of nanoseconds, blocking on an hrtimer */
+void timer_nanosleep(uint64_t ns) {
+    uint64_t deadline = ktime_get_ns() + ns;
+    process_t *proc = process_get_current();
+
+    /* Short waits (or no process to block) spin on the clocksource */
+    if (ns < HRTIMER_SPIN_THRESHOLD_NS || !proc || !interrupts_enabled()) {
+        while (ktime_get_ns() < deadline) {
+            cpu_relax();
+        }
+        return;
+    }
+
+    while (ktime_get_ns() < deadline) {
+        bool flags = interrupts_save();
+        proc->state = PROCESS_STATE_BLOCKED;
+        hrtimer_start(&proc->sleep_hrtimer, deadline);
+        process_schedule();
+        interrupts_restore(flags);
+    }
+    hrtimer_cancel(&proc->sleep_hrtimer);
+}
+
+/* sys_nanosleep - Sleep for the duration in *req */
+int sys_nanosleep(uint32_t req_ptr, uint32_t rem_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
+    (void)unused1; (void)unused2; (void)unused3;
+
+    timespec_t *req = (timespec_t *)req_ptr;
+    timespec_t *rem = (timespec_t *)rem_ptr;
+
+    if (!req || req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec >= (int32_t)NSEC_PER_SEC) {
+        return -1;
+    }
+
+    timer_nanosleep((uint64_t)req->tv_sec * NSEC_PER_SEC + (uint32_t)req->tv_nsec);
+
+    /* Sleeps are not interrupted by signals, so nothing remains */
+    if (rem) {
+        rem->tv_sec = 0;
+        rem->tv_nsec = 0;
     }
+    return 0;
 }
@@ -0,0 +1,76 @@
+# trampoline.s - Application processor startup code
+#
+# smp_init copies trampoline_start..trampoline_end to SMP_TRAMPOLINE_BASE
+# (0x8000); a STARTUP IPI for page 8 starts an AP there in real mode with
+# CS = 0x0800, IP = 0. It loads the kernel GDT, enters protected mode,
+# turns paging on with the kernel page directory and calls the C entry
+# with its argument on the stack it is given. Everything it needs is in
+# the parameter block at the end, filled in by the boot CPU before each
+# STARTUP, so the code itself only uses offsets from trampoline_start.
+
+# Mark stack as non-executable
+.section .note.GNU-stack,"",@progbits
+
+.set TRAMPOLINE_BASE, 0x8000
+.set CR0_PE,          0x00000001
+.set CR0_PG_WP,       0x80010000
+
+.section .text
+
+.code16
+.global trampoline_start
+trampoline_start:
+    cli
+    cld
+    mov %cs, %ax
+    mov %ax, %ds
+
+    lgdtl trampoline_params - trampoline_start
+
+    mov %cr0, %eax
+    or $CR0_PE, %eax
+    mov %eax, %cr0
+
+    # Far jump into the 32-bit kernel code segment (flat, base 0)
+    ljmpl $0x08, $(TRAMPOLINE_BASE + trampoline_32 - trampoline_start)
+
+.code32
+trampoline_32:
+    mov $0x10, %ax
+    mov %ax, %ds
+    mov %ax, %es
+    mov %ax, %fs
+    mov %ax, %gs
+    mov %ax, %ss
+
+    # Same address space as the boot CPU
+    mov TRAMPOLINE_BASE + (tp_cr3 - trampoline_start), %eax
+    mov %eax, %cr3
+    mov %cr0, %eax
+    or $CR0_PG_WP, %eax
+    mov %eax, %cr0
+
+    # entry(arg) on the prepared stack; it never returns
+    mov TRAMPOLINE_BASE + (tp_stack - trampoline_start), %esp
+    xor %ebp, %ebp
+    pushl TRAMPOLINE_BASE + (tp_arg - trampoline_start)
+    call *TRAMPOLINE_BASE + (tp_entry - trampoline_start)
+
+1:  cli
+    hlt
+    jmp 1b
+
+# Parameter block (smp.c: trampoline_params_t)
+.align 4
+.global trampoline_params
+trampoline_params:
+    .word 0                 # GDT limit
+    .long 0                 # GDT base
+    .word 0
+tp_cr3:   .long 0           # CR3
+tp_stack: .long 0           # Stack top
+tp_entry: .long 0           # C entry
+tp_arg:   .long 0           # Its argument
+
+.global trampoline_end
+trampoline_end:
@@ -0,0 +1,69 @@
+/* uaccess.c - Copying to and from process buffers
+ *
+ * Processes share the kernel's privilege level, so a buffer argument is
+ * only checked against the range no process may name (NULL and the fixed
+ * kernel pages at the top); the copy itself may demand-fault pages in.
+ * Copies move four bytes per iteration with rep movsl, which matters for
+ * the file layer's multi-kilobyte chunks.
+ */
+
+#include "../include/uaccess.h"
+#include "../include/vdso.h"
+
+/* Whether the range may hold a process buffer */
+bool access_ok(uint32_t addr, uint32_t size) {
+    if (!size) {
+        return true;
+    }
+    if (!addr || addr + size < addr) {
+        return false;
+    }
+    return addr + size <= VDSO_BASE;
+}
+
+/* rep movsl for the dwords, rep movsb for the tail */
+static void uaccess_copy(void *dest, const void *src, uint32_t size) {
+    uint32_t dwords = size >> 2;
+    uint32_t bytes = size & 3;
+
+    __asm__ volatile("cld\n\t"
+                     "rep movsl\n\t"
+                     "mov %3, %%ecx\n\t"
+                     "rep movsb"
+                     : "+D"(dest), "+S"(src), "+c"(dwords)
+                     : "r"(bytes)
+                     : "memory");
+}
+
+int copy_from_user(void *dest, uint32_t src, uint32_t size) {
+    if (!access_ok(src, size)) {
+        return -1;
+    }
+    uaccess_copy(dest, (const void *)src, size);
+    return 0;
+}
+
+int copy_to_user(uint32_t dest, const void *src, uint32_t size) {
+    if (!access_ok(dest, size)) {
+        return -1;
+    }
+    uaccess_copy((void *)dest, src, size);
+    return 0;
+}
+
+/* Copy a NUL-terminated string of at most size bytes */
+int strncpy_from_user(char *dest, uint32_t src, uint32_t size) {
+    if (!src || !size) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        if (src + i >= VDSO_BASE) {
+            return -1;
+        }
+        dest[i] = *(const char *)(src + i);
+        if (!dest[i]) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
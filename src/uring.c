@@ -0,0 +1,558 @@
+/* uring.c - Submission/completion rings for batched system calls
+ *
+ * A ring is one page mapped into the process that set it up and seen by
+ * the kernel through its identity mapping. The process queues many
+ * operations in the submission queue and rings the doorbell once
+ * (sys_uring_enter); with URING_SETUP_SQPOLL the ring's kernel thread
+ * picks them up by itself and the doorbell is only needed to wake it
+ * after it went idle. Operations that complete right away (nop, send,
+ * a receive or poll on a ready socket) are done in the submitter; file
+ * I/O, which may sleep on the disk, and anything that has to wait goes
+ * to the ring's kernel thread. That thread borrows the owner's address
+ * space so it can reach the buffers, re-polls waiting operations every
+ * tick and posts completions to the completion queue.
+ *
+ * Kernel-side ring state only changes with interrupts disabled, that is
+ * under the global interrupt lock (idt.c), so submitters, the ring's
+ * thread and completions on different CPUs take turns. The process side
+ * of the ring runs on any CPU without that lock; it is safe because each
+ * index has one writer: the process writes sq_tail and cq_head, the
+ * kernel sq_head and cq_tail. x86 keeps stores in program order as seen
+ * by other CPUs, and a compiler barrier between filling an entry and
+ * publishing its index keeps the compiler from reordering them, so
+ * whoever sees an index advance also sees the entry behind it.
+ */
+
+#include "../include/uring.h"
+#include "../include/paging.h"
+#include "../include/kmalloc.h"
+#include "../include/kthread.h"
+#include "../include/socket.h"
+#include "../include/vfs.h"
+#include "../include/file.h"
+#include "../include/wait.h"
+#include "../include/list.h"
+#include "../include/timer.h"
+#include "../include/idt.h"
+#include "../include/uaccess.h"
+#include "../include/string.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+
+/* An operation waiting in the ring's thread */
+typedef struct uring_async {
+    list_head_t list;
+    uring_sqe_t sqe;
+    uint32_t deadline;               /* URING_OP_TIMEOUT expiry (ticks) */
+} uring_async_t;
+
+/* Kernel side of a ring */
+typedef struct uring {
+    uint32_t id;
+    uint32_t flags;                  /* URING_SETUP_* */
+    uint32_t owner;                  /* PID that set it up */
+    uint32_t users;                  /* Table entry plus callers inside enter */
+    uring_shared_t *shared;          /* The shared page (kernel view) */
+    uint32_t user_addr;              /* ... and where the owner sees it */
+    mm_t *mm;                        /* Owner's address space (referenced) */
+    files_struct_t *files;           /* Owner's descriptors (referenced) */
+    process_t *worker;
+
+    list_head_t async;               /* uring_async_t waiting in the worker */
+    uint32_t nr_async;
+    bool closing;
+    uint32_t last_submit;            /* SQPOLL: tick of the last submission */
+
+    wait_queue_head_t worker_wait;   /* Worker: new async work, SQ, close */
+    wait_queue_head_t cq_wait;       /* Callers waiting for completions */
+
+    /* Statistics */
+    uint32_t submitted;
+    uint32_t completed_inline;
+    uint32_t completed_async;
+    uint32_t enters;
+    uint32_t sqpoll_wakeups;
+} uring_t;
+
+static uring_t *rings[URING_MAX_RINGS];
+
+/* Look up a ring and take a reference */
+static uring_t *uring_get(uint32_t id) {
+    if (id >= URING_MAX_RINGS) {
+        return NULL;
+    }
+
+    bool flags = interrupts_save();
+    uring_t *ring = rings[id];
+    if (ring && !ring->closing) {
+        ring->users++;
+    } else {
+        ring = NULL;
+    }
+    interrupts_restore(flags);
+    return ring;
+}
+
+/* Drop a reference; the worker frees the ring after the last one */
+static void uring_put(uring_t *ring) {
+    bool flags = interrupts_save();
+    if (--ring->users == 0) {
+        wake_up_all(&ring->worker_wait);
+    }
+    interrupts_restore(flags);
+}
+
+/* Post a completion (counted as dropped if the CQ is full) */
+static void uring_complete(uring_t *ring, uint32_t user_data, int32_t res) {
+    uring_shared_t *sh = ring->shared;
+    bool flags = interrupts_save();
+
+    if (sh->cq_tail - sh->cq_head >= URING_CQ_ENTRIES) {
+        sh->cq_overflow++;
+    } else {
+        uring_cqe_t *cqe = &sh->cqes[sh->cq_tail & (URING_CQ_ENTRIES - 1)];
+        cqe->user_data = user_data;
+        cqe->res = res;
+        __asm__ volatile("" ::: "memory");
+        sh->cq_tail++;
+    }
+    wake_up_all(&ring->cq_wait);
+
+    interrupts_restore(flags);
+}
+
+/* Socket id behind one of the owner's descriptors (-1 if none) */
+static int uring_socket(uring_t *ring, int32_t fd) {
+    file_t *file = files_fget(ring->files, fd);
+    if (!file) {
+        return -1;
+    }
+    int sock = file->type == FILE_TYPE_SOCKET ? file->sock : -1;
+    fput(file);
+    return sock;
+}
+
+/* Check whether a socket operation can go ahead now (-1: bad socket) */
+static int uring_socket_ready(int sock, uint32_t events) {
+    if (!socket_get_by_fd(sock)) {
+        return -1;
+    }
+    uint32_t ready = 0;
+    if (socket_can_read(sock)) {
+        ready |= URING_POLL_IN;
+    }
+    if (socket_can_write(sock)) {
+        ready |= URING_POLL_OUT;
+    }
+    return (int)(ready & events);
+}
+
+/* Try to finish an operation without sleeping. Returns true (with *res
+ * set) if it is done, false if it has to wait in the worker. */
+static bool uring_try_op(uring_t *ring, const uring_sqe_t *sqe, uint32_t deadline, int32_t *res) {
+    int sock, ready;
+
+    switch (sqe->opcode) {
+        case URING_OP_NOP:
+            *res = 0;
+            return true;
+
+        case URING_OP_SEND:
+            if (!access_ok(sqe->addr, sqe->len)) {
+                *res = -1;
+                return true;
+            }
+            sock = uring_socket(ring, sqe->fd);
+            *res = socket_send(sock, (const void *)sqe->addr, sqe->len, 0);
+            return true;
+
+        case URING_OP_RECV:
+            if (!access_ok(sqe->addr, sqe->len)) {
+                *res = -1;
+                return true;
+            }
+            sock = uring_socket(ring, sqe->fd);
+            ready = uring_socket_ready(sock, URING_POLL_IN);
+            if (ready == 0) {
+                return false;
+            }
+            *res = ready < 0 ? -1 : socket_recv(sock, (void *)sqe->addr, sqe->len, 0);
+            return true;
+
+        case URING_OP_POLL:
+            ready = uring_socket_ready(uring_socket(ring, sqe->fd), sqe->len);
+            if (ready == 0) {
+                return false;
+            }
+            *res = ready;
+            return true;
+
+        case URING_OP_TIMEOUT:
+            if (time_before(timer_ticks, deadline)) {
+                return false;
+            }
+            *res = 0;
+            return true;
+
+        default:
+            *res = -1;
+            return true;
+    }
+}
+
+/* File I/O, in the worker (may sleep on the disk): by path, or on one
+ * of the owner's descriptors when there is none. The buffer and path
+ * come from the process, so they are checked like system call arguments. */
+static int32_t uring_file_op(uring_t *ring, const uring_sqe_t *sqe) {
+    if (!access_ok(sqe->addr, sqe->len)) {
+        return -1;
+    }
+    if (!sqe->path) {
+        file_t *file = files_fget(ring->files, sqe->fd);
+        if (!file) {
+            return -1;
+        }
+        int32_t res = sqe->opcode == URING_OP_READ ?
+                      file_pread(file, (void *)sqe->addr, sqe->len, sqe->off) :
+                      file_pwrite(file, (const void *)sqe->addr, sqe->len, sqe->off);
+        fput(file);
+        return res;
+    }
+
+    char path[256];
+    if (strncpy_from_user(path, sqe->path, sizeof(path)) <= 0) {
+        return -1;
+    }
+    vfs_node_t *node = vfs_resolve_path(path);
+    if (!node) {
+        return -1;
+    }
+    if (sqe->opcode == URING_OP_READ) {
+        return vfs_read(node, sqe->off, sqe->len, (void *)sqe->addr);
+    }
+    return vfs_write(node, sqe->off, sqe->len, (const void *)sqe->addr);
+}
+
+/* Hand an operation to the worker */
+static void uring_punt(uring_t *ring, const uring_sqe_t *sqe, uint32_t deadline) {
+    uring_async_t *req = (uring_async_t *)kmalloc(sizeof(uring_async_t));
+    if (!req) {
+        uring_complete(ring, sqe->user_data, -1);
+        return;
+    }
+    req->sqe = *sqe;
+    req->deadline = deadline;
+
+    bool flags = interrupts_save();
+    list_add_tail(&req->list, &ring->async);
+    ring->nr_async++;
+    wake_up(&ring->worker_wait);
+    interrupts_restore(flags);
+}
+
+/* Consume up to max submission queue entries */
+static uint32_t uring_submit(uring_t *ring, uint32_t max) {
+    uring_shared_t *sh = ring->shared;
+    uint32_t done = 0;
+
+    while (done < max) {
+        uring_sqe_t sqe;
+
+        bool flags = interrupts_save();
+        uint32_t head = sh->sq_head;
+        if (head == sh->sq_tail) {
+            interrupts_restore(flags);
+            break;
+        }
+        __asm__ volatile("" ::: "memory");
+        sqe = sh->sqes[head & (URING_SQ_ENTRIES - 1)];
+        sh->sq_head = head + 1;
+        interrupts_restore(flags);
+        done++;
+
+        int32_t res;
+        uint32_t deadline = 0;
+        if (sqe.opcode == URING_OP_TIMEOUT) {
+            deadline = timer_ticks + (sqe.off * TIMER_FREQUENCY + 999) / 1000;
+        }
+        if (sqe.opcode != URING_OP_READ && sqe.opcode != URING_OP_WRITE &&
+            uring_try_op(ring, &sqe, deadline, &res)) {
+            uring_complete(ring, sqe.user_data, res);
+            ring->completed_inline++;
+        } else {
+            uring_punt(ring, &sqe, deadline);
+        }
+    }
+
+    ring->submitted += done;
+    if (done) {
+        ring->last_submit = timer_ticks;
+    }
+    return done;
+}
+
+/* Run or re-poll the waiting operations; returns how many finished */
+static uint32_t uring_run_async(uring_t *ring) {
+    uint32_t finished = 0;
+    list_head_t *pos, *tmp;
+
+    list_for_each_safe(pos, tmp, &ring->async) {
+        uring_async_t *req = list_entry(pos, uring_async_t, list);
+        int32_t res;
+
+        if (req->sqe.opcode == URING_OP_READ || req->sqe.opcode == URING_OP_WRITE) {
+            res = uring_file_op(ring, &req->sqe);
+        } else if (!uring_try_op(ring, &req->sqe, req->deadline, &res)) {
+            continue;
+        }
+
+        bool flags = interrupts_save();
+        list_del(&req->list);
+        ring->nr_async--;
+        interrupts_restore(flags);
+
+        uring_complete(ring, req->sqe.user_data, res);
+        ring->completed_async++;
+        kfree(req);
+        finished++;
+    }
+    return finished;
+}
+
+/* Whether the SQPOLL thread has entries to pick up */
+static bool uring_sq_pending(uring_t *ring) {
+    return (ring->flags & URING_SETUP_SQPOLL) && ring->shared->sq_head != ring->shared->sq_tail;
+}
+
+/* The ring's kernel thread: async operations, and SQ polling */
+static int uring_worker(void *arg) {
+    uring_t *ring = (uring_t *)arg;
+    bool sqpoll = (ring->flags & URING_SETUP_SQPOLL) != 0;
+
+    process_use_mm(ring->mm);
+
+    while (!ring->closing) {
+        uint32_t progress = 0;
+        if (sqpoll) {
+            progress += uring_submit(ring, URING_SQ_ENTRIES);
+        }
+        progress += uring_run_async(ring);
+        if (progress) {
+            continue;
+        }
+
+        /* SQPOLL: keep polling for a while after the last submission */
+        if (sqpoll && time_before(timer_ticks, ring->last_submit + URING_SQPOLL_IDLE)) {
+            process_schedule();
+            continue;
+        }
+
+        if (sqpoll) {
+            ring->shared->flags |= URING_SQ_NEED_WAKEUP;
+        }
+        if (ring->nr_async) {
+            /* Something waits for a socket or a deadline: look again next tick */
+            wait_event_timeout(ring->worker_wait,
+                               ring->closing || uring_sq_pending(ring), 1);
+        } else {
+            wait_event(ring->worker_wait,
+                       ring->closing || ring->nr_async || uring_sq_pending(ring));
+        }
+        if (sqpoll) {
+            ring->shared->flags &= ~URING_SQ_NEED_WAKEUP;
+            ring->last_submit = timer_ticks;
+        }
+    }
+
+    /* Closed: drop what is still waiting, then wait for callers to leave */
+    list_head_t *pos, *tmp;
+    list_for_each_safe(pos, tmp, &ring->async) {
+        list_del(pos);
+        kfree(list_entry(pos, uring_async_t, list));
+    }
+    wait_event(ring->worker_wait, ring->users == 0);
+
+    process_unuse_mm();
+    mm_put(ring->mm);
+    files_put(ring->files);
+    paging_release_frame((uint32_t)ring->shared | PAGE_SHARED | PAGE_PRESENT);
+
+    bool flags = interrupts_save();
+    rings[ring->id] = NULL;
+    interrupts_restore(flags);
+    kfree(ring);
+    return 0;
+}
+
+/* Mark a ring closed; its worker finishes the teardown */
+static void uring_close(uring_t *ring) {
+    bool flags = interrupts_save();
+    if (!ring->closing) {
+        ring->closing = true;
+        ring->users--;               /* The table's reference */
+        wake_up_all(&ring->cq_wait);
+        wake_up_all(&ring->worker_wait);
+    }
+    interrupts_restore(flags);
+}
+
+/* Close the rings a process set up (it is exiting) */
+void uring_exit_task(process_t *proc) {
+    bool flags = interrupts_save();
+    for (uint32_t i = 0; i < URING_MAX_RINGS; i++) {
+        if (rings[i] && rings[i]->owner == proc->pid) {
+            uring_close(rings[i]);
+        }
+    }
+    interrupts_restore(flags);
+}
+
+/* sys_uring_setup - Map a ring into the caller and start its thread */
+int sys_uring_setup(uint32_t flags, uint32_t addr_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
+    (void)unused1; (void)unused2; (void)unused3;
+
+    process_t *proc = process_get_current();
+    if (!proc || !proc->cold->mm || !access_ok(addr_ptr, sizeof(uint32_t)) ||
+        (flags & ~URING_SETUP_SQPOLL)) {
+        return -1;
+    }
+    mm_t *mm = proc->cold->mm;
+
+    bool iflags = interrupts_save();
+    int id = -1;
+    for (int i = 0; i < URING_MAX_RINGS; i++) {
+        if (!rings[i]) {
+            id = i;
+            break;
+        }
+    }
+    uring_t *ring = id >= 0 ? (uring_t *)kmalloc(sizeof(uring_t)) : NULL;
+    uring_shared_t *shared = ring ? (uring_shared_t *)paging_alloc_frame() : NULL;
+    if (!shared || paging_share_frame((uint32_t)shared) != 0) {
+        interrupts_restore(iflags);
+        kfree(shared);
+        kfree(ring);
+        return -1;
+    }
+    memset(ring, 0, sizeof(uring_t));
+    rings[id] = ring;               /* Reserve the slot */
+    interrupts_restore(iflags);
+
+    memset(shared, 0, PAGE_SIZE);
+    shared->sq_entries = URING_SQ_ENTRIES;
+    shared->cq_entries = URING_CQ_ENTRIES;
+
+    /* One reference for the owner's mapping, one for the kernel */
+    paging_shared_frame_get((uint32_t)shared);
+    uint32_t virt = mm->heap_end;
+    paging_map_page_in_directory(mm->pgd, virt, (uint32_t)shared,
+                                 PAGE_USER | PAGE_WRITE | PAGE_SHARED);
+    mm->heap_end += PAGE_SIZE;
+
+    ring->id = (uint32_t)id;
+    ring->flags = flags;
+    ring->owner = proc->pid;
+    ring->users = 1;
+    ring->shared = shared;
+    ring->user_addr = virt;
+    ring->mm = mm;
+    mm_get(mm);
+    ring->files = proc->cold->files;
+    files_get(ring->files);
+    list_init(&ring->async);
+    init_waitqueue_head(&ring->worker_wait);
+    init_waitqueue_head(&ring->cq_wait);
+    ring->last_submit = timer_ticks;
+
+    char name[PROCESS_NAME_LEN] = "uring-0";
+    name[6] = (char)('0' + id);
+    ring->worker = kthread_create(uring_worker, ring, name);
+    if (!ring->worker) {
+        paging_release_frame(paging_unmap_page_in_directory(mm->pgd, virt));
+        paging_release_frame((uint32_t)shared | PAGE_SHARED | PAGE_PRESENT);
+        mm_put(mm);
+        files_put(ring->files);
+        rings[id] = NULL;
+        kfree(ring);
+        return -1;
+    }
+
+    /* Checked above; the ring stays set up either way */
+    copy_to_user(addr_ptr, &virt, sizeof(virt));
+    return id;
+}
+
+/* sys_uring_enter - Doorbell: submit, and optionally wait for completions */
+int sys_uring_enter(uint32_t id, uint32_t to_submit, uint32_t min_complete, uint32_t flags, uint32_t unused) {
+    (void)unused;
+
+    uring_t *ring = uring_get(id);
+    if (!ring) {
+        return -1;
+    }
+    ring->enters++;
+
+    int submitted = 0;
+    if (ring->flags & URING_SETUP_SQPOLL) {
+        if (flags & URING_ENTER_SQ_WAKEUP) {
+            ring->sqpoll_wakeups++;
+            wake_up(&ring->worker_wait);
+        }
+    } else if (to_submit) {
+        submitted = (int)uring_submit(ring, to_submit);
+    }
+
+    if ((flags & URING_ENTER_GETEVENTS) && min_complete) {
+        uring_shared_t *sh = ring->shared;
+        wait_event(ring->cq_wait, ring->closing || sh->cq_tail - sh->cq_head >= min_complete);
+    }
+
+    uring_put(ring);
+    return submitted;
+}
+
+/* sys_uring_close - Tear a ring down (pending operations are dropped) */
+int sys_uring_close(uint32_t id, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
+    (void)unused1; (void)unused2; (void)unused3; (void)unused4;
+
+    process_t *proc = process_get_current();
+    uring_t *ring = uring_get(id);
+    if (!ring) {
+        return -1;
+    }
+    if (!proc || ring->owner != proc->pid) {
+        uring_put(ring);
+        return -1;
+    }
+
+    uring_close(ring);
+    uring_put(ring);
+    return 0;
+}
+
+/* Print per-ring counters */
+void uring_print_stats(void) {
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Submission rings ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    bool any = false;
+    for (uint32_t i = 0; i < URING_MAX_RINGS; i++) {
+        uring_t *ring = rings[i];
+        if (!ring) {
+            continue;
+        }
+        any = true;
+        printk("Ring %u (PID %u%s) at 0x%x: %u submitted, %u inline, %u async (%u waiting), %u enters",
+               ring->id, ring->owner, (ring->flags & URING_SETUP_SQPOLL) ? ", SQPOLL" : "",
+               ring->user_addr, ring->submitted, ring->completed_inline,
+               ring->completed_async, ring->nr_async, ring->enters);
+        if (ring->flags & URING_SETUP_SQPOLL) {
+            printk(", %u wakeups", ring->sqpoll_wakeups);
+        }
+        printk(", %u CQ overflows\n", ring->shared->cq_overflow);
+    }
+    if (!any) {
+        printk("No rings open\n");
+    }
+}
@@ -0,0 +1,98 @@
+/* vdso.c - Kernel-maintained page for trap-free time and identity reads
+ *
+ * One page of data and one page of code (vdso_code.s) are mapped read-only
+ * and user-accessible at fixed addresses in every address space, so
+ * reading the time, the tick count, the PID or the UID costs a few loads
+ * instead of a system call. The timer interrupt and clocksource switches
+ * rewrite the time fields, the context switch rewrites the identity of
+ * the process running on its CPU (one slot per CPU); both bump a sequence
+ * count around the update.
+ * The kernel writes through the page's identity mapping, the alias is
+ * read-only even for ring 0 (CR0.WP).
+ */
+
+#include "../include/vdso.h"
+#include "../include/paging.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+#include "../include/smp.h"
+
+/* The data page, alone in its frame since the whole frame is visible */
+static union {
+    vdso_data_t data;
+    uint8_t page[PAGE_SIZE];
+} vdso_page __attribute__((aligned(PAGE_SIZE)));
+
+static bool vdso_mapped = false;
+
+/* Map the pages (once paging is set up) */
+void vdso_init(void) {
+    paging_map_vdso_page(VDSO_DATA_ADDR, (uint32_t)&vdso_page);
+    paging_map_vdso_page(VDSO_TEXT_ADDR, (uint32_t)__vdso_text_start);
+    vdso_mapped = true;
+
+    printk("[VDSO] Data page at 0x%x, code page at 0x%x\n", VDSO_DATA_ADDR, VDSO_TEXT_ADDR);
+}
+
+/* Open and close an update (callers have interrupts disabled) */
+static void vdso_write_begin(void) {
+    vdso_page.data.seq++;
+    __asm__ volatile("" ::: "memory");
+}
+
+static void vdso_write_end(void) {
+    __asm__ volatile("" ::: "memory");
+    vdso_page.data.seq++;
+}
+
+/* Timekeeping changed (timer tick or clocksource switch) */
+void vdso_update_time(uint32_t ticks, uint32_t clock_mode, uint32_t mult, uint32_t shift,
+                      uint64_t cycle_last, uint64_t base_ns) {
+    vdso_data_t *vd = &vdso_page.data;
+
+    vdso_write_begin();
+    vd->ticks = ticks;
+    vd->clock_mode = clock_mode;
+    vd->mult = mult;
+    vd->shift = shift;
+    vd->cycle_last = cycle_last;
+    vd->base_ns = base_ns;
+    vdso_write_end();
+}
+
+/* A different process runs on this CPU now, or its uid changed */
+void vdso_update_task(uint32_t pid, uint32_t tid, uint32_t uid) {
+    vdso_task_t *task = &vdso_page.data.tasks[smp_processor_id()];
+
+    task->seq++;
+    __asm__ volatile("" ::: "memory");
+    task->pid = pid;
+    task->tid = tid;
+    task->uid = uid;
+    __asm__ volatile("" ::: "memory");
+    task->seq++;
+}
+
+/* Print the page contents and mapping */
+void vdso_print_info(void) {
+    vdso_data_t *vd = &vdso_page.data;
+
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== vDSO ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    if (!vdso_mapped) {
+        printk("Not mapped\n");
+        return;
+    }
+    printk("Data 0x%x (frame 0x%x), code 0x%x (frame 0x%x), seq %u\n",
+           VDSO_DATA_ADDR, (uint32_t)&vdso_page, VDSO_TEXT_ADDR,
+           (uint32_t)__vdso_text_start, vd->seq);
+    printk("Clock: %s, mult %u shift %u, ticks %u\n",
+           vd->clock_mode == VDSO_CLOCK_TSC ? "tsc" : "coarse (per tick)",
+           vd->mult, vd->shift, vd->ticks);
+    for (uint32_t i = 0; i < smp_online_cpus(); i++) {
+        vdso_task_t *task = &vd->tasks[i];
+        printk("Task (CPU %u): pid %u tid %u uid %u\n", i, task->pid, task->tid, task->uid);
+    }
+}
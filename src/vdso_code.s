@@ -0,0 +1,144 @@
+# vdso_code.s - vDSO code page: reads the kernel-maintained data page
+#
+# Linked into the kernel but only ever run from its read-only alias at
+# VDSO_TEXT_ADDR, so everything here is position independent and only
+# touches the data page at its fixed address (offsets from vdso.h).
+# cdecl: results in eax (edx:eax for 64 bits), ebx/esi/edi/ebp preserved.
+
+# Mark stack as non-executable
+.section .note.GNU-stack,"",@progbits
+
+.set VDSO_DATA,       0xFEFFE000
+.set VD_SEQ,          VDSO_DATA + 0
+.set VD_CLOCK_MODE,   VDSO_DATA + 4
+.set VD_MULT,         VDSO_DATA + 8
+.set VD_SHIFT,        VDSO_DATA + 12
+.set VD_CYCLE_LAST,   VDSO_DATA + 16
+.set VD_BASE_NS,      VDSO_DATA + 24
+.set VD_TICKS,        VDSO_DATA + 32
+.set VD_TASKS,        VDSO_DATA + 36   # vdso_task_t[VDSO_MAX_CPUS], 16 bytes each
+.set VT_SEQ,          0
+.set VT_PID,          4
+.set VT_TID,          8
+.set VT_UID,          12
+.set VDSO_CLOCK_TSC,  1
+
+# Per-CPU task slot: (GS selector >> 3) - GDT_PERCPU_FIRST
+.set GDT_PERCPU_FIRST, 6
+.set VDSO_MAX_CPUS,    8
+
+.section .vdso.text, "ax"
+
+.global __vdso_text_start
+__vdso_text_start:
+
+# uint64_t vdso_clock_gettime_ns(void) - monotonic ns since boot
+.global vdso_clock_gettime_ns
+vdso_clock_gettime_ns:
+    push %ebx
+    push %esi
+    push %edi
+    push %ebp
+
+1:  mov VD_SEQ, %ebp
+    test $1, %ebp
+    jnz 4f                  # Update in progress
+    mov VD_BASE_NS, %esi
+    mov VD_BASE_NS + 4, %edi
+    cmpl $VDSO_CLOCK_TSC, VD_CLOCK_MODE
+    jne 3f
+
+    # delta = rdtsc - cycle_last, clamped to 32 bits
+    rdtsc
+    sub VD_CYCLE_LAST, %eax
+    sbb VD_CYCLE_LAST + 4, %edx
+    jz 2f
+    mov $0xFFFFFFFF, %eax
+2:  mull VD_MULT            # edx:eax = delta * mult
+    mov VD_SHIFT, %ecx
+    cmp $32, %ecx
+    jb 5f
+    mov %edx, %eax          # shift >= 32: take the high word
+    xor %edx, %edx
+    sub $32, %ecx
+5:  shrd %cl, %edx, %eax
+    shr %cl, %edx
+    add %eax, %esi
+    adc %edx, %edi
+
+3:  cmp VD_SEQ, %ebp
+    jne 1b                  # The kernel updated the page meanwhile
+
+    mov %esi, %eax
+    mov %edi, %edx
+    pop %ebp
+    pop %edi
+    pop %esi
+    pop %ebx
+    ret
+
+4:  pause
+    jmp 1b
+
+# A single aligned word: one load is already consistent
+
+# uint32_t vdso_get_ticks(void)
+.global vdso_get_ticks
+vdso_get_ticks:
+    mov VD_TICKS, %eax
+    ret
+
+# Field edx of the running CPU's task slot. The caller may move to another
+# CPU at any point, so retry unless both the slot's seq and GS (the CPU)
+# are the same after the read as before it.
+vdso_task_read:
+    push %ebx
+    push %esi
+
+1:  xor %ecx, %ecx
+    mov %gs, %cx
+    mov %ecx, %eax
+    shr $3, %eax
+    sub $GDT_PERCPU_FIRST, %eax
+    cmp $VDSO_MAX_CPUS, %eax
+    jb 2f
+    xor %eax, %eax          # Not a per-CPU selector: slot 0
+2:  shl $4, %eax
+    add $VD_TASKS, %eax
+
+    mov VT_SEQ(%eax), %ebx
+    test $1, %ebx
+    jnz 3f                  # Update in progress
+    mov (%eax,%edx), %esi
+    cmp VT_SEQ(%eax), %ebx
+    jne 1b                  # The kernel switched tasks meanwhile
+    xor %eax, %eax
+    mov %gs, %ax
+    cmp %eax, %ecx
+    jne 1b                  # Moved to another CPU meanwhile
+
+    mov %esi, %eax
+    pop %esi
+    pop %ebx
+    ret
+
+3:  pause
+    jmp 1b
+
+# uint32_t vdso_getpid(void)
+.global vdso_getpid
+vdso_getpid:
+    mov $VT_PID, %edx
+    jmp vdso_task_read
+
+# uint32_t vdso_gettid(void)
+.global vdso_gettid
+vdso_gettid:
+    mov $VT_TID, %edx
+    jmp vdso_task_read
+
+# uint32_t vdso_getuid(void)
+.global vdso_getuid
+vdso_getuid:
+    mov $VT_UID, %edx
+    jmp vdso_task_read
@@ -6,6 +6,7 @@
 #include "../include/string.h"
 #include "../include/kmalloc.h"
 #include "../include/panic.h"
+#include "../include/pagecache.h"
 
 /* Global VFS state */
 static vfs_state_t vfs_state;
@@ -258,6 +259,8 @@ int vfs_write(vfs_node_t *node, uint32_t offset, uint32_t size, const void *buff
     }
 
     if (node->write) {
+        /* Cached executable pages of the file go stale */
+        pagecache_invalidate(node);
         return node->write(node, offset, size, buffer);
     }
 
@@ -348,6 +351,18 @@ vfs_node_t *vfs_get_root(void) {
     return vfs_state.root;
 }
 
+/* Link a node into an in-memory directory */
+int vfs_add_child(vfs_node_t *parent, vfs_node_t *child) {
+    if (!parent || !child || parent->type != VFS_FILE_TYPE_DIRECTORY) {
+        return -1;
+    }
+
+    child->father = parent;
+    child->next_sibling = parent->children;
+    parent->children = child;
+    return 0;
+}
+
 /* Get file type name */
 const char *vfs_get_type_name(vfs_file_type_t type) {
     switch (type) {
@@ -573,6 +588,22 @@ static vfs_node_t *vfs_virtual_finddir(vfs_node_t *node, const char *name) {
     return NULL;
 }
 
+/* Create an in-memory directory and link it under parent */
+vfs_node_t *vfs_create_dir(vfs_node_t *parent, const char *name) {
+    vfs_node_t *dir = vfs_create_virtual_dir(name);
+    if (!dir) {
+        return NULL;
+    }
+
+    dir->readdir = vfs_virtual_readdir;
+    dir->finddir = vfs_virtual_finddir;
+    if (vfs_add_child(parent, dir) != 0) {
+        kfree(dir);
+        return NULL;
+    }
+    return dir;
+}
+
 /* Initialize VFS */
 void vfs_init(void) {
     printk("[VFS] Initializing Virtual File System...\n");
@@ -95,7 +95,8 @@ static void vga_scroll(void) {
     }
 }
 
-void vga_putchar(char c) {
+/* Put one character, leaving the hardware cursor where it was */
+static void vga_putchar_nocursor(char c) {
     if (c == '\n') {
         vga_column = 0;
         vga_row++;
@@ -117,7 +118,18 @@ void vga_putchar(char c) {
         vga_scroll();
         vga_row = VGA_HEIGHT - 1;
     }
+}
 
+void vga_putchar(char c) {
+    vga_putchar_nocursor(c);
+    vga_update_cursor();
+}
+
+/* Print a buffer, moving the hardware cursor once at the end */
+void vga_write(const char *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        vga_putchar_nocursor(buf[i]);
+    }
     vga_update_cursor();
 }
 
@@ -0,0 +1,85 @@
+/* wait.c - Wait queue implementation */
+
+#include "../include/wait.h"
+#include "../include/process.h"
+#include "../include/idt.h"
+
+/* Initialize a wait queue */
+void init_waitqueue_head(wait_queue_head_t *wq) {
+    list_init(&wq->head);
+}
+
+/* Initialize a waiter for the current process */
+void init_wait_entry(wait_queue_entry_t *wait, uint32_t flags) {
+    list_init(&wait->entry);
+    wait->task = process_get_current();
+    wait->flags = flags;
+}
+
+/* Queue the waiter (if needed) and mark the current process BLOCKED.
+ * Setting the state before the caller re-checks its condition means a
+ * wakeup racing with the check just makes the process READY again. */
+void prepare_to_wait(wait_queue_head_t *wq, wait_queue_entry_t *wait) {
+    bool flags = interrupts_save();
+
+    if (list_empty(&wait->entry)) {
+        if (wait->flags & WQ_FLAG_EXCLUSIVE) {
+            list_add_tail(&wait->entry, &wq->head);
+        } else {
+            list_add(&wait->entry, &wq->head);
+        }
+    }
+    wait->task->state = PROCESS_STATE_BLOCKED;
+
+    interrupts_restore(flags);
+}
+
+/* Dequeue the waiter and mark the current process RUNNING again */
+void finish_wait(wait_queue_head_t *wq, wait_queue_entry_t *wait) {
+    (void)wq;
+    bool flags = interrupts_save();
+
+    wait->task->state = PROCESS_STATE_RUNNING;
+    if (!list_empty(&wait->entry)) {
+        list_del(&wait->entry);
+    }
+
+    interrupts_restore(flags);
+}
+
+/* Wake all non-exclusive waiters and up to nr_exclusive exclusive ones
+ * (nr_exclusive == 0 wakes everybody). Woken waiters are dequeued so a
+ * second wake_up() goes to the next exclusive waiter. */
+void __wake_up(wait_queue_head_t *wq, int nr_exclusive) {
+    list_head_t *pos, *tmp;
+    bool flags = interrupts_save();
+
+    list_for_each_safe(pos, tmp, &wq->head) {
+        wait_queue_entry_t *wait = list_entry(pos, wait_queue_entry_t, entry);
+        bool exclusive = (wait->flags & WQ_FLAG_EXCLUSIVE) != 0;
+
+        list_del(&wait->entry);
+        process_wakeup(wait->task);
+
+        if (exclusive && nr_exclusive > 0 && --nr_exclusive == 0) {
+            break;
+        }
+    }
+
+    interrupts_restore(flags);
+}
+
+/* Check whether anyone is waiting */
+bool waitqueue_active(wait_queue_head_t *wq) {
+    return !list_empty(&wq->head);
+}
+
+/* Give up the CPU until woken */
+void wait_schedule(void) {
+    process_schedule();
+}
+
+/* Give up the CPU until woken or timeout ticks elapse */
+int32_t wait_schedule_timeout(int32_t timeout) {
+    return schedule_timeout(timeout);
+}
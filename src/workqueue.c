@@ -0,0 +1,196 @@
+/* workqueue.c - Deferred work executed by kernel worker threads */
+
+#include "../include/workqueue.h"
+#include "../include/kthread.h"
+#include "../include/kmalloc.h"
+#include "../include/clocksource.h"
+#include "../include/timer.h"
+#include "../include/math64.h"
+#include "../include/idt.h"
+#include "../include/printf.h"
+#include "../include/vga.h"
+
+/* All workqueues, for statistics */
+static workqueue_t *workqueue_list = NULL;
+
+/* Shared queue for schedule_work() */
+static workqueue_t *system_wq = NULL;
+
+/* Worker thread: run queued items in order, sleep when the list is empty */
+static int worker_thread(void *data) {
+    workqueue_t *wq = (workqueue_t *)data;
+
+    while (1) {
+        wait_event(wq->more_work, !list_empty(&wq->worklist));
+
+        bool flags = interrupts_save();
+        work_t *work = list_entry(wq->worklist.next, work_t, entry);
+        list_del(&work->entry);
+        work->pending = false;
+        interrupts_restore(flags);
+
+        uint64_t start = ktime_get_ns();
+        work->func(work);
+        uint64_t elapsed = ktime_get_ns() - start;
+
+        wq->busy_ns += elapsed;
+        if (elapsed > wq->max_ns) {
+            wq->max_ns = elapsed;
+        }
+        wq->completed++;
+    }
+
+    return 0;
+}
+
+/* Create a workqueue with its own worker thread */
+workqueue_t *create_workqueue(const char *name) {
+    workqueue_t *wq = (workqueue_t *)kmalloc(sizeof(workqueue_t));
+    if (!wq) {
+        return NULL;
+    }
+
+    wq->name = name;
+    list_init(&wq->worklist);
+    init_waitqueue_head(&wq->more_work);
+    wq->queued = 0;
+    wq->completed = 0;
+    wq->busy_ns = 0;
+    wq->max_ns = 0;
+    wq->created_ns = ktime_get_ns();
+
+    wq->worker = kthread_create(worker_thread, wq, name);
+    if (!wq->worker) {
+        kfree(wq);
+        return NULL;
+    }
+
+    wq->next = workqueue_list;
+    workqueue_list = wq;
+    return wq;
+}
+
+/* Create the shared "events" workqueue */
+void workqueue_init(void) {
+    system_wq = create_workqueue("events");
+}
+
+/* Queue work (returns false if it was already pending) */
+bool queue_work(workqueue_t *wq, work_t *work) {
+    if (!wq) {
+        return false;
+    }
+
+    bool flags = interrupts_save();
+    if (work->pending) {
+        interrupts_restore(flags);
+        return false;
+    }
+
+    work->pending = true;
+    list_add_tail(&work->entry, &wq->worklist);
+    wq->queued++;
+    wake_up(&wq->more_work);
+
+    interrupts_restore(flags);
+    return true;
+}
+
+/* Timer callback queueing a delayed_work (data is the delayed_work_t *) */
+void delayed_work_timer_fn(uint32_t data) {
+    delayed_work_t *dwork = (delayed_work_t *)data;
+    dwork->work.pending = false;
+    queue_work(dwork->wq, &dwork->work);
+}
+
+/* Queue work after delay ticks (returns false if already pending) */
+bool queue_delayed_work(workqueue_t *wq, delayed_work_t *dwork, uint32_t delay) {
+    if (!wq) {
+        return false;
+    }
+    if (delay == 0) {
+        return queue_work(wq, &dwork->work);
+    }
+
+    bool flags = interrupts_save();
+    if (dwork->work.pending) {
+        interrupts_restore(flags);
+        return false;
+    }
+
+    /* Pending covers the timer phase too, so it cannot be queued twice */
+    dwork->work.pending = true;
+    dwork->wq = wq;
+    mod_timer(&dwork->timer, timer_ticks + delay);
+
+    interrupts_restore(flags);
+    return true;
+}
+
+/* Cancel work that has not started yet (returns true if it was pending) */
+bool cancel_work(work_t *work) {
+    bool cancelled = false;
+    bool flags = interrupts_save();
+
+    if (work->pending && !list_empty(&work->entry)) {
+        list_del(&work->entry);
+        work->pending = false;
+        cancelled = true;
+    }
+
+    interrupts_restore(flags);
+    return cancelled;
+}
+
+bool cancel_delayed_work(delayed_work_t *dwork) {
+    bool flags = interrupts_save();
+    bool cancelled = del_timer(&dwork->timer) != 0;
+
+    if (cancelled) {
+        dwork->work.pending = false;
+    } else {
+        cancelled = cancel_work(&dwork->work);
+    }
+
+    interrupts_restore(flags);
+    return cancelled;
+}
+
+/* Same, on the shared "events" workqueue */
+bool schedule_work(work_t *work) {
+    return queue_work(system_wq, work);
+}
+
+bool schedule_delayed_work(delayed_work_t *dwork, uint32_t delay) {
+    return queue_delayed_work(system_wq, dwork, delay);
+}
+
+/* Print per-worker statistics */
+void workqueue_print_stats(void) {
+    vga_set_color(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK);
+    printk("\n=== Workqueues ===\n");
+    vga_set_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK);
+
+    uint64_t now = ktime_get_ns();
+    for (workqueue_t *wq = workqueue_list; wq; wq = wq->next) {
+        uint64_t lifetime_us = div_u64(now - wq->created_ns, NSEC_PER_USEC);
+        uint64_t busy_us = div_u64(wq->busy_ns, NSEC_PER_USEC);
+        uint32_t permille = 0;
+
+        /* Scale both down until the divisor fits in 32 bits */
+        uint64_t num = busy_us * 1000;
+        while (lifetime_us >> 32) {
+            lifetime_us >>= 1;
+            num >>= 1;
+        }
+        if (lifetime_us) {
+            permille = (uint32_t)div_u64(num, (uint32_t)lifetime_us);
+        }
+
+        printk("  %s (PID %d): queued %u, done %u, pending %u\n", wq->name,
+               wq->worker ? wq->worker->pid : 0, wq->queued, wq->completed,
+               wq->queued - wq->completed);
+        printk("    busy %u us (%u.%u%%), longest item %u us\n", (uint32_t)busy_us,
+               permille / 10, permille % 10, (uint32_t)div_u64(wq->max_ns, NSEC_PER_USEC));
+    }
+}